@@ -118,6 +118,8 @@ typedef struct {
     int td_lastframe;    // to meter out one message a frame
     int td_startframe;   // host_framecount at start
     float td_starttime;  // realtime at second frame of timedemo
+    float td_timestep;   // fixed host_frametime for benchdemo, 0 = off
+    qboolean td_nullvid; // benchdemo without screen updates
 
     // connection information
     int signon;  // 0 to SIGNONS
@@ -338,6 +340,7 @@ void CL_Stop_f(void);
 void CL_Record_f(void);
 
 void CL_TimeDemo_f(void);
+void CL_BenchDemo_f(void);
 void CL_PlayDemo_f(void);
 struct stree_root *CL_Demo_Arg_f(const char *arg);
 
@@ -346,6 +349,31 @@ struct stree_root *CL_Demo_Arg_f(const char *arg);
 //
 void CL_ParseServerMessage(void);
 
+//
+// cl_lerp.c
+//
+#define LERP_GRAPH 128 /* frames shown by cl_lerpgraph */
+
+typedef struct {
+    float delay;   /* newest message time less the render clock */
+    float jitter;  /* mean deviation of message arrival, seconds */
+    int depth;     /* messages the render clock has not reached */
+    unsigned late; /* messages that came after the clock ran out */
+    float ahead[LERP_GRAPH]; /* delay, frame by frame */
+    int head;
+} lerpstats_t;
+
+extern cvar_t cl_lerpbuffer;
+extern cvar_t cl_lerpgraph;
+extern lerpstats_t cl_lerpstats;
+
+void CL_LerpInit(void);
+void CL_LerpClear(void);
+void CL_LerpMessage(void);
+void CL_LerpUpdate(int num, const entity_t *ent, qboolean reset);
+qboolean CL_LerpFrame(void);
+void CL_LerpEntity(int num, entity_t *ent);
+
 //
 // view.c
 //
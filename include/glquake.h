@@ -123,6 +123,9 @@ extern int r_visframecount;  // ??? what difs?
 extern int r_framecount;
 extern int c_brush_polys;
 extern int c_lightmaps_uploaded;
+extern int c_program_switches;
+extern int c_texture_binds;
+extern int c_draw_calls;
 
 //
 // view origin
@@ -172,6 +175,9 @@ extern cvar_t gl_reporttjunctions;
 extern cvar_t gl_flashblend;
 extern cvar_t gl_nocolors;
 extern cvar_t gl_zfix;
+extern cvar_t gl_aliasvbo;
+extern cvar_t gl_singlepass;
+extern cvar_t gl_overbright;
 extern cvar_t gl_finish;
 extern cvar_t gl_subdivide_size;
 
@@ -289,6 +295,7 @@ void R_DrawWorld(void);
 void R_DrawWorldHull(void); /* Quick hack for now... */
 void R_DrawWaterSurfaces(void);
 void R_RenderBrushPoly(const entity_t *e, msurface_t *fa);
+void R_FlushSurfaceQueue(void);
 void GL_BuildLightmaps(void *hunkbase);
 
 //
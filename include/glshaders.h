@@ -68,6 +68,60 @@ static const char *QGL_SHADER_VERTEX_ONLY_SRC = R"(
     }
 )";
 
+/*
+ * Alias models: both poses live in a static vertex buffer, the lerp and
+ * the anorm_dots lighting are done here instead of per vertex on the CPU.
+ * ShadeDot reproduces anorm_dots.h for a shade vector built from the same
+ * quantized yaw the table is indexed with.
+ */
+static const char *QGL_SHADER_ALIAS_SRC = R"(
+    precision highp float;
+
+    attribute vec3 inPose0;
+    attribute vec3 inNormal0;
+    attribute vec3 inPose1;
+    attribute vec3 inNormal1;
+    attribute vec2 inTexCoord;
+    uniform mat4 uMVP;
+    uniform float uBlend;
+    uniform vec3 uShadeVector;
+    uniform float uShadeLight;
+
+    varying vec2 vTexCoord;
+    varying vec4 vColor;
+
+    float ShadeDot(vec3 normal) {
+      float d = dot(normal, uShadeVector);
+      return d < 0.0 ? 1.0 + d * (13.0 / 44.0) : 1.0 + d;
+    }
+
+    void main() {
+      vec3 normal = uBlend < 0.5 ? inNormal0 : inNormal1;
+      float light = ShadeDot(normal) * uShadeLight;
+      gl_Position = uMVP * vec4(mix(inPose0, inPose1, uBlend), 1.0);
+      vTexCoord = inTexCoord;
+      vColor = vec4(light, light, light, 1.0);
+    }
+)";
+
+// world surfaces: base texture and lightmap in one pass
+static const char *QGL_SHADER_LIGHTMAPPED_VS_SRC = R"(
+    precision highp float;
+
+    attribute vec3 inPos;
+    attribute vec2 inTexCoord;
+    attribute vec2 inLMCoord;
+    uniform mat4 uMVP;
+
+    varying vec2 vTexCoord;
+    varying vec2 vLMCoord;
+
+    void main() {
+      gl_Position = uMVP * vec4(inPos, 1.0);
+      vTexCoord = inTexCoord;
+      vLMCoord = inLMCoord;
+    }
+)";
 
 //
 // frag
@@ -170,6 +224,26 @@ static const char *QGL_SHADER_RGBA_A_SRC = R"(
     }
 )";
 
+/*
+ * Lightmaps are stored inverted for the GL_ZERO, GL_ONE_MINUS_SRC_COLOR
+ * blend of the two-pass path; uLightScale is 2.0 when they were built with
+ * an extra bit of range for overbrights.
+ */
+static const char *QGL_SHADER_LIGHTMAPPED_SRC = R"(
+    precision mediump float;
+
+    varying vec2 vTexCoord;
+    varying vec2 vLMCoord;
+    uniform sampler2D uTexture;
+    uniform sampler2D uLightmap;
+    uniform float uLightScale;
+
+    void main() {
+      float light = (1.0 - texture2D(uLightmap, vLMCoord).r) * uLightScale;
+      gl_FragColor = vec4(texture2D(uTexture, vTexCoord).rgb * light, 1.0);
+    }
+)";
+
 static const char *QGL_SHADER_MONO_COLOR_SRC = R"(
     precision mediump float;
 
@@ -180,4 +254,4 @@ static const char *QGL_SHADER_MONO_COLOR_SRC = R"(
     }
 )";
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
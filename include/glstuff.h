@@ -18,11 +18,14 @@
 #define QGL_SHADER_MODULATE_A 6
 #define QGL_SHADER_RGBA_A 7
 #define QGL_SHADER_REPLACE_A 8
+#define QGL_SHADER_LIGHTMAPPED 9
 // vertex shaders
 #define QGL_SHADER_TEXTURE2D 0
 #define QGL_SHADER_TEXTURE2D_WITH_COLOR 1
 #define QGL_SHADER_COLOR 2
 #define QGL_SHADER_VERTEX_ONLY 3
+#define QGL_SHADER_ALIAS 4
+#define QGL_SHADER_LIGHTMAPPED_VS 5
 // shader programs
 #define QGL_SHADER_TEX2D_REPL 0
 #define QGL_SHADER_TEX2D_MODUL 1
@@ -33,6 +36,24 @@
 #define QGL_SHADER_TEX2D_MODUL_A 6
 #define QGL_SHADER_RGBA_CLR_A 7
 #define QGL_SHADER_FULL_A 8
+#define QGL_SHADER_ALIAS_MODUL_CLR 9
+#define QGL_SHADER_TEX2D_LIGHTMAP 10
+
+#define QGL_NUM_FS 10
+#define QGL_NUM_VS 6
+#define QGL_NUM_PROGRAMS 11
+
+// attribute locations for QGL_SHADER_ALIAS
+#define QGL_ATTR_POSE0 0
+#define QGL_ATTR_NORMAL0 1
+#define QGL_ATTR_POSE1 2
+#define QGL_ATTR_NORMAL1 3
+#define QGL_ATTR_TEXCOORD 4
+
+// attribute locations for QGL_SHADER_LIGHTMAPPED_VS
+#define QGL_ATTR_LM_POS 0
+#define QGL_ATTR_LM_TEXCOORD 1
+#define QGL_ATTR_LM_LMCOORD 2
 
 // gl1 imm shit
 
@@ -65,6 +86,17 @@ qboolean QGL_Init(void);
 void QGL_Deinit(void);
 void QGL_EndFrame(void);
 
+// hardware alias models: bind the alias program with the current matrices,
+// the caller points the QGL_ATTR_* arrays at its buffers and draws
+void QGL_BeginAlias(GLfloat blend, const GLfloat *shadevector, GLfloat shadelight);
+void QGL_EndAlias(void);
+
+// single-pass world surfaces: texture on unit 0, lightmap on unit 1;
+// verts are glpoly_t verts (xyz s1t1 s2t2)
+void QGL_BeginLightmapped(GLfloat lightscale);
+void QGL_DrawLightmappedPoly(const GLfloat *verts, int numverts);
+void QGL_EndLightmapped(void);
+
 void qglBegin(GLenum prim);
 void qglEnd(void);
 
@@ -334,9 +334,18 @@ typedef struct {
 typedef struct {
     int commands;  // gl command list with embedded s/t
     int textures;  /* Offset to GLuint texture names */
+    GLuint vertexbuffer;  /* s/t coords, followed by every pose */
+    GLuint indexbuffer;   /* triangle list built from the commands */
+    int numindices;
     aliashdr_t ahdr;
 } gl_aliashdr_t;
 
+/* Per-pose vertex layout in the GL vertex buffer */
+typedef struct {
+    byte v[4];         /* position, w unused */
+    signed char n[4];  /* unit normal scaled by 127, w unused */
+} gl_aliasvert_t;
+
 static inline gl_aliashdr_t *GL_Aliashdr(aliashdr_t *h) {
     return container_of(h, gl_aliashdr_t, ahdr);
 }
@@ -603,9 +612,14 @@ typedef struct {
     float fraction;  // time completed, 1.0 = didn't hit anything
     vec3_t endpos;   // final position
     mplane_t plane;  // surface normal at impact
+    qboolean backedup; // impact backed up past the start, for the caller to report
 } trace_t;
 
 qboolean Mod_TraceHull(const hull_t *hull, int nodenum, const vec3_t p1, const vec3_t p2,
                        trace_t *trace);
 
+/* The original recursive walk, for checking Mod_TraceHull against */
+qboolean Mod_TraceHullRecursive(const hull_t *hull, int nodenum, const vec3_t p1, const vec3_t p2,
+                                trace_t *trace);
+
 #endif /* MODEL_H */
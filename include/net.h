@@ -48,10 +48,27 @@ typedef struct {
 #define NETFLAG_NAK 0x00040000
 #define NETFLAG_EOM 0x00080000
 #define NETFLAG_UNRELIABLE 0x00100000
+#define NETFLAG_COMPRESSED 0x00200000 /* on each fragment of an LZ compressed message */
 #define NETFLAG_CTL 0x80000000
 
 #define NET_PROTOCOL_VERSION 3
 
+/*
+ * Optional transport extensions, offered by the client after the protocol
+ * version in CCREQ_CONNECT and echoed by the server after the port in
+ * CCREP_ACCEPT. Older peers stop reading before the extra bytes, so a
+ * connection only uses an extension if both sides named it. The value is
+ * chosen not to clash with the ProQuake mod byte sent in the same place.
+ */
+#define NETOPT_WINDOW 0x80   /* windowed reliable transport with selective acks */
+#define NETOPT_COMPRESS 0x40 /* LZ compressed reliable messages, see net_lz.c */
+
+#define NET_COMPRESS_MIN 128 /* smaller reliable messages are sent as they are */
+
+#define NET_WINDOW 32 /* max reliable fragments in flight, power of two */
+#define NET_INITIAL_WINDOW 4
+#define NET_INITIAL_RTO 1.0 /* seconds, also the stop-and-wait resend time */
+
 /*
  * This is the network info/connection protocol.  It is used to find Quake
  * servers, get info about them, and connect to them.  Once connected, the
@@ -64,6 +81,8 @@ typedef struct {
  * CCREQ_CONNECT
  *              string  game_name               "QUAKE"
  *              byte    net_protocol_version    NET_PROTOCOL_VERSION
+ *              byte    net_options             NETOPT_* (optional)
+ *              short   fragment_size           (only with net_options)
  *
  * CCREQ_SERVER_INFO
  *              string  game_name               "QUAKE"
@@ -79,6 +98,9 @@ typedef struct {
  *
  * CCREP_ACCEPT
  *              long    port
+ *              byte    net_options             accepted NETOPT_* (only if
+ *                                              the client sent any)
+ *              short   fragment_size           used in both directions
  *
  * CCREP_REJECT
  *              string  reason
@@ -128,6 +150,13 @@ typedef struct {
 struct net_landriver_s;
 struct net_driver_s;
 
+/* a reliable fragment in flight on a windowed connection */
+typedef struct {
+    double time; /* last (re)transmission */
+    qboolean resent;
+    qboolean acked;
+} netfragment_t;
+
 typedef struct qsocket_s {
     struct qsocket_s *next;
     double connecttime;
@@ -155,6 +184,38 @@ typedef struct qsocket_s {
     int receiveMessageLength;
     byte receiveMessage[NET_MAXMESSAGE];
 
+    /*
+     * Windowed transport (NETOPT_WINDOW). The reliable message is still sent
+     * one at a time, but up to 'window' of its fragments are in flight at
+     * once; ackSequence is the first fragment the peer has not acked and
+     * receiveMask holds the fragments received beyond receiveSequence.
+     */
+    qboolean windowed;
+    unsigned int messageSequence; /* sequence of the first fragment of sendMessage */
+    int sendFragments;
+    int window; /* congestion window, in fragments */
+    netfragment_t sendWindow[NET_WINDOW];
+    double rtt, rttvar, rto; /* seconds, rtt < 0 until the first sample */
+    int retransmits;
+    unsigned int receiveMask;
+    unsigned int receiveEOM;
+    int receiveEOMLength; /* -1 if the last fragment has not arrived */
+
+    /* NETOPT_COMPRESS, flags for the message being sent and received */
+    qboolean compress;
+    qboolean sendCompressed;
+    qboolean receiveCompressed;
+
+    /*
+     * Server connections on the shared listening socket (net_sharedsocket)
+     * are found by address and get their packets queued by the driver.
+     */
+    qboolean shared;
+    struct qsocket_s *hashNext;
+    int queueHead, queueTail; /* driver packet indices, -1 if empty */
+
+    int broadcasts; /* NET_SendToAll messages not yet sent and acked */
+
     netadr_t addr;
 
     char address[NET_NAMELEN];
@@ -164,6 +225,13 @@ typedef struct qsocket_s {
 extern qsocket_t *net_activeSockets;
 extern qsocket_t *net_freeSockets;
 
+/* one datagram for the batched landriver calls */
+typedef struct {
+    void *data;
+    int length; /* buffer size on read, then bytes received; bytes to send */
+    netadr_t addr;
+} netpacket_t;
+
 typedef struct net_landriver_s {
     const char *name;
     qboolean initialized;
@@ -181,6 +249,10 @@ typedef struct net_landriver_s {
     int (*GetNameFromAddr)(const netadr_t *addr, char *name);
     int (*GetAddrFromName)(const char *name, netadr_t *addr);
     int (*GetDefaultMTU)(void);
+    int (*ListenSocket)(void); /* -1 if not listening */
+    int (*ReadBatch)(int socket, netpacket_t *packets, int count);
+    int (*WriteBatch)(int socket, const netpacket_t *packets, int count);
+    int (*Wait)(const int *sockets, int count, double timeout); /* until readable */
 } net_landriver_t;
 
 extern int net_numlandrivers;
@@ -201,12 +273,17 @@ typedef struct net_driver_s {
     qboolean (*CanSendUnreliableMessage)(qsocket_t *sock);
     void (*Close)(qsocket_t *sock);
     void (*Shutdown)(void);
+    void (*Flush)(void); /* optional, send anything held back for batching */
+    void (*Wait)(qsocket_t *const *socks, int count, double timeout); /* optional */
+    byte *(*SendBuffer)(qsocket_t *sock, int *size);                  /* optional */
     int controlSock;
 } net_driver_t;
 
 extern int net_numdrivers;
 extern net_driver_t net_drivers[];
 
+#define IS_LOOP_DRIVER(p) ((p) == &net_drivers[0])
+
 extern int DEFAULTnet_hostport;
 extern int net_hostport;
 
@@ -295,7 +372,17 @@ int NET_SendMessage(struct qsocket_s *sock, const sizebuf_t *data);
 int NET_SendUnreliableMessage(struct qsocket_s *sock, const sizebuf_t *data);
 
 /*
- * This is a reliable *blocking* send to all attached clients.
+ * Returns a buffer of *size bytes to build the next unreliable message in,
+ * or NULL if the driver has none. Sent from there with the next
+ * NET_SendUnreliableMessage, the message is not copied.
+ */
+byte *NET_SendBuffer(struct qsocket_s *sock, int *size);
+
+/*
+ * Reliable send to all attached clients. Blocks for up to blocktime seconds
+ * waiting for the acks and returns the number of clients still pending;
+ * they keep receiving it from NET_Poll, and NET_CanSendMessage is false for
+ * them until it is acked.
  */
 int NET_SendToAll(const sizebuf_t *data, double blocktime);
 
@@ -310,6 +397,12 @@ int NET_SendToAll(const sizebuf_t *data, double blocktime);
  */
 void NET_Close(struct qsocket_s *sock);
 
+/*
+ * Sends anything the drivers are holding back to batch up; the server calls
+ * it once it has written a frame's messages
+ */
+void NET_Flush(void);
+
 void NET_Poll(void);
 
 typedef struct _PollProcedure {
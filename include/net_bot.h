@@ -0,0 +1,57 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef NET_BOT_H
+#define NET_BOT_H
+
+#include "common.h"
+#include "mathlib.h"
+#include "qtypes.h"
+
+// net_bot.h -- headless protocol clients for net_loadtest
+
+/*
+ * The game side of a load test client: parses server messages the way
+ * CL_ParseServerMessage does without keeping any of it, answers the signon
+ * stages like CL_SignonReply and makes up movement. The transport is left
+ * to the caller.
+ */
+typedef struct {
+    int index;
+    int protocol; /* 0 until svc_serverinfo */
+    int signon;   /* last svc_signonnum */
+    int replied;  /* signon stage answered */
+    qboolean active; /* signed on, sending moves */
+    qboolean disconnected;
+    double servertime; /* from the last svc_time */
+    vec3_t viewangles;
+
+    /* statistics */
+    unsigned messages, errors;
+    unsigned ticks;
+    double tickTotal, tickMax; /* between svc_times once active */
+} bot_t;
+
+void Bot_Reset(bot_t *bot, int index);
+qboolean Bot_ParseServerMessage(bot_t *bot);
+void Bot_SignonReply(bot_t *bot, sizebuf_t *msg);
+void Bot_WriteMove(bot_t *bot, sizebuf_t *msg, double time);
+
+#endif /* NET_BOT_H */
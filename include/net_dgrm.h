@@ -37,5 +37,7 @@ qboolean Datagram_CanSendMessage(qsocket_t *sock);
 qboolean Datagram_CanSendUnreliableMessage(qsocket_t *sock);
 void Datagram_Close(qsocket_t *sock);
 void Datagram_Shutdown(void);
+void Datagram_Flush(void);
+void Datagram_Wait(qsocket_t *const *socks, int count, double timeout);
 
 #endif /* NET_DGRM_H */
@@ -38,5 +38,6 @@ qboolean Loop_CanSendUnreliableMessage(qsocket_t *sock);
 void Loop_Close(qsocket_t *sock);
 void Loop_Shutdown(void);
 int Loop_GetDefaultMTU(void);
+byte *Loop_SendBuffer(qsocket_t *sock, int *size);
 
 #endif /* NET_LOOP_H */
@@ -0,0 +1,37 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef NET_LZ_H
+#define NET_LZ_H
+
+#include "qtypes.h"
+
+// net_lz.h -- LZ compression of reliable messages (NETOPT_COMPRESS)
+
+/*
+ * Returns the compressed length, or 0 if the result would not fit in
+ * outsize bytes (pass less than inlen to only accept a saving).
+ */
+int LZ_Compress(const byte *in, int inlen, byte *out, int outsize);
+
+/* Returns the decompressed length, or -1 if the data is corrupt */
+int LZ_Decompress(const byte *in, int inlen, byte *out, int outsize);
+
+#endif /* NET_LZ_H */
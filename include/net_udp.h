@@ -38,5 +38,9 @@ int UDP_GetSocketAddr(int socket, netadr_t *addr);
 int UDP_GetNameFromAddr(const netadr_t *addr, char *name);
 int UDP_GetAddrFromName(const char *name, netadr_t *addr);
 int UDP_GetDefaultMTU(void);
+int UDP_ListenSocket(void);
+int UDP_ReadBatch(int socket, netpacket_t *packets, int count);
+int UDP_WriteBatch(int socket, const netpacket_t *packets, int count);
+int UDP_Wait(const int *sockets, int count, double timeout);
 
 #endif /* NET_UDP_H */
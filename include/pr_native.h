@@ -0,0 +1,99 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef PR_NATIVE_H
+#define PR_NATIVE_H
+
+#include <string.h>
+
+#include "pr_comp.h"
+#include "progs.h"
+#include "server.h"
+
+#ifdef NQ_HACK
+#include "quakedef.h"
+#endif
+#ifdef QW_HACK
+#include "qwsvdef.h"
+#endif
+
+/*
+ * Native QuakeC. The pr_translate command writes the loaded progs out as a C
+ * file; built into the engine, that file registers a table of functions that
+ * replace the interpreter for progs with a matching CRC. Translated functions
+ * work directly on pr_globals and the edicts exactly as the interpreter does,
+ * so native and interpreted functions can call each other freely.
+ */
+typedef void (*prnativefunc_t)(void);
+
+typedef struct {
+    int crc; /* CRC_Block of the whole progs.dat */
+    int numfunctions;
+    int numstatements;
+    const prnativefunc_t *functions; /* by function number, NULL if not translated */
+} prnativeprogs_t;
+
+extern const prnativefunc_t *pr_nativefunctions; /* for the loaded progs, or NULL */
+extern int pr_nativerunaway;
+
+void PR_NativeInit(void);
+void PR_NativeRegister(const prnativeprogs_t *native);
+void PR_NativeBind(int crc);
+void PR_NativeFrame(void);
+
+/* pr_exec.c */
+void PR_NativeCall(func_t fnum);
+
+#define PR_NATIVE_REGISTER(native)                                                \
+    static void __attribute__((constructor)) PR_NativeRegister_##native(void) { \
+        PR_NativeRegister(&native);                                               \
+    }
+
+/*
+ * Helpers for translated code, mirroring the matching cases in
+ * PR_ExecuteProgram
+ */
+#define PRN_G(o) ((eval_t *)&pr_globals[o])
+#define PRN_RUNAWAY() \
+    if (!--pr_nativerunaway) PR_RunError("runaway loop error")
+
+static inline eval_t *PRN_Pointer(int ofs) { return (eval_t *)((byte *)sv.edicts + ofs); }
+
+static inline eval_t *PRN_Field(int edict, int field) {
+    return (eval_t *)((int *)&PROG_TO_EDICT(edict)->v + field);
+}
+
+static inline int PRN_Address(int edict, int field) {
+    edict_t *ed = PROG_TO_EDICT(edict);
+
+    if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+        PR_RunError("assignment to world entity");
+    return (byte *)((int *)&ed->v + field) - (byte *)sv.edicts;
+}
+
+static inline void PRN_State(float frame, func_t think) {
+    edict_t *ed = PROG_TO_EDICT(pr_global_struct->self);
+
+    ed->v.nextthink = pr_global_struct->time + 0.1;
+    if (frame != ed->v.frame) ed->v.frame = frame;
+    ed->v.think = think;
+}
+
+#endif /* PR_NATIVE_H */
@@ -0,0 +1,71 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef PROF_H
+#define PROF_H
+
+#include "cvar.h"
+#include "qtypes.h"
+
+/*
+ * Per-subsystem frame timers. Each timer accumulates the time spent between
+ * PROF_BEGIN/PROF_END pairs during a host frame; Prof_EndFrame stores the
+ * totals into a ring buffer of recent frames (and the trace file, if one is
+ * open). When host_profile is off the macros reduce to a single test of
+ * prof_active.
+ */
+typedef enum {
+    PROF_FRAME,       /* wall time since the previous host frame */
+    PROF_HOST,        /* everything inside _Host_Frame */
+    PROF_SERVER,      /* Host_ServerFrame */
+    PROF_SV_PHYSICS,  /* SV_Physics */
+    PROF_SV_SEND,     /* SV_SendClientMessages */
+    PROF_CL_READ,     /* CL_ReadFromServer */
+    PROF_SCREEN,      /* SCR_UpdateScreen, including buffer swap */
+    PROF_RENDER,      /* R_RenderView */
+    PROF_SOUND,       /* S_Update */
+    PROF_NUM_TIMERS
+} prof_timer_t;
+
+#define PROF_HISTORY 4096 /* must be a power of two */
+
+extern cvar_t host_profile;
+extern qboolean prof_active;
+
+void Prof_Init(void);
+void Prof_Shutdown(void);
+void Prof_BeginFrame(void);
+void Prof_EndFrame(void);
+void Prof_Begin(prof_timer_t timer);
+void Prof_End(prof_timer_t timer);
+void Prof_Report(int frames);
+void Prof_Reset(void);
+void Prof_Force(qboolean enable);
+
+#define PROF_BEGIN(t)                   \
+    do {                                \
+        if (prof_active) Prof_Begin(t); \
+    } while (0)
+#define PROF_END(t)                   \
+    do {                              \
+        if (prof_active) Prof_End(t); \
+    } while (0)
+
+#endif /* PROF_H */
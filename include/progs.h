@@ -35,12 +35,25 @@ typedef union eval_s {
 } eval_t;
 
 #define MAX_ENT_LEAFS 16
+/*
+ * The range of abs boxes that would touch the same leaves as the last one
+ * SV_LinkEdict walked the BSP for; see SV_FindTouchedLeafs
+ */
+typedef struct {
+    int worldcount; /* sv_worldcount when filled in, stale if different */
+    vec3_t minlo, minhi; /* minlo <= absmin < minhi */
+    vec3_t maxlo, maxhi; /* maxlo < absmax <= maxhi */
+} leafcache_t;
+
 typedef struct edict_s {
     qboolean free;
     link_t area;  // linked to a division node or leaf
+    struct arealist_s *arealist;  // packed copy of the area link, see world.c
+    int areaslot;
 
     int num_leafs;
     short leafnums[MAX_ENT_LEAFS];
+    leafcache_t leafcache;
 
     entity_state_t baseline;
 
@@ -72,6 +85,24 @@ void PR_Profile_f(void);
 
 edict_t *ED_Alloc(void);
 void ED_Free(edict_t *ed);
+void ED_ResetLists(void);
+void ED_StringFieldStored(int ofs);
+void ED_SetString(string_t *field, const char *s);
+int ED_FindIndexed(int start, int field, const char *s);
+qboolean PF_IsTempString(const char *s);
+
+/* edict allocation and search counters, reported by "profile" */
+typedef struct {
+    unsigned alloc_reused;      /* taken from the free queue */
+    unsigned alloc_new;         /* added to the end of the array */
+    unsigned findradius;
+    unsigned findradius_tested; /* edicts distance checked */
+    unsigned find;
+    unsigned find_indexed;      /* answered from the find index */
+    unsigned find_tested;       /* edicts string compared */
+} edsearchstats_t;
+
+extern edsearchstats_t ed_searchstats;
 
 // returns a copy of the string allocated from the server's string heap
 
@@ -141,6 +172,20 @@ extern func_t SpectatorDisconnect;
 
 void PR_RunError(const char *error, ...) __attribute__((noreturn, format(printf, 1, 2)));
 
+/*
+ * Wall clock profiler (pr_prof.c), enabled by the pr_profile cvar.
+ * The interpreter calls Enter/Leave around every QuakeC function and builtin
+ * while pr_profiling is set.
+ */
+extern qboolean pr_profiling;
+
+void PR_ProfInit(void);
+void PR_ProfReset(void);
+void PR_ProfBeginExecute(void);
+void PR_ProfAbort(void);
+void PR_ProfEnter(int function);
+void PR_ProfLeave(void);
+
 void ED_PrintEdicts(void);
 void ED_PrintNum(int ent);
 
@@ -152,6 +197,8 @@ eval_t *GetEdictFieldValue(edict_t *ed, const char *field);
 void PR_InitStringTable(void);
 const char *PR_GetString(int num);
 int PR_SetString(const char *s);
+int PR_NumStrings(void);
+void PR_RestoreStringTable(const char *const *strings, int count);
 
 /*
  * Somehow, I don't think this should be exposed - but better to have it here
@@ -154,6 +154,7 @@ void R_Init(void);
 void R_InitTextures(void);
 void R_InitEfrags(void);
 void R_RenderView(void);  // must set r_refdef first
+unsigned R_FrameChecksum(void);  // of the refresh window, before presenting
 void R_ViewChanged(vrect_t *pvrect, int lineadj, float aspect);
 // called whenever r_refdef or vid change
 
@@ -34,6 +34,7 @@ void SCR_CenterPrint(const char *str);
 void SCR_BeginLoadingPlaque(void);
 void SCR_EndLoadingPlaque(void);
 int SCR_ModalMessage(const char *text);
+unsigned SCR_FrameChecksum(void);
 
 extern float scr_con_current;
 extern float scr_centertime_off;
@@ -63,6 +63,10 @@ typedef struct {
     sizebuf_t signon;
     byte signon_buf[MAX_MSGLEN];
 
+    sizebuf_t serverinfo; /* serverinfo and precaches, built once per map */
+    byte serverinfo_buf[MAX_MSGLEN];
+    int gametype; /* GAME_COOP or GAME_DEATHMATCH in serverinfo */
+
     int protocol; /* Active network protocol version */
 } server_t;
 
@@ -86,6 +90,9 @@ typedef struct client_s {
     sizebuf_t message;  // can be added to at any time,
                         // copied and clear once per frame
     byte msgbuf[MAX_MSGLEN];
+    sizebuf_t datagram; // sv.datagram held until the next datagram goes out
+    byte datagram_buf[MAX_DATAGRAM];
+    const sizebuf_t *signondata; /* shared, sent before message */
     edict_t *edict;  // EDICT_NUM(clientnum+1)
     char name[32];   // for printing to other people
     int colors;
@@ -98,6 +105,15 @@ typedef struct client_s {
 
     // client known data for deltas
     int old_frags;
+
+    /* rate control, see SV_SendClientDatagram */
+    int rate;            // bytes/sec asked for with "rate", 0 for no limit
+    int snaps;           // snapshots/sec asked for with "snaps", 0 for no limit
+    double cleartime;    // when what was already sent has drained at rate
+    double nextsnapshot; // earliest realtime for the next datagram
+    unsigned sent, skipped, thinned, overflows;
+    byte entskips[MAX_EDICTS]; // datagrams each entity was left out of in a row
+    byte entsent[MAX_EDICTS];  // entities in the last datagram sent
 } client_t;
 
 //=============================================================================
@@ -189,6 +205,11 @@ extern cvar_t sv_maxspeed;
 extern cvar_t sv_accelerate;
 extern cvar_t sv_idealpitchscale;
 extern cvar_t sv_aim;
+extern cvar_t sv_fastfind;
+extern cvar_t sv_fastfindradius;
+extern cvar_t sv_parallelphysics;
+extern cvar_t sv_maxrate;
+extern cvar_t sv_maxsnapshots;
 
 extern server_static_t svs;  // persistant server info
 extern server_t sv;          // local server
@@ -205,6 +226,7 @@ void SV_StartSound(edict_t *entity, int channel, const char *sample, int volume,
 void SV_DropClient(client_t *client, qboolean crash);
 
 void SV_SendClientMessages(void);
+void SV_SendSignonData(client_t *client, const sizebuf_t *data);
 void SV_ClearDatagram(void);
 
 int SV_ModelIndex(const char *name);
@@ -219,6 +241,7 @@ void SV_ClientPrintf(client_t *client, const char *fmt, ...) __attribute__((form
 void SV_BroadcastPrintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 
 void SV_Physics(void);
+void SV_PhysStress_f(void);
 
 qboolean SV_CheckBottom(edict_t *ent);
 qboolean SV_movestep(edict_t *ent, vec3_t move, qboolean relink);
@@ -233,6 +256,37 @@ void SV_SaveSpawnparms();
 
 void SV_SpawnServer(char *server);
 
+/*
+ * Binary snapshots of the QuakeC state (sv_snap.c), for fast save/load and
+ * the rewind history
+ */
+typedef struct {
+    int magic;
+    int version;
+    int crc; /* pr_crc of the progs it was saved with */
+    int numglobals;
+    int entityfields;
+    int num_edicts;
+    int numstrings;
+    int skill;
+    double time;
+    char mapname[64];
+    float spawn_parms[NUM_SPAWN_PARMS];
+    int size; /* of the whole file, filled in by SV_SnapLoad */
+} snapheader_t;
+
+void SV_SnapInit(void);
+void SV_SnapUpdate(void);
+void SV_SnapShutdown(void);
+qboolean SV_SnapSave(const char *filename);
+snapheader_t *SV_SnapLoad(const char *filename);
+qboolean SV_SnapRestore(snapheader_t *header);
+void SV_SnapFree(snapheader_t *header);
+
+void SV_RewindNewMap(void);
+void SV_RewindReset(void);
+void SV_RewindFrame(void);
+
 /*
  * Protocol dependent write of model index to buffer
  * (shared with pr_cmds.c)
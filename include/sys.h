@@ -78,4 +78,14 @@ void Sys_SetFPCW(void);
 
 void Sys_Init(void);
 
+//
+// worker threads
+//
+int Sys_NumWorkers(void);
+void Sys_ParallelFor(int count, void (*func)(int index, void *data), void *data);
+
+// calls func once for each index in [0, count), spread across the worker
+// threads and the calling thread, and returns when every call has finished.
+// func must be reentrant and must not print, allocate or call into progs.
+
 #endif /* SYS_H */
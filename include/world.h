@@ -32,6 +32,16 @@ typedef enum {
     MOVE_MISSILE = 2,
 } movetype_t;
 
+/* SV_LinkEdict counters, reported by "profile" */
+typedef struct {
+    unsigned frames;    /* SV_Physics runs */
+    unsigned links;     /* SV_LinkEdict calls that placed an entity */
+    unsigned leafwalks; /* BSP walks for the touched leaves */
+    unsigned leafskips; /* leaves reused from the entity's leaf cache */
+} svlinkstats_t;
+
+extern svlinkstats_t sv_linkstats;
+
 void SV_ClearWorld(void);
 
 // called after the world model has been loaded, before linking any entities
@@ -49,8 +59,27 @@ void SV_LinkEdict(edict_t *ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+int SV_AreaEdicts(const vec3_t mins, const vec3_t maxs, edict_t **list, int maxcount);
+
+// fills in a list of the solid and trigger edicts whose abs boxes touch the
+// given box, in no particular order; returns the count
+
+void SV_OpenMoveLog(const byte *skip);
+void SV_CloseMoveLog(void);
+qboolean SV_MoveLogTouches(const vec3_t mins, const vec3_t maxs);
+
+// while open, records where solid entities not flagged in skip have been
+// linked and unlinked; SV_MoveLogTouches tests a box against the record
+
 int SV_PointContents(const vec3_t point);
 
+void SV_TraceBench_f(void);
+void SV_MoveBench_f(void);
+
+// time Mod_TraceHull against the original recursive walk, and SV_TraceMove
+// over the packed area lists against the link lists, checking that every
+// result matches
+
 // returns the CONTENTS_* value from the world at the given point.
 // does not check any entities at all
 
@@ -70,6 +99,32 @@ const edict_t *SV_TraceMove(const vec3_t start, const vec3_t mins, const vec3_t
                             const vec3_t end, const movetype_t type, const edict_t *passedict,
                             trace_t *trace);
 
+/*
+ * What SV_TraceMoveRecord saw of each entity the move was tested against.
+ * QuakeC may change these without relinking the entity, so a trace kept for
+ * later is only good while SV_RecordValid finds them unchanged.
+ */
+typedef struct {
+    const edict_t *ent;
+    float solid;
+    qboolean monster; /* FL_MONSTER */
+    int owner;
+    vec3_t origin;
+} traceclip_t;
+
+typedef struct {
+    traceclip_t *clips;
+    int count, max;
+    qboolean overflow; /* more candidates than clips */
+    qboolean error;    /* SV_TraceMove would have raised an error */
+} tracerecord_t;
+
+const edict_t *SV_TraceMoveRecord(const vec3_t start, const vec3_t mins, const vec3_t maxs,
+                                  const vec3_t end, const movetype_t type,
+                                  const edict_t *passedict, trace_t *trace,
+                                  tracerecord_t *record);
+qboolean SV_RecordValid(const tracerecord_t *record);
+
 static inline const edict_t *SV_TraceMoveEntity(const edict_t *entity, const vec3_t start,
                                                 const vec3_t end, movetype_t type, trace_t *trace) {
     return SV_TraceMove(start, entity->v.mins, entity->v.maxs, end, type, entity, trace);
@@ -42,8 +42,10 @@ server allocations when changing to a higher video mode.
 
 
 Z_??? Zone memory functions used for small, dynamic allocations like text
-strings from command input.  There is only about 48K for it, allocated at
-the very bottom of the hunk.
+strings from command input.  Requests of up to 512 bytes come from fixed
+size-class slabs, anything larger (or anything that doesn't fit once the
+slabs are full) from a first-fit heap.  Both are allocated at the very
+bottom of the hunk.
 
 Cache_??? Cache memory is for objects that can be dynamically loaded and
 can usefully stay persistant between levels.  The size of the cache
@@ -81,6 +83,8 @@ client and server low hunk allocations
 
 startup hunk allocations
 
+Zone slabs
+
 Zone block
 
 ----- Bottom of Memory -----
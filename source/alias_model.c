@@ -423,7 +423,15 @@ void Mod_LoadAliasModel(const model_loader_t *loader, model_t *model, void *buff
     end = Hunk_LowMark();
     memsize = end - start;
     Cache_AllocPadded(&model->cache, pad, memsize - pad, model->name);
-    if (!model->cache.data) return;
+    if (!model->cache.data) {
+        /* nowhere to keep it, so free what the driver made for it */
+        if (loader->CacheDestructor) {
+            cache_user_t hunkcopy = {.data = aliashdr, .pad = pad};
+            loader->CacheDestructor(&hunkcopy);
+        }
+        Hunk_FreeToLowMark(lowmark);
+        return;
+    }
     memcpy((byte *)model->cache.data - pad, membase, memsize);
     model->cache.destructor = loader->CacheDestructor;
 
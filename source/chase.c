@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // chase.c -- chase camera code
 
 #include "client.h"
+#include "console.h"
 #include "quakedef.h"
 #include "world.h"
 
@@ -51,6 +52,7 @@ void TraceLine(vec3_t start, vec3_t end, vec3_t impact) {
 
     memset(&trace, 0, sizeof(trace));
     Mod_TraceHull(cl.worldmodel->hulls, 0, start, end, &trace);
+    if (trace.backedup) Con_DPrintf("backup past 0\n");
 
     VectorCopy(trace.endpos, impact);
 }
@@ -26,8 +26,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "console.h"
 #include "host.h"
 #include "net.h"
+#include "prof.h"
 #include "protocol.h"
 #include "quakedef.h"
+#include "screen.h"
 #include "sys.h"
 #include "zone.h"
 
@@ -109,7 +111,10 @@ int CL_GetMessage(void) {
 
                 // if this is the second frame, grab the real td_starttime
                 // so the bogus time on the first frame doesn't count
-                if (host_framecount == cls.td_startframe + 1) cls.td_starttime = realtime;
+                if (host_framecount == cls.td_startframe + 1) {
+                    cls.td_starttime = realtime;
+                    if (cls.td_timestep) Prof_Reset();
+                }
             } else if (cl.time <= cl.mtime[0]) {
                 // don't need another message yet
                 return 0;
@@ -350,6 +355,14 @@ static void CL_FinishTimeDemo(void) {
     time = realtime - cls.td_starttime;
     if (!time) time = 1;
     Con_Printf("%i frames %5.1f seconds %5.1f fps\n", frames, time, frames / time);
+
+    if (cls.td_timestep) {
+        Prof_Report(frames);
+        Prof_Force(false);
+        cls.td_timestep = 0;
+        cls.td_nullvid = false;
+        Con_Printf("final frame checksum %08x\n", SCR_FrameChecksum());
+    }
 }
 
 /*
@@ -377,3 +390,38 @@ void CL_TimeDemo_f(void) {
     cls.td_startframe = host_framecount;
     cls.td_lastframe = -1;  // get a new message this frame
 }
+
+/*
+====================
+CL_BenchDemo_f
+
+benchdemo <demoname> [nullvid]
+
+A timedemo that runs every frame with a fixed host_frametime, so the
+simulation does not depend on vsync or the system timer, and records the
+subsystem timers for the whole run. With "nullvid" the screen is not
+updated at all. At the end the frame time percentiles are printed along
+with a checksum of the final view, rendered once from the end state.
+Start the engine with -simsound to mix into a null sound buffer.
+====================
+*/
+void CL_BenchDemo_f(void) {
+    if (cmd_source != src_command) return;
+
+    if (Cmd_Argc() < 2 || Cmd_Argc() > 3 || (Cmd_Argc() == 3 && strcmp(Cmd_Argv(2), "nullvid"))) {
+        Con_Printf("benchdemo <demoname> [nullvid] : fixed timestep demo benchmark\n");
+        return;
+    }
+
+    CL_PlayDemo_f();
+    if (!cls.demofile) return;
+
+    cls.timedemo = true;
+    cls.td_startframe = host_framecount;
+    cls.td_lastframe = -1;
+    cls.td_timestep = 1.0 / 72.0;
+    cls.td_nullvid = Cmd_Argc() == 3;
+
+    Prof_Reset();
+    Prof_Force(true);
+}
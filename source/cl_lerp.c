@@ -0,0 +1,269 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_lerp.c -- entity interpolation buffer
+
+#include <math.h>
+#include <string.h>
+
+#include "client.h"
+#include "cvar.h"
+#include "host.h"
+#include "quakedef.h"
+#include "server.h"
+
+/*
+ * CL_LerpPoint only ever interpolates between the last two messages, and
+ * its clock stops dead on the newest one whenever the next is late, then
+ * jumps when it arrives. On a jittery link that is visible stutter.
+ *
+ * Instead each entity keeps its last few states and is drawn at a render
+ * clock of its own. The clock runs at the host's rate, steered gently
+ * towards the server time estimated from the mean arrival offset of
+ * messages, less one message interval (where CL_LerpPoint draws) and less
+ * a delay that covers the spread of arrival times: twice their mean
+ * deviation, or cl_lerpdelay seconds if that is set. While messages are on
+ * time there is always a state either side of the clock; when one is late
+ * regardless, entities carry on along their last motion for up to
+ * cl_lerpextrapolate seconds and then hold.
+ *
+ * cl_lerpgraph draws how far the newest message was ahead of the clock
+ * each frame, red where there was nothing ahead.
+ */
+
+#define LERP_HISTORY 8   /* states per entity, power of two */
+#define LERP_MAXDELAY 0.2 /* seconds, what the history can cover */
+#define LERP_SNAP 0.25    /* clock error beyond which it jumps */
+#define LERP_SKEW 0.1     /* fraction of the clock error corrected per frame */
+
+typedef struct {
+    float time; /* server time of the message */
+    vec3_t origin;
+    vec3_t angles;
+} lerpstate_t;
+
+typedef struct {
+    lerpstate_t states[LERP_HISTORY];
+    int head; /* newest */
+    int count;
+} lerphistory_t;
+
+cvar_t cl_lerpbuffer = {"cl_lerpbuffer", "1"};
+cvar_t cl_lerpdelay = {"cl_lerpdelay", "0"};
+cvar_t cl_lerpextrapolate = {"cl_lerpextrapolate", "0.05"};
+cvar_t cl_lerpgraph = {"cl_lerpgraph", "0"};
+
+lerpstats_t cl_lerpstats;
+
+static lerphistory_t cl_lerphistory[MAX_EDICTS];
+
+static struct {
+    unsigned messages;
+    double newest;     /* server time of the newest message */
+    float times[LERP_HISTORY]; /* of the last few messages */
+    int head;
+    float interval;    /* between messages, smoothed */
+    float offset;      /* realtime - server time on arrival, smoothed */
+    qboolean running;
+    double clock;
+} lerp;
+
+void CL_LerpClear(void) {
+    memset(cl_lerphistory, 0, sizeof(cl_lerphistory));
+    memset(&lerp, 0, sizeof(lerp));
+    memset(&cl_lerpstats, 0, sizeof(cl_lerpstats));
+}
+
+/*
+===============
+CL_LerpMessage
+
+A message with a new svc_time has arrived
+===============
+*/
+void CL_LerpMessage(void) {
+    float offset = realtime - cl.mtime[0];
+    float interval = cl.mtime[0] - cl.mtime[1];
+    float error;
+
+    if (!lerp.messages++) {
+        lerp.offset = offset;
+        lerp.interval = 0.1;
+    } else {
+        if (interval > 0 && interval <= 0.1) lerp.interval += (interval - lerp.interval) * 0.125;
+        error = offset - lerp.offset;
+        lerp.offset += error * 0.125;
+        cl_lerpstats.jitter += (fabs(error) - cl_lerpstats.jitter) * 0.25;
+    }
+
+    /* the clock had already gone past everything there was */
+    if (lerp.running && lerp.clock > lerp.newest) cl_lerpstats.late++;
+
+    lerp.newest = cl.mtime[0];
+    lerp.head = (lerp.head + 1) & (LERP_HISTORY - 1);
+    lerp.times[lerp.head] = cl.mtime[0];
+}
+
+/*
+===============
+CL_LerpUpdate
+
+Called for each entity in a message, once its msg_origins[0] and
+msg_angles[0] are filled in. Reset drops what came before, as when the
+entity was not in the previous message.
+===============
+*/
+void CL_LerpUpdate(int num, const entity_t *ent, qboolean reset) {
+    lerphistory_t *history = &cl_lerphistory[num];
+    lerpstate_t *state;
+
+    if (reset) history->count = 0;
+
+    state = &history->states[history->head];
+    if (!history->count || state->time != (float)cl.mtime[0]) {
+        history->head = (history->head + 1) & (LERP_HISTORY - 1);
+        state = &history->states[history->head];
+        if (history->count < LERP_HISTORY) history->count++;
+    }
+    state->time = cl.mtime[0];
+    VectorCopy(ent->msg_origins[0], state->origin);
+    VectorCopy(ent->msg_angles[0], state->angles);
+}
+
+/*
+===============
+CL_LerpFrame
+
+Advances the render clock. Returns false if entities should be placed by
+CL_LerpPoint's fraction as before: with the buffer off, for demos, and
+with the server in this process, where nothing is ever late.
+===============
+*/
+qboolean CL_LerpFrame(void) {
+    double target, delay;
+    int i;
+
+    if (!cl_lerpbuffer.value || cl_nolerp.value || cls.demoplayback || sv.active ||
+        lerp.messages < 2) {
+        lerp.running = false;
+        return false;
+    }
+
+    if (cl_lerpdelay.value > 0)
+        delay = qmin((double)cl_lerpdelay.value, LERP_MAXDELAY);
+    else
+        delay = qmin(cl_lerpstats.jitter * 2.0, LERP_MAXDELAY);
+
+    target = realtime - lerp.offset - lerp.interval - delay;
+    if (!lerp.running || fabs(target - lerp.clock) > LERP_SNAP) {
+        lerp.clock = target;
+        lerp.running = true;
+    } else {
+        lerp.clock += host_frametime + (target - lerp.clock) * LERP_SKEW;
+    }
+
+    cl_lerpstats.delay = lerp.newest - lerp.clock;
+    cl_lerpstats.depth = 0;
+    for (i = 0; i < LERP_HISTORY; i++)
+        if (lerp.times[i] > lerp.clock) cl_lerpstats.depth++;
+    cl_lerpstats.head = (cl_lerpstats.head + 1) % LERP_GRAPH;
+    cl_lerpstats.ahead[cl_lerpstats.head] = cl_lerpstats.delay;
+
+    return true;
+}
+
+static void CL_LerpStates(const lerpstate_t *from, const lerpstate_t *to, float frac, entity_t *ent) {
+    float d;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        d = to->origin[i] - from->origin[i];
+        if (d > 100 || d < -100) frac = 1; /* assume a teleport and don't lerp */
+    }
+
+    for (i = 0; i < 3; i++) {
+        ent->origin[i] = from->origin[i] + frac * (to->origin[i] - from->origin[i]);
+        d = to->angles[i] - from->angles[i];
+        if (d >= 180)
+            d -= 360;
+        else if (d < -180)
+            d += 360;
+        ent->angles[i] = from->angles[i] + frac * d;
+    }
+}
+
+/*
+===============
+CL_LerpEntity
+
+Places the entity at the render clock
+===============
+*/
+void CL_LerpEntity(int num, entity_t *ent) {
+    const lerphistory_t *history = &cl_lerphistory[num];
+    const lerpstate_t *from, *to;
+    float ahead, span;
+    int i, slot;
+
+    to = &history->states[history->head];
+    if (history->count < 2) {
+        CL_LerpStates(to, to, 1, ent);
+        return;
+    }
+
+    /* late: carry on from the last two states, but not far */
+    if (lerp.clock >= to->time) {
+        from = &history->states[(history->head - 1) & (LERP_HISTORY - 1)];
+        span = to->time - from->time;
+        ahead = qmin((float)(lerp.clock - to->time), cl_lerpextrapolate.value);
+        if (span <= 0 || ahead <= 0) {
+            CL_LerpStates(to, to, 1, ent);
+            return;
+        }
+        CL_LerpStates(from, to, 1 + ahead / span, ent);
+        return;
+    }
+
+    /* find the states either side of the clock */
+    for (i = 1; i < history->count; i++) {
+        slot = (history->head - i) & (LERP_HISTORY - 1);
+        from = &history->states[slot];
+        if (from->time <= lerp.clock) {
+            span = to->time - from->time;
+            CL_LerpStates(from, to, span > 0 ? (lerp.clock - from->time) / span : 1, ent);
+            return;
+        }
+        to = from;
+    }
+
+    /* older than anything kept */
+    CL_LerpStates(to, to, 1, ent);
+}
+
+/*
+===============
+CL_LerpInit
+===============
+*/
+void CL_LerpInit(void) {
+    Cvar_RegisterVariable(&cl_lerpbuffer);
+    Cvar_RegisterVariable(&cl_lerpdelay);
+    Cvar_RegisterVariable(&cl_lerpextrapolate);
+    Cvar_RegisterVariable(&cl_lerpgraph);
+}
@@ -115,6 +115,7 @@ void CL_ClearState(void) {
     memset(cl_entities, 0, sizeof(cl_entities));
     memset(cl_dlights, 0, sizeof(cl_dlights));
     memset(cl_lightstyle, 0, sizeof(cl_lightstyle));
+    CL_LerpClear();
 
     //
     // allocate the efrags and chain together into a free list
@@ -493,6 +494,7 @@ void CL_RelinkEntities(void) {
     entity_t *ent;
     int i, j;
     float frac, f, d;
+    qboolean buffered;
     vec3_t delta;
     float bobjrotate;
     vec3_t oldorg;
@@ -500,6 +502,7 @@ void CL_RelinkEntities(void) {
 
     // determine partial update time
     frac = CL_LerpPoint();
+    buffered = CL_LerpFrame();
 
     cl_numvisedicts = 0;
 
@@ -551,6 +554,8 @@ void CL_RelinkEntities(void) {
              */
             VectorCopy(ent->msg_origins[0], ent->origin);
             VectorCopy(ent->msg_angles[0], ent->angles);
+        } else if (buffered) {
+            CL_LerpEntity(i, ent);
         } else {
             f = frac;
             for (j = 0; j < 3; j++) {
@@ -742,6 +747,7 @@ void CL_Init(void) {
 
     CL_InitInput();
     CL_InitTEnts();
+    CL_LerpInit();
 
     //
     // register our commands
@@ -778,12 +784,16 @@ void CL_Init(void) {
     Cmd_SetCompletion("playdemo", CL_Demo_Arg_f);
     Cmd_AddCommand("timedemo", CL_TimeDemo_f);
     Cmd_SetCompletion("timedemo", CL_Demo_Arg_f);
+    Cmd_AddCommand("benchdemo", CL_BenchDemo_f);
+    Cmd_SetCompletion("benchdemo", CL_Demo_Arg_f);
     Cmd_AddCommand("mcache", Mod_Print);
 
     Cmd_AddCommand("name", CL_Name_f);
     Cmd_AddCommand("color", CL_Color_f);
     Cmd_AddCommand("status", NULL);
     Cmd_AddCommand("ping", NULL);
+    Cmd_AddCommand("rate", NULL);
+    Cmd_AddCommand("snaps", NULL);
     Cmd_AddCommand("say", NULL);
     Cmd_AddCommand("say_team", NULL);
     Cmd_AddCommand("tell", NULL);
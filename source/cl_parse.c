@@ -576,6 +576,8 @@ void CL_ParseUpdate(unsigned int bits) {
         VectorCopy(ent->msg_angles[0], ent->angles);
         ent->forcelink = true;
     }
+
+    CL_LerpUpdate(num, ent, ent->forcelink);
 }
 
 /*
@@ -900,6 +902,7 @@ void CL_ParseServerMessage(void) {
             case svc_time:
                 cl.mtime[1] = cl.mtime[0];
                 cl.mtime[0] = MSG_ReadFloat();
+                CL_LerpMessage();
                 break;
 
             case svc_clientdata:
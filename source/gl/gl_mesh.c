@@ -51,6 +51,8 @@ static int numorder;
 
 static int allverts, alltris;
 
+#define NUMVERTEXNORMALS 162
+
 static int stripverts[128];
 static int striptris[128];
 static int stripcount;
@@ -305,6 +307,85 @@ static qboolean GL_MeshVerifyCommands(const aliashdr_t *hdr, const model_t *mode
     return true;
 }
 
+/*
+ * Upload the s/t coords and every pose of the model into one vertex buffer
+ * and expand the strip/fan command list into an indexed triangle list, so
+ * the whole model can be drawn with a single call and the pose lerp and
+ * shading done in the vertex shader.
+ */
+static void GL_MeshUploadBuffers(aliashdr_t *hdr, const int *cmds, const trivertx_t *verts) {
+    gl_aliashdr_t *glhdr = GL_Aliashdr(hdr);
+    gl_aliasvert_t *poseverts;
+    unsigned short *indices;
+    float *st;
+    int i, j, count, vertnum, mark;
+    int stsize, posesize, numindices;
+
+    mark = Hunk_LowMark();
+
+    stsize = hdr->numverts * 2 * sizeof(float);
+    posesize = hdr->numposes * hdr->numverts * sizeof(gl_aliasvert_t);
+    st = Hunk_Alloc(stsize);
+    poseverts = Hunk_Alloc(posesize);
+    indices = Hunk_Alloc(hdr->numtris * 3 * sizeof(unsigned short));
+
+    numindices = 0;
+    vertnum = 0;
+    while (1) {
+        count = *cmds++;
+        if (!count)
+            break;
+        if (count < 0) {
+            count = -count;
+            for (i = 2; i < count; i++) {
+                indices[numindices++] = vertnum;
+                indices[numindices++] = vertnum + i - 1;
+                indices[numindices++] = vertnum + i;
+            }
+        } else {
+            /* every other strip triangle is flipped to keep the winding */
+            for (i = 2; i < count; i++) {
+                indices[numindices++] = vertnum + i - ((i & 1) ? 1 : 2);
+                indices[numindices++] = vertnum + i - ((i & 1) ? 2 : 1);
+                indices[numindices++] = vertnum + i;
+            }
+        }
+        for (i = 0; i < count; i++) {
+            st[(vertnum + i) * 2 + 0] = ((const float *)cmds)[0];
+            st[(vertnum + i) * 2 + 1] = ((const float *)cmds)[1];
+            cmds += 2;
+        }
+        vertnum += count;
+    }
+
+    for (i = 0; i < hdr->numposes * hdr->numverts; i++, verts++) {
+        const int normalindex = verts->lightnormalindex < NUMVERTEXNORMALS ? verts->lightnormalindex : 0;
+        const float *normal = r_avertexnormals[normalindex];
+        for (j = 0; j < 3; j++) {
+            poseverts[i].v[j] = verts->v[j];
+            poseverts[i].n[j] = (signed char)(normal[j] * 127.0f);
+        }
+        poseverts[i].v[3] = 0;
+        poseverts[i].n[3] = 0;
+    }
+
+    glGenBuffers(1, &glhdr->vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, glhdr->vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, stsize + posesize, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, stsize, st);
+    glBufferSubData(GL_ARRAY_BUFFER, stsize, posesize, poseverts);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &glhdr->indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glhdr->indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, numindices * sizeof(unsigned short), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glhdr->numindices = numindices;
+
+    Hunk_FreeToLowMark(mark);
+}
+
 /*
 ================
 GL_MakeAliasModelDisplayLists
@@ -390,4 +471,6 @@ void GL_LoadMeshData(const model_t *model, aliashdr_t *hdr, const alias_meshdata
     for (i = 0; i < hdr->numposes; i++)
         for (j = 0; j < numorder; j++)
             *verts++ = posedata->verts[i][vertexorder[j]];
+
+    GL_MeshUploadBuffers(hdr, cmds, (trivertx_t *)((byte *)hdr + hdr->posedata));
 }
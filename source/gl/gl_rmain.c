@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "glquake.h"
 #include "mathlib.h"
 #include "model.h"
+#include "prof.h"
 #include "quakedef.h"
 #include "render.h"
 #include "screen.h"
@@ -43,6 +44,9 @@ static mplane_t frustum[4];
 int c_lightmaps_uploaded;
 int c_brush_polys;
 static int c_alias_polys;
+int c_program_switches;
+int c_texture_binds;
+int c_draw_calls;
 
 qboolean envmap; // true during envmap command capture
 
@@ -106,6 +110,10 @@ cvar_t gl_flashblend = {"gl_flashblend", "1"};
 cvar_t gl_playermip = {"gl_playermip", "0"};
 cvar_t gl_nocolors = {"gl_nocolors", "0"};
 cvar_t gl_zfix = {"gl_zfix", "0"};
+cvar_t gl_aliasvbo = {"gl_aliasvbo", "1"};
+cvar_t gl_singlepass = {"gl_singlepass", "1"};
+/* takes effect when the lightmaps are rebuilt on map load */
+cvar_t gl_overbright = {"gl_overbright", "0", true};
 #ifdef NQ_HACK
 cvar_t gl_doubleeyes = {"gl_doubleeyes", "1"};
 #endif
@@ -257,6 +265,7 @@ float r_avertexnormals[NUMVERTEXNORMALS][3] = {
 };
 
 static vec3_t shadevector;
+static vec3_t shadedotvector; // quantized like shadedots, for the shader
 static float shadelight, ambientlight;
 
 // precalculated dot products for quantized angles
@@ -373,15 +382,61 @@ static void GL_LoadSkinData(model_t *model, aliashdr_t *aliashdr, const alias_sk
     }
 }
 
+/*
+ * The vertex and index buffers are owned by the cached model data, so they
+ * go away with it (moving the cache block doesn't call this).
+ */
+static void GL_AliasCacheDestructor(cache_user_t *cache) {
+    gl_aliashdr_t *glhdr = GL_Aliashdr(cache->data);
+
+    glDeleteBuffers(1, &glhdr->vertexbuffer);
+    glDeleteBuffers(1, &glhdr->indexbuffer);
+    glhdr->vertexbuffer = glhdr->indexbuffer = 0;
+}
+
 static model_loader_t GL_Model_Loader = {
     .Aliashdr_Padding = GL_Aliashdr_Padding,
     .LoadSkinData = GL_LoadSkinData,
     .LoadMeshData = GL_LoadMeshData,
-    .CacheDestructor = NULL,
+    .CacheDestructor = GL_AliasCacheDestructor,
 };
 
 const model_loader_t *R_ModelLoader(void) { return &GL_Model_Loader; }
 
+/*
+=============
+GL_AliasDrawBuffers
+
+Both poses are already on the GPU, just point the shader at them
+=============
+*/
+static void GL_AliasDrawBuffers(const entity_t *entity, aliashdr_t *aliashdr, float blend) {
+    const gl_aliashdr_t *glhdr = GL_Aliashdr(aliashdr);
+    const byte *posebase = (byte *)0 + aliashdr->numverts * 2 * sizeof(float);
+    const int posesize = aliashdr->numverts * sizeof(gl_aliasvert_t);
+    const byte *pose0 = posebase + entity->previouspose * posesize;
+    const byte *pose1 = posebase + entity->currentpose * posesize;
+
+    if (r_fullbright.value)
+        QGL_BeginAlias(blend, vec3_origin, 255.0f);
+    else
+        QGL_BeginAlias(blend, shadedotvector, shadelight);
+
+    glBindBuffer(GL_ARRAY_BUFFER, glhdr->vertexbuffer);
+    glVertexAttribPointer(QGL_ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+    glVertexAttribPointer(QGL_ATTR_POSE0, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(gl_aliasvert_t), pose0);
+    glVertexAttribPointer(QGL_ATTR_NORMAL0, 3, GL_BYTE, GL_TRUE, sizeof(gl_aliasvert_t),
+                          pose0 + offsetof(gl_aliasvert_t, n));
+    glVertexAttribPointer(QGL_ATTR_POSE1, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(gl_aliasvert_t), pose1);
+    glVertexAttribPointer(QGL_ATTR_NORMAL1, 3, GL_BYTE, GL_TRUE, sizeof(gl_aliasvert_t),
+                          pose1 + offsetof(gl_aliasvert_t, n));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glhdr->indexbuffer);
+    glDrawElements(GL_TRIANGLES, glhdr->numindices, GL_UNSIGNED_SHORT, (void *)0);
+
+    QGL_EndAlias();
+}
+
 /*
 =============
 GL_AliasDrawModel
@@ -396,6 +451,17 @@ static void GL_AliasDrawModel(const entity_t *entity, float blend) {
     lastposenum = entity->currentpose;
 
     aliashdr = Mod_Extradata(entity->model);
+
+    if (gl_aliasvbo.value && GL_Aliashdr(aliashdr)->vertexbuffer) {
+        /* only blend poses when the immediate path below would */
+#ifdef NQ_HACK
+        if (!r_lerpmodels.value) blend = 1.0f;
+#else
+        blend = 1.0f;
+#endif
+        GL_AliasDrawBuffers(entity, aliashdr, blend);
+        return;
+    }
     vertbase = (trivertx_t *)((byte *)aliashdr + aliashdr->posedata);
     verts1 = vertbase + entity->currentpose * aliashdr->numverts;
     order = (int *)((byte *)aliashdr + GL_Aliashdr(aliashdr)->commands);
@@ -752,10 +818,16 @@ static void R_AliasCalcLight(const entity_t *entity, const vec3_t origin, const
         ambientlight = shadelight = 256;
     }
 
-    shadequant = (int)(angles[1] * (SHADEDOT_QUANT / 360.0));
-    shadedots = r_avertexnormal_dots[shadequant & (SHADEDOT_QUANT - 1)];
+    shadequant = (int)(angles[1] * (SHADEDOT_QUANT / 360.0)) & (SHADEDOT_QUANT - 1);
+    shadedots = r_avertexnormal_dots[shadequant];
     shadelight /= 200.0;
 
+    angle = shadequant * (2 * M_PI / SHADEDOT_QUANT);
+    shadedotvector[0] = cos(-angle);
+    shadedotvector[1] = sin(-angle);
+    shadedotvector[2] = 1;
+    VectorNormalize(shadedotvector);
+
     angle = angles[1] / 180 * M_PI;
     shadevector[0] = cos(-angle);
     shadevector[1] = sin(-angle);
@@ -904,9 +976,33 @@ void R_MarkLeaves(void) {
     }
 }
 
+/*
+=========================
+R_DrawBrushEntitiesOnList
+
+Only queues their surfaces, they are drawn with the world's
+=========================
+*/
+static void R_DrawBrushEntitiesOnList(void) {
+    entity_t *e;
+    int i;
+
+    if (!r_drawentities.value)
+        return;
+
+    for (i = 0; i < cl_numvisedicts; i++) {
+        e = &cl_visedicts[i];
+        if (e->model->type == mod_brush)
+            R_DrawBrushModel(e);
+    }
+}
+
 /*
 ====================
 R_DrawEntitiesOnList
+
+After the surface queue is flushed, so alias model shadows and sprites
+blend over the surfaces behind them
 ====================
 */
 static void R_DrawEntitiesOnList(void) {
@@ -923,9 +1019,6 @@ static void R_DrawEntitiesOnList(void) {
         case mod_alias:
             R_AliasDrawModel(e);
             break;
-        case mod_brush:
-            R_DrawBrushModel(e);
-            break;
         default:
             break;
         }
@@ -1154,6 +1247,9 @@ void R_SetupFrame(void) {
     c_brush_polys = 0;
     c_alias_polys = 0;
     c_lightmaps_uploaded = 0;
+    c_program_switches = 0;
+    c_texture_binds = 0;
+    c_draw_calls = 0;
 }
 
 static void MYgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar) {
@@ -1272,8 +1368,10 @@ static void R_RenderScene(void) {
     R_MarkLeaves();  // done here so we know if we're in water
     R_DrawWorld();   // adds static entities to the list
     S_ExtraUpdate(); // don't let sound get messed up if going slow
-    R_DrawEntitiesOnList();
+    R_DrawBrushEntitiesOnList();
+    R_FlushSurfaceQueue(); // world and brush entity surfaces
     GL_DisableMultitexture();
+    R_DrawEntitiesOnList();
     R_RenderDlights();
     R_DrawParticles();
 }
@@ -1412,6 +1510,8 @@ void R_RenderView(void) {
     if (!r_worldentity.model || !cl.worldmodel)
         Sys_Error("%s: NULL worldmodel", __func__);
 
+    PROF_BEGIN(PROF_RENDER);
+
     if (gl_finish.value || r_speeds.value)
         glFinish();
 
@@ -1420,6 +1520,9 @@ void R_RenderView(void) {
         c_brush_polys = 0;
         c_alias_polys = 0;
         c_lightmaps_uploaded = 0;
+        c_program_switches = 0;
+        c_texture_binds = 0;
+        c_draw_calls = 0;
     }
 
     mirror = false;
@@ -1443,5 +1546,8 @@ void R_RenderView(void) {
         time2 = Sys_DoubleTime();
         Con_Printf("%3i ms  %4i wpoly %4i epoly %4i dlit\n", (int)((time2 - time1) * 1000), c_brush_polys,
                    c_alias_polys, c_lightmaps_uploaded);
+        Con_Printf("       %4i prog %4i bind %4i draw\n", c_program_switches, c_texture_binds, c_draw_calls);
     }
+
+    PROF_END(PROF_RENDER);
 }
@@ -93,6 +93,94 @@ static void R_InitParticleTexture(void) {
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
+/*
+====================
+R_AliasBench_f
+
+Draw a grid of animated alias models in front of the view, once through
+the CPU lerp path and once through the vertex buffer path, and time both.
+aliasbench [count] [model]
+====================
+*/
+static void R_AliasBench_f(void) {
+    const int numframes = 128;
+    model_t *model = NULL;
+    entity_t *e;
+    int i, j, count, side, oldnumvisedicts, pass;
+    float oldaliasvbo;
+    double start, stop;
+    vec3_t forward, right, up;
+
+    if (cls.state != ca_active || !cl.worldmodel) {
+        Con_Printf("Not connected to a server\n");
+        return;
+    }
+
+    count = (Cmd_Argc() > 1) ? Q_atoi(Cmd_Argv(1)) : 200;
+    count = qclamp(count, 1, MAX_VISEDICTS - cl_numvisedicts);
+
+    if (Cmd_Argc() > 2) {
+        model = Mod_ForName(Cmd_Argv(2), false);
+    } else {
+        /* pick the first animated monster-ish model in the precache */
+        for (i = 1; i < MAX_MODELS && cl.model_precache[i]; i++) {
+            if (cl.model_precache[i]->type == mod_alias && cl.model_precache[i]->numframes > 1) {
+                model = cl.model_precache[i];
+                break;
+            }
+        }
+    }
+    if (!model || model->type != mod_alias) {
+        Con_Printf("No alias model to draw\n");
+        return;
+    }
+
+    AngleVectors(r_refdef.viewangles, forward, right, up);
+    side = (int)ceil(sqrt(count));
+
+    oldnumvisedicts = cl_numvisedicts;
+    for (i = 0; i < count; i++) {
+        e = &cl_visedicts[cl_numvisedicts++];
+        memset(e, 0, sizeof(*e));
+        e->model = model;
+        e->colormap = vid.colormap;
+        e->syncbase = i * 0.1f;
+        e->angles[1] = r_refdef.viewangles[1] + 180;
+        VectorMA(r_refdef.vieworg, 96 + (i / side) * 48, forward, e->origin);
+        VectorMA(e->origin, ((i % side) - side / 2) * 48, right, e->origin);
+        VectorCopy(e->origin, e->currentorigin);
+        VectorCopy(e->origin, e->previousorigin);
+        VectorCopy(e->angles, e->currentangles);
+        VectorCopy(e->angles, e->previousangles);
+    }
+
+    oldaliasvbo = gl_aliasvbo.value;
+    for (pass = 0; pass < 2; pass++) {
+        gl_aliasvbo.value = pass;
+        start = Sys_DoubleTime();
+        for (j = 0; j < numframes; j++) {
+            for (i = 0; i < count; i++) {
+                e = &cl_visedicts[oldnumvisedicts + i];
+                e->frame = (i + j) % model->numframes;
+                e->previousframe = e->currentframe;
+                e->currentframe = e->frame;
+                e->currentframetime = cl.time - (i % 10) * 0.01f;
+                e->previousframetime = e->currentframetime - 0.1f;
+            }
+            GL_BeginRendering(&glx, &gly, &glwidth, &glheight);
+            R_RenderView();
+            GL_EndRendering();
+        }
+        glFinish();
+        stop = Sys_DoubleTime();
+        Con_Printf("%s: %d x %s, %.3f ms/frame\n", pass ? "vbo" : "cpu", count, model->name,
+                   (stop - start) * 1000.0 / numframes);
+    }
+    gl_aliasvbo.value = oldaliasvbo;
+
+    cl_numvisedicts = oldnumvisedicts;
+}
+
 /*
 ===============
 R_Envmap_f
@@ -116,6 +204,7 @@ void R_Init(void) {
     Cmd_AddCommand("envmap", R_Envmap_f);
     Cmd_AddCommand("pointfile", R_ReadPointFile_f);
     Cmd_AddCommand("timerefresh", R_TimeRefresh_f);
+    Cmd_AddCommand("aliasbench", R_AliasBench_f);
 
     Cvar_RegisterVariable(&r_speeds);
     Cvar_RegisterVariable(&r_fullbright);
@@ -153,6 +242,9 @@ void R_Init(void) {
     Cvar_RegisterVariable(&gl_playermip);
     Cvar_RegisterVariable(&gl_nocolors);
     Cvar_RegisterVariable(&gl_zfix);
+    Cvar_RegisterVariable(&gl_aliasvbo);
+    Cvar_RegisterVariable(&gl_singlepass);
+    Cvar_RegisterVariable(&gl_overbright);
 
     Cvar_RegisterVariable(&gl_keeptjunctions);
     Cvar_RegisterVariable(&gl_reporttjunctions);
@@ -431,6 +523,63 @@ R_TimeRefresh_f
 For program optimization
 ====================
 */
-void R_TimeRefresh_f(void) {}
+void R_TimeRefresh_f(void) {
+    int i;
+    float start, stop, time;
+    int startangle;
+
+    startangle = r_refdef.viewangles[1];
+
+    glFinish();
+    start = Sys_DoubleTime();
+    for (i = 0; i < 128; i++) {
+        r_refdef.viewangles[1] = i / 128.0 * 360.0;
+
+        GL_BeginRendering(&glx, &gly, &glwidth, &glheight);
+        R_RenderView();
+        GL_EndRendering();
+    }
+    glFinish();
+    stop = Sys_DoubleTime();
+    time = stop - start;
+    Con_Printf("%f seconds (%f fps)\n", time, 128 / time);
+
+    r_refdef.viewangles[1] = startangle;
+}
+
+/*
+====================
+R_FrameChecksum
+
+FNV-1a over the RGBA pixels of the refresh window, read back before the
+buffers are swapped
+====================
+*/
+unsigned R_FrameChecksum(void) {
+    int x, y, w, h, i;
+    unsigned sum;
+    byte *pixels;
+
+    x = r_refdef.vrect.x * glwidth / vid.width;
+    y = (vid.height - (r_refdef.vrect.y + r_refdef.vrect.height)) * glheight / vid.height;
+    w = r_refdef.vrect.width * glwidth / vid.width;
+    h = r_refdef.vrect.height * glheight / vid.height;
+    if (w <= 0 || h <= 0) return 0;
+
+    pixels = malloc(w * h * 4);
+    if (!pixels) return 0;
+
+    glFinish();
+    glReadPixels(glx + x, gly + y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    sum = 2166136261u;
+    for (i = 0; i < w * h * 4; i++) {
+        sum ^= pixels[i];
+        sum *= 16777619u;
+    }
+    free(pixels);
+
+    return sum;
+}
 
 void D_FlushCaches(void) {}
@@ -19,6 +19,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // gl_rsurf.c: surface-related refresh code
 
+#include <stdint.h>
+
 #include "console.h"
 #include "glquake.h"
 #include "quakedef.h"
@@ -49,6 +51,17 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define MAX_LM_BLOCKS 256
 
 static int lightmap_bytes; // 1, 2, or 4
+
+/*
+ * gl_overbright builds lightmaps with one more bit of range, which only
+ * the single pass shader scales back up. They are rebuilt at the normal
+ * range whenever the two-pass blend is in use, and warped underwater polys
+ * (always two-pass) never get the extra bit.
+ */
+static qboolean lightmap_overbright;
+static float lightmap_waterwarp; // r_waterwarp they were built for
+
+#define LIGHTMAP_SHIFT(surf) ((lightmap_overbright && !WATER_WARP_TEST(surf)) ? 8 : 7)
 static int lightmap_textures_initialised = 0;
 
 #define BLOCK_WIDTH 128
@@ -148,6 +161,7 @@ static void R_BuildLightMap(msurface_t *surf, byte *dest, int stride) {
     int map;
     unsigned blocklights[18 * 18];
     unsigned *bl;
+    const int shift = LIGHTMAP_SHIFT(surf);
 
     surf->cached_dlight = (surf->dlightframe == r_framecount);
 
@@ -190,7 +204,7 @@ store:
         for (i = 0; i < tmax; i++, dest += stride) {
             for (j = 0; j < smax; j++) {
                 t = *bl++;
-                t >>= 7;
+                t >>= shift;
                 if (t > 255)
                     t = 255;
                 dest[3] = 255 - t;
@@ -205,7 +219,7 @@ store:
         for (i = 0; i < tmax; i++, dest += stride) {
             for (j = 0; j < smax; j++) {
                 t = *bl++;
-                t >>= 7;
+                t >>= shift;
                 if (t > 255)
                     t = 255;
                 dest[j] = 255 - t;
@@ -266,18 +280,19 @@ static GLenum oldtarget = GL_TEXTURE0_ARB;
 static int cnttextures[2] = {-1, -1}; // cached
 
 /*
- * Makes the given texture unit active
+ * Makes the given texture unit active. The shaders always have two units,
+ * so this works without gl_mtexable; the fixed function callers check it.
  * FIXME: only aware of two texture units...
  */
 void GL_SelectTexture(GLenum target) {
-    if (!gl_mtexable || target == oldtarget)
+    if (target == oldtarget)
         return;
 
     /*
      * Save the current texture unit's texture handle, select the new texture
      * unit and update currenttexture
      */
-    qglActiveTextureARB(target);
+    glActiveTexture(target);
     cnttextures[oldtarget - GL_TEXTURE0_ARB] = currenttexture;
     currenttexture = cnttextures[target - GL_TEXTURE0_ARB];
     oldtarget = target;
@@ -443,58 +458,6 @@ static void R_UploadLMBlockUpdate(int blocknum) {
     c_lightmaps_uploaded++;
 }
 
-/*
-================
-R_BlendLightmaps
-================
-*/
-static void R_BlendLightmaps(void) {
-    int i;
-    glpoly_t *p;
-
-    if (r_drawflat.value)
-        return;
-
-    glDepthMask(0); // don't bother writing Z
-
-    if (gl_lightmap_format == GL_LUMINANCE)
-        glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
-    else if (gl_lightmap_format == GL_INTENSITY) {
-        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-        glColor4f(0, 0, 0, 1);
-    }
-
-    if (!r_lightmap.value) {
-        qglEnable(GL_BLEND);
-    }
-
-    for (i = 0; i < MAX_LM_BLOCKS; i++) {
-        lm_block_t *block = &lm_blocks[i];
-        if (!block->polys)
-            continue;
-        GL_Bind(block->texture);
-        if (block->modified) {
-            R_UploadLMBlockUpdate(i);
-            block->modified = false;
-        }
-        for (p = block->polys; p; p = p->chain) {
-            if (WATER_WARP_TEST(p))
-                DrawGLWaterPolyLightmap(p);
-            else
-                DrawGLPolyLM(p);
-        }
-    }
-
-    qglDisable(GL_BLEND);
-    if (gl_lightmap_format == GL_LUMINANCE)
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    else if (gl_lightmap_format == GL_INTENSITY) {
-        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-        glColor4f(1, 1, 1, 1);
-    }
-    glDepthMask(1); // back to normal Z buffering
-}
-
 /*
  * R_UpdateLightmapBlockRect
  */
@@ -548,6 +511,285 @@ static void R_UpdateLightmapBlockRect(msurface_t *fa) {
     }
 }
 
+/*
+=============================================================
+
+        SURFACE QUEUE
+
+Opaque world and brush entity surfaces are collected over the frame and
+submitted sorted by (program, texture, lightmap), so every texture and
+every lightmap block is bound once per flush instead of once per chain
+and once per entity. Sky stays on its own two-layer path.
+
+=============================================================
+*/
+
+#define MAX_SURFQUEUE 16384
+#define MAX_SURFQUEUE_SLOTS 256
+
+/* program classes, lowest sorts first */
+#define SQ_LIGHTMAPPED 0 // texture x lightmap in one pass
+#define SQ_SOLID 1       // texture now, lightmap blended on later
+#define SQ_TURB 2
+
+#define SQ_KEY(class, texture, lightmap, slot)                                                                          \
+    (((uint64_t)(class) << 56) | ((uint64_t)((texture)&0xffffff) << 32) | ((uint64_t)((lightmap)&0xffff) << 16) |      \
+     ((slot)&0xffff))
+#define SQ_CLASS(key) ((int)((key) >> 56))
+#define SQ_TEXTURE(key) ((int)(((key) >> 32) & 0xffffff))
+#define SQ_LIGHTMAP(key) ((int)(((key) >> 16) & 0xffff))
+#define SQ_SLOT(key) ((int)((key)&0xffff))
+
+typedef struct {
+    uint64_t key;
+    msurface_t *surf;
+} surfqueue_t;
+
+/* One per entity: the modelview to draw its surfaces with */
+typedef struct {
+    float matrix[16];
+    qboolean zfix;
+} surfqueue_slot_t;
+
+static surfqueue_t surfqueue[MAX_SURFQUEUE];
+static surfqueue_t surfqueue_lm[MAX_SURFQUEUE];
+static int surfqueue_num;
+static surfqueue_slot_t surfqueue_slots[MAX_SURFQUEUE_SLOTS];
+static int surfqueue_numslots;
+static int surfqueue_curslot;
+
+static int R_SurfQueueCompare(const void *a, const void *b) {
+    const uint64_t k1 = ((const surfqueue_t *)a)->key;
+    const uint64_t k2 = ((const surfqueue_t *)b)->key;
+
+    return (k1 > k2) - (k1 < k2);
+}
+
+/*
+ * Capture the current modelview as a new slot for the surfaces that
+ * follow. Slot 0 is always the world.
+ */
+static int R_SurfQueueSlot(qboolean zfix) {
+    surfqueue_slot_t *slot;
+
+    if (surfqueue_numslots == MAX_SURFQUEUE_SLOTS)
+        R_FlushSurfaceQueue();
+
+    slot = &surfqueue_slots[surfqueue_numslots];
+    qglGetFloatv(GL_MODELVIEW_MATRIX, slot->matrix);
+    slot->zfix = zfix;
+
+    return surfqueue_numslots++;
+}
+
+static void R_SurfQueueSetSlot(int slotnum) {
+    const surfqueue_slot_t *slot;
+
+    if (slotnum == surfqueue_curslot)
+        return;
+
+    slot = &surfqueue_slots[slotnum];
+    glLoadMatrixf((GLfloat *)slot->matrix);
+    if (slot->zfix != (surfqueue_curslot >= 0 && surfqueue_slots[surfqueue_curslot].zfix)) {
+        if (slot->zfix)
+            qglEnable(GL_POLYGON_OFFSET_FILL);
+        else
+            qglDisable(GL_POLYGON_OFFSET_FILL);
+    }
+    surfqueue_curslot = slotnum;
+}
+
+/*
+ * The single pass shader only knows the default luminance lightmaps and
+ * can't show the lightmap on its own, so the debug modes stay two-pass.
+ */
+static qboolean R_SinglePassLightmaps(void) {
+    return gl_singlepass.value && !r_lightmap.value && !r_fullbright.value && gl_lightmap_format == GL_LUMINANCE;
+}
+
+/*
+ * Resolve the texture and lightmap the surface will be drawn with and add
+ * it to the queue. Lightmap updates for the surface are recorded now and
+ * uploaded when the flush gets to its block.
+ */
+static void R_QueueSurface(const entity_t *e, msurface_t *surf, int *slot) {
+    const texture_t *t;
+    surfqueue_t *item;
+
+    if (surfqueue_num == MAX_SURFQUEUE) {
+        /* flushing renumbers the slots, so take a fresh one */
+        const qboolean zfix = surfqueue_slots[*slot].zfix;
+        R_FlushSurfaceQueue();
+        *slot = R_SurfQueueSlot(zfix);
+    }
+
+    t = R_TextureAnimation(e, surf->texinfo->texture);
+    item = &surfqueue[surfqueue_num++];
+    item->surf = surf;
+    if (surf->flags & SURF_DRAWTURB) {
+        item->key = SQ_KEY(SQ_TURB, t->gl_texturenum, 0, *slot);
+    } else {
+        /* warped polys are drawn through the imm path */
+        const int class = (R_SinglePassLightmaps() && !WATER_WARP_TEST(surf)) ? SQ_LIGHTMAPPED : SQ_SOLID;
+        item->key = SQ_KEY(class, t->gl_texturenum, surf->lightmaptexturenum, *slot);
+        if (!r_fullbright.value)
+            R_UpdateLightmapBlockRect(surf);
+    }
+}
+
+/*
+ * Bind a lightmap block on the second texture unit for the single pass
+ * program, uploading it first if it was changed this frame.
+ */
+static void R_BindLightmapUnit(int blocknum) {
+    lm_block_t *block = &lm_blocks[blocknum];
+
+    GL_SelectTexture(GL_TEXTURE1_ARB);
+    GL_Bind(block->texture);
+    if (block->modified) {
+        R_UploadLMBlockUpdate(blocknum);
+        block->modified = false;
+    }
+    GL_SelectTexture(GL_TEXTURE0_ARB);
+}
+
+/*
+ * Lightmap pass: a stable counting sort of the solid surfaces by lightmap
+ * block, so each block is uploaded and bound once.
+ */
+static void R_FlushSurfaceQueueLightmaps(void) {
+    static int blockstart[MAX_LM_BLOCKS + 1];
+    const surfqueue_t *item;
+    int i, blocknum, numlm;
+
+    memset(blockstart, 0, sizeof(blockstart));
+    for (i = 0, item = surfqueue; i < surfqueue_num; i++, item++)
+        if (SQ_CLASS(item->key) == SQ_SOLID)
+            blockstart[SQ_LIGHTMAP(item->key) + 1]++;
+    for (i = 0; i < MAX_LM_BLOCKS; i++)
+        blockstart[i + 1] += blockstart[i];
+    numlm = blockstart[MAX_LM_BLOCKS];
+    if (!numlm)
+        return;
+    for (i = 0, item = surfqueue; i < surfqueue_num; i++, item++)
+        if (SQ_CLASS(item->key) == SQ_SOLID)
+            surfqueue_lm[blockstart[SQ_LIGHTMAP(item->key)]++] = *item;
+
+    glDepthMask(0); // don't bother writing Z
+
+    if (gl_lightmap_format == GL_LUMINANCE)
+        glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    else if (gl_lightmap_format == GL_INTENSITY) {
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glColor4f(0, 0, 0, 1);
+    }
+
+    if (!r_lightmap.value) {
+        qglEnable(GL_BLEND);
+    }
+
+    blocknum = -1;
+    for (i = 0, item = surfqueue_lm; i < numlm; i++, item++) {
+        if (SQ_LIGHTMAP(item->key) != blocknum) {
+            lm_block_t *block;
+
+            blocknum = SQ_LIGHTMAP(item->key);
+            block = &lm_blocks[blocknum];
+            GL_Bind(block->texture);
+            if (block->modified) {
+                R_UploadLMBlockUpdate(blocknum);
+                block->modified = false;
+            }
+        }
+        R_SurfQueueSetSlot(SQ_SLOT(item->key));
+        if (WATER_WARP_TEST(item->surf))
+            DrawGLWaterPolyLightmap(item->surf->polys);
+        else
+            DrawGLPolyLM(item->surf->polys);
+    }
+
+    qglDisable(GL_BLEND);
+    if (gl_lightmap_format == GL_LUMINANCE)
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    else if (gl_lightmap_format == GL_INTENSITY) {
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+        glColor4f(1, 1, 1, 1);
+    }
+    glDepthMask(1); // back to normal Z buffering
+}
+
+/*
+================
+R_FlushSurfaceQueue
+
+Draw everything queued since the last flush, base textures first and then
+the lightmaps blended on top
+================
+*/
+void R_FlushSurfaceQueue(void) {
+    const surfqueue_t *item;
+    float modelview[16];
+    int i, blocknum;
+
+    if (!surfqueue_num) {
+        surfqueue_numslots = 1;
+        return;
+    }
+
+    /* the queue may be flushed while an entity matrix is loaded */
+    qglGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    surfqueue_curslot = -1;
+
+    qsort(surfqueue, surfqueue_num, sizeof(surfqueue[0]), R_SurfQueueCompare);
+
+    GL_DisableMultitexture();
+    glColor3f(1, 1, 1);
+
+    /* single pass surfaces sort first */
+    item = surfqueue;
+    if (SQ_CLASS(item->key) == SQ_LIGHTMAPPED) {
+        QGL_BeginLightmapped(lightmap_overbright ? 2.0f : 1.0f);
+        blocknum = -1;
+        for (; item < surfqueue + surfqueue_num && SQ_CLASS(item->key) == SQ_LIGHTMAPPED; item++) {
+            const glpoly_t *poly = item->surf->polys;
+
+            c_brush_polys++;
+            R_SurfQueueSetSlot(SQ_SLOT(item->key));
+            GL_Bind(SQ_TEXTURE(item->key));
+            if (SQ_LIGHTMAP(item->key) != blocknum) {
+                blocknum = SQ_LIGHTMAP(item->key);
+                R_BindLightmapUnit(blocknum);
+            }
+            QGL_DrawLightmappedPoly(poly->verts[0], poly->numverts);
+        }
+        QGL_EndLightmapped();
+    }
+
+    for (i = item - surfqueue; i < surfqueue_num; i++, item++) {
+        msurface_t *surf = item->surf;
+
+        c_brush_polys++;
+        R_SurfQueueSetSlot(SQ_SLOT(item->key));
+        GL_Bind(SQ_TEXTURE(item->key));
+        if (SQ_CLASS(item->key) == SQ_TURB)
+            EmitWaterPolys(surf);
+        else if (WATER_WARP_TEST(surf))
+            DrawGLWaterPoly(surf->polys);
+        else
+            DrawGLPoly(surf->polys);
+    }
+
+    if (!r_fullbright.value)
+        R_FlushSurfaceQueueLightmaps();
+
+    if (surfqueue_curslot >= 0 && surfqueue_slots[surfqueue_curslot].zfix)
+        qglDisable(GL_POLYGON_OFFSET_FILL);
+    glLoadMatrixf(modelview);
+
+    surfqueue_num = 0;
+    surfqueue_numslots = 1; // keep the world slot
+}
+
 /*
 ================
 R_RenderBrushPoly
@@ -673,34 +915,15 @@ void R_DrawWaterSurfaces(void) {
 /*
 ================
 DrawTextureChains
+
+Sky is drawn straight away, everything else opaque goes to the queue
 ================
 */
 static void DrawTextureChains(const entity_t *e) {
-    int i;
+    int i, slot = 0;
     msurface_t *s;
     texture_t *t;
 
-    if (gl_mtexable) {
-        /* Update all lightmaps */
-        for (i = 0; i < cl.worldmodel->numtextures; i++) {
-            t = cl.worldmodel->textures[i];
-            if (!t)
-                continue;
-            s = t->texturechain;
-            if (!s)
-                continue;
-            if (s->flags & SURF_DRAWSKY)
-                continue;
-            if (i == mirrortexturenum && !r_mirroralpha.value)
-                continue;
-            if ((s->flags & SURF_DRAWTURB))
-                continue;
-
-            for (; s; s = s->texturechain)
-                R_UpdateLightmapBlockRect(s);
-        }
-    }
-
     for (i = 0; i < cl.worldmodel->numtextures; i++) {
         t = cl.worldmodel->textures[i];
         if (!t)
@@ -717,7 +940,7 @@ static void DrawTextureChains(const entity_t *e) {
             if ((s->flags & SURF_DRAWTURB) && r_wateralpha.value != 1.0)
                 continue; // draw translucent water later
             for (; s; s = s->texturechain)
-                R_RenderBrushPoly(e, s);
+                R_QueueSurface(e, s, &slot);
         }
         t->texturechain = NULL;
     }
@@ -780,6 +1003,7 @@ void R_DrawBrushModel(const entity_t *e) {
     mplane_t *pplane;
     model_t *model;
     brushmodel_t *brushmodel;
+    int slot = 0;
 
     qboolean rotated;
 
@@ -817,22 +1041,21 @@ void R_DrawBrushModel(const entity_t *e) {
 
     surf = &brushmodel->surfaces[brushmodel->firstmodelsurface];
 
-    if (gl_zfix.value)
-        qglEnable(GL_POLYGON_OFFSET_FILL);
-
     glPushMatrix();
     /* Stupid bug means pitch is reversed for entities */
     VectorCopy(e->angles, angles_bug);
     angles_bug[PITCH] = -angles_bug[PITCH];
     R_RotateForEntity(e->origin, angles_bug);
 
-    if (!r_drawflat.value) {
+    if (r_drawflat.value) {
+        if (gl_zfix.value)
+            qglEnable(GL_POLYGON_OFFSET_FILL);
+    } else {
+        slot = R_SurfQueueSlot(gl_zfix.value != 0);
+
         /*
          * calculate dynamic lighting for bmodel if it's not an instanced model
          */
-        for (i = 0; i < MAX_LM_BLOCKS; i++)
-            lm_blocks[i].polys = NULL;
-
         if (brushmodel->firstmodelsurface != 0 && !gl_flashblend.value) {
             for (k = 0; k < MAX_DLIGHTS; k++) {
                 if ((cl_dlights[k].die < cl.time) || (!cl_dlights[k].radius))
@@ -859,29 +1082,23 @@ void R_DrawBrushModel(const entity_t *e) {
         /* draw the polygon */
         if (((surf->flags & SURF_PLANEBACK) && (dot < -BACKFACE_EPSILON)) ||
             (!(surf->flags & SURF_PLANEBACK) && (dot > BACKFACE_EPSILON))) {
-            if (r_drawflat.value) {
+            if (r_drawflat.value)
                 DrawFlatGLPoly(surf->polys);
-            } else {
-                /* FIXME - hack for dynamic lightmap updates... */
-                qboolean real_mtexable = gl_mtexable;
-                gl_mtexable = false;
+            else if (surf->flags & SURF_DRAWSKY)
                 R_RenderBrushPoly(e, surf);
-                gl_mtexable = real_mtexable;
-            }
+            else
+                R_QueueSurface(e, surf, &slot);
         }
     }
 
     if (r_drawflat.value) {
         qglEnable(GL_TEXTURE_2D);
         glColor3f(1, 1, 1);
-    } else {
-        R_BlendLightmaps();
+        if (gl_zfix.value)
+            qglDisable(GL_POLYGON_OFFSET_FILL);
     }
 
     glPopMatrix();
-
-    if (gl_zfix.value)
-        qglDisable(GL_POLYGON_OFFSET_FILL);
 }
 
 /*
@@ -983,6 +1200,58 @@ static void R_RecursiveWorldNode(mnode_t *node) {
     R_RecursiveWorldNode(node->children[side ? 0 : 1]);
 }
 
+/*
+=============
+R_CheckLightmapRange
+
+Rebuilds every lightmap if the overbright range they were built with no
+longer matches the path they will be drawn through
+=============
+*/
+static void R_CheckLightmapRange(void) {
+    const qboolean overbright = gl_overbright.value && R_SinglePassLightmaps();
+    model_t *model;
+    brushmodel_t *brushmodel;
+    msurface_t *surf;
+    lm_block_t *block;
+    byte *base;
+    int i, j;
+
+    if (overbright == lightmap_overbright && (!overbright || r_waterwarp.value == lightmap_waterwarp))
+        return;
+    lightmap_overbright = overbright;
+    lightmap_waterwarp = r_waterwarp.value;
+
+    for (j = 1; j < MAX_MODELS; j++) {
+        model = cl.model_precache[j];
+        if (!model)
+            break;
+        if (model->name[0] == '*' || model->type != mod_brush)
+            continue;
+
+        brushmodel = BrushModel(model);
+        surf = brushmodel->surfaces;
+        for (i = 0; i < brushmodel->numsurfaces; i++, surf++) {
+            if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB))
+                continue;
+            base = lm_blocks[surf->lightmaptexturenum].data;
+            base += (surf->light_t * BLOCK_WIDTH + surf->light_s) * lightmap_bytes;
+            R_BuildLightMap(surf, base, BLOCK_WIDTH * lightmap_bytes);
+        }
+    }
+
+    for (i = 0; i < MAX_LM_BLOCKS; i++) {
+        block = &lm_blocks[i];
+        if (!block->allocated[0])
+            break;
+        block->modified = true;
+        block->rectchange.l = 0;
+        block->rectchange.t = 0;
+        block->rectchange.w = BLOCK_WIDTH;
+        block->rectchange.h = BLOCK_HEIGHT;
+    }
+}
+
 /*
 =============
 R_DrawWorld
@@ -992,6 +1261,8 @@ void R_DrawWorld(void) {
     int i;
     entity_t ent;
 
+    R_CheckLightmapRange();
+
     memset(&ent, 0, sizeof(ent));
     ent.model = &cl.worldmodel->model;
 
@@ -1003,6 +1274,11 @@ void R_DrawWorld(void) {
     for (i = 0; i < MAX_LM_BLOCKS; i++)
         lm_blocks[i].polys = NULL;
 
+    /* the world slot, brush entities get theirs as they are drawn */
+    memcpy(surfqueue_slots[0].matrix, r_world_matrix, sizeof(surfqueue_slots[0].matrix));
+    surfqueue_slots[0].zfix = false;
+    surfqueue_numslots = 1;
+
     if (r_drawflat.value || _gl_drawhull.value) {
         GL_DisableMultitexture();
         qglDisable(GL_TEXTURE_2D);
@@ -1024,12 +1300,10 @@ void R_DrawWorld(void) {
     } else {
         R_RecursiveWorldNode(cl.worldmodel->nodes);
 
-        if (r_drawflat.value) {
+        if (r_drawflat.value)
             DrawFlatTextureChains();
-        } else {
+        else
             DrawTextureChains(&ent);
-            R_BlendLightmaps();
-        }
     }
 }
 
@@ -1227,6 +1501,9 @@ void GL_BuildLightmaps(void *hunkbase) {
     if (COM_CheckParm("-lm_4"))
         gl_lightmap_format = GL_RGBA;
 
+    lightmap_overbright = gl_overbright.value && R_SinglePassLightmaps();
+    lightmap_waterwarp = r_waterwarp.value;
+
     switch (gl_lightmap_format) {
     case GL_RGBA:
         lightmap_bytes = 4;
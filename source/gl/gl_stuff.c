@@ -30,9 +30,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // shaders
 //
 
-static GLuint fs[9];
-static GLuint vs[4];
-static GLuint programs[9];
+static GLuint fs[QGL_NUM_FS];
+static GLuint vs[QGL_NUM_VS];
+static GLuint programs[QGL_NUM_PROGRAMS];
 static GLuint cur_program = (GLuint)-1;
 
 static qboolean just_color; // HACK
@@ -44,9 +44,13 @@ static int alpha_state = 0;
 static int color_state = 0;
 static GLfloat cur_color[4] = {1.f, 1.f, 1.f, 1.f};
 static GLfloat cur_texcoord[2] = {0.f, 0.f};
-static GLint u_mvp[9];
+static GLint u_mvp[QGL_NUM_PROGRAMS];
 static GLint u_monocolor;
 static GLint u_modcolor[2];
+static GLint u_alias_blend;
+static GLint u_alias_shadevector;
+static GLint u_alias_shadelight;
+static GLint u_lm_lightscale;
 
 static qboolean shaders_loaded = false;
 static qboolean shaders_reload = false;
@@ -81,6 +85,17 @@ static inline void LinkShader(GLuint pidx, GLuint fidx, GLuint vidx, GLboolean t
     programs[pidx] = glCreateProgram();
     glAttachShader(programs[pidx], fs[fidx]);
     glAttachShader(programs[pidx], vs[vidx]);
+    if (vidx == QGL_SHADER_ALIAS) {
+        glBindAttribLocation(programs[pidx], QGL_ATTR_POSE0, "inPose0");
+        glBindAttribLocation(programs[pidx], QGL_ATTR_NORMAL0, "inNormal0");
+        glBindAttribLocation(programs[pidx], QGL_ATTR_POSE1, "inPose1");
+        glBindAttribLocation(programs[pidx], QGL_ATTR_NORMAL1, "inNormal1");
+        glBindAttribLocation(programs[pidx], QGL_ATTR_TEXCOORD, "inTexCoord");
+    } else if (vidx == QGL_SHADER_LIGHTMAPPED_VS) {
+        glBindAttribLocation(programs[pidx], QGL_ATTR_LM_POS, "inPos");
+        glBindAttribLocation(programs[pidx], QGL_ATTR_LM_TEXCOORD, "inTexCoord");
+        glBindAttribLocation(programs[pidx], QGL_ATTR_LM_LMCOORD, "inLMCoord");
+    }
     // vglBindAttribLocation( programs[pidx], 0, "aPosition", 3, GL_FLOAT );
     // if( texcoord ) vglBindAttribLocation( programs[pidx], 1, "aTexCoord", 2,
     // GL_FLOAT ); if( color ) vglBindAttribLocation( programs[pidx], 2,
@@ -97,11 +112,11 @@ static inline void LinkShader(GLuint pidx, GLuint fidx, GLuint vidx, GLboolean t
 
 void QGL_FreeShaders(void) {
     if (shaders_loaded) {
-        for (int i = 0; i < 9; i++)
+        for (int i = 0; i < QGL_NUM_PROGRAMS; i++)
             glDeleteProgram(programs[i]);
-        for (int i = 0; i < 9; i++)
+        for (int i = 0; i < QGL_NUM_FS; i++)
             glDeleteShader(fs[i]);
-        for (int i = 0; i < 4; i++)
+        for (int i = 0; i < QGL_NUM_VS; i++)
             glDeleteShader(vs[i]);
         shaders_loaded = false;
     }
@@ -124,6 +139,9 @@ void QGL_ReloadShaders(void) {
     CompileShader(QGL_SHADER_RGBA_A_SRC, QGL_SHADER_RGBA_A, GL_TRUE);
     CompileShader(QGL_SHADER_COLOR_SRC, QGL_SHADER_COLOR, GL_FALSE);
     CompileShader(QGL_SHADER_VERTEX_ONLY_SRC, QGL_SHADER_VERTEX_ONLY, GL_FALSE);
+    CompileShader(QGL_SHADER_ALIAS_SRC, QGL_SHADER_ALIAS, GL_FALSE);
+    CompileShader(QGL_SHADER_LIGHTMAPPED_VS_SRC, QGL_SHADER_LIGHTMAPPED_VS, GL_FALSE);
+    CompileShader(QGL_SHADER_LIGHTMAPPED_SRC, QGL_SHADER_LIGHTMAPPED, GL_TRUE);
 
     LinkShader(QGL_SHADER_TEX2D_REPL, QGL_SHADER_REPLACE, QGL_SHADER_TEXTURE2D, GL_TRUE, GL_FALSE);
     LinkShader(QGL_SHADER_TEX2D_MODUL, QGL_SHADER_MODULATE, QGL_SHADER_TEXTURE2D, GL_TRUE, GL_FALSE);
@@ -134,19 +152,28 @@ void QGL_ReloadShaders(void) {
     LinkShader(QGL_SHADER_TEX2D_MODUL_A, QGL_SHADER_MODULATE_A, QGL_SHADER_TEXTURE2D, GL_TRUE, GL_FALSE);
     LinkShader(QGL_SHADER_FULL_A, QGL_SHADER_MODULATE_COLOR_A, QGL_SHADER_TEXTURE2D_WITH_COLOR, GL_TRUE, GL_TRUE);
     LinkShader(QGL_SHADER_RGBA_CLR_A, QGL_SHADER_RGBA_A, QGL_SHADER_COLOR, GL_FALSE, GL_TRUE);
+    LinkShader(QGL_SHADER_ALIAS_MODUL_CLR, QGL_SHADER_MODULATE_COLOR, QGL_SHADER_ALIAS, GL_TRUE, GL_TRUE);
+    LinkShader(QGL_SHADER_TEX2D_LIGHTMAP, QGL_SHADER_LIGHTMAPPED, QGL_SHADER_LIGHTMAPPED_VS, GL_TRUE, GL_FALSE);
 
-    for (GLuint p = 0; p < 9; ++p)
+    for (GLuint p = 0; p < QGL_NUM_PROGRAMS; ++p)
         u_mvp[p] = glGetUniformLocation(programs[p], "uMVP");
     u_modcolor[0] = glGetUniformLocation(programs[QGL_SHADER_TEX2D_MODUL], "uColor");
     u_modcolor[1] = glGetUniformLocation(programs[QGL_SHADER_TEX2D_MODUL_A], "uColor");
     u_monocolor = glGetUniformLocation(programs[QGL_SHADER_NO_COLOR], "uColor");
-    // uTexture should be 0 by default, so it should be fine
-
+    u_alias_blend = glGetUniformLocation(programs[QGL_SHADER_ALIAS_MODUL_CLR], "uBlend");
+    u_alias_shadevector = glGetUniformLocation(programs[QGL_SHADER_ALIAS_MODUL_CLR], "uShadeVector");
+    u_alias_shadelight = glGetUniformLocation(programs[QGL_SHADER_ALIAS_MODUL_CLR], "uShadeLight");
+    u_lm_lightscale = glGetUniformLocation(programs[QGL_SHADER_TEX2D_LIGHTMAP], "uLightScale");
+    // uTexture should be 0 by default, so it should be fine; uLightmap isn't
+    glUseProgram(programs[QGL_SHADER_TEX2D_LIGHTMAP]);
+    glUniform1i(glGetUniformLocation(programs[QGL_SHADER_TEX2D_LIGHTMAP], "uLightmap"), 1);
+
+    cur_program = (GLuint)-1;
     shaders_loaded = true;
 }
 
 void QGL_SetShader(void) {
-    qboolean changed = true;
+    GLuint program;
     just_color = false;
 
     switch (state_mask + texenv_mask) {
@@ -155,52 +182,47 @@ void QGL_SetShader(void) {
     case 0x08: // Alpha Test
     case 0x0C: // Alpha Test + Modulate
         just_color = true;
-        glUseProgram(programs[QGL_SHADER_NO_COLOR]);
-        cur_program = QGL_SHADER_NO_COLOR;
+        program = QGL_SHADER_NO_COLOR;
         break;
     case 0x01: // Texcoord
     case 0x03: // Texcoord + Color
-        glUseProgram(programs[QGL_SHADER_TEX2D_REPL]);
-        cur_program = QGL_SHADER_TEX2D_REPL;
+        program = QGL_SHADER_TEX2D_REPL;
         break;
     case 0x02: // Color
     case 0x06: // Color + Modulate
-        glUseProgram(programs[QGL_SHADER_RGBA_COLOR]);
-        cur_program = QGL_SHADER_RGBA_COLOR;
+        program = QGL_SHADER_RGBA_COLOR;
         break;
     case 0x05: // Modulate + Texcoord
-        glUseProgram(programs[QGL_SHADER_TEX2D_MODUL]);
-        cur_program = QGL_SHADER_TEX2D_MODUL;
+        program = QGL_SHADER_TEX2D_MODUL;
         break;
     case 0x07: // Modulate + Texcoord + Color
-        glUseProgram(programs[QGL_SHADER_TEX2D_MODUL_CLR]);
-        cur_program = QGL_SHADER_TEX2D_MODUL_CLR;
+        program = QGL_SHADER_TEX2D_MODUL_CLR;
         break;
     case 0x09: // Alpha Test + Texcoord
     case 0x0B: // Alpha Test + Color + Texcoord
-        glUseProgram(programs[QGL_SHADER_TEX2D_REPL_A]);
-        cur_program = QGL_SHADER_TEX2D_REPL_A;
+        program = QGL_SHADER_TEX2D_REPL_A;
         break;
     case 0x0A: // Alpha Test + Color
     case 0x0E: // Alpha Test + Modulate + Color
-        glUseProgram(programs[QGL_SHADER_RGBA_CLR_A]);
-        cur_program = QGL_SHADER_RGBA_CLR_A;
+        program = QGL_SHADER_RGBA_CLR_A;
         break;
     case 0x0D: // Alpha Test + Modulate + Texcoord
-        glUseProgram(programs[QGL_SHADER_TEX2D_MODUL_A]);
-        cur_program = QGL_SHADER_TEX2D_MODUL_A;
+        program = QGL_SHADER_TEX2D_MODUL_A;
         break;
     case 0x0F: // Alpha Test + Modulate + Texcoord + Color
-        glUseProgram(programs[QGL_SHADER_FULL_A]);
-        cur_program = QGL_SHADER_FULL_A;
+        program = QGL_SHADER_FULL_A;
         break;
     default:
-        changed = false;
-        break;
+        return;
     }
-    if (changed) {
+
+    // enable/disable calls land here all the time, mostly without changing
+    // the combination; only touch GL when the program really changes
+    if (program != cur_program) {
+        glUseProgram(programs[program]);
+        cur_program = program;
         program_changed = true;
-        // printf("PROGRAM CHANGE %u -> %u\n", old_program, cur_program);
+        c_program_switches++;
     }
 }
 
@@ -359,6 +381,7 @@ void qglEnd(void) {
     if (imm_mode > -1 && imm_numverts) {
         SetupAttribs();
         glDrawArrays(imm_mode, 0, imm_numverts);
+        c_draw_calls++;
         glDisableVertexAttribArray(1);
         glDisableVertexAttribArray(2);
     }
@@ -368,6 +391,80 @@ void qglEnd(void) {
     imm_mode = -1;
 }
 
+void QGL_BeginAlias(GLfloat blend, const GLfloat *shadevector, GLfloat shadelight) {
+    if (mvp_modified) {
+        glm_mat4_mul(m_projection, m_modelview, m_mvp);
+        mvp_modified = false;
+    }
+
+    glUseProgram(programs[QGL_SHADER_ALIAS_MODUL_CLR]);
+    c_program_switches++;
+    c_draw_calls++;
+    glUniformMatrix4fv(u_mvp[QGL_SHADER_ALIAS_MODUL_CLR], 1, GL_FALSE, (GLfloat *)m_mvp);
+    glUniform1f(u_alias_blend, blend);
+    glUniform3fv(u_alias_shadevector, 1, shadevector);
+    glUniform1f(u_alias_shadelight, shadelight);
+
+    // attrib 0 is always enabled
+    for (int i = QGL_ATTR_NORMAL0; i <= QGL_ATTR_TEXCOORD; i++)
+        glEnableVertexAttribArray(i);
+}
+
+void QGL_EndAlias(void) {
+    for (int i = QGL_ATTR_NORMAL0; i <= QGL_ATTR_TEXCOORD; i++)
+        glDisableVertexAttribArray(i);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // put the imm program back, with the matrix it may have missed
+    if (cur_program < QGL_NUM_PROGRAMS) {
+        glUseProgram(programs[cur_program]);
+        c_program_switches++;
+        glUniformMatrix4fv(u_mvp[cur_program], 1, GL_FALSE, (GLfloat *)m_mvp);
+    }
+}
+
+void QGL_BeginLightmapped(GLfloat lightscale) {
+    if (mvp_modified)
+        glm_mat4_mul(m_projection, m_modelview, m_mvp);
+    mvp_modified = false;
+
+    glUseProgram(programs[QGL_SHADER_TEX2D_LIGHTMAP]);
+    c_program_switches++;
+    glUniformMatrix4fv(u_mvp[QGL_SHADER_TEX2D_LIGHTMAP], 1, GL_FALSE, (GLfloat *)m_mvp);
+    glUniform1f(u_lm_lightscale, lightscale);
+
+    glEnableVertexAttribArray(QGL_ATTR_LM_TEXCOORD);
+    glEnableVertexAttribArray(QGL_ATTR_LM_LMCOORD);
+}
+
+void QGL_DrawLightmappedPoly(const GLfloat *verts, int numverts) {
+    // brush entities load their own matrix between polys
+    if (mvp_modified) {
+        glm_mat4_mul(m_projection, m_modelview, m_mvp);
+        glUniformMatrix4fv(u_mvp[QGL_SHADER_TEX2D_LIGHTMAP], 1, GL_FALSE, (GLfloat *)m_mvp);
+        mvp_modified = false;
+    }
+
+    glVertexAttribPointer(QGL_ATTR_LM_POS, 3, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(GLfloat), verts);
+    glVertexAttribPointer(QGL_ATTR_LM_TEXCOORD, 2, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(GLfloat), verts + 3);
+    glVertexAttribPointer(QGL_ATTR_LM_LMCOORD, 2, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(GLfloat), verts + 5);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, numverts);
+    c_draw_calls++;
+}
+
+void QGL_EndLightmapped(void) {
+    glDisableVertexAttribArray(QGL_ATTR_LM_TEXCOORD);
+    glDisableVertexAttribArray(QGL_ATTR_LM_LMCOORD);
+
+    if (cur_program < QGL_NUM_PROGRAMS) {
+        glUseProgram(programs[cur_program]);
+        c_program_switches++;
+        glUniformMatrix4fv(u_mvp[cur_program], 1, GL_FALSE, (GLfloat *)m_mvp);
+    }
+}
+
 void qglVertex3f(GLfloat x, GLfloat y, GLfloat z) {
     imm_vertp->pos[0] = x;
     imm_vertp->pos[1] = y;
@@ -58,6 +58,7 @@ void GL_Bind(int texnum) {
     if (currenttexture == texnum)
         return;
     currenttexture = texnum;
+    c_texture_binds++;
 
     glBindTexture(GL_TEXTURE_2D, texnum);
 }
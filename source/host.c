@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "menu.h"
 #include "model.h"
 #include "net.h"
+#include "prof.h"
 #include "protocol.h"
 #include "quakedef.h"
 #include "sbar.h"
@@ -213,6 +214,7 @@ Host_InitLocal
 */
 void Host_InitLocal(void) {
     Host_InitCommands();
+    Prof_Init();
 
     Cvar_RegisterVariable(&host_framerate);
     Cvar_RegisterVariable(&host_speeds);
@@ -354,6 +356,7 @@ void SV_DropClient(client_t *client, qboolean crash) {
     /* break the net connection */
     NET_Close(client->netconnection);
     client->netconnection = NULL;
+    client->signondata = NULL;
 
     /* free the client (the body stays around) */
     client->active = false;
@@ -470,7 +473,9 @@ qboolean Host_FilterTime(float time) {
     host_frametime = realtime - oldrealtime;
     oldrealtime = realtime;
 
-    if (host_framerate.value > 0)
+    if (cls.td_timestep > 0)
+        host_frametime = cls.td_timestep;
+    else if (host_framerate.value > 0)
         host_frametime = host_framerate.value;
     else {  // don't allow really long or short frames
         if (host_frametime > 0.1) host_frametime = 0.1;
@@ -514,7 +519,11 @@ void _Host_ServerFrame(void) {
 
     // move things around and think
     // always pause in single player if in console or menus
-    if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game)) SV_Physics();
+    if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game)) {
+        PROF_BEGIN(PROF_SV_PHYSICS);
+        SV_Physics();
+        PROF_END(PROF_SV_PHYSICS);
+    }
 }
 
 void Host_ServerFrame(void) {
@@ -542,7 +551,9 @@ void Host_ServerFrame(void) {
     host_frametime = save_host_frametime;
 
     // send all messages to the clients
+    PROF_BEGIN(PROF_SV_SEND);
     SV_SendClientMessages();
+    PROF_END(PROF_SV_SEND);
 }
 
 #else
@@ -564,10 +575,16 @@ void Host_ServerFrame(void) {
      * Move things around and think. Always pause in single player if in
      * console or menus
      */
-    if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game)) SV_Physics();
+    if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game)) {
+        PROF_BEGIN(PROF_SV_PHYSICS);
+        SV_Physics();
+        PROF_END(PROF_SV_PHYSICS);
+    }
 
     /* send all messages to the clients */
+    PROF_BEGIN(PROF_SV_SEND);
     SV_SendClientMessages();
+    PROF_END(PROF_SV_SEND);
 }
 
 #endif
@@ -597,6 +614,9 @@ void _Host_Frame(float time) {
      */
     if (!Host_FilterTime(time)) return;
 
+    Prof_BeginFrame();
+    PROF_BEGIN(PROF_HOST);
+
     /* get new key events */
     Sys_SendKeyEvents();
 
@@ -620,7 +640,12 @@ void _Host_Frame(float time) {
     /* check for commands typed to the host */
     Host_GetConsoleCommands();
 
-    if (sv.active) Host_ServerFrame();
+    if (sv.active) {
+        PROF_BEGIN(PROF_SERVER);
+        Host_ServerFrame();
+        PROF_END(PROF_SERVER);
+    }
+    SV_SnapUpdate();
 
     //-------------------
     //
@@ -637,22 +662,30 @@ void _Host_Frame(float time) {
     host_time += host_frametime;
 
     /* fetch results from server */
-    if (cls.state >= ca_connected) CL_ReadFromServer();
+    if (cls.state >= ca_connected) {
+        PROF_BEGIN(PROF_CL_READ);
+        CL_ReadFromServer();
+        PROF_END(PROF_CL_READ);
+    }
 
     /* update video */
     if (host_speeds.value) time1 = Sys_DoubleTime();
 
+    PROF_BEGIN(PROF_SCREEN);
     SCR_UpdateScreen();
+    PROF_END(PROF_SCREEN);
     CL_RunParticles();
 
     if (host_speeds.value) time2 = Sys_DoubleTime();
 
     /* update audio */
+    PROF_BEGIN(PROF_SOUND);
     if (cls.state == ca_active) {
         S_Update(r_origin, vpn, vright, vup);
         CL_DecayLights();
     } else
         S_Update(vec3_origin, vec3_origin, vec3_origin, vec3_origin);
+    PROF_END(PROF_SOUND);
 
     CDAudio_Update();
 
@@ -665,6 +698,9 @@ void _Host_Frame(float time) {
                    pass3);
     }
 
+    PROF_END(PROF_HOST);
+    Prof_EndFrame();
+
     host_framecount++;
     fps_count++;
 }
@@ -799,6 +835,8 @@ void Host_Shutdown(void) {
     scr_disabled_for_loading = true;
 
     Host_WriteConfiguration();
+    Prof_Shutdown();
+    SV_SnapShutdown();
 
     CDAudio_Shutdown();
     NET_Shutdown();
@@ -0,0 +1,333 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sys_unix.c -- POSIX system driver for the headless host build
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "common.h"
+#include "host.h"
+#include "quakedef.h"
+#include "sys.h"
+#include "zone.h"
+
+#ifndef QBASEDIR
+#define QBASEDIR "."
+#endif
+
+qboolean isDedicated;
+
+static qboolean nostdout = false;
+
+/*
+ * ===========================================================================
+ * General Routines
+ * ===========================================================================
+ */
+
+void Sys_Printf(const char *fmt, ...) {
+    va_list argptr;
+    char text[MAX_PRINTMSG];
+    unsigned char *p;
+
+    if (nostdout) return;
+
+    va_start(argptr, fmt);
+    vsnprintf(text, sizeof(text), fmt, argptr);
+    va_end(argptr);
+
+    for (p = (unsigned char *)text; *p; p++) {
+        if ((*p > 128 || *p < 32) && *p != 10 && *p != 13 && *p != 9)
+            printf("[%02x]", *p);
+        else
+            putc(*p, stdout);
+    }
+    fflush(stdout);
+}
+
+/*
+ * ===========================================================================
+ * Worker threads
+ * ===========================================================================
+ */
+
+#define SYS_MAX_WORKERS 8
+
+static pthread_t sys_workers[SYS_MAX_WORKERS];
+static int sys_numworkers = -1; /* -1 until the workers are started */
+static sem_t sys_jobstart;
+static sem_t sys_jobdone;
+static volatile qboolean sys_workersquit;
+
+static struct {
+    void (*func)(int index, void *data);
+    void *data;
+    int count;
+    int next; /* next index to hand out, taken atomically */
+} sys_job;
+
+static void Sys_RunJob(void) {
+    int index;
+
+    while ((index = __atomic_fetch_add(&sys_job.next, 1, __ATOMIC_RELAXED)) < sys_job.count)
+        sys_job.func(index, sys_job.data);
+}
+
+static void *Sys_WorkerThread(void *arg) {
+    while (1) {
+        sem_wait(&sys_jobstart);
+        if (sys_workersquit) break;
+        Sys_RunJob();
+        sem_post(&sys_jobdone);
+    }
+    return NULL;
+}
+
+static void Sys_StartWorkers(void) {
+    long cpus;
+    int i, count;
+
+    sem_init(&sys_jobstart, 0, 0);
+    sem_init(&sys_jobdone, 0, 0);
+    sys_numworkers = 0;
+    if (COM_CheckParm("-noworkers")) return;
+
+    /* the main thread takes a share of every job too */
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    count = (cpus > 1) ? qmin(cpus - 1, (long)SYS_MAX_WORKERS) : 0;
+    for (i = 0; i < count; i++) {
+        if (pthread_create(&sys_workers[i], NULL, Sys_WorkerThread, NULL)) break;
+        sys_numworkers++;
+    }
+}
+
+static void Sys_StopWorkers(void) {
+    int i;
+
+    if (sys_numworkers <= 0) return;
+
+    sys_workersquit = true;
+    for (i = 0; i < sys_numworkers; i++) sem_post(&sys_jobstart);
+    for (i = 0; i < sys_numworkers; i++) pthread_join(sys_workers[i], NULL);
+    sys_numworkers = 0;
+}
+
+int Sys_NumWorkers(void) {
+    if (sys_numworkers < 0) Sys_StartWorkers();
+    return sys_numworkers;
+}
+
+void Sys_ParallelFor(int count, void (*func)(int index, void *data), void *data) {
+    int i, workers;
+
+    workers = Sys_NumWorkers();
+    if (workers > count - 1) workers = count - 1;
+    if (workers <= 0) {
+        for (i = 0; i < count; i++) func(i, data);
+        return;
+    }
+
+    sys_job.func = func;
+    sys_job.data = data;
+    sys_job.count = count;
+    sys_job.next = 0;
+
+    for (i = 0; i < workers; i++) sem_post(&sys_jobstart);
+    Sys_RunJob();
+    for (i = 0; i < workers; i++) sem_wait(&sys_jobdone);
+}
+
+void Sys_Quit(void) {
+    Host_Shutdown();
+    Sys_StopWorkers();
+    exit(0);
+}
+
+void Sys_Init(void) {}
+
+void Sys_Error(const char *error, ...) {
+    va_list argptr;
+    char string[MAX_PRINTMSG];
+
+    va_start(argptr, error);
+    vsnprintf(string, sizeof(string), error, argptr);
+    va_end(argptr);
+    fprintf(stderr, "Error: %s\n", string);
+
+    Host_Shutdown();
+    exit(1);
+}
+
+/*
+============
+Sys_FileTime
+
+returns -1 if not present
+============
+*/
+int Sys_FileTime(const char *path) {
+    struct stat buf;
+
+    if (stat(path, &buf) == -1) return -1;
+
+    return buf.st_mtime;
+}
+
+void Sys_mkdir(const char *path) { mkdir(path, 0777); }
+
+double Sys_DoubleTime(void) {
+    struct timeval tp;
+    static int secbase;
+
+    gettimeofday(&tp, NULL);
+
+    if (!secbase) {
+        secbase = tp.tv_sec;
+        return tp.tv_usec / 1000000.0;
+    }
+
+    return (tp.tv_sec - secbase) + tp.tv_usec / 1000000.0;
+}
+
+/*
+================
+Sys_ConsoleInput
+
+Checks for a complete line of text typed in at the console, then forwards
+it to the host command processor
+================
+*/
+char *Sys_ConsoleInput(void) {
+    static char text[256];
+    int len;
+    fd_set fdset;
+    struct timeval timeout;
+
+    if (cls.state != ca_dedicated) return NULL;
+
+    FD_ZERO(&fdset);
+    FD_SET(STDIN_FILENO, &fdset);
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+    if (select(STDIN_FILENO + 1, &fdset, NULL, NULL, &timeout) == -1 ||
+        !FD_ISSET(STDIN_FILENO, &fdset))
+        return NULL;
+
+    len = read(STDIN_FILENO, text, sizeof(text));
+    if (len < 1) return NULL;
+    text[len - 1] = 0; /* remove the /n and terminate */
+
+    return text;
+}
+
+void Sys_Sleep(void) {
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = 1000000;
+
+    while (nanosleep(&ts, &ts) == -1)
+        if (errno != EINTR) break;
+}
+
+void Sys_DebugLog(const char *file, const char *fmt, ...) {
+    va_list argptr;
+    static char data[MAX_PRINTMSG];
+    int fd;
+
+    va_start(argptr, fmt);
+    vsnprintf(data, sizeof(data), fmt, argptr);
+    va_end(argptr);
+    fd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (fd < 0) return;
+    if (write(fd, data, strlen(data)) < 0) {}
+    close(fd);
+}
+
+void Sys_HighFPPrecision(void) {}
+void Sys_LowFPPrecision(void) {}
+void Sys_SetFPCW(void) {}
+void Sys_MakeCodeWriteable(void *start_addr, void *end_addr) {}
+
+/*
+ * ===========================================================================
+ * Main
+ * ===========================================================================
+ */
+
+int main(int argc, const char *argv[]) {
+    double time, oldtime, newtime;
+    quakeparms_t parms;
+
+    signal(SIGFPE, SIG_IGN);
+
+    memset(&parms, 0, sizeof(parms));
+
+    COM_InitArgv(argc, argv);
+    parms.argc = com_argc;
+    parms.argv = com_argv;
+    parms.basedir = QBASEDIR;
+    parms.memsize = Memory_GetSize();
+    parms.membase = malloc(parms.memsize);
+    if (!parms.membase) Sys_Error("Allocation of %d byte heap failed", (int)parms.memsize);
+
+    if (COM_CheckParm("-nostdout")) nostdout = true;
+    if (!nostdout) printf("Quake -- TyrQuake Version %s\n", stringify(TYR_VERSION));
+
+    Sys_Init();
+    Host_Init(&parms);
+
+    oldtime = Sys_DoubleTime() - 0.1;
+    while (1) {
+        /* find time passed since last cycle */
+        newtime = Sys_DoubleTime();
+        time = newtime - oldtime;
+
+        if (cls.state == ca_dedicated) {
+            if (time < sys_ticrate.value) {
+                Sys_Sleep();
+                continue; // not time to run a server only tic yet
+            }
+            time = sys_ticrate.value;
+        }
+        if (time > sys_ticrate.value * 2)
+            oldtime = newtime;
+        else
+            oldtime += time;
+
+        Host_Frame(time);
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// vid_null.c -- video driver that renders into memory and never shows it
+
+#include "cmd.h"
+#include "common.h"
+#include "console.h"
+#include "cvar.h"
+#include "d_iface.h"
+#include "d_local.h"
+#include "host.h"
+#include "quakedef.h"
+#include "sys.h"
+#include "vid.h"
+
+/*
+ * The software renderer draws into vid.buffer as usual, so R_FrameChecksum
+ * works; VID_Update has nowhere to send it. Used by the host build for
+ * benchdemo. The size comes from -width and -height, 320x200 by default.
+ */
+
+#define BASEWIDTH 320
+#define BASEHEIGHT 200
+
+static cvar_t vid_mode = {"vid_mode", "0"};
+
+static byte *vid_surfcache;
+static int vid_surfcachesize;
+
+unsigned short d_8to16table[256];
+unsigned d_8to24table[256];
+viddef_t vid; /* global video state */
+int vid_modenum = VID_MODE_NONE;
+
+qboolean window_visible(void) { return true; }
+qboolean VID_IsFullScreen(void) { return false; }
+
+void VID_SetPalette(const byte *palette) {}
+void VID_ShiftPalette(const byte *palette) {}
+void VID_SetDefaultMode(void) {}
+void VID_Shutdown(void) {}
+void VID_Update(vrect_t *rects) {}
+void VID_LockBuffer(void) {}
+void VID_UnlockBuffer(void) {}
+void D_BeginDirectRect(int x, int y, const byte *pbitmap, int width, int height) {}
+void D_EndDirectRect(int x, int y, int width, int height) {}
+
+qboolean VID_CheckAdequateMem(int width, int height) {
+    int tbuffersize;
+
+    tbuffersize = width * height * sizeof(*d_pzbuffer);
+    tbuffersize += D_SurfaceCacheForRes(width, height);
+
+    return host_parms.memsize - tbuffersize + SURFCACHE_SIZE_AT_320X200 + 0x10000 * 3 >= minimum_memory;
+}
+
+qboolean VID_SetMode(const qvidmode_t *mode, const byte *palette) {
+    int tbuffersize;
+
+    vid.numpages = 1;
+    vid.width = vid.conwidth = mode->width;
+    vid.height = vid.conheight = mode->height;
+    vid.maxwarpwidth = WARP_WIDTH;
+    vid.maxwarpheight = WARP_HEIGHT;
+    vid.aspect = ((float)vid.height / (float)vid.width) * (320.0 / 240.0);
+    vid.colormap = host_colormap;
+    vid.fullbright = 256 - LittleLong(*((int *)vid.colormap + 2048));
+
+    vid_surfcachesize = D_SurfaceCacheForRes(vid.width, vid.height);
+    tbuffersize = vid.width * vid.height * sizeof(*d_pzbuffer) + vid_surfcachesize;
+    d_pzbuffer = Hunk_HighAllocName(tbuffersize, "video");
+    vid_surfcache = (byte *)d_pzbuffer + vid.width * vid.height * sizeof(*d_pzbuffer);
+
+    vid.buffer = vid.conbuffer = vid.direct = Hunk_HighAllocName(vid.width * vid.height, "vidbuf");
+    vid.rowbytes = vid.conrowbytes = vid.width;
+
+    D_InitCaches(vid_surfcache, vid_surfcachesize);
+
+    vid_modenum = mode - modelist;
+    vid.recalc_refdef = 1;
+
+    return true;
+}
+
+void VID_Init(const byte *palette) {
+    qvidmode_t *mode;
+    int i;
+
+    Cvar_RegisterVariable(&vid_mode);
+    VID_InitModeCvars();
+
+    mode = modelist;
+    mode->modenum = 0;
+    mode->width = BASEWIDTH;
+    mode->height = BASEHEIGHT;
+    mode->bpp = 8;
+    mode->refresh = 0;
+    nummodes = 1;
+
+    i = COM_CheckParm("-width");
+    if (i && i < com_argc - 1) mode->width = qclamp(atoi(com_argv[i + 1]), BASEWIDTH, MAXWIDTH);
+    i = COM_CheckParm("-height");
+    if (i && i < com_argc - 1) mode->height = qclamp(atoi(com_argv[i + 1]), BASEHEIGHT, MAXHEIGHT);
+
+    VID_SetMode(mode, palette);
+}
+
+void Sys_SendKeyEvents(void) {}
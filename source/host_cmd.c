@@ -446,6 +446,8 @@ static void Host_Loadgame_f(void) {
 
     sv.num_edicts = entnum;
     sv.time = time;
+    ED_ResetLists();
+    SV_RewindReset();
 
     fclose(f);
 
@@ -457,6 +459,137 @@ static void Host_Loadgame_f(void) {
     }
 }
 
+/*
+===============
+Host_Savesnap_f
+
+Like save, but writes a binary snapshot (.snp) in the background
+===============
+*/
+static void Host_Savesnap_f(void) {
+    char name[MAX_OSPATH];
+    int i, length, err;
+
+    if (cmd_source != src_command) return;
+
+    if (!sv.active) {
+        Con_Printf("Not playing a local game.\n");
+        return;
+    }
+
+    if (cl.intermission) {
+        Con_Printf("Can't save in intermission.\n");
+        return;
+    }
+
+    if (svs.maxclients != 1) {
+        Con_Printf("Can't save multiplayer games.\n");
+        return;
+    }
+
+    if (Cmd_Argc() != 2) {
+        Con_Printf("savesnap <savename> : save a game snapshot\n");
+        return;
+    }
+
+    if (strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+
+    for (i = 0; i < svs.maxclients; i++) {
+        if (svs.clients[i].active && (svs.clients[i].edict->v.health <= 0)) {
+            Con_Printf("Can't savegame with a dead player\n");
+            return;
+        }
+    }
+
+    length = snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+    err = COM_DefaultExtension(name, ".snp", name, sizeof(name));
+    if (length >= sizeof(name) || err) {
+        Con_Printf("ERROR: couldn't save, filename too long.\n");
+        return;
+    }
+
+    Con_Printf("Saving snapshot to %s\n", name);
+    if (!SV_SnapSave(name)) Con_Printf("ERROR: couldn't open.\n");
+}
+
+/*
+===============
+Host_Loadsnap_f
+
+Restores in place when the snapshot is for the map already running,
+otherwise spawns the map first as load does
+===============
+*/
+static void Host_Loadsnap_f(void) {
+    char name[MAX_OSPATH];
+    snapheader_t *snap;
+    double start;
+    int length, err;
+    qboolean spawn;
+
+    if (cmd_source != src_command) return;
+
+    if (Cmd_Argc() != 2) {
+        Con_Printf("loadsnap <savename> : load a game snapshot\n");
+        return;
+    }
+
+    if (strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+
+    cls.demonum = -1;  // stop demo loop in case this fails
+
+    length = snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+    err = COM_DefaultExtension(name, ".snp", name, sizeof(name));
+    if (length >= sizeof(name) || err) {
+        Con_Printf("ERROR: couldn't open snapshot, filename too long.\n");
+        return;
+    }
+
+    SV_SnapShutdown(); /* in case it is still being written */
+    start = Sys_DoubleTime();
+    snap = SV_SnapLoad(name);
+    if (!snap) {
+        Con_Printf("ERROR: couldn't open %s, or not a snapshot.\n", name);
+        return;
+    }
+
+    current_skill = snap->skill;
+    Cvar_SetValue("skill", (float)current_skill);
+
+    spawn = !sv.active || svs.maxclients != 1 || strcmp(sv.name, snap->mapname);
+    if (spawn) {
+        CL_Disconnect_f();
+        SV_SpawnServer(snap->mapname);
+        if (!sv.active) {
+            Con_Printf("Couldn't load map\n");
+            SV_SnapFree(snap);
+            return;
+        }
+        sv.paused = true;  // pause until all clients connect
+        sv.loadgame = true;
+    }
+
+    if (!SV_SnapRestore(snap)) {
+        SV_SnapFree(snap);
+        return;
+    }
+    memcpy(svs.clients->spawn_parms, snap->spawn_parms, sizeof(snap->spawn_parms));
+    SV_SnapFree(snap);
+
+    Con_Printf("Loaded snapshot %s in %.2f msec\n", name, (Sys_DoubleTime() - start) * 1000.0);
+
+    if (spawn && cls.state != ca_dedicated) {
+        CL_EstablishConnection("local");
+        Host_Reconnect_f();
+    }
+}
+
 //============================================================================
 
 static void Host_Version_f(void) {
@@ -662,6 +795,8 @@ void Host_InitCommands(void) {
 
     Cmd_AddCommand("load", Host_Loadgame_f);
     Cmd_AddCommand("save", Host_Savegame_f);
+    Cmd_AddCommand("loadsnap", Host_Loadsnap_f);
+    Cmd_AddCommand("savesnap", Host_Savesnap_f);
 
     Cmd_AddCommand("startdemos", Host_Startdemos_f);
     Cmd_AddCommand("demos", Host_Demos_f);
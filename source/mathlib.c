@@ -275,7 +275,7 @@ void AngleVectors(const vec3_t angles, vec3_t forward, vec3_t right, vec3_t up)
     up[2] = cr * cp;
 }
 
-int VectorCompare(vec3_t v1, vec3_t v2) {
+int VectorCompare(const vec3_t v1, const vec3_t v2) {
     int i;
 
     for (i = 0; i < 3; i++)
@@ -1897,6 +1897,66 @@ int Mod_HullPointContents(const hull_t *hull, int nodenum, const vec3_t point) {
 /* 1/32 epsilon to keep floating point happy */
 #define DIST_EPSILON (0.03125)
 
+/* Flags the trace for the contents of a leaf it passes through */
+static inline void Mod_TraceLeaf(int contents, trace_t *trace) {
+    if (contents != CONTENTS_SOLID) {
+        trace->allsolid = false;
+        if (contents == CONTENTS_EMPTY)
+            trace->inopen = true;
+        else
+            trace->inwater = true;
+    } else {
+        trace->startsolid = true;
+    }
+}
+
+/*
+==================
+Mod_TraceImpact
+
+The trace crossed the plane at mid into solid on the far side, so this is
+the impact point. Backs it up until it is out of the solid and fills in the
+trace. Always returns false.
+==================
+*/
+static qboolean Mod_TraceImpact(const hull_t *hull, const mplane_t *plane, int side, vec_t frac,
+                                const float p1f, const float p2f, const vec3_t p1,
+                                const vec3_t p2, vec3_t mid, vec_t midf, trace_t *trace) {
+    int i, contents;
+
+    /* Never got out of the solid area */
+    if (trace->allsolid) return false;
+
+    if (!side) {
+        VectorCopy(plane->normal, trace->plane.normal);
+        trace->plane.dist = plane->dist;
+    } else {
+        VectorSubtract(vec3_origin, plane->normal, trace->plane.normal);
+        trace->plane.dist = -plane->dist;
+    }
+
+    /* shouldn't really happen, but does occasionally */
+    contents = Mod_HullPointContents(hull, hull->firstclipnode, mid);
+    while (contents == CONTENTS_SOLID) {
+        frac -= 0.1;
+        if (frac < 0) {
+            trace->fraction = midf;
+            VectorCopy(mid, trace->endpos);
+            trace->backedup = true; /* may be on a worker thread, so no printing here */
+            return false;
+        }
+        midf = p1f + (p2f - p1f) * frac;
+        for (i = 0; i < 3; i++) mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+
+        contents = Mod_HullPointContents(hull, hull->firstclipnode, mid);
+    }
+
+    trace->fraction = midf;
+    VectorCopy(mid, trace->endpos);
+
+    return false;
+}
+
 /*
 ==================
 MOD_TraceHull
@@ -1908,19 +1968,11 @@ static qboolean Mod_TraceHull_r(const hull_t *hull, int nodenum, const float p1f
     const mplane_t *plane;
     vec3_t mid;
     vec_t dist1, dist2, frac, midf;
-    int i, child, side, contents;
+    int i, child, side;
 
     /* check for empty */
     if (nodenum < 0) {
-        if (nodenum != CONTENTS_SOLID) {
-            trace->allsolid = false;
-            if (nodenum == CONTENTS_EMPTY)
-                trace->inopen = true;
-            else
-                trace->inwater = true;
-        } else {
-            trace->startsolid = true;
-        }
+        Mod_TraceLeaf(nodenum, trace);
         return true;
     }
 
@@ -1986,41 +2038,148 @@ static qboolean Mod_TraceHull_r(const hull_t *hull, int nodenum, const float p1f
     if (Mod_HullPointContents(hull, child, mid) != CONTENTS_SOLID) /* Go past the node */
         return Mod_TraceHull_r(hull, child, midf, p2f, mid, p2, trace);
 
-    /* Never got out of the solid area */
-    if (trace->allsolid) return false;
-
     /* The other side of the node is solid, this is the impact point */
-    if (!side) {
-        VectorCopy(plane->normal, trace->plane.normal);
-        trace->plane.dist = plane->dist;
-    } else {
-        VectorSubtract(vec3_origin, plane->normal, trace->plane.normal);
-        trace->plane.dist = -plane->dist;
-    }
-
-    /* shouldn't really happen, but does occasionally */
-    contents = Mod_HullPointContents(hull, hull->firstclipnode, mid);
-    while (contents == CONTENTS_SOLID) {
-        frac -= 0.1;
-        if (frac < 0) {
-            trace->fraction = midf;
-            VectorCopy(mid, trace->endpos);
-            Con_DPrintf("backup past 0\n");
-            return false;
-        }
-        midf = p1f + (p2f - p1f) * frac;
-        for (i = 0; i < 3; i++) mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+    return Mod_TraceImpact(hull, plane, side, frac, p1f, p2f, p1, p2, mid, midf, trace);
+}
 
-        contents = Mod_HullPointContents(hull, hull->firstclipnode, mid);
-    }
+qboolean Mod_TraceHullRecursive(const hull_t *hull, int nodenum, const vec3_t p1, const vec3_t p2,
+                                trace_t *trace) {
+    return Mod_TraceHull_r(hull, nodenum, 0, 1, p1, p2, trace);
+}
 
-    trace->fraction = midf;
-    VectorCopy(mid, trace->endpos);
+/*
+ * Mod_TraceHull gives exactly the same results as the recursive walk above,
+ * with the same arithmetic, but keeps its own stack: each node the segment
+ * crosses pushes its far side, and once the near side has been walked down
+ * to a leaf the innermost split is popped and the walk carries on past its
+ * node from the crossing point.
+ *
+ * Before going past a node the recursive walk looks up the contents of the
+ * crossing point on the far side, then walks the far side again for the
+ * rest of the trace. Walking a segment always reaches the leaf holding its
+ * start point first, so here the far side is walked once and the crossing
+ * point's contents are simply the first leaf it reaches.
+ */
+#define TRACE_STACK 128
 
-    return false;
-}
+typedef struct {
+    const mclipnode_t *node;
+    int side;
+    vec_t frac, midf;
+    float p1f, p2f;
+    vec3_t p1, p2, mid;
+} tracesplit_t;
 
+/*
+==================
+Mod_TraceHull
+==================
+*/
 qboolean Mod_TraceHull(const hull_t *hull, int nodenum, const vec3_t p1, const vec3_t p2,
                        trace_t *trace) {
-    return Mod_TraceHull_r(hull, nodenum, 0, 1, p1, p2, trace);
+    tracesplit_t stack[TRACE_STACK];
+    tracesplit_t *split, *crossed, saved;
+    const mclipnode_t *node;
+    const mplane_t *plane;
+    const vec_t *start, *end;
+    vec_t dist1, dist2, frac;
+    float p1f, p2f;
+    int i, depth, rootnode;
+    qboolean pastnode;
+
+    /* a point never splits, so only its leaf matters */
+    if (VectorCompare(p1, p2)) {
+        Mod_TraceLeaf(Mod_HullPointContents(hull, nodenum, p1), trace);
+        return true;
+    }
+
+    rootnode = nodenum;
+    depth = 0;
+    crossed = NULL;
+    pastnode = false;
+    p1f = 0;
+    p2f = 1;
+    start = p1;
+    end = p2;
+
+    while (1) {
+        /* walk down the near side to a leaf */
+        while (nodenum >= 0) {
+            if (nodenum < hull->firstclipnode || nodenum > hull->lastclipnode)
+                SV_Error("%s: bad node number", __func__);
+
+            node = hull->clipnodes + nodenum;
+            plane = hull->planes + node->planenum;
+            if (plane->type < 3) {
+                dist1 = start[plane->type] - plane->dist;
+                dist2 = end[plane->type] - plane->dist;
+            } else {
+                dist1 = DotProduct(plane->normal, start) - plane->dist;
+                dist2 = DotProduct(plane->normal, end) - plane->dist;
+            }
+
+            if (dist1 >= 0 && dist2 >= 0) {
+                nodenum = node->children[0];
+                continue;
+            }
+            if (dist1 < 0 && dist2 < 0) {
+                nodenum = node->children[1];
+                continue;
+            }
+
+            /* too deep for the stack, start again the slow way */
+            if (depth == TRACE_STACK) return Mod_TraceHull_r(hull, rootnode, 0, 1, p1, p2, trace);
+
+            /* Put the crosspoint DIST_EPSILON pixels on the near side */
+            if (dist1 < 0)
+                frac = (dist1 + DIST_EPSILON) / (dist1 - dist2);
+            else
+                frac = (dist1 - DIST_EPSILON) / (dist1 - dist2);
+            if (frac < 0) frac = 0;
+            if (frac > 1) frac = 1;
+
+            split = &stack[depth++];
+            if (split == crossed) {
+                /* still needed if the far side turns out to be solid */
+                saved = *crossed;
+                crossed = &saved;
+                if (start == split->mid) start = saved.mid;
+                if (end == split->p2) end = saved.p2;
+            }
+            split->node = node;
+            split->side = (dist1 < 0);
+            split->frac = frac;
+            split->p1f = p1f;
+            split->p2f = p2f;
+            split->midf = p1f + (p2f - p1f) * frac;
+            VectorCopy(start, split->p1);
+            VectorCopy(end, split->p2);
+            for (i = 0; i < 3; i++) split->mid[i] = start[i] + frac * (end[i] - start[i]);
+
+            /* move up to the node */
+            nodenum = node->children[split->side];
+            p2f = split->midf;
+            end = split->mid;
+        }
+
+        /* The other side of the node is solid, this is the impact point */
+        if (pastnode && nodenum == CONTENTS_SOLID) break;
+        pastnode = false;
+
+        Mod_TraceLeaf(nodenum, trace);
+        if (!depth) return true;
+
+        /* the near side of the innermost split is clear, go past the node */
+        crossed = &stack[--depth];
+        nodenum = crossed->node->children[crossed->side ^ 1];
+        pastnode = true;
+        p1f = crossed->midf;
+        p2f = crossed->p2f;
+        start = crossed->mid;
+        end = crossed->p2;
+    }
+
+    plane = hull->planes + crossed->node->planenum;
+    return Mod_TraceImpact(hull, plane, crossed->side, crossed->frac, crossed->p1f, crossed->p2f,
+                           crossed->p1, crossed->p2, crossed->mid, crossed->midf, trace);
 }
@@ -0,0 +1,484 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_bot.c -- headless protocol clients for net_loadtest
+
+#include <math.h>
+#include <string.h>
+
+#include "common.h"
+#include "net_bot.h"
+#include "protocol.h"
+#include "quakedef.h"
+
+/*
+ * Everything here reads exactly what the matching code in cl_parse.c,
+ * cl_tent.c, r_part.c and view.c reads, and throws it away. A message the
+ * real client would stop on with Host_Error is counted as an error and the
+ * rest of it skipped, so one bad message can't take down a local server.
+ */
+
+#define BOT_FORWARDSPEED 200 /* cl_forwardspeed */
+#define BOT_SIDESPEED 350    /* cl_sidespeed */
+
+void Bot_Reset(bot_t *bot, int index) {
+    memset(bot, 0, sizeof(*bot));
+    bot->index = index;
+    bot->servertime = -1;
+}
+
+static int Bot_ReadModelIndex(const bot_t *bot, unsigned int bits) {
+    if (bot->protocol == PROTOCOL_VERSION_NQ) return MSG_ReadByte();
+    if (bot->protocol == PROTOCOL_VERSION_FITZ && !(bits & B_FITZ_LARGEMODEL))
+        return MSG_ReadByte();
+    return MSG_ReadShort();
+}
+
+static int Bot_ReadSoundNum(const bot_t *bot, int field_mask) {
+    switch (bot->protocol) {
+        case PROTOCOL_VERSION_BJP2:
+        case PROTOCOL_VERSION_BJP3:
+            return MSG_ReadShort();
+        case PROTOCOL_VERSION_FITZ:
+            if (field_mask & SND_FITZ_LARGESOUND) return MSG_ReadShort();
+            return MSG_ReadByte();
+        default:
+            return MSG_ReadByte();
+    }
+}
+
+static void Bot_ReadCoords(int count) {
+    while (count--) MSG_ReadCoord();
+}
+
+static void Bot_ParseServerInfo(bot_t *bot) {
+    int protocol;
+
+    protocol = MSG_ReadLong();
+    if (!Protocol_Known(protocol)) {
+        msg_badread = true;
+        return;
+    }
+    bot->protocol = protocol;
+
+    MSG_ReadByte();   // maxclients
+    MSG_ReadByte();   // gametype
+    MSG_ReadString(); // level name
+
+    /* model and sound precaches, each list ends with an empty string */
+    while (!msg_badread && MSG_ReadString()[0]);
+    while (!msg_badread && MSG_ReadString()[0]);
+}
+
+static void Bot_ParseUpdate(bot_t *bot, unsigned int bits) {
+    if (bits & U_MOREBITS) bits |= MSG_ReadByte() << 8;
+    if (bot->protocol == PROTOCOL_VERSION_FITZ) {
+        if (bits & U_FITZ_EXTEND1) bits |= MSG_ReadByte() << 16;
+        if (bits & U_FITZ_EXTEND2) bits |= MSG_ReadByte() << 24;
+    }
+
+    if (bits & U_LONGENTITY)
+        MSG_ReadShort();
+    else
+        MSG_ReadByte();
+
+    if (bits & U_MODEL) Bot_ReadModelIndex(bot, 0);
+    if (bits & U_FRAME) MSG_ReadByte();
+    if (bits & U_COLORMAP) MSG_ReadByte();
+    if (bits & U_SKIN) MSG_ReadByte();
+    if (bits & U_EFFECTS) MSG_ReadByte();
+    if (bits & U_ORIGIN1) MSG_ReadCoord();
+    if (bits & U_ANGLE1) MSG_ReadAngle();
+    if (bits & U_ORIGIN2) MSG_ReadCoord();
+    if (bits & U_ANGLE2) MSG_ReadAngle();
+    if (bits & U_ORIGIN3) MSG_ReadCoord();
+    if (bits & U_ANGLE3) MSG_ReadAngle();
+
+    if (bot->protocol == PROTOCOL_VERSION_FITZ) {
+        if (bits & U_FITZ_ALPHA) MSG_ReadByte();
+        if (bits & U_FITZ_FRAME2) MSG_ReadByte();
+        if (bits & U_FITZ_MODEL2) MSG_ReadByte();
+        if (bits & U_FITZ_LERPFINISH) MSG_ReadByte();
+    }
+}
+
+static void Bot_ParseBaseline(bot_t *bot, unsigned int bits) {
+    int i;
+
+    Bot_ReadModelIndex(bot, bits);
+    if (bot->protocol == PROTOCOL_VERSION_FITZ && (bits & B_FITZ_LARGEFRAME))
+        MSG_ReadShort();
+    else
+        MSG_ReadByte();
+    MSG_ReadByte(); // colormap
+    MSG_ReadByte(); // skin
+    for (i = 0; i < 3; i++) {
+        MSG_ReadCoord();
+        MSG_ReadAngle();
+    }
+    if (bot->protocol == PROTOCOL_VERSION_FITZ && (bits & B_FITZ_ALPHA)) MSG_ReadByte();
+}
+
+static void Bot_ParseClientdata(bot_t *bot) {
+    unsigned int bits;
+    int i;
+
+    bits = (unsigned short)MSG_ReadShort();
+    if (bits & SU_FITZ_EXTEND1) bits |= MSG_ReadByte() << 16;
+    if (bits & SU_FITZ_EXTEND2) bits |= MSG_ReadByte() << 24;
+
+    if (bits & SU_VIEWHEIGHT) MSG_ReadChar();
+    if (bits & SU_IDEALPITCH) MSG_ReadChar();
+    for (i = 0; i < 3; i++) {
+        if (bits & (SU_PUNCH1 << i)) MSG_ReadChar();
+        if (bits & (SU_VELOCITY1 << i)) MSG_ReadChar();
+    }
+    MSG_ReadLong(); // items, always sent
+    if (bits & SU_WEAPONFRAME) MSG_ReadByte();
+    if (bits & SU_ARMOR) MSG_ReadByte();
+    if (bits & SU_WEAPON) Bot_ReadModelIndex(bot, 0);
+    MSG_ReadShort(); // health
+    MSG_ReadByte();  // ammo
+    for (i = 0; i < 4; i++) MSG_ReadByte();
+    MSG_ReadByte(); // active weapon
+
+    /* FITZ protocol */
+    if (bits & SU_FITZ_WEAPON2) MSG_ReadByte();
+    if (bits & SU_FITZ_ARMOR2) MSG_ReadByte();
+    if (bits & SU_FITZ_AMMO2) MSG_ReadByte();
+    if (bits & SU_FITZ_SHELLS2) MSG_ReadByte();
+    if (bits & SU_FITZ_NAILS2) MSG_ReadByte();
+    if (bits & SU_FITZ_ROCKETS2) MSG_ReadByte();
+    if (bits & SU_FITZ_CELLS2) MSG_ReadByte();
+    if (bits & SU_FITZ_WEAPONFRAME2) MSG_ReadByte();
+    if (bits & SU_FITZ_WEAPONALPHA) MSG_ReadByte();
+}
+
+static void Bot_ParseSound(bot_t *bot) {
+    int field_mask;
+
+    field_mask = MSG_ReadByte();
+    if (field_mask & SND_VOLUME) MSG_ReadByte();
+    if (field_mask & SND_ATTENUATION) MSG_ReadByte();
+    if (bot->protocol == PROTOCOL_VERSION_FITZ && (field_mask & SND_FITZ_LARGEENTITY)) {
+        MSG_ReadShort();
+        MSG_ReadByte();
+    } else {
+        MSG_ReadShort();
+    }
+    Bot_ReadSoundNum(bot, field_mask);
+    Bot_ReadCoords(3);
+}
+
+static void Bot_ParseTempEntity(void) {
+    switch (MSG_ReadByte()) {
+        case TE_WIZSPIKE:
+        case TE_KNIGHTSPIKE:
+        case TE_SPIKE:
+        case TE_SUPERSPIKE:
+        case TE_GUNSHOT:
+        case TE_EXPLOSION:
+        case TE_TAREXPLOSION:
+        case TE_LAVASPLASH:
+        case TE_TELEPORT:
+            Bot_ReadCoords(3);
+            break;
+        case TE_LIGHTNING1:
+        case TE_LIGHTNING2:
+        case TE_LIGHTNING3:
+        case TE_BEAM:
+            MSG_ReadShort(); // entity
+            Bot_ReadCoords(6);
+            break;
+        case TE_EXPLOSION2:
+            Bot_ReadCoords(3);
+            MSG_ReadByte(); // color start
+            MSG_ReadByte(); // color length
+            break;
+        default:
+            msg_badread = true;
+            break;
+    }
+}
+
+static void Bot_ParseStaticSound(bot_t *bot) {
+    Bot_ReadCoords(3);
+    if (bot->protocol == PROTOCOL_VERSION_BJP2)
+        MSG_ReadShort();
+    else
+        MSG_ReadByte();
+    MSG_ReadByte(); // volume
+    MSG_ReadByte(); // attenuation
+}
+
+/*
+=====================
+Bot_ParseServerMessage
+
+Parses net_message. Returns false if it was illegible.
+=====================
+*/
+qboolean Bot_ParseServerMessage(bot_t *bot) {
+    int i, cmd;
+    float time;
+
+    bot->messages++;
+    MSG_BeginReading();
+
+    while (!msg_badread) {
+        cmd = MSG_ReadByte();
+        if (cmd == -1) return true;
+
+        if (cmd & 128) {
+            Bot_ParseUpdate(bot, cmd & 127);
+            continue;
+        }
+
+        switch (cmd) {
+            case svc_nop:
+            case svc_killedmonster:
+            case svc_foundsecret:
+            case svc_intermission:
+            case svc_sellscreen:
+            case svc_fitz_bf:
+                break;
+
+            case svc_time:
+                time = MSG_ReadFloat();
+                if (bot->active && time > bot->servertime) {
+                    bot->ticks++;
+                    bot->tickTotal += time - bot->servertime;
+                    bot->tickMax = qmax(bot->tickMax, (double)(time - bot->servertime));
+                }
+                bot->servertime = time;
+                break;
+
+            case svc_clientdata:
+                Bot_ParseClientdata(bot);
+                break;
+
+            case svc_version:
+                i = MSG_ReadLong();
+                if (!Protocol_Known(i)) msg_badread = true;
+                bot->protocol = i;
+                break;
+
+            case svc_disconnect:
+                bot->disconnected = true;
+                return true;
+
+            case svc_print:
+            case svc_centerprint:
+            case svc_stufftext:
+            case svc_finale:
+            case svc_cutscene:
+            case svc_fitz_skybox:
+                MSG_ReadString();
+                break;
+
+            case svc_damage:
+                MSG_ReadByte(); // armor
+                MSG_ReadByte(); // blood
+                Bot_ReadCoords(3);
+                break;
+
+            case svc_serverinfo:
+                Bot_ParseServerInfo(bot);
+                bot->signon = bot->replied = 0;
+                bot->active = false;
+                break;
+
+            case svc_setangle:
+                for (i = 0; i < 3; i++) MSG_ReadAngle();
+                break;
+
+            case svc_setview:
+            case svc_stopsound:
+                MSG_ReadShort();
+                break;
+
+            case svc_lightstyle:
+            case svc_updatename:
+                MSG_ReadByte();
+                MSG_ReadString();
+                break;
+
+            case svc_sound:
+                Bot_ParseSound(bot);
+                break;
+
+            case svc_updatefrags:
+                MSG_ReadByte();
+                MSG_ReadShort();
+                break;
+
+            case svc_updatecolors:
+            case svc_cdtrack:
+                MSG_ReadByte();
+                MSG_ReadByte();
+                break;
+
+            case svc_particle:
+                Bot_ReadCoords(3);
+                for (i = 0; i < 3; i++) MSG_ReadChar(); // direction
+                MSG_ReadByte();                       // count
+                MSG_ReadByte();                       // color
+                break;
+
+            case svc_spawnbaseline:
+                MSG_ReadShort();
+                Bot_ParseBaseline(bot, 0);
+                break;
+
+            case svc_fitz_spawnbaseline2:
+                MSG_ReadShort();
+                Bot_ParseBaseline(bot, MSG_ReadByte());
+                break;
+
+            case svc_spawnstatic:
+                Bot_ParseBaseline(bot, 0);
+                break;
+
+            case svc_fitz_spawnstatic2:
+                Bot_ParseBaseline(bot, MSG_ReadByte());
+                break;
+
+            case svc_temp_entity:
+                Bot_ParseTempEntity();
+                break;
+
+            case svc_setpause:
+                MSG_ReadByte();
+                break;
+
+            case svc_signonnum:
+                i = MSG_ReadByte();
+                if (i <= bot->signon) {
+                    msg_badread = true;
+                    break;
+                }
+                bot->signon = i;
+                break;
+
+            case svc_updatestat:
+                MSG_ReadByte();
+                MSG_ReadLong();
+                break;
+
+            case svc_spawnstaticsound:
+                Bot_ParseStaticSound(bot);
+                break;
+
+            case svc_fitz_spawnstaticsound2:
+                Bot_ReadCoords(3);
+                MSG_ReadShort(); // sound
+                MSG_ReadByte();  // volume
+                MSG_ReadByte();  // attenuation
+                break;
+
+            case svc_fitz_fog:
+                MSG_ReadByte();  // density
+                MSG_ReadByte();  // red
+                MSG_ReadByte();  // green
+                MSG_ReadByte();  // blue
+                MSG_ReadShort(); // time
+                break;
+
+            default:
+                msg_badread = true;
+                break;
+        }
+    }
+
+    bot->errors++;
+    return false;
+}
+
+/*
+=====================
+Bot_SignonReply
+
+Writes the answer to the last signon stage, if there is one due
+=====================
+*/
+void Bot_SignonReply(bot_t *bot, sizebuf_t *msg) {
+    if (bot->replied == bot->signon) return;
+    bot->replied = bot->signon;
+
+    switch (bot->signon) {
+        case 1:
+            MSG_WriteByte(msg, clc_stringcmd);
+            MSG_WriteString(msg, "prespawn");
+            break;
+
+        case 2:
+            MSG_WriteByte(msg, clc_stringcmd);
+            MSG_WriteStringf(msg, "name \"bot%d\"\n", bot->index);
+
+            MSG_WriteByte(msg, clc_stringcmd);
+            MSG_WriteStringf(msg, "color %i %i\n", bot->index % 14, (bot->index + 7) % 14);
+
+            MSG_WriteByte(msg, clc_stringcmd);
+            MSG_WriteString(msg, "spawn ");
+            break;
+
+        case 3:
+            MSG_WriteByte(msg, clc_stringcmd);
+            MSG_WriteString(msg, "begin");
+            break;
+    }
+}
+
+/*
+=====================
+Bot_WriteMove
+
+Scripted movement, time in seconds since the bot spawned: run forward while
+turning, strafe from side to side, and every four seconds hold fire for one
+and jump once, which also respawns a dead player. Each bot turns at its own
+rate and keeps its own phase so they spread out over the map.
+=====================
+*/
+void Bot_WriteMove(bot_t *bot, sizebuf_t *msg, double time) {
+    float turn = 20 + (bot->index % 8) * 10; /* degrees per second */
+    double phase = fmod(time + bot->index * 0.37, 4.0);
+    int i, buttons;
+
+    if (bot->index & 1) turn = -turn;
+    bot->viewangles[PITCH] = 0;
+    bot->viewangles[YAW] = anglemod(time * turn);
+    bot->viewangles[ROLL] = 0;
+
+    buttons = 0;
+    if (phase < 1.0) buttons |= 1;
+    if (phase >= 2.5 && phase < 2.6) buttons |= 2;
+
+    MSG_WriteByte(msg, clc_move);
+    MSG_WriteFloat(msg, bot->servertime); /* so the server can get ping times */
+    for (i = 0; i < 3; i++)
+        if (bot->protocol == PROTOCOL_VERSION_FITZ)
+            MSG_WriteAngle16(msg, bot->viewangles[i]);
+        else
+            MSG_WriteAngle(msg, bot->viewangles[i]);
+    MSG_WriteShort(msg, BOT_FORWARDSPEED);
+    MSG_WriteShort(msg, fmod(time, 4.0) < 2.0 ? BOT_SIDESPEED : -BOT_SIDESPEED);
+    MSG_WriteShort(msg, 0);
+    MSG_WriteByte(msg, buttons);
+    MSG_WriteByte(msg, 0); // impulse
+}
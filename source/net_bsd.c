@@ -36,7 +36,8 @@ net_driver_t net_drivers[] = {{.name = "Loopback",
                                .CanSendMessage = Loop_CanSendMessage,
                                .CanSendUnreliableMessage = Loop_CanSendUnreliableMessage,
                                .Close = Loop_Close,
-                               .Shutdown = Loop_Shutdown},
+                               .Shutdown = Loop_Shutdown,
+                               .SendBuffer = Loop_SendBuffer},
                               {.name = "Datagram",
                                .initialized = false,
                                .Init = Datagram_Init,
@@ -50,7 +51,9 @@ net_driver_t net_drivers[] = {{.name = "Loopback",
                                .CanSendMessage = Datagram_CanSendMessage,
                                .CanSendUnreliableMessage = Datagram_CanSendUnreliableMessage,
                                .Close = Datagram_Close,
-                               .Shutdown = Datagram_Shutdown}};
+                               .Shutdown = Datagram_Shutdown,
+                               .Flush = Datagram_Flush,
+                               .Wait = Datagram_Wait}};
 
 int net_numdrivers = 2;
 
@@ -69,6 +72,10 @@ net_landriver_t net_landrivers[] = {{.name = "UDP",
                                      .GetSocketAddr = UDP_GetSocketAddr,
                                      .GetNameFromAddr = UDP_GetNameFromAddr,
                                      .GetAddrFromName = UDP_GetAddrFromName,
-                                     .GetDefaultMTU = UDP_GetDefaultMTU}};
+                                     .GetDefaultMTU = UDP_GetDefaultMTU,
+                                     .ListenSocket = UDP_ListenSocket,
+                                     .ReadBatch = UDP_ReadBatch,
+                                     .WriteBatch = UDP_WriteBatch,
+                                     .Wait = UDP_Wait}};
 
 int net_numlandrivers = 1;
@@ -28,12 +28,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/types.h>
 #endif
 
+#include <time.h>
+
 #include "cmd.h"
 #include "console.h"
+#include "host.h"
 #include "keys.h"
+#include "mathlib.h"
 #include "menu.h"
 #include "net.h"
+#include "net_bot.h"
 #include "net_dgrm.h"
+#include "net_lz.h"
+#include "net_sim.h"
+#include "prof.h"
+#include "protocol.h"
 #include "quakedef.h"
 #include "screen.h"
 #include "server.h"
@@ -49,12 +58,342 @@ static int droppedDatagrams;
 
 static net_driver_t *dgrm_driver;
 
+/* offer/accept NETOPT_WINDOW on new connections */
+static cvar_t net_window = {"net_window", "1"};
+
+#define NET_MIN_RTO 0.2
+#define NET_MAX_RTO 3.0
+
+/* offer/accept NETOPT_COMPRESS on new connections */
+static cvar_t net_compress = {"net_compress", "1"};
+
+static struct {
+    unsigned messages, bytesIn, bytesOut; /* only counts messages that shrank */
+    unsigned tried;
+    double time;
+} compressStats, decompressStats;
+
+/* accept new server connections on the listening socket itself */
+static cvar_t net_sharedsocket = {"net_sharedsocket", "0"};
+
 static struct {
     unsigned int length;
     unsigned int sequence;
     byte data[NET_MAXMESSAGE];
 } packetBuffer;
 
+/*
+ * ===========================================================================
+ *
+ * Shared server socket (net_sharedsocket)
+ *
+ * Instead of opening a socket per client, the server can answer every
+ * client on its listening socket. The socket is drained in batches into a
+ * pool of packets; each one is queued on the qsocket its address hashes to,
+ * while control packets go to the accept queue. The accept queue keeps
+ * only the newest DEMUX_ACCEPT packets, so a flood of queries cannot use
+ * up the pool the clients' packets need. A reader that finds its queue
+ * empty drains again, at most every DEMUX_INTERVAL, so a server frame
+ * reading all its clients costs one or two batched reads instead of a
+ * recvfrom per client. Writes to shared qsockets are held back and sent
+ * together by Datagram_Flush.
+ *
+ * ===========================================================================
+ */
+
+#define DEMUX_PACKETS 128
+#define DEMUX_PACKETSIZE 1500 /* larger than any datagram we send */
+#define DEMUX_HASH 64         /* power of two */
+#define DEMUX_BATCH 32
+#define DEMUX_ACCEPT 16 /* control packets held for the accept queue */
+#define DEMUX_INTERVAL 0.002
+
+typedef struct {
+    int next; /* next in the same queue or the free list, -1 for none */
+    int length;
+    netadr_t addr;
+    byte data[DEMUX_PACKETSIZE];
+} demuxpacket_t;
+
+static struct {
+    net_landriver_t *driver; /* NULL until a listening socket is shared */
+    int socket;
+    qsocket_t *hash[DEMUX_HASH];
+    demuxpacket_t packets[DEMUX_PACKETS];
+    int free;
+    int numShared;
+    int acceptHead, acceptTail;
+    int numAccept;
+    double drainTime;
+
+    netpacket_t out[DEMUX_BATCH];
+    byte outData[DEMUX_BATCH][DEMUX_PACKETSIZE];
+    int numOut;
+
+    /* statistics */
+    unsigned drains, readCalls, packetsRead, strays, controlDrops;
+    unsigned writeCalls, packetsWritten;
+} demux;
+
+static unsigned Demux_Hash(const netadr_t *addr) {
+    unsigned hash = addr->ip.l ^ ((unsigned)addr->port << 16 | addr->port);
+
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+
+    return hash & (DEMUX_HASH - 1);
+}
+
+static void Demux_Add(qsocket_t *sock);
+
+static void Demux_Reset(void) {
+    qsocket_t *sock;
+    int i;
+
+    memset(demux.hash, 0, sizeof(demux.hash));
+    for (i = 0; i < DEMUX_PACKETS; i++) demux.packets[i].next = i + 1;
+    demux.packets[DEMUX_PACKETS - 1].next = -1;
+    demux.free = 0;
+    demux.acceptHead = demux.acceptTail = -1;
+    demux.numAccept = 0;
+    demux.numOut = 0;
+
+    /* the clients keep sending to the same port */
+    for (sock = net_activeSockets; sock; sock = sock->next)
+        if (sock->shared) Demux_Add(sock);
+}
+
+/*
+ * Returns the listening socket if it is, or is about to be, shared by the
+ * driver's connections, else -1
+ */
+static int Demux_Socket(net_landriver_t *driver) {
+    int socket;
+
+    if (!driver->ReadBatch || !driver->ListenSocket) return -1;
+    if (!net_sharedsocket.value && !(demux.driver == driver && demux.numShared)) return -1;
+    socket = driver->ListenSocket();
+    if (socket == -1) return -1;
+
+    if (demux.driver != driver || demux.socket != socket) {
+        /* connections on a previous listening socket are gone anyway */
+        Demux_Reset();
+        demux.driver = driver;
+        demux.socket = socket;
+    }
+
+    return socket;
+}
+
+static void Demux_FreeQueue(int head) {
+    int next;
+
+    for (; head != -1; head = next) {
+        next = demux.packets[head].next;
+        demux.packets[head].next = demux.free;
+        demux.free = head;
+    }
+}
+
+static void Demux_Enqueue(int *head, int *tail, int packet) {
+    demux.packets[packet].next = -1;
+    if (*tail == -1)
+        *head = packet;
+    else
+        demux.packets[*tail].next = packet;
+    *tail = packet;
+}
+
+/* Queues a control packet, dropping the oldest when there are too many */
+static void Demux_Accept(int packet) {
+    int oldest;
+
+    if (demux.numAccept == DEMUX_ACCEPT) {
+        oldest = demux.acceptHead;
+        demux.acceptHead = demux.packets[oldest].next;
+        demux.packets[oldest].next = demux.free;
+        demux.free = oldest;
+        demux.numAccept--;
+        demux.controlDrops++;
+    }
+    Demux_Enqueue(&demux.acceptHead, &demux.acceptTail, packet);
+    demux.numAccept++;
+}
+
+static void Demux_Add(qsocket_t *sock) {
+    unsigned hash = Demux_Hash(&sock->addr);
+
+    if (!sock->shared) demux.numShared++;
+    sock->shared = true;
+    sock->queueHead = sock->queueTail = -1;
+    sock->hashNext = demux.hash[hash];
+    demux.hash[hash] = sock;
+}
+
+static void Demux_Remove(qsocket_t *sock) {
+    qsocket_t **link;
+
+    for (link = &demux.hash[Demux_Hash(&sock->addr)]; *link; link = &(*link)->hashNext) {
+        if (*link == sock) {
+            *link = sock->hashNext;
+            break;
+        }
+    }
+    Demux_FreeQueue(sock->queueHead);
+    sock->queueHead = sock->queueTail = -1;
+    sock->shared = false;
+    demux.numShared--;
+}
+
+static qsocket_t *Demux_Find(const netadr_t *addr) {
+    qsocket_t *sock;
+
+    for (sock = demux.hash[Demux_Hash(addr)]; sock; sock = sock->hashNext)
+        if (NET_AddrCompare(addr, &sock->addr) == 0) return sock;
+
+    return NULL;
+}
+
+void Datagram_Flush(void) {
+    int sent;
+
+    if (!demux.numOut) return;
+
+    demux.writeCalls++;
+    sent = demux.driver->WriteBatch(demux.socket, demux.out, demux.numOut);
+    if (sent > 0) demux.packetsWritten += sent;
+    demux.numOut = 0;
+}
+
+static void Demux_Drain(void) {
+    netpacket_t batch[DEMUX_BATCH];
+    int slots[DEMUX_BATCH];
+    demuxpacket_t *packet;
+    qsocket_t *sock;
+    unsigned int header;
+    int i, count, received;
+
+    Datagram_Flush();
+    demux.drainTime = net_time;
+    demux.drains++;
+
+    /* when the pool is used up the rest waits in the socket buffer */
+    while (demux.free != -1) {
+        for (count = 0; count < DEMUX_BATCH && demux.free != -1; count++) {
+            slots[count] = demux.free;
+            packet = &demux.packets[demux.free];
+            demux.free = packet->next;
+            batch[count].data = packet->data;
+            batch[count].length = DEMUX_PACKETSIZE;
+        }
+
+        demux.readCalls++;
+        received = demux.driver->ReadBatch(demux.socket, batch, count);
+        if (received < 0) received = 0;
+
+        for (i = count - 1; i >= received; i--) {
+            demux.packets[slots[i]].next = demux.free;
+            demux.free = slots[i];
+        }
+
+        for (i = 0; i < received; i++) {
+            packet = &demux.packets[slots[i]];
+            packet->length = batch[i].length;
+            packet->addr = batch[i].addr;
+            demux.packetsRead++;
+
+            memcpy(&header, packet->data, sizeof(header));
+            if (packet->length < sizeof(header) || (BigLong(header) & NETFLAG_CTL)) {
+                Demux_Accept(slots[i]);
+                continue;
+            }
+            sock = Demux_Find(&packet->addr);
+            if (sock) {
+                Demux_Enqueue(&sock->queueHead, &sock->queueTail, slots[i]);
+                continue;
+            }
+            demux.strays++;
+            packet->next = demux.free;
+            demux.free = slots[i];
+        }
+
+        if (received < count) break;
+    }
+}
+
+static int Demux_Read(int *head, int *tail, void *buf, int len, netadr_t *addr) {
+    demuxpacket_t *packet;
+    int index;
+
+    if (*head == -1 && net_time - demux.drainTime >= DEMUX_INTERVAL) Demux_Drain();
+    if (*head == -1) return 0;
+
+    index = *head;
+    packet = &demux.packets[index];
+    *head = packet->next;
+    if (*head == -1) *tail = -1;
+    if (head == &demux.acceptHead) demux.numAccept--;
+
+    len = qmin(len, packet->length);
+    memcpy(buf, packet->data, len);
+    *addr = packet->addr;
+
+    packet->next = demux.free;
+    demux.free = index;
+
+    return len;
+}
+
+static int Demux_Write(const void *buf, int len, const netadr_t *addr) {
+    netpacket_t *out;
+
+    if (len > DEMUX_PACKETSIZE) return -1;
+    if (demux.numOut == DEMUX_BATCH) Datagram_Flush();
+
+    out = &demux.out[demux.numOut];
+    out->data = demux.outData[demux.numOut];
+    out->length = len;
+    out->addr = *addr;
+    memcpy(out->data, buf, len);
+    demux.numOut++;
+
+    return len;
+}
+
+/*
+ * Sleeps until one of the connections has a packet waiting or the timeout
+ * passes
+ */
+void Datagram_Wait(qsocket_t *const *socks, int count, double timeout) {
+    int sockets[MAX_SCOREBOARD];
+    net_landriver_t *driver = NULL;
+    int i, j, numsockets;
+
+    numsockets = 0;
+    for (i = 0; i < count && numsockets < MAX_SCOREBOARD; i++) {
+        if (socks[i]->shared && socks[i]->queueHead != -1) return;
+        if (!socks[i]->landriver->Wait) continue;
+        if (driver && socks[i]->landriver != driver) continue;
+        driver = socks[i]->landriver;
+        for (j = 0; j < numsockets; j++)
+            if (sockets[j] == socks[i]->socket) break;
+        if (j == numsockets) sockets[numsockets++] = socks[i]->socket;
+    }
+
+    if (driver) driver->Wait(sockets, numsockets, timeout);
+}
+
+static int ReadPacket(qsocket_t *sock, void *buf, int len, netadr_t *addr) {
+    if (sock->shared) return Demux_Read(&sock->queueHead, &sock->queueTail, buf, len, addr);
+    return sock->landriver->Read(sock->socket, buf, len, addr);
+}
+
+static int WritePacket(qsocket_t *sock, const void *buf, int len, const netadr_t *addr) {
+    if (sock->shared) return Demux_Write(buf, len, addr);
+    return sock->landriver->Write(sock->socket, buf, len, addr);
+}
+
 #ifdef DEBUG
 static const char *StrAddr(netadr_t *addr) {
     static char buf[32];
@@ -104,6 +443,75 @@ void NET_Ban_f(client_t *client) {
     }
 }
 
+/*
+ * ===========================================================================
+ *
+ * Compressed reliable messages (NETOPT_COMPRESS)
+ *
+ * A reliable message of NET_COMPRESS_MIN bytes or more is compressed as a
+ * whole before it is cut into fragments, and sent that way if it shrank.
+ * Every fragment of it carries NETFLAG_COMPRESSED; the receiver inflates
+ * the message once the last fragment is in, so everything above the
+ * driver sees the original message.
+ *
+ * ===========================================================================
+ */
+
+/* copies the message to sendMessage, compressed if that saves anything */
+static void StoreMessage(qsocket_t *sock, const sizebuf_t *data) {
+    double start;
+    int length;
+
+    sock->sendCompressed = false;
+    if (sock->compress && data->cursize >= NET_COMPRESS_MIN) {
+        start = Sys_DoubleTime();
+        length = LZ_Compress(data->data, data->cursize, sock->sendMessage, data->cursize - 1);
+        compressStats.time += Sys_DoubleTime() - start;
+        compressStats.tried++;
+        if (length) {
+            compressStats.messages++;
+            compressStats.bytesIn += data->cursize;
+            compressStats.bytesOut += length;
+            sock->sendMessageLength = length;
+            sock->sendCompressed = true;
+            return;
+        }
+    }
+
+    memcpy(sock->sendMessage, data->data, data->cursize);
+    sock->sendMessageLength = data->cursize;
+}
+
+/*
+ * Puts a completed reliable message of 'length' bytes in receiveMessage
+ * into net_message. Returns false if it doesn't decompress.
+ */
+static qboolean ReadMessage(qsocket_t *sock, int length) {
+    double start;
+
+    SZ_Clear(&net_message);
+    if (!sock->receiveCompressed) {
+        SZ_Write(&net_message, sock->receiveMessage, length);
+        return true;
+    }
+
+    start = Sys_DoubleTime();
+    net_message.cursize =
+        LZ_Decompress(sock->receiveMessage, length, net_message.data, net_message.maxsize);
+    decompressStats.time += Sys_DoubleTime() - start;
+    sock->receiveCompressed = false;
+    if (net_message.cursize < 0) {
+        net_message.cursize = 0;
+        Con_Printf("Corrupt compressed message from %s\n", sock->address);
+        return false;
+    }
+    decompressStats.messages++;
+    decompressStats.bytesIn += length;
+    decompressStats.bytesOut += net_message.cursize;
+
+    return true;
+}
+
 static int SendPacket(qsocket_t *sock) {
     unsigned int packetLen;
     unsigned int dataLen;
@@ -117,20 +525,232 @@ static int SendPacket(qsocket_t *sock) {
         eom = 0;
     }
     packetLen = NET_HEADERSIZE + dataLen;
+    if (sock->sendCompressed) eom |= NETFLAG_COMPRESSED;
 
     packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
     packetBuffer.sequence = BigLong(sock->sendSequence++);
     memcpy(packetBuffer.data, sock->sendMessage, dataLen);
 
-    if (sock->landriver->Write(sock->socket, &packetBuffer, packetLen, &sock->addr) == -1)
+    if (WritePacket(sock, &packetBuffer, packetLen, &sock->addr) == -1)
+        return -1;
+
+    sock->lastSendTime = net_time;
+    packetsSent++;
+
+    return 1;
+}
+
+/*
+ * ===========================================================================
+ *
+ * Windowed reliable transport (NETOPT_WINDOW)
+ *
+ * A reliable message is cut into sock->mtu fragments exactly as before, but
+ * up to sock->window of them are sent without waiting for acks. The receiver
+ * acks every data packet with the next sequence it needs plus a mask of the
+ * NET_WINDOW fragments it already holds beyond that, so only the holes get
+ * retransmitted. Each fragment has its own resend timer, derived from the
+ * smoothed round trip time as in RFC 6298; fragments that were resent give
+ * no RTT sample (Karn's algorithm). The window opens by one fragment per ack
+ * and halves when a timer expires.
+ *
+ * All fragments but the last are exactly sock->mtu bytes (both sides agree
+ * on it when connecting), which is what lets the receiver place fragments
+ * that arrive out of order.
+ *
+ * ===========================================================================
+ */
+
+static int SendFragment(qsocket_t *sock, unsigned int sequence) {
+    netfragment_t *fragment = &sock->sendWindow[sequence & (NET_WINDOW - 1)];
+    unsigned int offset;
+    unsigned int packetLen;
+    unsigned int dataLen;
+    unsigned int eom;
+
+    offset = (sequence - sock->messageSequence) * sock->mtu;
+    dataLen = sock->sendMessageLength - offset;
+    if (dataLen <= sock->mtu) {
+        eom = NETFLAG_EOM;
+    } else {
+        dataLen = sock->mtu;
+        eom = 0;
+    }
+    packetLen = NET_HEADERSIZE + dataLen;
+    if (sock->sendCompressed) eom |= NETFLAG_COMPRESSED;
+
+    packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+    packetBuffer.sequence = BigLong(sequence);
+    memcpy(packetBuffer.data, sock->sendMessage + offset, dataLen);
+
+    if (WritePacket(sock, &packetBuffer, packetLen, &sock->addr) == -1)
         return -1;
 
+    fragment->time = net_time;
     sock->lastSendTime = net_time;
     packetsSent++;
 
     return 1;
 }
 
+/* send new fragments of the current message while the window allows */
+static int SendWindow(qsocket_t *sock) {
+    unsigned int end = sock->messageSequence + sock->sendFragments;
+    netfragment_t *fragment;
+
+    while (sock->sendSequence != end && sock->sendSequence - sock->ackSequence < sock->window) {
+        fragment = &sock->sendWindow[sock->sendSequence & (NET_WINDOW - 1)];
+        fragment->resent = false;
+        fragment->acked = false;
+        if (SendFragment(sock, sock->sendSequence) == -1) return -1;
+        sock->sendSequence++;
+    }
+
+    return 1;
+}
+
+static void ReSendWindow(qsocket_t *sock) {
+    unsigned int sequence;
+    netfragment_t *fragment;
+    qboolean expired = false;
+
+    for (sequence = sock->ackSequence; sequence != sock->sendSequence; sequence++) {
+        fragment = &sock->sendWindow[sequence & (NET_WINDOW - 1)];
+        if (fragment->acked || net_time - fragment->time <= sock->rto) continue;
+        if (SendFragment(sock, sequence) == -1) return;
+        fragment->resent = true;
+        sock->retransmits++;
+        packetsReSent++;
+        expired = true;
+    }
+
+    if (expired) {
+        sock->rto = qmin(sock->rto * 2, NET_MAX_RTO);
+        sock->window = qmax(sock->window / 2, 1);
+    }
+}
+
+static void AckFragment(qsocket_t *sock, unsigned int sequence) {
+    netfragment_t *fragment = &sock->sendWindow[sequence & (NET_WINDOW - 1)];
+    double sample;
+
+    if (fragment->acked) return;
+    fragment->acked = true;
+    if (sock->window < NET_WINDOW) sock->window++;
+    if (fragment->resent) return;
+
+    sample = net_time - fragment->time;
+    if (sock->rtt < 0) {
+        sock->rtt = sample;
+        sock->rttvar = sample / 2;
+    } else {
+        sock->rttvar = 0.75 * sock->rttvar + 0.25 * fabs(sock->rtt - sample);
+        sock->rtt = 0.875 * sock->rtt + 0.125 * sample;
+    }
+    sock->rto = qmax(NET_MIN_RTO, qmin(sock->rtt + 4 * sock->rttvar, NET_MAX_RTO));
+}
+
+static void ReceiveWindowAck(qsocket_t *sock, unsigned int sequence, unsigned int length) {
+    unsigned int mask;
+    unsigned int i;
+
+    if (length < NET_HEADERSIZE + 4) {
+        shortPacketCount++;
+        return;
+    }
+    memcpy(&mask, packetBuffer.data, 4);
+    mask = BigLong(mask);
+
+    if ((int)(sequence - sock->ackSequence) < 0 || (int)(sequence - sock->sendSequence) > 0) {
+        Con_DPrintf("Stale ACK received\n");
+        return;
+    }
+    while (sock->ackSequence != sequence) AckFragment(sock, sock->ackSequence++);
+    for (i = 1; mask; i++, mask >>= 1) {
+        if ((int)(sequence + i - sock->sendSequence) >= 0) break;
+        if (mask & 1) AckFragment(sock, sequence + i);
+    }
+
+    if (sock->ackSequence == sock->messageSequence + sock->sendFragments) {
+        sock->sendMessageLength = 0;
+        sock->canSend = true;
+        return;
+    }
+    SendWindow(sock);
+}
+
+static void SendWindowAck(qsocket_t *sock, const netadr_t *addr) {
+    struct {
+        unsigned int length;
+        unsigned int sequence;
+        unsigned int mask;
+    } ack;
+
+    ack.length = BigLong((NET_HEADERSIZE + 4) | NETFLAG_ACK);
+    ack.sequence = BigLong(sock->receiveSequence);
+    ack.mask = BigLong(sock->receiveMask);
+    WritePacket(sock, &ack, sizeof(ack), addr);
+}
+
+/*
+ * Stores a data fragment and acks it. Returns 1 when it completed a
+ * message, which is then in net_message, or -1 if that message is corrupt.
+ */
+static int ReceiveWindowData(qsocket_t *sock, unsigned int sequence, unsigned int flags,
+                             unsigned int length, const netadr_t *addr) {
+    int distance = sequence - sock->receiveSequence;
+    unsigned int offset;
+    qboolean complete = false;
+    qboolean more;
+    int ret;
+
+    length -= NET_HEADERSIZE;
+    offset = sock->receiveMessageLength + distance * sock->mtu;
+
+    if (distance < 0 || (distance && (sock->receiveMask & (1u << (distance - 1))))) {
+        receivedDuplicateCount++;
+    } else if (distance > NET_WINDOW || (!(flags & NETFLAG_EOM) && length != sock->mtu) ||
+               (sock->receiveEOMLength >= 0 && (int)(sequence - sock->receiveEOM) > 0) ||
+               offset + length > NET_MAXMESSAGE) {
+        Con_DPrintf("Bad fragment received\n");
+        return 0; /* no ack, let the sender time out */
+    } else {
+        memcpy(sock->receiveMessage + offset, packetBuffer.data, length);
+        if (flags & NETFLAG_EOM) {
+            sock->receiveEOM = sequence;
+            sock->receiveEOMLength = length;
+            sock->receiveCompressed = sock->compress && (flags & NETFLAG_COMPRESSED);
+        }
+        if (distance) {
+            sock->receiveMask |= 1u << (distance - 1);
+        } else {
+            /* in order: take it and everything queued up behind it */
+            do {
+                if (sock->receiveEOMLength >= 0 && sock->receiveSequence == sock->receiveEOM) {
+                    sock->receiveMessageLength += sock->receiveEOMLength;
+                    complete = true;
+                } else {
+                    sock->receiveMessageLength += sock->mtu;
+                }
+                sock->receiveSequence++;
+                more = sock->receiveMask & 1;
+                sock->receiveMask >>= 1;
+            } while (more && !complete);
+        }
+    }
+
+    SendWindowAck(sock, addr);
+
+    if (!complete) return 0;
+
+    ret = ReadMessage(sock, sock->receiveMessageLength) ? 1 : -1;
+    sock->receiveMessageLength = 0;
+    sock->receiveEOMLength = -1;
+    sock->receiveMask = 0;
+
+    return ret;
+}
+
 int Datagram_SendMessage(qsocket_t *sock, const sizebuf_t *data) {
 #ifdef DEBUG
     if (data->cursize == 0) Sys_Error("%s: zero length message", __func__);
@@ -141,10 +761,15 @@ int Datagram_SendMessage(qsocket_t *sock, const sizebuf_t *data) {
     if (sock->canSend == false) Sys_Error("%s: called with canSend == false", __func__);
 #endif
 
-    memcpy(sock->sendMessage, data->data, data->cursize);
-    sock->sendMessageLength = data->cursize;
+    StoreMessage(sock, data);
     sock->canSend = false;
 
+    if (sock->windowed) {
+        sock->messageSequence = sock->sendSequence;
+        sock->sendFragments = (sock->sendMessageLength + sock->mtu - 1) / sock->mtu;
+        return SendWindow(sock);
+    }
+
     return SendPacket(sock);
 }
 
@@ -156,12 +781,18 @@ static int SendMessageNext(qsocket_t *sock) {
 
 static int ReSendMessage(qsocket_t *sock) {
     sock->sendNext = false;
+    sock->sendSequence--;
+    sock->retransmits++;
+    packetsReSent++;
 
     return SendPacket(sock);
 }
 
 qboolean Datagram_CanSendMessage(qsocket_t *sock) {
-    if (sock->sendNext) SendMessageNext(sock);
+    if (sock->windowed)
+        ReSendWindow(sock);
+    else if (sock->sendNext)
+        SendMessageNext(sock);
 
     return sock->canSend;
 }
@@ -183,7 +814,7 @@ int Datagram_SendUnreliableMessage(qsocket_t *sock, const sizebuf_t *data) {
     packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
     memcpy(packetBuffer.data, data->data, data->cursize);
 
-    if (sock->landriver->Write(sock->socket, &packetBuffer, packetLen, &sock->addr) == -1)
+    if (WritePacket(sock, &packetBuffer, packetLen, &sock->addr) == -1)
         return -1;
 
     packetsSent++;
@@ -198,11 +829,13 @@ int Datagram_GetMessage(qsocket_t *sock) {
     unsigned int sequence;
     unsigned int count;
 
-    if (!sock->canSend)
-        if ((net_time - sock->lastSendTime) > 1.0) ReSendMessage(sock);
+    if (sock->windowed)
+        ReSendWindow(sock);
+    else if (!sock->canSend)
+        if ((net_time - sock->lastSendTime) > NET_INITIAL_RTO) ReSendMessage(sock);
 
     while (1) {
-        length = sock->landriver->Read(sock->socket, &packetBuffer, NET_MESSAGESIZE, &readaddr);
+        length = ReadPacket(sock, &packetBuffer, NET_MESSAGESIZE, &readaddr);
 #if 0
     /* for testing packet loss effects */
     if ((rand() & 255) > 220)
@@ -240,9 +873,9 @@ int Datagram_GetMessage(qsocket_t *sock) {
 
         if (flags & NETFLAG_UNRELIABLE) {
             if (sequence < sock->unreliableReceiveSequence) {
+                /* overtaken, read on rather than leave the rest queued */
                 Con_DPrintf("Got a stale datagram\n");
-                ret = 0;
-                break;
+                continue;
             }
             if (sequence != sock->unreliableReceiveSequence) {
                 count = sequence - sock->unreliableReceiveSequence;
@@ -261,6 +894,10 @@ int Datagram_GetMessage(qsocket_t *sock) {
         }
 
         if (flags & NETFLAG_ACK) {
+            if (sock->windowed) {
+                ReceiveWindowAck(sock, sequence, length);
+                continue;
+            }
             if (sequence != (sock->sendSequence - 1)) {
                 Con_DPrintf("Stale ACK received\n");
                 continue;
@@ -284,9 +921,14 @@ int Datagram_GetMessage(qsocket_t *sock) {
         }
 
         if (flags & NETFLAG_DATA) {
+            if (sock->windowed) {
+                ret = ReceiveWindowData(sock, sequence, flags, length, &readaddr);
+                if (ret) break;
+                continue;
+            }
             packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
             packetBuffer.sequence = BigLong(sequence);
-            sock->landriver->Write(sock->socket, &packetBuffer, NET_HEADERSIZE, &readaddr);
+            WritePacket(sock, &packetBuffer, NET_HEADERSIZE, &readaddr);
 
             if (sequence != sock->receiveSequence) {
                 receivedDuplicateCount++;
@@ -296,6 +938,18 @@ int Datagram_GetMessage(qsocket_t *sock) {
 
             length -= NET_HEADERSIZE;
 
+            if ((flags & NETFLAG_EOM) && sock->compress && (flags & NETFLAG_COMPRESSED)) {
+                if (sock->receiveMessageLength + length > NET_MAXMESSAGE) {
+                    ret = -1;
+                    break;
+                }
+                memcpy(sock->receiveMessage + sock->receiveMessageLength, packetBuffer.data,
+                       length);
+                sock->receiveCompressed = true;
+                ret = ReadMessage(sock, sock->receiveMessageLength + length) ? 1 : -1;
+                sock->receiveMessageLength = 0;
+                break;
+            }
             if (flags & NETFLAG_EOM) {
                 SZ_Clear(&net_message);
                 SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
@@ -318,9 +972,21 @@ int Datagram_GetMessage(qsocket_t *sock) {
 }
 
 static void PrintStats(qsocket_t *s) {
+    Con_Printf("%s (%s%s)\n", s->address, s->windowed ? "windowed" : "stop-and-wait",
+               s->compress ? ", compressed" : "");
     Con_Printf("canSend = %4u   \n", s->canSend);
     Con_Printf("sendSeq = %4u   ", s->sendSequence);
     Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+    Con_Printf("resent  = %4i   \n", s->retransmits);
+    if (s->windowed) {
+        if (s->rtt >= 0)
+            Con_Printf("rtt     = %4.0f ms  rttvar = %4.0f ms\n", s->rtt * 1000, s->rttvar * 1000);
+        else
+            Con_Printf("rtt     =    - ms\n");
+        Con_Printf("rto     = %4.0f ms\n", s->rto * 1000);
+        Con_Printf("window  = %4i   ", s->window);
+        Con_Printf("inflight = %2u\n", s->sendSequence - s->ackSequence);
+    }
     Con_Printf("\n");
 }
 
@@ -338,6 +1004,31 @@ void NET_Stats_f(void) {
         Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
         Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
         Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+        if (demux.drains) {
+            Con_Printf("shared socket drains       = %u\n", demux.drains);
+            Con_Printf("  packets read / calls     = %u / %u\n", demux.packetsRead,
+                       demux.readCalls);
+            Con_Printf("  packets sent / calls     = %u / %u\n", demux.packetsWritten,
+                       demux.writeCalls);
+            Con_Printf("  unknown senders          = %u\n", demux.strays);
+            Con_Printf("  control packets dropped  = %u\n", demux.controlDrops);
+        }
+        if (compressStats.tried) {
+            Con_Printf("compressed messages        = %u of %u\n", compressStats.messages,
+                       compressStats.tried);
+            Con_Printf("  bytes in / out           = %u / %u, %u saved\n",
+                       compressStats.bytesIn, compressStats.bytesOut,
+                       compressStats.bytesIn - compressStats.bytesOut);
+            Con_Printf("  usec per message         = %.1f\n",
+                       compressStats.time * 1000000.0 / compressStats.tried);
+        }
+        if (decompressStats.messages) {
+            Con_Printf("decompressed messages      = %u\n", decompressStats.messages);
+            Con_Printf("  bytes in / out           = %u / %u\n", decompressStats.bytesIn,
+                       decompressStats.bytesOut);
+            Con_Printf("  usec per message         = %.1f\n",
+                       decompressStats.time * 1000000.0 / decompressStats.messages);
+        }
     } else if (strcmp(Cmd_Argv(1), "*") == 0) {
         for (s = net_activeSockets; s; s = s->next) PrintStats(s);
         for (s = net_freeSockets; s; s = s->next) PrintStats(s);
@@ -566,11 +1257,468 @@ JustDoIt:
     SchedulePollProcedure(&poll_procedure, 0.05);
 }
 
+/*
+ * ===========================================================================
+ *
+ * net_loadtest <host> [clients] [seconds] [packets/sec] [spawn]
+ *
+ * Connects a number of fake clients to a server (this one, over loopback,
+ * if it is listening) and has each of them send clc_nop datagrams at a
+ * client's usual rate while acking whatever reliable data comes back. By
+ * default they never sign on, so this measures the server's network path
+ * rather than the game. With spawn set each one is a headless client
+ * (net_bot.c) instead: it parses everything the server sends, answers the
+ * signon stages and, once in the game, sends scripted clc_move commands in
+ * place of the nops. The report then adds the time each took to spawn,
+ * bytes per client, datagrams lost on the way, the time between updates
+ * and, against a local server, its frame times.
+ * Runs from the poll loop so a local server keeps running.
+ *
+ * ===========================================================================
+ */
+
+#define LOADTEST_RELIABLE 256 /* largest message a client sends reliably */
+
+typedef struct {
+    int socket; /* -1 if rejected or failed */
+    netadr_t addr;
+    qboolean accepted;
+    unsigned int sendSequence;
+    int sent;
+
+    /* reliable messages, stop-and-wait both ways */
+    unsigned int receiveSequence;
+    unsigned int reliableSequence;
+    qboolean reliablePending; /* message not acked yet */
+    double reliableTime;
+    sizebuf_t reliable; /* in flight */
+    sizebuf_t queued;   /* sent once the one in flight is acked */
+    byte reliableBuf[LOADTEST_RELIABLE];
+    byte queuedBuf[LOADTEST_RELIABLE];
+    byte message[NET_MAXMESSAGE]; /* being received */
+    int messageLength;            /* -1 if too long, skipped to the end */
+    unsigned int unreliableSequence;
+
+    /* spawn */
+    bot_t bot;
+    double connectTime, spawnTime;
+    unsigned bytesSent, bytesReceived;
+    unsigned dropped, stale, duplicates;
+} loadclient_t;
+
+static struct {
+    qboolean inProgress;
+    net_landriver_t *driver;
+    netadr_t server;
+    int numclients;
+    int accepted;
+    int spawned;
+    qboolean spawn;
+    qboolean local; /* profiling the server in this process */
+    int startframe;
+    double pps;
+    double start, end, lastconnect;
+    clock_t cpu;
+    loadclient_t clients[MAX_SCOREBOARD];
+    unsigned packetsSent, packetsReceived, reliableReceived, bytesReceived;
+} loadtest;
+
+static void LoadTest_Poll(void *arg);
+static PollProcedure loadTestProcedure = {.procedure = LoadTest_Poll};
+
+static void LoadTest_Connect(loadclient_t *client) {
+    SZ_Clear(&net_message);
+    // save space for the header, filled in later
+    MSG_WriteLong(&net_message, 0);
+    MSG_WriteByte(&net_message, CCREQ_CONNECT);
+    MSG_WriteString(&net_message, "QUAKE");
+    MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+    MSG_WriteControlHeader(&net_message);
+    loadtest.driver->Write(client->socket, net_message.data, net_message.cursize, &loadtest.server);
+    SZ_Clear(&net_message);
+}
+
+static void LoadTest_SendUnreliable(loadclient_t *client, const sizebuf_t *msg) {
+    struct {
+        unsigned int length;
+        unsigned int sequence;
+        byte data[32];
+    } packet;
+    int length = NET_HEADERSIZE + msg->cursize;
+
+    packet.length = BigLong(length | NETFLAG_UNRELIABLE);
+    packet.sequence = BigLong(client->sendSequence++);
+    memcpy(packet.data, msg->data, msg->cursize);
+    loadtest.driver->Write(client->socket, &packet, length, &client->addr);
+    client->bytesSent += length;
+    loadtest.packetsSent++;
+}
+
+static void LoadTest_SendNop(loadclient_t *client, int command) {
+    sizebuf_t msg;
+    byte data[1];
+
+    msg.data = data;
+    msg.maxsize = sizeof(data);
+    msg.cursize = 0;
+    MSG_WriteByte(&msg, command);
+    LoadTest_SendUnreliable(client, &msg);
+}
+
+static void LoadTest_SendMove(loadclient_t *client) {
+    sizebuf_t msg;
+    byte data[32];
+
+    if (!client->bot.active) {
+        LoadTest_SendNop(client, clc_nop);
+        return;
+    }
+    msg.data = data;
+    msg.maxsize = sizeof(data);
+    msg.cursize = 0;
+    Bot_WriteMove(&client->bot, &msg, net_time - client->spawnTime);
+    LoadTest_SendUnreliable(client, &msg);
+}
+
+static void LoadTest_SendReliable(loadclient_t *client) {
+    struct {
+        unsigned int length;
+        unsigned int sequence;
+        byte data[LOADTEST_RELIABLE];
+    } packet;
+    int length = NET_HEADERSIZE + client->reliable.cursize;
+
+    packet.length = BigLong(length | NETFLAG_DATA | NETFLAG_EOM);
+    packet.sequence = BigLong(client->reliableSequence);
+    memcpy(packet.data, client->reliable.data, client->reliable.cursize);
+    loadtest.driver->Write(client->socket, &packet, length, &client->addr);
+    client->reliablePending = true;
+    client->reliableTime = net_time;
+    client->bytesSent += length;
+    loadtest.packetsSent++;
+}
+
+/* sends whatever is queued, if nothing is in flight */
+static void LoadTest_FlushReliable(loadclient_t *client) {
+    if (client->reliablePending || !client->queued.cursize) return;
+
+    SZ_Clear(&client->reliable);
+    SZ_Write(&client->reliable, client->queued.data, client->queued.cursize);
+    SZ_Clear(&client->queued);
+    LoadTest_SendReliable(client);
+}
+
+static void LoadTest_Parse(loadclient_t *client, const byte *data, int length) {
+    bot_t *bot = &client->bot;
+
+    SZ_Clear(&net_message);
+    SZ_Write(&net_message, data, length);
+    Bot_ParseServerMessage(bot);
+    SZ_Clear(&net_message);
+
+    Bot_SignonReply(bot, &client->queued);
+    if (bot->replied == 3 && !client->spawnTime) {
+        client->spawnTime = net_time;
+        loadtest.spawned++;
+    }
+}
+
+static void LoadTest_Receive(loadclient_t *client, const byte *data, int length, qboolean eom) {
+    if (client->messageLength >= 0 && client->messageLength + length <= NET_MAXMESSAGE) {
+        memcpy(client->message + client->messageLength, data, length);
+        client->messageLength += length;
+    } else {
+        client->messageLength = -1;
+    }
+    if (!eom) return;
+
+    if (client->messageLength >= 0)
+        LoadTest_Parse(client, client->message, client->messageLength);
+    else
+        client->bot.errors++;
+    client->messageLength = 0;
+}
+
+static void LoadTest_Read(loadclient_t *client) {
+    netadr_t addr;
+    unsigned int length, flags, sequence;
+    int len, control;
+
+    while ((len = loadtest.driver->Read(client->socket, &packetBuffer, NET_MESSAGESIZE, &addr)) > 0) {
+        if (len < NET_HEADERSIZE) continue;
+        length = BigLong(packetBuffer.length);
+        flags = length & ~NETFLAG_LENGTH_MASK;
+
+        if (flags & NETFLAG_CTL) {
+            if (client->accepted) continue;
+            SZ_Clear(&net_message);
+            SZ_Write(&net_message, &packetBuffer, len);
+            MSG_BeginReading();
+            control = MSG_ReadControlHeader();
+            if (control == -1 || (control & NETFLAG_LENGTH_MASK) != len) continue;
+            control = MSG_ReadByte();
+            if (control == CCREP_ACCEPT) {
+                client->addr = loadtest.server;
+                NET_SetSocketPort(&client->addr, MSG_ReadLong());
+                client->accepted = true;
+                loadtest.accepted++;
+            } else if (control == CCREP_REJECT) {
+                Con_Printf("loadtest client %d rejected: %s", (int)(client - loadtest.clients),
+                           MSG_ReadString());
+                loadtest.driver->CloseSocket(client->socket);
+                client->socket = -1;
+                SZ_Clear(&net_message);
+                return;
+            }
+            SZ_Clear(&net_message);
+            continue;
+        }
+
+        loadtest.packetsReceived++;
+        loadtest.bytesReceived += len;
+        client->bytesReceived += len;
+        sequence = BigLong(packetBuffer.sequence);
+        if (flags & NETFLAG_ACK) {
+            if (client->reliablePending && sequence == client->reliableSequence) {
+                client->reliablePending = false;
+                client->reliableSequence++;
+            }
+        } else if (flags & NETFLAG_DATA) {
+            /* ack it, a stop-and-wait client doesn't care about order */
+            packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
+            loadtest.driver->Write(client->socket, &packetBuffer, NET_HEADERSIZE, &addr);
+            loadtest.reliableReceived++;
+
+            /* unless it is signing on, then duplicates have to be skipped */
+            if (!loadtest.spawn) continue;
+            if (sequence != client->receiveSequence) {
+                client->duplicates++;
+                continue;
+            }
+            client->receiveSequence++;
+            LoadTest_Receive(client, packetBuffer.data, len - NET_HEADERSIZE,
+                             (flags & NETFLAG_EOM) != 0);
+        } else if (flags & NETFLAG_UNRELIABLE) {
+            if (!loadtest.spawn) continue;
+            if (sequence < client->unreliableSequence) {
+                client->stale++;
+                continue;
+            }
+            client->dropped += sequence - client->unreliableSequence;
+            client->unreliableSequence = sequence + 1;
+            LoadTest_Parse(client, packetBuffer.data, len - NET_HEADERSIZE);
+
+            /* the first update after begin, like ca_firstupdate */
+            if (client->bot.replied == 3) client->bot.active = true;
+        }
+
+        if (client->bot.disconnected) {
+            Con_Printf("loadtest client %d disconnected by the server\n",
+                       (int)(client - loadtest.clients));
+            loadtest.driver->CloseSocket(client->socket);
+            client->socket = -1;
+            return;
+        }
+    }
+}
+
+static void LoadTest_ReportBots(double elapsed) {
+    loadclient_t *client;
+    const bot_t *bot;
+    unsigned dropped, received, stale, duplicates, errors, ticks;
+    double bytes, minBytes, maxBytes, sent, tickTotal, tickMax;
+    int i, count;
+
+    count = 0;
+    dropped = received = stale = duplicates = errors = ticks = 0;
+    bytes = sent = maxBytes = tickTotal = tickMax = 0;
+    minBytes = -1;
+    for (i = 0, client = loadtest.clients; i < loadtest.numclients; i++, client++) {
+        if (!client->accepted) continue;
+        bot = &client->bot;
+        count++;
+        bytes += client->bytesReceived;
+        sent += client->bytesSent;
+        if (minBytes < 0 || client->bytesReceived < minBytes) minBytes = client->bytesReceived;
+        maxBytes = qmax(maxBytes, (double)client->bytesReceived);
+        received += client->unreliableSequence - client->dropped;
+        dropped += client->dropped;
+        stale += client->stale;
+        duplicates += client->duplicates;
+        errors += bot->errors;
+        ticks += bot->ticks;
+        tickTotal += bot->tickTotal;
+        tickMax = qmax(tickMax, bot->tickMax);
+    }
+    if (!count) return;
+
+    Con_Printf("per client %.0f bytes/sec in (%.0f min, %.0f max), %.0f out\n",
+               bytes / count / elapsed, minBytes / elapsed, maxBytes / elapsed,
+               sent / count / elapsed);
+    Con_Printf("datagrams %u received, %u dropped (%.1f%%), %u out of order\n", received, dropped,
+               received + dropped ? dropped * 100.0 / (received + dropped) : 0.0, stale);
+    Con_Printf("reliable %u resent by the server, %u illegible messages\n", duplicates, errors);
+    if (ticks)
+        Con_Printf("updates every %.1f ms avg, %.1f max\n", tickTotal * 1000.0 / ticks,
+                   tickMax * 1000.0);
+}
+
+static void LoadTest_Finish(void) {
+    loadclient_t *client;
+    double elapsed = net_time - loadtest.start;
+    clock_t cpu = clock();
+    double spawnTime, minSpawn, maxSpawn;
+    int i;
+
+    for (i = 0, client = loadtest.clients; i < loadtest.numclients; i++, client++) {
+        if (client->socket == -1) continue;
+        if (client->accepted) LoadTest_SendNop(client, clc_disconnect);
+        loadtest.driver->CloseSocket(client->socket);
+    }
+    loadtest.inProgress = false;
+    if (loadtest.local) Prof_Force(false);
+
+    if (elapsed <= 0) return;
+    Con_Printf("%d of %d clients connected, %.1f seconds\n", loadtest.accepted, loadtest.numclients,
+               elapsed);
+    Con_Printf("sent     %8.0f packets/sec\n", loadtest.packetsSent / elapsed);
+    Con_Printf("received %8.0f packets/sec, %.0f bytes/sec, %u reliable\n",
+               loadtest.packetsReceived / elapsed, loadtest.bytesReceived / elapsed,
+               loadtest.reliableReceived);
+    if (cpu != (clock_t)-1 && loadtest.cpu != (clock_t)-1)
+        Con_Printf("process cpu %.1f%%\n",
+                   (double)(cpu - loadtest.cpu) / CLOCKS_PER_SEC * 100.0 / elapsed);
+
+    if (!loadtest.spawn) return;
+    Con_Printf("%d of %d clients spawned", loadtest.spawned, loadtest.numclients);
+    if (!loadtest.spawned) {
+        Con_Printf("\n");
+        return;
+    }
+    spawnTime = maxSpawn = 0;
+    minSpawn = elapsed;
+    for (i = 0, client = loadtest.clients; i < loadtest.numclients; i++, client++) {
+        if (!client->spawnTime) continue;
+        elapsed = client->spawnTime - client->connectTime;
+        spawnTime += elapsed;
+        minSpawn = qmin(minSpawn, elapsed);
+        maxSpawn = qmax(maxSpawn, elapsed);
+    }
+    Con_Printf(", time to spawn %.1f ms avg, %.1f min, %.1f max\n",
+               spawnTime * 1000.0 / loadtest.spawned, minSpawn * 1000.0, maxSpawn * 1000.0);
+
+    LoadTest_ReportBots(net_time - loadtest.start);
+    if (loadtest.local) Prof_Report(host_framecount - loadtest.startframe);
+}
+
+static void LoadTest_Poll(void *arg) {
+    loadclient_t *client;
+    qboolean resend;
+    int i, due;
+
+    if (!loadtest.inProgress) return;
+
+    resend = loadtest.accepted < loadtest.numclients && net_time - loadtest.lastconnect > 1.0;
+    if (resend) loadtest.lastconnect = net_time;
+
+    for (i = 0, client = loadtest.clients; i < loadtest.numclients; i++, client++) {
+        if (client->socket == -1) continue;
+        LoadTest_Read(client);
+        if (client->socket == -1) continue;
+        if (!client->accepted) {
+            if (resend) LoadTest_Connect(client);
+            continue;
+        }
+        if (client->reliablePending && net_time - client->reliableTime > 1.0)
+            LoadTest_SendReliable(client);
+        LoadTest_FlushReliable(client);
+        /* catch up to the packet rate, but don't burst after a stall */
+        due = (int)((net_time - loadtest.start) * loadtest.pps) - client->sent;
+        for (due = qmin(due, 4); due > 0; due--, client->sent++) LoadTest_SendMove(client);
+    }
+
+    if (net_time >= loadtest.end) {
+        LoadTest_Finish();
+        return;
+    }
+    SchedulePollProcedure(&loadTestProcedure, 0);
+}
+
+static void LoadTest_f(void) {
+    const char *host;
+    loadclient_t *client;
+    int i;
+
+    if (Cmd_Argc() < 2) {
+        Con_Printf("net_loadtest <host> [clients] [seconds] [packets/sec] [spawn]\n");
+        return;
+    }
+    if (loadtest.inProgress) {
+        Con_Printf("Load test already running\n");
+        return;
+    }
+
+    host = Cmd_Argv(1);
+    loadtest.driver = NULL;
+    for (i = 0; i < net_numlandrivers; i++) {
+        if (!net_landrivers[i].initialized) continue;
+        if (net_landrivers[i].GetAddrFromName(host, &loadtest.server) != -1) {
+            loadtest.driver = &net_landrivers[i];
+            break;
+        }
+    }
+    if (!loadtest.driver) {
+        Con_Printf("Couldn't resolve %s\n", host);
+        return;
+    }
+
+    loadtest.numclients = Cmd_Argc() > 2 ? Q_atoi(Cmd_Argv(2)) : 8;
+    loadtest.numclients = qmax(1, qmin(loadtest.numclients, MAX_SCOREBOARD));
+    loadtest.pps = Cmd_Argc() > 4 ? Q_atof(Cmd_Argv(4)) : 72;
+    if (loadtest.pps <= 0) loadtest.pps = 72;
+    loadtest.spawn = Cmd_Argc() > 5 && Q_atoi(Cmd_Argv(5));
+
+    SetNetTime();
+    loadtest.accepted = loadtest.spawned = 0;
+    loadtest.packetsSent = loadtest.packetsReceived = 0;
+    loadtest.reliableReceived = loadtest.bytesReceived = 0;
+    for (i = 0, client = loadtest.clients; i < loadtest.numclients; i++, client++) {
+        memset(client, 0, sizeof(*client));
+        client->reliable.data = client->reliableBuf;
+        client->reliable.maxsize = sizeof(client->reliableBuf);
+        client->queued.data = client->queuedBuf;
+        client->queued.maxsize = sizeof(client->queuedBuf);
+        Bot_Reset(&client->bot, i);
+        client->connectTime = net_time;
+        client->socket = loadtest.driver->OpenSocket(0);
+        if (client->socket != -1) LoadTest_Connect(client);
+    }
+
+    /* the server frame times are only ours to report if it runs here */
+    loadtest.local = loadtest.spawn && sv.active;
+    if (loadtest.local) {
+        Prof_Reset();
+        Prof_Force(true);
+        loadtest.startframe = host_framecount;
+    }
+
+    loadtest.start = loadtest.lastconnect = net_time;
+    loadtest.end = net_time + (Cmd_Argc() > 3 ? Q_atof(Cmd_Argv(3)) : 10);
+    loadtest.cpu = clock();
+    loadtest.inProgress = true;
+    SchedulePollProcedure(&loadTestProcedure, 0);
+}
+
 int Datagram_Init(void) {
     int i, csock, num_inited;
 
     dgrm_driver = net_driver;
     Cmd_AddCommand("net_stats", NET_Stats_f);
+    Cvar_RegisterVariable(&net_window);
+    Cvar_RegisterVariable(&net_compress);
+    Cvar_RegisterVariable(&net_sharedsocket);
+    Demux_Reset();
+    Sim_Init();
 
     if (COM_CheckParm("-nolan")) return -1;
 
@@ -580,6 +1728,7 @@ int Datagram_Init(void) {
         if (csock == -1) continue;
         net_landrivers[i].initialized = true;
         net_landrivers[i].controlSock = csock;
+        Sim_Wrap(&net_landrivers[i]);
         num_inited++;
     }
 
@@ -588,6 +1737,7 @@ int Datagram_Init(void) {
     Cmd_AddCommand("ban", NULL);
     Cmd_AddCommand("test", Test_f);
     Cmd_AddCommand("test2", Test2_f);
+    Cmd_AddCommand("net_loadtest", LoadTest_f);
 
     return 0;
 }
@@ -595,6 +1745,8 @@ int Datagram_Init(void) {
 void Datagram_Shutdown(void) {
     int i;
 
+    Sim_Shutdown();
+
     //
     // shutdown the lan drivers
     //
@@ -606,7 +1758,14 @@ void Datagram_Shutdown(void) {
     }
 }
 
-void Datagram_Close(qsocket_t *sock) { sock->landriver->CloseSocket(sock->socket); }
+void Datagram_Close(qsocket_t *sock) {
+    if (sock->shared) {
+        Datagram_Flush();
+        Demux_Remove(sock);
+        return;
+    }
+    sock->landriver->CloseSocket(sock->socket);
+}
 
 void Datagram_Listen(qboolean state) {
     int i;
@@ -628,13 +1787,25 @@ static qsocket_t *_Datagram_CheckNewConnections(net_landriver_t *driver) {
     int command;
     int control;
     int ret;
+    int options;
+    int mtu;
+    qboolean demuxing, shared;
+
+    demuxing = Demux_Socket(driver) != -1;
+    shared = demuxing && net_sharedsocket.value;
+    if (demuxing) {
+        acceptsock = demux.socket;
+        SZ_Clear(&net_message);
+        len = Demux_Read(&demux.acceptHead, &demux.acceptTail, net_message.data,
+                         net_message.maxsize, &clientaddr);
+    } else {
+        acceptsock = driver->CheckNewConnections();
+        if (acceptsock == -1) return NULL;
 
-    acceptsock = driver->CheckNewConnections();
-    if (acceptsock == -1) return NULL;
-
-    SZ_Clear(&net_message);
+        SZ_Clear(&net_message);
 
-    len = driver->Read(acceptsock, net_message.data, net_message.maxsize, &clientaddr);
+        len = driver->Read(acceptsock, net_message.data, net_message.maxsize, &clientaddr);
+    }
     if (len < sizeof(int)) return NULL;
     net_message.cursize = len;
 
@@ -741,6 +1912,14 @@ static qsocket_t *_Datagram_CheckNewConnections(net_landriver_t *driver) {
         return NULL;
     }
 
+    // transport extensions the client offers, if any
+    options = MSG_ReadByte();
+    mtu = MSG_ReadShort();
+    if (msg_badread || mtu < 256) options = 0;
+    if (!net_window.value) options &= ~NETOPT_WINDOW;
+    if (!net_compress.value) options &= ~NETOPT_COMPRESS;
+    options &= NETOPT_WINDOW | NETOPT_COMPRESS;
+
     // check for a ban
     testAddr.ip.l = clientaddr.ip.l;
     if ((testAddr.ip.l & banMask.ip.l) == banAddr.ip.l) {
@@ -769,6 +1948,11 @@ static qsocket_t *_Datagram_CheckNewConnections(net_landriver_t *driver) {
                 MSG_WriteByte(&net_message, CCREP_ACCEPT);
                 driver->GetSocketAddr(s->socket, &newaddr);
                 MSG_WriteLong(&net_message, NET_GetSocketPort(&newaddr));
+                if (options) {
+                    MSG_WriteByte(&net_message, (s->windowed ? NETOPT_WINDOW : 0) |
+                                                    (s->compress ? NETOPT_COMPRESS : 0));
+                    MSG_WriteShort(&net_message, s->mtu);
+                }
                 MSG_WriteControlHeader(&net_message);
                 driver->Write(acceptsock, net_message.data, net_message.cursize, &clientaddr);
                 SZ_Clear(&net_message);
@@ -797,8 +1981,8 @@ static qsocket_t *_Datagram_CheckNewConnections(net_landriver_t *driver) {
         SZ_Clear(&net_message);
         return NULL;
     }
-    // allocate a network socket
-    newsock = driver->OpenSocket(0);
+    // allocate a network socket, unless they all share the listening one
+    newsock = shared ? acceptsock : driver->OpenSocket(0);
     if (newsock == -1) {
         NET_FreeQSocket(sock);
         return NULL;
@@ -809,7 +1993,13 @@ static qsocket_t *_Datagram_CheckNewConnections(net_landriver_t *driver) {
     sock->landriver = driver;
     sock->addr = clientaddr;
     strcpy(sock->address, NET_AdrToString(&clientaddr));
+    if (shared) Demux_Add(sock);
     sock->mtu = driver->GetDefaultMTU() - NET_HEADERSIZE;
+    if (options & NETOPT_WINDOW) {
+        sock->windowed = true;
+        sock->mtu = qmin(sock->mtu, mtu);
+    }
+    sock->compress = (options & NETOPT_COMPRESS) != 0;
 
     // send him back the info about the server connection he has been allocated
     SZ_Clear(&net_message);
@@ -818,6 +2008,10 @@ static qsocket_t *_Datagram_CheckNewConnections(net_landriver_t *driver) {
     MSG_WriteByte(&net_message, CCREP_ACCEPT);
     driver->GetSocketAddr(newsock, &newaddr);
     MSG_WriteLong(&net_message, NET_GetSocketPort(&newaddr));
+    if (options) {
+        MSG_WriteByte(&net_message, options);
+        MSG_WriteShort(&net_message, sock->mtu);
+    }
     MSG_WriteControlHeader(&net_message);
     driver->Write(acceptsock, net_message.data, net_message.cursize, &clientaddr);
     SZ_Clear(&net_message);
@@ -832,8 +2026,13 @@ qsocket_t *Datagram_CheckNewConnections(void) {
 
     for (i = 0; i < net_numlandrivers; i++) {
         driver = &net_landrivers[i];
-        if (driver->initialized)
-            if ((ret = _Datagram_CheckNewConnections(driver)) != NULL) break;
+        if (!driver->initialized) continue;
+
+        /* answer everything queued on a shared socket, not one a frame */
+        do {
+            ret = _Datagram_CheckNewConnections(driver);
+        } while (!ret && Demux_Socket(driver) != -1 && demux.acceptHead != -1);
+        if (ret) break;
     }
 
     return ret;
@@ -952,6 +2151,8 @@ static qsocket_t *_Datagram_Connect(const char *host, net_landriver_t *driver) {
     int reps;
     double start_time;
     int control;
+    int options;
+    int mtu;
     const char *reason;
 
     // see if we can resolve the host name
@@ -966,6 +2167,8 @@ static qsocket_t *_Datagram_Connect(const char *host, net_landriver_t *driver) {
     sock->socket = newsock;
     sock->landriver = driver;
     sock->mtu = driver->GetDefaultMTU() - NET_HEADERSIZE;
+    options = net_window.value ? NETOPT_WINDOW : 0;
+    if (net_compress.value) options |= NETOPT_COMPRESS;
 
     // send the connection request
     Con_Printf("trying...\n");
@@ -979,6 +2182,10 @@ static qsocket_t *_Datagram_Connect(const char *host, net_landriver_t *driver) {
         MSG_WriteByte(&net_message, CCREQ_CONNECT);
         MSG_WriteString(&net_message, "QUAKE");
         MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+        if (options) {
+            MSG_WriteByte(&net_message, options);
+            MSG_WriteShort(&net_message, sock->mtu);
+        }
         MSG_WriteControlHeader(&net_message);
         driver->Write(newsock, net_message.data, net_message.cursize, &sendaddr);
         SZ_Clear(&net_message);
@@ -1046,6 +2253,14 @@ static qsocket_t *_Datagram_Connect(const char *host, net_landriver_t *driver) {
     if (ret == CCREP_ACCEPT) {
         sock->addr = sendaddr;
         NET_SetSocketPort(&sock->addr, MSG_ReadLong());
+        // older servers don't echo the options back
+        options &= MSG_ReadByte();
+        mtu = MSG_ReadShort();
+        if (!msg_badread && (options & NETOPT_WINDOW) && mtu >= 256 && mtu <= sock->mtu) {
+            sock->windowed = true;
+            sock->mtu = mtu;
+        }
+        sock->compress = !msg_badread && (options & NETOPT_COMPRESS);
     } else {
         reason = "Bad Response";
         goto ErrorReturn;
@@ -21,7 +21,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "net_loop.h"
 #include "client.h"
+#include "cmd.h"
 #include "console.h"
+#include "cvar.h"
+#include "host.h"
 #include "quakedef.h"
 #include "server.h"
 #include "sys.h"
@@ -30,12 +33,178 @@ qboolean localconnectpending = false;
 qsocket_t *loop_client = NULL;
 qsocket_t *loop_server = NULL;
 
+/*
+ * ===========================================================================
+ *
+ * Zero-copy mode (net_loopzerocopy)
+ *
+ * The original loopback packs each message into the peer's receiveMessage
+ * and copies it out again into net_message, on top of the copy the sender
+ * made to build it. In zero-copy mode each side instead owns a ring of
+ * message slots. A sender can ask for the next free slot with
+ * NET_SendBuffer and build its message right there, and the receiver gets
+ * net_message pointed at the slot and parses it in place. The slot stays
+ * held until the next Loop_GetMessage, which is what lets anything else
+ * that uses net_message in between scribble over it harmlessly.
+ *
+ * Unreliable messages may not take the last free slot, that is kept for
+ * the one reliable message allowed in flight.
+ *
+ * ===========================================================================
+ */
+
+#define LOOP_SLOTS 8
+
+typedef struct {
+    int type; /* 1 reliable, 2 unreliable, as returned by QGetMessage */
+    int length;
+    byte data[NET_MAXMESSAGE];
+} loopslot_t;
+
+typedef struct {
+    loopslot_t slots[LOOP_SLOTS];
+    int head;  /* oldest message */
+    int count; /* queued messages, including a held one */
+} loopring_t;
+
+static cvar_t net_loopzerocopy = {"net_loopzerocopy", "1"};
+
+static qboolean loop_zerocopy; /* latched when connecting */
+static loopring_t loop_rings[2]; /* received by the client and by the server */
+static loopring_t *loop_held;    /* whose head net_message points at */
+static byte *loop_messagedata;   /* net_message's own buffer while one is held */
+static int loop_messagesize;
+
+static struct {
+    unsigned messages;
+    unsigned bytes;  /* message bytes delivered */
+    unsigned copied; /* bytes memcpy'd by the driver on the way */
+    double time;     /* spent in the send and receive calls */
+    int startframe;
+} loopstats;
+
+static loopring_t *Loop_Ring(const qsocket_t *sock) {
+    return sock == loop_client ? &loop_rings[0] : &loop_rings[1];
+}
+
+/* frees the held slot and gives net_message its own buffer back */
+static void Loop_Release(void) {
+    if (!loop_held) return;
+
+    loop_held->head = (loop_held->head + 1) % LOOP_SLOTS;
+    loop_held->count--;
+    loop_held = NULL;
+
+    net_message.data = loop_messagedata;
+    net_message.maxsize = loop_messagesize;
+    SZ_Clear(&net_message);
+}
+
+static void Loop_ResetRing(loopring_t *ring) {
+    if (loop_held == ring) Loop_Release();
+    ring->head = 0;
+    ring->count = 0;
+}
+
+/* the slot a message to sock's peer goes in, NULL if there is no room */
+static loopslot_t *Loop_SendSlot(qsocket_t *sock, qboolean reliable) {
+    loopring_t *ring = Loop_Ring(sock->driverdata);
+
+    if (ring->count >= LOOP_SLOTS - (reliable ? 0 : 1)) return NULL;
+    return &ring->slots[(ring->head + ring->count) % LOOP_SLOTS];
+}
+
+static int Loop_SendSlotMessage(qsocket_t *sock, const sizebuf_t *data, int type) {
+    loopring_t *ring = Loop_Ring(sock->driverdata);
+    loopslot_t *slot = Loop_SendSlot(sock, type == 1);
+
+    if (!slot) {
+        if (type == 1) Sys_Error("%s: overflow", __func__);
+        return 0;
+    }
+
+    /* nothing to do if it was built in place */
+    if (data->data != slot->data) {
+        memcpy(slot->data, data->data, data->cursize);
+        loopstats.copied += data->cursize;
+    }
+    slot->type = type;
+    slot->length = data->cursize;
+    ring->count++;
+
+    return 1;
+}
+
+static int Loop_GetSlotMessage(qsocket_t *sock) {
+    loopring_t *ring = Loop_Ring(sock);
+    loopslot_t *slot;
+
+    Loop_Release();
+    if (!ring->count) return 0;
+
+    slot = &ring->slots[ring->head];
+    loop_held = ring;
+    loop_messagedata = net_message.data;
+    loop_messagesize = net_message.maxsize;
+    net_message.data = slot->data;
+    net_message.maxsize = sizeof(slot->data);
+    net_message.cursize = slot->length;
+
+    loopstats.messages++;
+    loopstats.bytes += slot->length;
+
+    return slot->type;
+}
+
+byte *Loop_SendBuffer(qsocket_t *sock, int *size) {
+    loopslot_t *slot;
+
+    if (!loop_zerocopy || !sock->driverdata) return NULL;
+    slot = Loop_SendSlot(sock, false);
+    if (!slot) return NULL;
+
+    *size = sizeof(slot->data);
+    return slot->data;
+}
+
+/*
+====================
+Loop_Stats_f
+
+net_loopstats [reset] : how much copying the loopback did per message and
+                        per frame
+====================
+*/
+static void Loop_Stats_f(void) {
+    int frames = host_framecount - loopstats.startframe;
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "reset")) {
+        memset(&loopstats, 0, sizeof(loopstats));
+        loopstats.startframe = host_framecount;
+        return;
+    }
+
+    Con_Printf("loopback (%s)\n", loop_zerocopy ? "zero-copy" : "copying");
+    Con_Printf("%u messages, %u bytes, %u copied\n", loopstats.messages, loopstats.bytes,
+               loopstats.copied);
+    if (loopstats.messages)
+        Con_Printf("%.0f bytes copied, %.2f usec per message\n",
+                   (double)loopstats.copied / loopstats.messages,
+                   loopstats.time * 1000000.0 / loopstats.messages);
+    if (frames > 0)
+        Con_Printf("%.0f bytes copied, %.2f usec per frame\n",
+                   (double)loopstats.copied / frames, loopstats.time * 1000000.0 / frames);
+}
+
 int Loop_Init(void) {
+    Cvar_RegisterVariable(&net_loopzerocopy);
+    Cmd_AddCommand("net_loopstats", Loop_Stats_f);
+
     if (cls.state == ca_dedicated) return -1;
     return 0;
 }
 
-void Loop_Shutdown(void) {}
+void Loop_Shutdown(void) { Loop_Release(); }
 
 void Loop_Listen(qboolean state) {}
 
@@ -86,6 +255,10 @@ qsocket_t *Loop_Connect(const char *host) {
     loop_client->driverdata = (void *)loop_server;
     loop_server->driverdata = (void *)loop_client;
 
+    loop_zerocopy = net_loopzerocopy.value != 0;
+    Loop_ResetRing(&loop_rings[0]);
+    Loop_ResetRing(&loop_rings[1]);
+
     return loop_client;
 }
 
@@ -99,15 +272,25 @@ qsocket_t *Loop_CheckNewConnections(void) {
     loop_client->sendMessageLength = 0;
     loop_client->receiveMessageLength = 0;
     loop_client->canSend = true;
+    Loop_ResetRing(&loop_rings[0]);
+    Loop_ResetRing(&loop_rings[1]);
     return loop_server;
 }
 
 static int IntAlign(int value) { return (value + (sizeof(int) - 1)) & (~(sizeof(int) - 1)); }
 
 int Loop_GetMessage(qsocket_t *sock) {
+    double start = Sys_DoubleTime();
     int ret;
     int length;
 
+    if (loop_zerocopy) {
+        ret = Loop_GetSlotMessage(sock);
+        if (sock->driverdata && ret == 1) ((qsocket_t *)sock->driverdata)->canSend = true;
+        loopstats.time += Sys_DoubleTime() - start;
+        return ret;
+    }
+
     if (sock->receiveMessageLength == 0) return 0;
 
     ret = sock->receiveMessage[0];
@@ -115,6 +298,9 @@ int Loop_GetMessage(qsocket_t *sock) {
     // alignment byte skipped here
     SZ_Clear(&net_message);
     SZ_Write(&net_message, &sock->receiveMessage[4], length);
+    loopstats.messages++;
+    loopstats.bytes += length;
+    loopstats.copied += length;
 
     length = IntAlign(length + 4);
     sock->receiveMessageLength -= length;
@@ -124,15 +310,25 @@ int Loop_GetMessage(qsocket_t *sock) {
 
     if (sock->driverdata && ret == 1) ((qsocket_t *)sock->driverdata)->canSend = true;
 
+    loopstats.time += Sys_DoubleTime() - start;
+
     return ret;
 }
 
 int Loop_SendMessage(qsocket_t *sock, const sizebuf_t *data) {
+    double start = Sys_DoubleTime();
     byte *buffer;
     int *bufferLength;
 
     if (!sock->driverdata) return -1;
 
+    if (loop_zerocopy) {
+        Loop_SendSlotMessage(sock, data, 1);
+        sock->canSend = false;
+        loopstats.time += Sys_DoubleTime() - start;
+        return 1;
+    }
+
     bufferLength = &((qsocket_t *)sock->driverdata)->receiveMessageLength;
 
     if ((*bufferLength + data->cursize + 4) > NET_MAXMESSAGE) Sys_Error("%s: overflow", __func__);
@@ -152,17 +348,27 @@ int Loop_SendMessage(qsocket_t *sock, const sizebuf_t *data) {
     // message
     memcpy(buffer, data->data, data->cursize);
     *bufferLength = IntAlign(*bufferLength + data->cursize + 4);
+    loopstats.copied += data->cursize;
+    loopstats.time += Sys_DoubleTime() - start;
 
     sock->canSend = false;
     return 1;
 }
 
 int Loop_SendUnreliableMessage(qsocket_t *sock, const sizebuf_t *data) {
+    double start = Sys_DoubleTime();
     byte *buffer;
     int *bufferLength;
+    int ret;
 
     if (!sock->driverdata) return -1;
 
+    if (loop_zerocopy) {
+        ret = Loop_SendSlotMessage(sock, data, 2);
+        loopstats.time += Sys_DoubleTime() - start;
+        return ret;
+    }
+
     bufferLength = &((qsocket_t *)sock->driverdata)->receiveMessageLength;
 
     if ((*bufferLength + data->cursize + sizeof(byte) + sizeof(short)) > NET_MAXMESSAGE) return 0;
@@ -182,6 +388,8 @@ int Loop_SendUnreliableMessage(qsocket_t *sock, const sizebuf_t *data) {
     // message
     memcpy(buffer, data->data, data->cursize);
     *bufferLength = IntAlign(*bufferLength + data->cursize + 4);
+    loopstats.copied += data->cursize;
+    loopstats.time += Sys_DoubleTime() - start;
     return 1;
 }
 
@@ -193,6 +401,7 @@ qboolean Loop_CanSendMessage(qsocket_t *sock) {
 qboolean Loop_CanSendUnreliableMessage(qsocket_t *sock) { return true; }
 
 void Loop_Close(qsocket_t *sock) {
+    Loop_ResetRing(Loop_Ring(sock));
     if (sock->driverdata) ((qsocket_t *)sock->driverdata)->driverdata = NULL;
     sock->receiveMessageLength = 0;
     sock->sendMessageLength = 0;
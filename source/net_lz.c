@@ -0,0 +1,277 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_lz.c -- LZ compression of reliable messages
+
+#include <string.h>
+
+#include "mathlib.h"
+#include "net_lz.h"
+
+/*
+ * A byte oriented LZ77 in the style of LZ4's block format. Each sequence is
+ * a token byte holding a literal count (high nibble) and a match length
+ * minus LZ_MINMATCH (low nibble), where 15 means more length follows in
+ * bytes of 255 ending with a smaller one. Then come the literals and a
+ * little endian 16-bit offset back to the match. The last sequence has
+ * literals only and ends the data.
+ *
+ * Matches may reach back past the start of the message into a preset
+ * dictionary, which is what makes short messages worth compressing: the
+ * precache lists, light styles and common prints a server sends every
+ * client are mostly found there. It is made of the strings the id1 progs
+ * put on the wire, NUL terminated as MSG_WriteString sends them, with the
+ * most common last. Changing it breaks compatibility with older builds.
+ */
+
+#define LZ_MINMATCH 4
+#define LZ_MAXOFFSET 0xffff
+#define LZ_HASHBITS 12
+#define LZ_HASHSIZE (1 << LZ_HASHBITS)
+
+static const char lz_dictionary[] =
+    /* prints */
+    "You got the \0You receive \0 health\n\0You got \0Shotgun\0Super Shotgun\0"
+    "Nailgun\0Super Nailgun\0Grenade Launcher\0Rocket Launcher\0Thunderbolt\0"
+    "Quad Damage\0Pentagram of Protection\0Ring of Shadows\0Biosuit\0"
+    "You need the gold key\0You need the silver key\0This door opens elsewhere\0"
+    " was telefragged by \0 suicides\n\0 entered the game\n\0"
+    /* monsters */
+    "progs/soldier.mdl\0progs/h_guard.mdl\0progs/dog.mdl\0progs/h_dog.mdl\0"
+    "progs/ogre.mdl\0progs/h_ogre.mdl\0progs/knight.mdl\0progs/h_knight.mdl\0"
+    "progs/demon.mdl\0progs/h_demon.mdl\0progs/zombie.mdl\0progs/h_zombie.mdl\0"
+    "progs/wizard.mdl\0progs/h_wizard.mdl\0progs/w_spike.mdl\0progs/shambler.mdl\0"
+    "progs/h_shams.mdl\0progs/hknight.mdl\0progs/h_hellkn.mdl\0progs/k_spike.mdl\0"
+    "progs/enforcer.mdl\0progs/h_mega.mdl\0progs/laser.mdl\0progs/fish.mdl\0"
+    "progs/tarbaby.mdl\0progs/zom_gib.mdl\0"
+    "soldier/death1.wav\0soldier/idle.wav\0soldier/pain1.wav\0soldier/pain2.wav\0"
+    "soldier/sattck1.wav\0soldier/sight1.wav\0dog/dattack1.wav\0dog/ddeath.wav\0"
+    "dog/dpain1.wav\0dog/dsight.wav\0dog/idle.wav\0ogre/ogdrag.wav\0ogre/ogdth.wav\0"
+    "ogre/ogidle.wav\0ogre/ogidle2.wav\0ogre/ogpain1.wav\0ogre/ogsawatk.wav\0"
+    "ogre/ogwake.wav\0knight/kdeath.wav\0knight/khurt.wav\0knight/ksight.wav\0"
+    "knight/sword1.wav\0knight/sword2.wav\0knight/idle.wav\0zombie/z_idle.wav\0"
+    "zombie/z_idle1.wav\0zombie/z_shot1.wav\0zombie/z_gib.wav\0zombie/z_pain.wav\0"
+    "zombie/z_pain1.wav\0zombie/z_fall.wav\0zombie/z_miss.wav\0zombie/z_hit.wav\0"
+    "zombie/idle_w2.wav\0demon/ddeath.wav\0demon/dhit2.wav\0demon/djump.wav\0"
+    "demon/dpain1.wav\0demon/idle1.wav\0demon/sight2.wav\0demon/dland2.wav\0"
+    "wizard/hit.wav\0wizard/wattack.wav\0wizard/wdeath.wav\0wizard/widle1.wav\0"
+    "wizard/widle2.wav\0wizard/wpain.wav\0wizard/wsight.wav\0"
+    /* items */
+    "maps/b_bh10.bsp\0maps/b_bh25.bsp\0maps/b_bh100.bsp\0maps/b_shell0.bsp\0"
+    "maps/b_shell1.bsp\0maps/b_nail0.bsp\0maps/b_nail1.bsp\0maps/b_rock0.bsp\0"
+    "maps/b_rock1.bsp\0maps/b_batt0.bsp\0maps/b_batt1.bsp\0maps/b_explob.bsp\0"
+    "progs/armor.mdl\0progs/g_shot.mdl\0progs/g_nail.mdl\0progs/g_nail2.mdl\0"
+    "progs/g_rock.mdl\0progs/g_rock2.mdl\0progs/g_light.mdl\0progs/quaddama.mdl\0"
+    "progs/invulner.mdl\0progs/suit.mdl\0progs/invisibl.mdl\0progs/w_g_key.mdl\0"
+    "progs/w_s_key.mdl\0progs/m_g_key.mdl\0progs/m_s_key.mdl\0progs/b_g_key.mdl\0"
+    "progs/b_s_key.mdl\0progs/end1.mdl\0progs/flame.mdl\0progs/flame2.mdl\0"
+    "items/armor1.wav\0items/health1.wav\0items/r_item1.wav\0items/r_item2.wav\0"
+    "items/itembk2.wav\0items/damage.wav\0items/damage2.wav\0items/damage3.wav\0"
+    "items/protect.wav\0items/protect2.wav\0items/protect3.wav\0items/inv1.wav\0"
+    "items/inv2.wav\0items/inv3.wav\0items/suit.wav\0items/suit2.wav\0"
+    "doors/medtry.wav\0doors/meduse.wav\0doors/runetry.wav\0doors/runeuse.wav\0"
+    "doors/basetry.wav\0doors/baseuse.wav\0doors/drclos4.wav\0doors/doormv1.wav\0"
+    "doors/hydro1.wav\0doors/hydro2.wav\0doors/stndr1.wav\0doors/stndr2.wav\0"
+    "doors/ddoor1.wav\0doors/ddoor2.wav\0doors/latch2.wav\0doors/winch2.wav\0"
+    "doors/airdoor1.wav\0doors/airdoor2.wav\0doors/basesec1.wav\0doors/basesec2.wav\0"
+    "plats/plat1.wav\0plats/plat2.wav\0plats/medplat1.wav\0plats/medplat2.wav\0"
+    "plats/train1.wav\0plats/train2.wav\0buttons/switch21.wav\0buttons/switch02.wav\0"
+    "buttons/switch04.wav\0buttons/airbut1.wav\0misc/secret.wav\0misc/talk.wav\0"
+    "misc/trigger1.wav\0misc/null.wav\0ambience/windfly.wav\0ambience/comp1.wav\0"
+    "ambience/drip1.wav\0ambience/drone6.wav\0ambience/fire1.wav\0ambience/hum1.wav\0"
+    "ambience/swamp1.wav\0ambience/swamp2.wav\0ambience/water1.wav\0ambience/buzz1.wav\0"
+    "ambience/fl_hum1.wav\0ambience/suck1.wav\0"
+    /* light styles from world.qc */
+    "mmnmmommommnonmmonqnmmo\0abcdefghijklmnopqrstuvwxyzyxwvutsrqponmlkjihgfedcba\0"
+    "mmmmmaaaaammmmmaaaaaabcdefgabcdefg\0mamamamamama\0"
+    "jklmnopqrstuvwxyzyxwvutsrqponmlkj\0nmonqnmomnmomomno\0"
+    "mmmaaaabcdefgmmmmaaaammmaamm\0mmmaaammmaaammmabcdefaaaammmmabcdefmmmaaaa\0"
+    "aaaaaaaazzzzzzzz\0mmamammmmammamamaaamammma\0abcdefghijklmnopqrrqponmlkjihgfedcba\0"
+    /* the player and weapons, precached on every map */
+    "weapons/r_exp3.wav\0weapons/rocket1i.wav\0weapons/sgun1.wav\0weapons/guncock.wav\0"
+    "weapons/ric1.wav\0weapons/ric2.wav\0weapons/ric3.wav\0weapons/spike2.wav\0"
+    "weapons/tink1.wav\0weapons/grenade.wav\0weapons/bounce.wav\0weapons/shotgn2.wav\0"
+    "weapons/lhit.wav\0weapons/lstart.wav\0weapons/ax1.wav\0weapons/pkup.wav\0"
+    "weapons/lock4.wav\0demon/dland2.wav\0misc/h2ohit1.wav\0misc/water1.wav\0"
+    "misc/water2.wav\0misc/power.wav\0misc/outwater.wav\0misc/r_tele1.wav\0"
+    "misc/r_tele2.wav\0misc/r_tele3.wav\0misc/r_tele4.wav\0misc/r_tele5.wav\0"
+    "player/plyrjmp8.wav\0player/land.wav\0player/land2.wav\0player/drown1.wav\0"
+    "player/drown2.wav\0player/gasp1.wav\0player/gasp2.wav\0player/h2odeath.wav\0"
+    "player/inh2o.wav\0player/slimbrn2.wav\0player/lburn1.wav\0player/lburn2.wav\0"
+    "player/tornoff2.wav\0player/gib.wav\0player/udeath.wav\0player/teledth1.wav\0"
+    "player/axhit1.wav\0player/axhit2.wav\0player/h2ojump.wav\0player/death1.wav\0"
+    "player/death2.wav\0player/death3.wav\0player/death4.wav\0player/death5.wav\0"
+    "player/pain1.wav\0player/pain2.wav\0player/pain3.wav\0player/pain4.wav\0"
+    "player/pain5.wav\0player/pain6.wav\0"
+    "progs/player.mdl\0progs/eyes.mdl\0progs/h_player.mdl\0progs/gib1.mdl\0"
+    "progs/gib2.mdl\0progs/gib3.mdl\0progs/s_bubble.spr\0progs/s_explod.spr\0"
+    "progs/v_axe.mdl\0progs/v_shot.mdl\0progs/v_nail.mdl\0progs/v_rock.mdl\0"
+    "progs/v_shot2.mdl\0progs/v_nail2.mdl\0progs/v_rock2.mdl\0progs/v_light.mdl\0"
+    "progs/bolt.mdl\0progs/bolt2.mdl\0progs/bolt3.mdl\0progs/lavaball.mdl\0"
+    "progs/missile.mdl\0progs/grenade.mdl\0progs/spike.mdl\0progs/s_spike.mdl\0"
+    "progs/backpack.mdl\0"
+    /* serverinfo */
+    "\nVERSION TyrQuake-\0 SERVER (\0 CRC)";
+
+#define LZ_DICTSIZE ((int)sizeof(lz_dictionary))
+
+static struct {
+    qboolean initialized;
+    int dictionaryTable[LZ_HASHSIZE];        /* with only the dictionary hashed */
+    int table[LZ_HASHSIZE];                  /* position in buffer, -1 if none */
+    byte buffer[LZ_DICTSIZE + LZ_MAXOFFSET]; /* the dictionary, then the input */
+} lz;
+
+static inline unsigned LZ_Hash(const byte *p) {
+    unsigned v;
+
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASHBITS);
+}
+
+static void LZ_Init(void) {
+    int i;
+
+    memcpy(lz.buffer, lz_dictionary, LZ_DICTSIZE);
+    for (i = 0; i < LZ_HASHSIZE; i++) lz.dictionaryTable[i] = -1;
+    for (i = 0; i + LZ_MINMATCH <= LZ_DICTSIZE; i++)
+        lz.dictionaryTable[LZ_Hash(lz.buffer + i)] = i;
+    lz.initialized = true;
+}
+
+static byte *LZ_WriteLength(byte *op, int length) {
+    for (; length >= 255; length -= 255) *op++ = 255;
+    *op++ = length;
+
+    return op;
+}
+
+/* worst case size of a sequence */
+#define LZ_SEQUENCE_SIZE(literals, match) \
+    (1 + (literals) / 255 + 1 + (literals) + 2 + (match) / 255 + 1)
+
+static byte *LZ_WriteSequence(byte *op, const byte *literals, int numLiterals, int offset,
+                              int match) {
+    byte *token = op++;
+
+    *token = qmin(numLiterals, 15) << 4;
+    if (numLiterals >= 15) op = LZ_WriteLength(op, numLiterals - 15);
+    memcpy(op, literals, numLiterals);
+    op += numLiterals;
+    if (!match) return op; /* the last sequence */
+
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+    match -= LZ_MINMATCH;
+    *token |= qmin(match, 15);
+    if (match >= 15) op = LZ_WriteLength(op, match - 15);
+
+    return op;
+}
+
+int LZ_Compress(const byte *in, int inlen, byte *out, int outsize) {
+    const byte *base = lz.buffer;
+    byte *op = out;
+    int ip, anchor, end, ref, match;
+    unsigned hash;
+
+    if (inlen > LZ_MAXOFFSET) return 0;
+    if (!lz.initialized) LZ_Init();
+
+    memcpy(lz.buffer + LZ_DICTSIZE, in, inlen);
+    memcpy(lz.table, lz.dictionaryTable, sizeof(lz.table));
+
+    anchor = ip = LZ_DICTSIZE;
+    end = LZ_DICTSIZE + inlen;
+    while (ip + LZ_MINMATCH <= end) {
+        hash = LZ_Hash(base + ip);
+        ref = lz.table[hash];
+        lz.table[hash] = ip;
+        if (ref < 0 || ip - ref > LZ_MAXOFFSET || memcmp(base + ref, base + ip, LZ_MINMATCH)) {
+            ip++;
+            continue;
+        }
+
+        for (match = LZ_MINMATCH; ip + match < end; match++)
+            if (base[ref + match] != base[ip + match]) break;
+
+        if (op - out + LZ_SEQUENCE_SIZE(ip - anchor, match) > outsize) return 0;
+        op = LZ_WriteSequence(op, base + anchor, ip - anchor, ip - ref, match);
+        ip += match;
+        anchor = ip;
+    }
+
+    if (op - out + LZ_SEQUENCE_SIZE(end - anchor, 0) > outsize) return 0;
+    op = LZ_WriteSequence(op, base + anchor, end - anchor, 0, 0);
+
+    return op - out;
+}
+
+static int LZ_ReadLength(const byte **ip, const byte *end, int length) {
+    int more;
+
+    if (length != 15) return length;
+    do {
+        if (*ip == end) return -1;
+        more = *(*ip)++;
+        length += more;
+    } while (more == 255);
+
+    return length;
+}
+
+int LZ_Decompress(const byte *in, int inlen, byte *out, int outsize) {
+    const byte *ip = in;
+    const byte *end = in + inlen;
+    const byte *dictionary = (const byte *)lz_dictionary;
+    int op = 0;
+    int token, literals, match, offset, from;
+
+    while (ip < end) {
+        token = *ip++;
+
+        literals = LZ_ReadLength(&ip, end, token >> 4);
+        if (literals < 0 || literals > end - ip || literals > outsize - op) return -1;
+        memcpy(out + op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) return op;
+
+        if (end - ip < 2) return -1;
+        offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        match = LZ_ReadLength(&ip, end, token & 15);
+        if (match < 0) return -1;
+        match += LZ_MINMATCH;
+        if (!offset || offset > op + LZ_DICTSIZE || match > outsize - op) return -1;
+
+        /* the part still in the dictionary, then from the output itself */
+        from = op - offset;
+        if (from < 0) {
+            literals = qmin(-from, match);
+            memcpy(out + op, dictionary + LZ_DICTSIZE + from, literals);
+            op += literals;
+            from += literals;
+            match -= literals;
+        }
+        for (; match > 0; match--) out[op++] = out[from++];
+    }
+
+    return -1; /* no final sequence */
+}
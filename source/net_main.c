@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "cmd.h"
 #include "console.h"
+#include "mathlib.h"
 #include "net.h"
 #include "quakedef.h"
 #include "server.h"
@@ -49,13 +50,14 @@ static qboolean listening = false;
 qboolean slistInProgress = false;
 qboolean slistSilent = false;
 qboolean slistLocal = true;
-#define IS_LOOP_DRIVER(p) ((p) == &net_drivers[0])
 
 static double slistStartTime;
 static int slistLastShown;
 
 static void Slist_Send(void);
 static void Slist_Poll(void);
+static qboolean NET_BroadcastSocket(qsocket_t *sock);
+static void NET_BroadcastDrop(qsocket_t *sock);
 static PollProcedure slistSendProcedure = {NULL, 0.0, Slist_Send};
 static PollProcedure slistPollProcedure = {NULL, 0.0, Slist_Poll};
 
@@ -126,6 +128,19 @@ qsocket_t *NET_NewQSocket(void) {
     sock->receiveSequence = 0;
     sock->unreliableReceiveSequence = 0;
     sock->receiveMessageLength = 0;
+    sock->windowed = false;
+    sock->window = NET_INITIAL_WINDOW;
+    sock->rtt = -1;
+    sock->rttvar = 0;
+    sock->rto = NET_INITIAL_RTO;
+    sock->retransmits = 0;
+    sock->receiveMask = 0;
+    sock->receiveEOMLength = -1;
+    sock->compress = false;
+    sock->sendCompressed = false;
+    sock->receiveCompressed = false;
+    sock->shared = false;
+    sock->broadcasts = 0;
 
     return sock;
 }
@@ -145,6 +160,8 @@ void NET_FreeQSocket(qsocket_t *sock) {
         if (!s) Sys_Error("%s: not active", __func__);
     }
 
+    NET_BroadcastDrop(sock);
+
     /* add it to free list */
     sock->next = net_freeSockets;
     net_freeSockets = sock;
@@ -420,6 +437,13 @@ void NET_Close(qsocket_t *sock) {
     NET_FreeQSocket(sock);
 }
 
+void NET_Flush(void) {
+    int i;
+
+    for (i = 0; i < net_numdrivers; i++)
+        if (net_drivers[i].initialized && net_drivers[i].Flush) net_drivers[i].Flush();
+}
+
 /*
  * =================
  * NET_GetMessage
@@ -511,6 +535,12 @@ int NET_SendUnreliableMessage(qsocket_t *sock, const sizebuf_t *data) {
     return r;
 }
 
+byte *NET_SendBuffer(qsocket_t *sock, int *size) {
+    if (!sock || sock->disconnected || !sock->driver->SendBuffer) return NULL;
+
+    return sock->driver->SendBuffer(sock, size);
+}
+
 /*
  * ==================
  * NET_CanSendMessage
@@ -528,66 +558,276 @@ qboolean NET_CanSendMessage(qsocket_t *sock) {
 
     SetNetTime();
 
+    if (!NET_BroadcastSocket(sock)) return false;
     r = sock->driver->CanSendMessage(sock);
 
     return r;
 }
 
+/*
+ * ===========================================================================
+ *
+ * Reliable broadcasts
+ *
+ * NET_SendToAll queues the message for every connected client rather than
+ * spinning until they have all acked it. A client's copy goes out as soon
+ * as its reliable channel is free and is then tracked until acked; until
+ * then NET_CanSendMessage stays false for that client, so anything the
+ * server writes afterwards still arrives after the broadcast. Broadcasts
+ * are advanced from NET_Poll and whenever the server asks whether it can
+ * send to a client. The last few are kept for net_broadcasts.
+ *
+ * ===========================================================================
+ */
+
+#define NET_BROADCASTS 4 /* power of two */
+
+typedef enum { bc_queued, bc_sent, bc_acked, bc_failed } bcstate_t;
+
+typedef struct {
+    qsocket_t *sock;
+    char address[NET_NAMELEN];
+    bcstate_t state;
+    double sent, acked; /* seconds after the broadcast was queued */
+} netbroadcastclient_t;
+
+typedef struct {
+    sizebuf_t message;
+    double start;
+    int pending; /* clients neither acked nor failed */
+    int numclients;
+    netbroadcastclient_t clients[MAX_SCOREBOARD];
+} netbroadcast_t;
+
+static netbroadcast_t net_broadcasts[NET_BROADCASTS];
+static int net_numbroadcasts; /* total ever queued */
+
+static void NET_BroadcastFinish(netbroadcast_t *broadcast, netbroadcastclient_t *client,
+                                bcstate_t state) {
+    const netbroadcastclient_t *slowest;
+    int i;
+
+    client->state = state;
+    if (state == bc_acked) client->acked = net_time - broadcast->start;
+    if (--broadcast->pending) return;
+
+    Z_Free(broadcast->message.data);
+    broadcast->message.data = NULL;
+
+    slowest = NULL;
+    for (i = 0; i < broadcast->numclients; i++) {
+        client = &broadcast->clients[i];
+        if (client->state == bc_acked && (!slowest || client->acked > slowest->acked))
+            slowest = client;
+    }
+    if (slowest)
+        Con_DPrintf("Broadcast acked by all clients, slowest %s in %.3fs\n", slowest->address,
+                    slowest->acked);
+}
+
+/*
+ * Moves the socket's broadcasts along, oldest first; returns true once none
+ * of them is waiting to be sent or acked
+ */
+static qboolean NET_BroadcastSocket(qsocket_t *sock) {
+    netbroadcast_t *broadcast;
+    netbroadcastclient_t *client;
+    int i, j;
+
+    if (!sock->broadcasts) return true;
+
+    i = qmax(0, net_numbroadcasts - NET_BROADCASTS);
+    for (; i < net_numbroadcasts; i++) {
+        broadcast = &net_broadcasts[i & (NET_BROADCASTS - 1)];
+        if (!broadcast->pending) continue;
+        for (j = 0; j < broadcast->numclients; j++) {
+            client = &broadcast->clients[j];
+            if (client->sock != sock || client->state > bc_sent) continue;
+            if (!sock->driver->CanSendMessage(sock)) return false;
+            if (client->state == bc_sent) {
+                NET_BroadcastFinish(broadcast, client, bc_acked);
+                sock->broadcasts--;
+                continue;
+            }
+            if (sock->driver->QSendMessage(sock, &broadcast->message) == -1) {
+                NET_BroadcastFinish(broadcast, client, bc_failed);
+                sock->broadcasts--;
+                continue;
+            }
+            messagesSent++;
+            client->state = bc_sent;
+            client->sent = net_time - broadcast->start;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* gives up on whatever the socket still had to deliver */
+static void NET_BroadcastDrop(qsocket_t *sock) {
+    netbroadcast_t *broadcast;
+    netbroadcastclient_t *client;
+    int i, j;
+
+    if (!sock->broadcasts) return;
+
+    for (i = 0; i < NET_BROADCASTS; i++) {
+        broadcast = &net_broadcasts[i];
+        if (!broadcast->pending) continue;
+        for (j = 0; j < broadcast->numclients; j++) {
+            client = &broadcast->clients[j];
+            if (client->sock == sock && client->state <= bc_sent)
+                NET_BroadcastFinish(broadcast, client, bc_failed);
+        }
+    }
+    sock->broadcasts = 0;
+}
+
+static void NET_BroadcastPoll(void) {
+    netbroadcast_t *broadcast;
+    int i, j;
+
+    for (i = 0; i < NET_BROADCASTS; i++) {
+        broadcast = &net_broadcasts[i];
+        if (!broadcast->pending) continue;
+        for (j = 0; j < broadcast->numclients; j++)
+            if (broadcast->clients[j].state <= bc_sent)
+                NET_BroadcastSocket(broadcast->clients[j].sock);
+    }
+}
+
+static void NET_Broadcasts_f(void) {
+    const netbroadcast_t *broadcast;
+    const netbroadcastclient_t *client;
+    static const char *states[] = {"queued", "sent", "acked", "failed"};
+    int i, j;
+
+    if (!net_numbroadcasts) {
+        Con_Printf("No broadcasts sent\n");
+        return;
+    }
+
+    i = qmax(0, net_numbroadcasts - NET_BROADCASTS);
+    for (; i < net_numbroadcasts; i++) {
+        broadcast = &net_broadcasts[i & (NET_BROADCASTS - 1)];
+        Con_Printf("broadcast %d, %d bytes, %.1fs ago, %d pending\n", i, broadcast->message.cursize,
+                   net_time - broadcast->start, broadcast->pending);
+        for (j = 0; j < broadcast->numclients; j++) {
+            client = &broadcast->clients[j];
+            Con_Printf("  %-21s %-6s", client->address, states[client->state]);
+            if (client->state >= bc_sent && client->state != bc_failed)
+                Con_Printf(" sent %.3fs", client->sent);
+            if (client->state == bc_acked) Con_Printf(" acked %.3fs", client->acked);
+            Con_Printf("\n");
+        }
+    }
+}
+
+/*
+ * Waits until a packet arrives on one of the sockets a broadcast is waiting
+ * for, or the timeout passes
+ */
+static void NET_BroadcastWait(double timeout) {
+    qsocket_t *socks[NET_BROADCASTS * MAX_SCOREBOARD];
+    netbroadcast_t *broadcast;
+    netbroadcastclient_t *client;
+    net_driver_t *driver;
+    int i, j, count;
+
+    NET_Flush();
+
+    driver = NULL;
+    count = 0;
+    for (i = 0; i < NET_BROADCASTS; i++) {
+        broadcast = &net_broadcasts[i];
+        if (!broadcast->pending) continue;
+        for (j = 0; j < broadcast->numclients; j++) {
+            client = &broadcast->clients[j];
+            if (client->state > bc_sent || !client->sock->driver->Wait) continue;
+            driver = client->sock->driver;
+            socks[count++] = client->sock;
+        }
+    }
+
+    if (driver) driver->Wait(socks, count, timeout);
+}
+
+/*
+ * ====================
+ * NET_SendToAll
+ *
+ * Queues a reliable message for every connected client, then waits up to
+ * blocktime seconds (sleeping on the sockets in between) for them to ack
+ * it. Returns the number of clients that haven't acked it yet; they go on
+ * receiving it in the background unless their connection is closed.
+ * ====================
+ */
 int NET_SendToAll(const sizebuf_t *data, double blocktime) {
-    client_t *client;
+    netbroadcast_t *broadcast;
+    netbroadcastclient_t *client;
+    client_t *host;
     double start;
     int i, count;
-    qboolean msg_init[MAX_SCOREBOARD]; /* data written */
-    qboolean msg_sent[MAX_SCOREBOARD]; /* send completed */
 
-    count = 0;
-    client = svs.clients;
-    for (i = 0; i < svs.maxclients; i++, client++) {
-        if (!client->netconnection || !client->active) {
-            msg_init[i] = true;
-            msg_sent[i] = true;
-            continue;
+    SetNetTime();
+
+    broadcast = &net_broadcasts[net_numbroadcasts & (NET_BROADCASTS - 1)];
+    if (broadcast->pending) {
+        Con_DPrintf("%s: dropping an unfinished broadcast\n", __func__);
+        for (i = 0; i < broadcast->numclients; i++) {
+            client = &broadcast->clients[i];
+            if (client->state <= bc_sent) {
+                client->sock->broadcasts--;
+                NET_BroadcastFinish(broadcast, client, bc_failed);
+            }
         }
+    }
+    net_numbroadcasts++;
+
+    broadcast->message.data = Z_Malloc(data->cursize);
+    broadcast->message.maxsize = broadcast->message.cursize = data->cursize;
+    memcpy(broadcast->message.data, data->data, data->cursize);
+    broadcast->start = net_time;
+    broadcast->numclients = 0;
+    broadcast->pending = 0;
+
+    host = svs.clients;
+    for (i = 0; i < svs.maxclients; i++, host++) {
+        if (!host->netconnection || !host->active) continue;
         /* Loopback driver guarantees delivery, skip checks */
-        if (IS_LOOP_DRIVER(client->netconnection->driver)) {
-            NET_SendMessage(client->netconnection, data);
-            msg_init[i] = true;
-            msg_sent[i] = true;
+        if (IS_LOOP_DRIVER(host->netconnection->driver)) {
+            NET_SendMessage(host->netconnection, data);
             continue;
         }
-        count++;
-        msg_init[i] = false;
-        msg_sent[i] = false;
+        client = &broadcast->clients[broadcast->numclients++];
+        client->sock = host->netconnection;
+        client->state = bc_queued;
+        client->sent = client->acked = 0;
+        snprintf(client->address, sizeof(client->address), "%s", client->sock->address);
+        client->sock->broadcasts++;
+        broadcast->pending++;
+    }
+    if (!broadcast->pending) {
+        Z_Free(broadcast->message.data);
+        broadcast->message.data = NULL;
+        return 0;
     }
 
     start = Sys_DoubleTime();
-    while (count) {
-        count = 0;
-        client = svs.clients;
-        for (i = 0; i < svs.maxclients; i++, client++) {
-            if (!msg_init[i]) {
-                if (NET_CanSendMessage(client->netconnection)) {
-                    NET_SendMessage(client->netconnection, data);
-                    msg_init[i] = true;
-                } else {
-                    NET_GetMessage(client->netconnection);
-                }
-                count++;
-                continue;
-            }
-
-            if (!msg_sent[i]) {
-                if (NET_CanSendMessage(client->netconnection)) {
-                    msg_sent[i] = true;
-                } else {
-                    NET_GetMessage(client->netconnection);
-                }
-                count++;
-                continue;
-            }
+    while (1) {
+        SetNetTime();
+        for (i = 0; i < broadcast->numclients; i++) {
+            client = &broadcast->clients[i];
+            if (client->state > bc_sent) continue;
+            /* read acks; the message itself is dropped as in the old loop */
+            if (!NET_BroadcastSocket(client->sock)) NET_GetMessage(client->sock);
         }
-        if ((Sys_DoubleTime() - start) > blocktime) break;
+        count = broadcast->pending;
+        if (!count || net_time - start >= blocktime) break;
+        NET_BroadcastWait(qmin(blocktime - (net_time - start), 0.05));
     }
+    NET_Flush();
 
     return count;
 }
@@ -636,6 +876,7 @@ void NET_Init(void) {
     Cmd_AddCommand("listen", NET_Listen_f);
     Cmd_AddCommand("maxplayers", MaxPlayers_f);
     Cmd_AddCommand("port", NET_Port_f);
+    Cmd_AddCommand("net_broadcasts", NET_Broadcasts_f);
 
     /* initialize all the drivers */
     num_inited = 0;
@@ -686,6 +927,8 @@ void NET_Poll(void) {
 
     SetNetTime();
 
+    NET_BroadcastPoll();
+
     /*
      * FIXME - A procedure could schedule itself to the head of the list, but
      *         wouldn't be executed until next frame/tic; problem?
@@ -0,0 +1,637 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_sim.c -- network condition simulator for the datagram driver
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmd.h"
+#include "common.h"
+#include "console.h"
+#include "cvar.h"
+#include "net_sim.h"
+#include "quakedef.h"
+#include "sys.h"
+
+/*
+ * ===========================================================================
+ *
+ * Network condition simulator
+ *
+ * Sits between the datagram driver and a lan driver, in place of the lan
+ * driver's Read and Write. Every packet in either direction can be held
+ * back by net_sim_latency (milliseconds, each way) give or take
+ * net_sim_jitter, lost (net_sim_loss percent), sent twice
+ * (net_sim_duplicate percent) or held back past later packets
+ * (net_sim_reorder percent). Otherwise packets keep their order, however
+ * large the jitter. Run the client and server on one machine with the
+ * settings on either side; the round trip gains both directions' delay.
+ *
+ * What happens to each packet can be written to a trace, one line per
+ * packet:
+ *
+ *     <seconds> <in|out> <bytes> <delay msec|drop> [<duplicate delay msec>]
+ *
+ * and a trace replayed in place of the random settings, each direction
+ * taking the trace's lines for that direction in turn, from the top again
+ * when they run out. The same conditions can then be run against two
+ * builds, and traces can be made by hand or from a capture of a real link.
+ *
+ * With everything off and nothing held back, packets go straight through.
+ *
+ * ===========================================================================
+ */
+
+#define SIM_PACKETS 512
+#define SIM_PACKETSIZE 1500       /* larger than any datagram we send */
+#define SIM_REORDER_DELAY 0.02    /* seconds, on top of the jitter */
+
+enum { SIM_IN, SIM_OUT };
+
+typedef struct {
+    int next; /* next due in the queue or the free list, -1 for none */
+    int dir;
+    double time; /* when it is delivered */
+    int socket;
+    int length;
+    netadr_t addr;
+    byte data[SIM_PACKETSIZE];
+} simpacket_t;
+
+typedef struct {
+    float delay; /* seconds, negative for a drop */
+    float duplicate; /* seconds, negative for none */
+} simfate_t;
+
+typedef struct {
+    simfate_t *fates;
+    int count, size, next;
+} simtrace_t;
+
+cvar_t net_sim_latency = {"net_sim_latency", "0"};
+cvar_t net_sim_jitter = {"net_sim_jitter", "0"};
+cvar_t net_sim_loss = {"net_sim_loss", "0"};
+cvar_t net_sim_duplicate = {"net_sim_duplicate", "0"};
+cvar_t net_sim_reorder = {"net_sim_reorder", "0"};
+
+static struct {
+    net_landriver_t *driver; /* the one wrapped, NULL for none */
+    net_landriver_t real;    /* its own functions */
+
+    simpacket_t packets[SIM_PACKETS];
+    int queue; /* by delivery time */
+    int free;
+    double lastTime[2]; /* latest delivery per direction, to keep order */
+    uint32_t random;    /* Sim_Random state */
+
+    FILE *record;
+    double recordStart;
+    simtrace_t replay[2];
+
+    /* statistics, per direction */
+    unsigned total[2], dropped[2], duplicated[2], reordered[2], overflows[2];
+    double delay[2];
+} sim;
+
+static const char *sim_dirnames[2] = {"in", "out"};
+
+static void Sim_ResetQueue(void) {
+    int i;
+
+    for (i = 0; i < SIM_PACKETS; i++) sim.packets[i].next = i + 1;
+    sim.packets[SIM_PACKETS - 1].next = -1;
+    sim.free = 0;
+    sim.queue = -1;
+    sim.lastTime[SIM_IN] = sim.lastTime[SIM_OUT] = 0;
+}
+
+static qboolean Sim_Enabled(void) {
+    return net_sim_latency.value || net_sim_jitter.value || net_sim_loss.value ||
+           net_sim_duplicate.value || net_sim_reorder.value || sim.replay[SIM_IN].count ||
+           sim.replay[SIM_OUT].count || sim.record;
+}
+
+/* true if packets must go through the queue */
+static qboolean Sim_Busy(void) { return sim.queue != -1 || Sim_Enabled(); }
+
+static float Sim_Random(void) {
+    /* xorshift, so the game's rand() sequence is left alone */
+    sim.random ^= sim.random << 13;
+    sim.random ^= sim.random >> 17;
+    sim.random ^= sim.random << 5;
+    return (sim.random & 0xffffff) / (float)0x1000000;
+}
+
+/*
+====================
+Sim_Fate
+
+Decides what happens to a packet: fills in up to two delivery delays and
+returns how many copies are delivered.
+====================
+*/
+static int Sim_Fate(int dir, int length, double now, double delays[2]) {
+    simtrace_t *trace = &sim.replay[dir];
+    const simfate_t *fate;
+    float jitter;
+    int count;
+
+    if (trace->count) {
+        fate = &trace->fates[trace->next];
+        trace->next = (trace->next + 1) % trace->count;
+        count = 0;
+        if (fate->delay >= 0) delays[count++] = fate->delay;
+        if (fate->duplicate >= 0) delays[count++] = fate->duplicate;
+    } else {
+        count = 0;
+        jitter = qmax(net_sim_jitter.value, 0.0f) / 1000.0;
+        if (Sim_Random() * 100 >= net_sim_loss.value) {
+            delays[0] = net_sim_latency.value / 1000.0 + (Sim_Random() * 2 - 1) * jitter;
+            delays[0] = qmax(delays[0], 0.0);
+            if (Sim_Random() * 100 < net_sim_reorder.value) {
+                /* held back without holding up the packets after it */
+                delays[0] += SIM_REORDER_DELAY + jitter;
+                sim.reordered[dir]++;
+            } else {
+                delays[0] = qmax(delays[0], sim.lastTime[dir] - now);
+                sim.lastTime[dir] = now + delays[0];
+            }
+            count = 1;
+            if (Sim_Random() * 100 < net_sim_duplicate.value)
+                delays[count++] = delays[0] + Sim_Random() * jitter;
+        }
+    }
+
+    sim.total[dir]++;
+    if (!count) sim.dropped[dir]++;
+    if (count > 1) sim.duplicated[dir]++;
+    if (count) sim.delay[dir] += delays[0];
+
+    if (sim.record) {
+        fprintf(sim.record, "%.4f %s %d ", now - sim.recordStart, sim_dirnames[dir], length);
+        if (!count)
+            fprintf(sim.record, "drop\n");
+        else if (count == 1)
+            fprintf(sim.record, "%.1f\n", delays[0] * 1000.0);
+        else
+            fprintf(sim.record, "%.1f %.1f\n", delays[0] * 1000.0, delays[1] * 1000.0);
+    }
+
+    return count;
+}
+
+static void Sim_Enqueue(int dir, int socket, const void *data, int length, const netadr_t *addr,
+                        double time) {
+    simpacket_t *packet;
+    int index, *link;
+
+    if (sim.free == -1) {
+        sim.overflows[dir]++;
+        return;
+    }
+    index = sim.free;
+    packet = &sim.packets[index];
+    sim.free = packet->next;
+
+    packet->dir = dir;
+    packet->time = time;
+    packet->socket = socket;
+    packet->length = length;
+    packet->addr = *addr;
+    memcpy(packet->data, data, length);
+
+    /* after anything due at the same time, so equal delays keep their order */
+    for (link = &sim.queue; *link != -1; link = &sim.packets[*link].next)
+        if (sim.packets[*link].time > time) break;
+    packet->next = *link;
+    *link = index;
+}
+
+static void Sim_Impair(int dir, int socket, const void *data, int length,
+                       const netadr_t *addr) {
+    double now = Sys_DoubleTime();
+    double delays[2];
+    int i, count;
+
+    count = Sim_Fate(dir, length, now, delays);
+    for (i = 0; i < count; i++) Sim_Enqueue(dir, socket, data, length, addr, now + delays[i]);
+}
+
+/* sends everything outgoing that is due */
+static void Sim_Pump(void) {
+    double now = Sys_DoubleTime();
+    simpacket_t *packet;
+    int index, *link;
+
+    link = &sim.queue;
+    while (*link != -1) {
+        index = *link;
+        packet = &sim.packets[index];
+        if (packet->time > now) break;
+        if (packet->dir != SIM_OUT) {
+            link = &packet->next;
+            continue;
+        }
+        sim.real.Write(packet->socket, packet->data, packet->length, &packet->addr);
+        *link = packet->next;
+        packet->next = sim.free;
+        sim.free = index;
+    }
+}
+
+/* moves whatever has arrived on the socket into the queue */
+static int Sim_Receive(int socket) {
+    byte buf[SIM_PACKETSIZE];
+    netadr_t addr;
+    int length;
+
+    while (sim.free != -1) {
+        length = sim.real.Read(socket, buf, sizeof(buf), &addr);
+        if (length <= 0) return length;
+        Sim_Impair(SIM_IN, socket, buf, length, &addr);
+    }
+
+    return 0;
+}
+
+/* the first incoming packet due on the socket, by its link, or NULL */
+static int *Sim_Due(int socket, double now) {
+    int *link;
+
+    for (link = &sim.queue; *link != -1; link = &sim.packets[*link].next) {
+        if (sim.packets[*link].time > now) break;
+        if (sim.packets[*link].dir == SIM_IN && sim.packets[*link].socket == socket) return link;
+    }
+
+    return NULL;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Lan driver functions
+ * ---------------------------------------------------------------------------
+ */
+
+static int Sim_Read(int socket, void *buf, int len, netadr_t *addr) {
+    simpacket_t *packet;
+    int index, *link;
+    int err;
+
+    if (!Sim_Busy()) return sim.real.Read(socket, buf, len, addr);
+
+    Sim_Pump();
+    err = Sim_Receive(socket);
+    link = Sim_Due(socket, Sys_DoubleTime());
+    if (!link) return err < 0 ? err : 0;
+
+    index = *link;
+    packet = &sim.packets[index];
+    *link = packet->next;
+
+    len = qmin(len, packet->length);
+    memcpy(buf, packet->data, len);
+    *addr = packet->addr;
+
+    packet->next = sim.free;
+    sim.free = index;
+
+    return len;
+}
+
+static int Sim_Write(int socket, const void *buf, int len, const netadr_t *addr) {
+    if (!Sim_Busy() || len > SIM_PACKETSIZE) return sim.real.Write(socket, buf, len, addr);
+
+    Sim_Impair(SIM_OUT, socket, buf, len, addr);
+    Sim_Pump();
+
+    return len;
+}
+
+static int Sim_ReadBatch(int socket, netpacket_t *packets, int count) {
+    int i, length;
+
+    if (!Sim_Busy()) return sim.real.ReadBatch(socket, packets, count);
+
+    for (i = 0; i < count; i++) {
+        length = Sim_Read(socket, packets[i].data, packets[i].length, &packets[i].addr);
+        if (length < 0 && !i) return -1;
+        if (length <= 0) break;
+        packets[i].length = length;
+    }
+
+    return i;
+}
+
+static int Sim_WriteBatch(int socket, const netpacket_t *packets, int count) {
+    int i;
+
+    if (!Sim_Busy()) return sim.real.WriteBatch(socket, packets, count);
+
+    for (i = 0; i < count; i++)
+        Sim_Write(socket, packets[i].data, packets[i].length, &packets[i].addr);
+
+    return count;
+}
+
+static int Sim_Wait(const int *sockets, int count, double timeout) {
+    double now, next;
+    int i, index, ret;
+
+    if (!Sim_Busy()) return sim.real.Wait(sockets, count, timeout);
+
+    /* wake up for whatever in the queue falls due first */
+    Sim_Pump();
+    for (i = 0; i < count; i++) Sim_Receive(sockets[i]);
+    now = Sys_DoubleTime();
+    next = now + timeout;
+    for (index = sim.queue; index != -1; index = sim.packets[index].next) {
+        if (sim.packets[index].dir == SIM_OUT) break;
+        for (i = 0; i < count; i++)
+            if (sim.packets[index].socket == sockets[i]) break;
+        if (i < count) break;
+    }
+    if (index != -1) next = qmin(next, sim.packets[index].time);
+    if (next <= now) return 1;
+
+    ret = sim.real.Wait(sockets, count, next - now);
+    if (ret == 0 && index != -1 && Sys_DoubleTime() >= next) return 1;
+
+    return ret;
+}
+
+static int Sim_CheckNewConnections(void) {
+    int socket;
+
+    if (!Sim_Busy() || !sim.real.ListenSocket) return sim.real.CheckNewConnections();
+
+    socket = sim.real.ListenSocket();
+    if (socket == -1) return -1;
+
+    Sim_Pump();
+    Sim_Receive(socket);
+    return Sim_Due(socket, Sys_DoubleTime()) ? socket : -1;
+}
+
+static int Sim_CloseSocket(int socket) {
+    simpacket_t *packet;
+    int index, *link;
+
+    /* the number may be reused by the next socket opened */
+    link = &sim.queue;
+    while (*link != -1) {
+        index = *link;
+        packet = &sim.packets[index];
+        if (packet->socket != socket) {
+            link = &packet->next;
+            continue;
+        }
+        *link = packet->next;
+        packet->next = sim.free;
+        sim.free = index;
+    }
+
+    return sim.real.CloseSocket(socket);
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ * Commands
+ * ---------------------------------------------------------------------------
+ */
+
+static qboolean Sim_FileName(char *name, int size, const char *arg) {
+    if (strstr(arg, "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return false;
+    }
+    if (snprintf(name, size, "%s/%s", com_gamedir, arg) >= size) {
+        Con_Printf("ERROR: filename too long.\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void Sim_StopRecord(void) {
+    if (!sim.record) return;
+    fclose(sim.record);
+    sim.record = NULL;
+    Con_Printf("Stopped recording the network trace\n");
+}
+
+static void Sim_StopReplay(void) {
+    int dir;
+
+    for (dir = 0; dir < 2; dir++) {
+        free(sim.replay[dir].fates);
+        memset(&sim.replay[dir], 0, sizeof(sim.replay[dir]));
+    }
+}
+
+/*
+====================
+Sim_Record_f
+
+net_simrecord [file] : write what happens to each packet to a trace,
+                       stop recording without a file
+====================
+*/
+static void Sim_Record_f(void) {
+    char name[MAX_OSPATH];
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("net_simrecord [file] : record a network trace\n");
+        return;
+    }
+    Sim_StopRecord();
+    if (Cmd_Argc() == 1) return;
+    if (!Sim_FileName(name, sizeof(name), Cmd_Argv(1))) return;
+
+    sim.record = fopen(name, "w");
+    if (!sim.record) {
+        Con_Printf("ERROR: couldn't open %s\n", name);
+        return;
+    }
+    fprintf(sim.record, "# <seconds> <in|out> <bytes> <delay msec|drop> [<duplicate delay msec>]\n");
+    sim.recordStart = Sys_DoubleTime();
+    Con_Printf("Recording the network trace to %s\n", name);
+}
+
+/*
+====================
+Sim_Replay_f
+
+net_simreplay [file] : impair packets as in a recorded trace instead of by
+                       the net_sim cvars, stop replaying without a file
+====================
+*/
+static void Sim_Replay_f(void) {
+    char name[MAX_OSPATH], line[256], dirname[8], delay[32];
+    simtrace_t *trace;
+    simfate_t *fate;
+    FILE *f;
+    float duplicate;
+    int fields, dir, lines;
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("net_simreplay [file] : replay a network trace\n");
+        return;
+    }
+    Sim_StopReplay();
+    if (Cmd_Argc() == 1) return;
+    if (!Sim_FileName(name, sizeof(name), Cmd_Argv(1))) return;
+
+    f = fopen(name, "r");
+    if (!f) {
+        Con_Printf("ERROR: couldn't open %s\n", name);
+        return;
+    }
+
+    lines = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lines++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        duplicate = -1;
+        fields = sscanf(line, "%*f %7s %*d %31s %f", dirname, delay, &duplicate);
+        if (fields < 2) {
+            Con_Printf("%s:%d: bad trace line\n", name, lines);
+            continue;
+        }
+        dir = !strcmp(dirname, "out") ? SIM_OUT : SIM_IN;
+
+        trace = &sim.replay[dir];
+        if (trace->count == trace->size) {
+            fate = realloc(trace->fates, (trace->size * 2 + 256) * sizeof(*fate));
+            if (!fate) break;
+            trace->fates = fate;
+            trace->size = trace->size * 2 + 256;
+        }
+        fate = &trace->fates[trace->count++];
+        fate->delay = strcmp(delay, "drop") ? Q_atof(delay) / 1000.0 : -1;
+        fate->duplicate = fields > 2 ? duplicate / 1000.0 : -1;
+    }
+    fclose(f);
+
+    Con_Printf("Replaying %d incoming and %d outgoing packets from %s\n",
+               sim.replay[SIM_IN].count, sim.replay[SIM_OUT].count, name);
+}
+
+/*
+====================
+Sim_Stats_f
+
+net_simstats [reset]
+====================
+*/
+static void Sim_Stats_f(void) {
+    int dir;
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "reset")) {
+        memset(sim.total, 0, sizeof(sim.total));
+        memset(sim.dropped, 0, sizeof(sim.dropped));
+        memset(sim.duplicated, 0, sizeof(sim.duplicated));
+        memset(sim.reordered, 0, sizeof(sim.reordered));
+        memset(sim.overflows, 0, sizeof(sim.overflows));
+        memset(sim.delay, 0, sizeof(sim.delay));
+        return;
+    }
+
+    if (!sim.driver) {
+        Con_Printf("Network simulator not running\n");
+        return;
+    }
+
+    Con_Printf("%s simulator: %s%s%s\n", sim.driver->name,
+               Sim_Enabled() ? "on" : "off", sim.record ? ", recording" : "",
+               sim.replay[SIM_IN].count || sim.replay[SIM_OUT].count ? ", replaying" : "");
+    for (dir = 0; dir < 2; dir++) {
+        Con_Printf("%-3s %8u packets %6u dropped %6u duplicated %6u reordered %6u overflows\n",
+                   sim_dirnames[dir], sim.total[dir], sim.dropped[dir], sim.duplicated[dir],
+                   sim.reordered[dir], sim.overflows[dir]);
+        Con_Printf("    %.1f msec average delay\n",
+                   sim.total[dir] > sim.dropped[dir]
+                       ? sim.delay[dir] * 1000.0 / (sim.total[dir] - sim.dropped[dir])
+                       : 0.0);
+    }
+}
+
+/*
+====================
+Sim_Init
+====================
+*/
+void Sim_Init(void) {
+    Cvar_RegisterVariable(&net_sim_latency);
+    Cvar_RegisterVariable(&net_sim_jitter);
+    Cvar_RegisterVariable(&net_sim_loss);
+    Cvar_RegisterVariable(&net_sim_duplicate);
+    Cvar_RegisterVariable(&net_sim_reorder);
+
+    Cmd_AddCommand("net_simrecord", Sim_Record_f);
+    Cmd_AddCommand("net_simreplay", Sim_Replay_f);
+    Cmd_AddCommand("net_simstats", Sim_Stats_f);
+
+    sim.random = 0x2545f491;
+    Sim_ResetQueue();
+}
+
+/*
+====================
+Sim_Wrap
+
+Puts the simulator in front of a lan driver's reads and writes. Only one
+lan driver can be wrapped.
+====================
+*/
+void Sim_Wrap(net_landriver_t *driver) {
+    if (sim.driver || !driver->Read || !driver->Write) return;
+
+    sim.driver = driver;
+    sim.real = *driver;
+
+    driver->Read = Sim_Read;
+    driver->Write = Sim_Write;
+    driver->CloseSocket = Sim_CloseSocket;
+    driver->CheckNewConnections = Sim_CheckNewConnections;
+    if (driver->ReadBatch) driver->ReadBatch = Sim_ReadBatch;
+    if (driver->WriteBatch) driver->WriteBatch = Sim_WriteBatch;
+    if (driver->Wait) driver->Wait = Sim_Wait;
+}
+
+void Sim_Shutdown(void) {
+    if (!sim.driver) return;
+
+    Sim_StopRecord();
+    Sim_StopReplay();
+
+    sim.driver->Read = sim.real.Read;
+    sim.driver->Write = sim.real.Write;
+    sim.driver->CloseSocket = sim.real.CloseSocket;
+    sim.driver->CheckNewConnections = sim.real.CheckNewConnections;
+    sim.driver->ReadBatch = sim.real.ReadBatch;
+    sim.driver->WriteBatch = sim.real.WriteBatch;
+    sim.driver->Wait = sim.real.Wait;
+    sim.driver = NULL;
+
+    Sim_ResetQueue();
+}
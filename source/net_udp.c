@@ -18,11 +18,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE /* recvmmsg, sendmmsg */
+#endif
+
 #include <arpa/inet.h>
 #include <errno.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/param.h>
 #include <sys/socket.h>
@@ -31,6 +36,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "common.h"
 #include "console.h"
+#include "mathlib.h"
 #include "net.h"
 #include "net_udp.h"
 #include "quakedef.h"
@@ -251,6 +257,113 @@ int UDP_Read(int socket, void *buf, int len, netadr_t *addr) {
     return ret;
 }
 
+int UDP_ListenSocket(void) { return net_acceptsocket; }
+
+/*
+ * Batched reads and writes for the server's shared socket. Where the system
+ * has no recvmmsg/sendmmsg these fall back to one call per packet, which
+ * still saves polling every client socket separately.
+ */
+#ifdef __linux__
+#define UDP_BATCH 64
+
+int UDP_ReadBatch(int socket, netpacket_t *packets, int count) {
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    struct sockaddr_in saddr[UDP_BATCH];
+    int i, ret;
+
+    count = qmin(count, UDP_BATCH);
+    memset(msgs, 0, count * sizeof(msgs[0]));
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = packets[i].data;
+        iov[i].iov_len = packets[i].length;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &saddr[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(saddr[i]);
+    }
+
+    ret = recvmmsg(socket, msgs, count, MSG_DONTWAIT, NULL);
+    if (ret == -1) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN || errno == ECONNREFUSED) return 0;
+        return -1;
+    }
+    for (i = 0; i < ret; i++) {
+        /* truncated packets can't be valid, make them look short */
+        packets[i].length = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgs[i].msg_len;
+        SockadrToNetadr(&saddr[i], &packets[i].addr);
+    }
+
+    return ret;
+}
+
+int UDP_WriteBatch(int socket, const netpacket_t *packets, int count) {
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    struct sockaddr_in saddr[UDP_BATCH];
+    int i, batch, ret, sent;
+
+    for (sent = 0; sent < count; sent += ret) {
+        batch = qmin(count - sent, UDP_BATCH);
+        memset(msgs, 0, batch * sizeof(msgs[0]));
+        for (i = 0; i < batch; i++) {
+            iov[i].iov_base = packets[sent + i].data;
+            iov[i].iov_len = packets[sent + i].length;
+            NetadrToSockadr(&packets[sent + i].addr, &saddr[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &saddr[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(saddr[i]);
+        }
+        ret = sendmmsg(socket, msgs, batch, 0);
+        if (ret == -1) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN) return sent;
+            return -1;
+        }
+    }
+
+    return sent;
+}
+#else
+int UDP_ReadBatch(int socket, netpacket_t *packets, int count) {
+    int i, ret;
+
+    for (i = 0; i < count; i++) {
+        ret = UDP_Read(socket, packets[i].data, packets[i].length, &packets[i].addr);
+        if (ret == -1 && !i) return -1;
+        if (ret <= 0) break;
+        packets[i].length = ret;
+    }
+
+    return i;
+}
+
+int UDP_WriteBatch(int socket, const netpacket_t *packets, int count) {
+    int i;
+
+    for (i = 0; i < count; i++)
+        if (UDP_Write(socket, packets[i].data, packets[i].length, &packets[i].addr) == -1)
+            return i ? i : -1;
+
+    return count;
+}
+#endif
+
+int UDP_Wait(const int *sockets, int count, double timeout) {
+    struct pollfd fds[MAX_SCOREBOARD];
+    int i;
+
+    count = qmin(count, MAX_SCOREBOARD);
+    for (i = 0; i < count; i++) {
+        fds[i].fd = sockets[i];
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    return poll(fds, count, (int)(timeout * 1000));
+}
+
 static int UDP_MakeSocketBroadcastCapable(int socket) {
     int i = 1;
 
@@ -884,26 +884,69 @@ Returns a chain of entities that have origins within a spherical area
 findradius (origin, radius)
 =================
 */
+    static qboolean PF_InRadius(const edict_t *ent, const vec3_t org, float rad) {
+        vec3_t eorg;
+        int j;
+
+        if (ent->free) return false;
+        if (ent->v.solid == SOLID_NOT) return false;
+        for (j = 0; j < 3; j++)
+            eorg[j] = org[j] - (ent->v.origin[j] + (ent->v.mins[j] + ent->v.maxs[j]) * 0.5);
+
+        return Length(eorg) <= rad;
+    }
+
+    static int PF_CompareEdicts(const void *a, const void *b) {
+        const edict_t *ea = *(const edict_t **)a;
+        const edict_t *eb = *(const edict_t **)b;
+
+        return (ea > eb) - (ea < eb);
+    }
+
     static void PF_findradius(void) {
+        static edict_t *touched[MAX_EDICTS];
         edict_t *ent, *chain;
         float rad;
         float *org;
-        vec3_t eorg;
-        int i, j;
+        vec3_t mins, maxs;
+        int i, count;
 
         chain = (edict_t *)sv.edicts;
 
         org = G_VECTOR(OFS_PARM0);
         rad = G_FLOAT(OFS_PARM1);
+        ed_searchstats.findradius++;
+
+        if (!sv_fastfindradius.value) {
+            ent = NEXT_EDICT(sv.edicts);
+            for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent)) {
+                ed_searchstats.findradius_tested++;
+                if (!PF_InRadius(ent, org, rad)) continue;
+                ent->v.chain = EDICT_TO_PROG(chain);
+                chain = ent;
+            }
+            RETURN_EDICT(chain);
+            return;
+        }
 
-        ent = NEXT_EDICT(sv.edicts);
-        for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent)) {
-            if (ent->free) continue;
-            if (ent->v.solid == SOLID_NOT) continue;
-            for (j = 0; j < 3; j++)
-                eorg[j] = org[j] - (ent->v.origin[j] + (ent->v.mins[j] + ent->v.maxs[j]) * 0.5);
-            if (Length(eorg) > rad) continue;
+        /*
+         * Only exact if every edict findradius can return is linked into the
+         * area tree with an up to date abs box around its center: progs that
+         * never link an edict, or move it by assigning .origin without
+         * setorigin, lose it from the results. So this stays opt-in. Sort the
+         * candidates so the chain comes out in the same order as the scan.
+         */
+        for (i = 0; i < 3; i++) {
+            mins[i] = org[i] - rad;
+            maxs[i] = org[i] + rad;
+        }
+        count = SV_AreaEdicts(mins, maxs, touched, MAX_EDICTS);
+        qsort(touched, count, sizeof(touched[0]), PF_CompareEdicts);
+        ed_searchstats.findradius_tested += count;
 
+        for (i = 0; i < count; i++) {
+            ent = touched[i];
+            if (!PF_InRadius(ent, org, rad)) continue;
             ent->v.chain = EDICT_TO_PROG(chain);
             chain = ent;
         }
@@ -920,6 +963,9 @@ PF_dprint
 
     static char pr_string_temp[128];
 
+    /* ftos and vtos results are overwritten by the next call */
+    qboolean PF_IsTempString(const char *s) { return s == pr_string_temp; }
+
     static void PF_ftos(void) {
         float v;
 
@@ -961,7 +1007,7 @@ PF_dprint
 
     // entity (entity start, .string field, string match) find = #5;
     static void PF_Find(void) {
-        int e;
+        int e, i;
         int f;
         const char *s, *t;
         edict_t *ed;
@@ -971,9 +1017,17 @@ PF_dprint
         s = G_STRING(OFS_PARM2);
         if (!s) PR_RunError("%s: bad search string", __func__);
 
+        ed_searchstats.find++;
+        i = ED_FindIndexed(e, f, s);
+        if (i >= 0) {
+            RETURN_EDICT(EDICT_NUM(i));
+            return;
+        }
+
         for (e++; e < sv.num_edicts; e++) {
             ed = EDICT_NUM(e);
             if (ed->free) continue;
+            ed_searchstats.find_tested++;
             t = E_STRING(ed, f);
             if (!t) continue;
             if (!strcmp(t, s)) {
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "console.h"
 #include "crc.h"
 #include "pr_comp.h"
+#include "pr_native.h"
 #include "progdefs.h"
 #include "progs.h"
 #include "server.h"
@@ -99,6 +100,224 @@ func_t SpectatorThink;
 func_t SpectatorDisconnect;
 #endif
 
+/*
+ * Edict bookkeeping that lets ED_Alloc and PF_Find avoid walking the whole
+ * edict array. Freed edicts are queued in the order they were freed, so the
+ * head of the queue is always the first one to come out of the reuse delay.
+ * The find index chains edicts by a hash of a string field, in edict order,
+ * and is kept current by everything that stores to those fields.
+ */
+#ifdef NQ_HACK
+#define ED_FIRSTFREE (svs.maxclients + 1)
+#endif
+#if defined(QW_HACK) && defined(SERVERONLY)
+#define ED_FIRSTFREE (MAX_CLIENTS + 1)
+#endif
+
+#define ED_FINDHASH 256
+#define ED_FINDTEMP ED_FINDHASH /* chain for fields holding a temp string */
+
+typedef struct {
+    int field;               /* entvars offset, in ints */
+    int head[ED_FINDHASH + 1]; /* -1 terminated, in ascending edict order */
+    int next[MAX_EDICTS];
+    short bucket[MAX_EDICTS]; /* -1 if not in the index */
+} edfindindex_t;
+
+static edfindindex_t ed_findindex[] = {
+    {offsetof(entvars_t, classname) / 4},
+    {offsetof(entvars_t, targetname) / 4},
+};
+
+static struct {
+    int queue[MAX_EDICTS];
+    int head, count;
+    qboolean queued[MAX_EDICTS];
+} ed_freelist;
+
+cvar_t sv_fastfind = {"sv_fastfind", "1"};
+cvar_t sv_fastfindradius = {"sv_fastfindradius", "0"};
+edsearchstats_t ed_searchstats;
+
+static inline qboolean ED_CanReuse(const edict_t *e) {
+    // the first couple seconds of server time can involve a lot of
+    // freeing and allocating, so relax the replacement policy
+    return e->freetime < 2 || sv.time - e->freetime > 0.5;
+}
+
+static void ED_QueueFree(int num) {
+    if (num < ED_FIRSTFREE || ed_freelist.queued[num]) return;
+
+    ed_freelist.queue[(ed_freelist.head + ed_freelist.count) % MAX_EDICTS] = num;
+    ed_freelist.count++;
+    ed_freelist.queued[num] = true;
+}
+
+/*
+ * Returns the oldest free edict if it is past the reuse delay, else NULL
+ */
+static edict_t *ED_PopFree(void) {
+    edict_t *e;
+    int num;
+
+    while (ed_freelist.count) {
+        num = ed_freelist.queue[ed_freelist.head];
+        e = EDICT_NUM(num);
+        if (e->free && !ED_CanReuse(e)) break;
+
+        ed_freelist.head = (ed_freelist.head + 1) % MAX_EDICTS;
+        ed_freelist.count--;
+        ed_freelist.queued[num] = false;
+
+        /* skip edicts that were brought back without ED_Alloc */
+        if (e->free && num < sv.num_edicts) return e;
+    }
+
+    return NULL;
+}
+
+static inline int ED_FindHash(const char *s) {
+    unsigned hash = 0;
+
+    while (*s) hash = hash * 31 + (byte)*s++;
+
+    return hash & (ED_FINDHASH - 1);
+}
+
+static void ED_UpdateIndex(edfindindex_t *index, const edict_t *e) {
+    const char *s;
+    int num, bucket, *link;
+
+    num = NUM_FOR_EDICT(e);
+    s = E_STRING(e, index->field);
+    /* a temp string's text changes without a store to the field */
+    if (PF_IsTempString(s))
+        bucket = ED_FINDTEMP;
+    else
+        bucket = s[0] ? ED_FindHash(s) : -1;
+    if (bucket == index->bucket[num]) return;
+
+    if (index->bucket[num] >= 0) {
+        link = &index->head[index->bucket[num]];
+        while (*link != num) link = &index->next[*link];
+        *link = index->next[num];
+    }
+
+    index->bucket[num] = bucket;
+    if (bucket < 0) return;
+
+    link = &index->head[bucket];
+    while (*link >= 0 && *link < num) link = &index->next[*link];
+    index->next[num] = *link;
+    *link = num;
+}
+
+static void ED_UpdateIndexes(const edict_t *e) {
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(ed_findindex); i++) ED_UpdateIndex(&ed_findindex[i], e);
+}
+
+/*
+=================
+ED_StringFieldStored
+
+Called by the interpreter after a string is stored through an entity field
+pointer, ofs being the byte offset from sv.edicts
+=================
+*/
+void ED_StringFieldStored(int ofs) {
+    int num, field, i;
+
+    num = ofs / pr_edict_size;
+    field = (ofs - num * pr_edict_size - (int)offsetof(edict_t, v)) / 4;
+    for (i = 0; i < ARRAY_SIZE(ed_findindex); i++)
+        if (ed_findindex[i].field == field) ED_UpdateIndex(&ed_findindex[i], EDICT_NUM(num));
+}
+
+/*
+=================
+ED_SetString
+
+Stores a string in a field of an edict from engine code, keeping the find index
+up to date as a store from QuakeC would
+=================
+*/
+void ED_SetString(string_t *field, const char *s) {
+    *field = PR_SetString(s);
+    ED_StringFieldStored((byte *)field - (byte *)sv.edicts);
+}
+
+/*
+ * First edict after start on the chain whose field matches, or zero
+ */
+static int ED_FindInChain(const edfindindex_t *index, int num, int start, const char *s) {
+    const edict_t *e;
+
+    for (; num >= 0; num = index->next[num]) {
+        if (num <= start) continue;
+        if (num >= sv.num_edicts) break;
+        e = EDICT_NUM(num);
+        if (e->free) continue;
+        ed_searchstats.find_tested++;
+        if (!strcmp(E_STRING(e, index->field), s)) return num;
+    }
+
+    return 0;
+}
+
+/*
+=================
+ED_FindIndexed
+
+Returns the number of the first edict after start whose string field matches,
+zero if there is none, or -1 if the field isn't indexed
+=================
+*/
+int ED_FindIndexed(int start, int field, const char *s) {
+    const edfindindex_t *index;
+    int i, num, temp;
+
+    if (!sv_fastfind.value || !s[0]) return -1;
+
+    for (i = 0; i < ARRAY_SIZE(ed_findindex); i++)
+        if (ed_findindex[i].field == field) break;
+    if (i == ARRAY_SIZE(ed_findindex)) return -1;
+
+    index = &ed_findindex[i];
+    ed_searchstats.find_indexed++;
+    num = ED_FindInChain(index, index->head[ED_FindHash(s)], start, s);
+    temp = ED_FindInChain(index, index->head[ED_FINDTEMP], start, s);
+    if (temp && (!num || temp < num)) num = temp;
+
+    return num;
+}
+
+/*
+=================
+ED_ResetLists
+
+Rebuild the free queue and find index from scratch, for when the edicts have
+been set up without going through ED_Alloc (new map or savegame)
+=================
+*/
+void ED_ResetLists(void) {
+    edfindindex_t *index;
+    int i, num;
+
+    memset(&ed_freelist, 0, sizeof(ed_freelist));
+    for (i = 0; i < ARRAY_SIZE(ed_findindex); i++) {
+        index = &ed_findindex[i];
+        memset(index->head, 0xff, sizeof(index->head));
+        memset(index->bucket, 0xff, sizeof(index->bucket));
+    }
+
+    for (num = 0; num < sv.num_edicts; num++) {
+        ED_UpdateIndexes(EDICT_NUM(num));
+        if (EDICT_NUM(num)->free) ED_QueueFree(num);
+    }
+}
+
 /*
 =================
 ED_ClearEdict
@@ -109,6 +328,7 @@ Sets everything to NULL
 static void ED_ClearEdict(edict_t *e) {
     memset(&e->v, 0, progs->entityfields * 4);
     e->free = false;
+    ED_UpdateIndexes(e);
 }
 
 /*
@@ -126,40 +346,49 @@ edict_t *ED_Alloc(void) {
     int i;
     edict_t *e;
 
-#ifdef NQ_HACK
-    for (i = svs.maxclients + 1; i < sv.num_edicts; i++) {
-#endif
-#if defined(QW_HACK) && defined(SERVERONLY)
-        for (i = MAX_CLIENTS + 1; i < sv.num_edicts; i++) {
-#endif
+    e = ED_PopFree();
+    if (e) {
+        ed_searchstats.alloc_reused++;
+        ED_ClearEdict(e);
+        return e;
+    }
+
+    /*
+     * An edict freed twice keeps its old place in the queue and may be
+     * holding up the ones behind it, so do a full scan before giving up.
+     */
+    if (sv.num_edicts == MAX_EDICTS) {
+        for (i = ED_FIRSTFREE; i < sv.num_edicts; i++) {
             e = EDICT_NUM(i);
-            // the first couple seconds of server time can involve a lot of
-            // freeing and allocating, so relax the replacement policy
-            if (e->free && (e->freetime < 2 || sv.time - e->freetime > 0.5)) {
+            if (e->free && ED_CanReuse(e)) {
                 ED_ClearEdict(e);
                 return e;
             }
         }
+    }
+
+    i = sv.num_edicts;
+    ed_searchstats.alloc_new++;
 
 #ifdef NQ_HACK
-        if (i == MAX_EDICTS) SV_Error("%s: no free edicts", __func__);
-        sv.num_edicts++;
+    if (i == MAX_EDICTS) SV_Error("%s: no free edicts", __func__);
+    sv.num_edicts++;
 #endif
 #if defined(QW_HACK) && defined(SERVERONLY)
-        if (i == MAX_EDICTS) {
-            Con_Printf("WARNING: ED_Alloc: no free edicts\n");
-            i--;  // step on whatever is the last edict
-            e = EDICT_NUM(i);
-            SV_UnlinkEdict(e);
-        } else
-            sv.num_edicts++;
+    if (i == MAX_EDICTS) {
+        Con_Printf("WARNING: ED_Alloc: no free edicts\n");
+        i--;  // step on whatever is the last edict
+        e = EDICT_NUM(i);
+        SV_UnlinkEdict(e);
+    } else
+        sv.num_edicts++;
 #endif
 
-        e = EDICT_NUM(i);
-        ED_ClearEdict(e);
+    e = EDICT_NUM(i);
+    ED_ClearEdict(e);
 
-        return e;
-    }
+    return e;
+}
 
     /*
 =================
@@ -185,6 +414,7 @@ FIXME: walk all entities and NULL out references to this entity
         ed->v.solid = 0;
 
         ed->freetime = sv.time;
+        ED_QueueFree(NUM_FOR_EDICT(ed));
     }
 
     //===========================================================================
@@ -852,6 +1082,7 @@ Used for initial level load and for savegames.
         }
 
         if (!init) ent->free = true;
+        ED_UpdateIndexes(ent);
 
         return data;
     }
@@ -947,7 +1178,7 @@ PR_LoadProgs
 ===============
 */
     void PR_LoadProgs(void) {
-        int i;
+        int i, crc;
 #if defined(QW_HACK) && defined(SERVERONLY)
         char num[32];
         dfunction_t *f;
@@ -966,12 +1197,13 @@ PR_LoadProgs
         if (!progs) SV_Error("%s: couldn't load progs.dat", __func__);
         Con_DPrintf("Programs occupy %iK.\n", com_filesize / 1024);
 
+        crc = CRC_Block((byte *)progs, com_filesize);
 #ifdef NQ_HACK
-        pr_crc = CRC_Block((byte *)progs, com_filesize);
+        pr_crc = crc;
 #endif
 #if defined(QW_HACK) && defined(SERVERONLY)
         // add prog crc to the serverinfo
-        sprintf(num, "%i", CRC_Block((byte *)progs, com_filesize));
+        sprintf(num, "%i", crc);
         Info_SetValueForStarKey(svs.info, "*progs", num, MAX_SERVERINFO_STRING);
 #endif
 
@@ -992,6 +1224,7 @@ PR_LoadProgs
 #endif
 
         pr_functions = (dfunction_t *)((byte *)progs + progs->ofs_functions);
+        PR_ProfReset();
         pr_strings = (char *)progs + progs->ofs_strings;
         pr_strings_size = progs->strings_size;
         if (progs->ofs_strings + pr_strings_size >= com_filesize)
@@ -1046,6 +1279,8 @@ PR_LoadProgs
         for (i = 0; i < progs->numglobals; i++)
             ((int *)pr_globals)[i] = LittleLong(((int *)pr_globals)[i]);
 
+        PR_NativeBind(crc);
+
 #if defined(QW_HACK) && defined(SERVERONLY)
         // Zoid, find the spectator functions
         SpectatorConnect = SpectatorThink = SpectatorDisconnect = 0;
@@ -1069,6 +1304,10 @@ PR_Init
         Cmd_AddCommand("edicts", ED_PrintEdicts);
         Cmd_AddCommand("edictcount", ED_Count);
         Cmd_AddCommand("profile", PR_Profile_f);
+        Cvar_RegisterVariable(&sv_fastfind);
+        Cvar_RegisterVariable(&sv_fastfindradius);
+        PR_ProfInit();
+        PR_NativeInit();
 #ifdef NQ_HACK
         Cvar_RegisterVariable(&nomonsters);
         Cvar_RegisterVariable(&gamecfg);
@@ -20,9 +20,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "console.h"
 #include "pr_comp.h"
+#include "pr_native.h"
 #include "progs.h"
 #include "server.h"
 #include "sys.h"
+#include "world.h"
 #include "zone.h"
 
 #ifdef NQ_HACK
@@ -162,6 +164,7 @@ void PR_Profile_f(void) {
     int max;
     int num;
     int i;
+    float frames;
 
     // FIXME - progs get unloaded? if so, check that progs gets zero'd
     if (!progs) return;
@@ -183,6 +186,21 @@ void PR_Profile_f(void) {
             best->profile = 0;
         }
     } while (best);
+
+    Con_Printf("edicts: %u reused, %u appended\n", ed_searchstats.alloc_reused,
+               ed_searchstats.alloc_new);
+    Con_Printf("findradius: %u calls, %u edicts tested\n", ed_searchstats.findradius,
+               ed_searchstats.findradius_tested);
+    Con_Printf("find: %u calls (%u indexed), %u edicts tested\n", ed_searchstats.find,
+               ed_searchstats.find_indexed, ed_searchstats.find_tested);
+    memset(&ed_searchstats, 0, sizeof(ed_searchstats));
+
+    if (sv_linkstats.frames) {
+        frames = sv_linkstats.frames;
+        Con_Printf("links: %.1f/frame, %.1f leaf walks, %.1f skipped\n", sv_linkstats.links / frames,
+                   sv_linkstats.leafwalks / frames, sv_linkstats.leafskips / frames);
+    }
+    memset(&sv_linkstats, 0, sizeof(sv_linkstats));
 }
 
 /*
@@ -206,6 +224,7 @@ void PR_RunError(const char *error, ...) {
 
     /* dump the stack so SV/Host_Error can shutdown functions */
     pr_depth = 0;
+    PR_ProfAbort();
 
 #ifdef NQ_HACK
     Host_Error("Program error");
@@ -247,6 +266,8 @@ int PR_EnterFunction(dfunction_t *f) {
         localstack[localstack_used + i] = ((int *)pr_globals)[f->parm_start + i];
     localstack_used += c;
 
+    if (pr_profiling) PR_ProfEnter(f - pr_functions);
+
     // copy parameters
     o = f->parm_start;
     for (i = 0; i < f->numparms; i++) {
@@ -284,12 +305,60 @@ int PR_LeaveFunction(void) {
     for (i = 0; i < c; i++)
         ((int *)pr_globals)[pr_xfunction->parm_start + i] = localstack[localstack_used + i];
 
+    if (pr_profiling) PR_ProfLeave();
+
     // up stack
     pr_depth--;
     pr_xfunction = pr_stack[pr_depth].f;
     return pr_stack[pr_depth].s;
 }
 
+/*
+====================
+PR_RunNative
+
+Run a translated function in its own frame, as OP_CALL would
+====================
+*/
+static void PR_RunNative(dfunction_t *f, prnativefunc_t native) {
+    PR_EnterFunction(f);
+    native();
+    pr_xstatement = PR_LeaveFunction();
+}
+
+/*
+====================
+PR_NativeCall
+
+OP_CALL for translated code
+====================
+*/
+void PR_NativeCall(func_t fnum) {
+    dfunction_t *f;
+    int i;
+
+    if (!fnum) PR_RunError("NULL function");
+    f = &pr_functions[fnum];
+
+    if (f->first_statement < 0) {
+        i = -f->first_statement;
+        if (i >= pr_numbuiltins) PR_RunError("Bad builtin call number");
+        if (pr_profiling) {
+            PR_ProfEnter(fnum);
+            pr_builtins[i]();
+            PR_ProfLeave();
+        } else {
+            pr_builtins[i]();
+        }
+        return;
+    }
+
+    if (pr_nativefunctions[fnum])
+        PR_RunNative(f, pr_nativefunctions[fnum]);
+    else
+        PR_ExecuteProgram(fnum);
+}
+
 /*
 ====================
 PR_ExecuteProgram
@@ -323,6 +392,15 @@ void PR_ExecuteProgram(func_t fnum) {
 
     // make a stack frame
     exitdepth = pr_depth;
+    if (!exitdepth) {
+        PR_ProfBeginExecute();
+        pr_nativerunaway = 1000000;
+    }
+
+    if (pr_nativefunctions && pr_nativefunctions[fnum]) {
+        PR_RunNative(f, pr_nativefunctions[fnum]);
+        return;
+    }
 
     s = PR_EnterFunction(f);
 
@@ -478,11 +556,15 @@ void PR_ExecuteProgram(func_t fnum) {
             case OP_STOREP_F:
             case OP_STOREP_ENT:
             case OP_STOREP_FLD:  // integers
-            case OP_STOREP_S:
             case OP_STOREP_FNC:  // pointers
                 ptr = (eval_t *)((byte *)sv.edicts + b->_int);
                 ptr->_int = a->_int;
                 break;
+            case OP_STOREP_S:
+                ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+                ptr->_int = a->_int;
+                ED_StringFieldStored(b->_int);
+                break;
             case OP_STOREP_V:
                 ptr = (eval_t *)((byte *)sv.edicts + b->_int);
                 ptr->vector[0] = a->vector[0];
@@ -556,7 +638,18 @@ void PR_ExecuteProgram(func_t fnum) {
                 if (newf->first_statement < 0) {
                     i = -newf->first_statement;
                     if (i >= pr_numbuiltins) PR_RunError("Bad builtin call number");
-                    pr_builtins[i]();
+                    if (pr_profiling) {
+                        PR_ProfEnter(a->function);
+                        pr_builtins[i]();
+                        PR_ProfLeave();
+                    } else {
+                        pr_builtins[i]();
+                    }
+                    break;
+                }
+
+                if (pr_nativefunctions && pr_nativefunctions[a->function]) {
+                    PR_RunNative(newf, pr_nativefunctions[a->function]);
                     break;
                 }
 
@@ -641,3 +734,20 @@ int PR_SetString(const char *s) {
     }
     return (int)(s - pr_strings);
 }
+
+int PR_NumStrings(void) { return num_prstr; }
+
+/*
+ * Replace the string table with the given strings, in order, so that saved
+ * string_t values refer to the same text. The caller keeps the strings
+ * alive until the table is replaced again.
+ */
+void PR_RestoreStringTable(const char *const *strings, int count) {
+    if (count > pr_strtbl_size) {
+        pr_strtbl_size = (count + PR_STRTBL_CHUNK - 1) / PR_STRTBL_CHUNK * PR_STRTBL_CHUNK;
+        pr_strtbl = Z_Realloc(pr_strtbl, pr_strtbl_size * sizeof(char *));
+    }
+
+    memcpy(pr_strtbl, strings, count * sizeof(char *));
+    num_prstr = count;
+}
@@ -0,0 +1,639 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+/* pr_native.c -- translation of progs to C, and binding of the result */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmd.h"
+#include "common.h"
+#include "console.h"
+#include "cvar.h"
+#include "pr_native.h"
+#include "sys.h"
+#include "zone.h"
+
+#define PR_MAX_NATIVE 8
+
+cvar_t pr_native = {"pr_native", "1"};
+
+const prnativefunc_t *pr_nativefunctions;
+int pr_nativerunaway;
+
+static const prnativeprogs_t *pr_nativeprogs[PR_MAX_NATIVE];
+static int pr_numnative;
+static int pr_progscrc;
+
+static FILE *pr_difffile;
+static qboolean pr_diffstarted;
+static void PR_DiffStart(void);
+
+/*
+ * Called from the constructors of translated files, before main
+ */
+void PR_NativeRegister(const prnativeprogs_t *native) {
+    if (pr_numnative < PR_MAX_NATIVE) pr_nativeprogs[pr_numnative++] = native;
+}
+
+/*
+====================
+PR_NativeBind
+
+Called by PR_LoadProgs once the header is byte swapped. Native code is only
+used if it was translated from exactly this progs.dat.
+====================
+*/
+void PR_NativeBind(int crc) {
+    const prnativeprogs_t *native;
+    int i, j, count;
+
+    pr_progscrc = crc;
+    pr_nativefunctions = NULL;
+    if (pr_difffile && !pr_diffstarted) PR_DiffStart();
+    if (!pr_native.value) return;
+
+    for (i = 0; i < pr_numnative; i++) {
+        native = pr_nativeprogs[i];
+        if (native->crc != crc || native->numfunctions != progs->numfunctions ||
+            native->numstatements != progs->numstatements)
+            continue;
+
+        pr_nativefunctions = native->functions;
+        for (j = count = 0; j < native->numfunctions; j++)
+            if (native->functions[j]) count++;
+        Con_DPrintf("Using native code for %d of %d progs functions\n", count,
+                    native->numfunctions);
+        return;
+    }
+}
+
+/*
+============================================================================
+Translation
+============================================================================
+*/
+
+static int PR_CompareInt(const void *a, const void *b) { return *(const int *)a - *(const int *)b; }
+
+/*
+ * The statements of a function run up to the first statement of the next
+ * function in the file
+ */
+static int PR_FunctionEnd(const int *starts, int numstarts, int first) {
+    int lo = 0, hi = numstarts;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (starts[mid] <= first)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < numstarts ? starts[lo] : progs->numstatements;
+}
+
+/*
+ * Check that every branch lands inside the function and that the last
+ * statement doesn't fall through into the next one. Marks branch targets.
+ */
+static qboolean PR_CheckFunction(int first, int end, byte *labels) {
+    const dstatement_t *st;
+    int s, target;
+
+    for (s = first; s < end; s++) {
+        st = &pr_statements[s];
+        switch (st->op) {
+            case OP_IF:
+            case OP_IFNOT:
+                target = s + st->b;
+                break;
+            case OP_GOTO:
+                target = s + st->a;
+                break;
+            default:
+                if (st->op > OP_BITOR) return false;
+                continue;
+        }
+        if (target < first || target >= end) return false;
+        labels[target - first] = 1;
+    }
+
+    st = &pr_statements[end - 1];
+    return st->op == OP_DONE || st->op == OP_RETURN || st->op == OP_GOTO;
+}
+
+static void PR_Emit(FILE *f, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void PR_Emit(FILE *f, const char *fmt, ...) {
+    va_list argptr;
+
+    fputs("    ", f);
+    va_start(argptr, fmt);
+    vfprintf(f, fmt, argptr);
+    va_end(argptr);
+}
+
+static void PR_TranslateStatement(FILE *f, int s, const dstatement_t *st) {
+    static const char *const compare[] = {
+        [OP_EQ_F] = "==", [OP_NE_F] = "!=", [OP_EQ_E] = "==", [OP_NE_E] = "!=",
+        [OP_EQ_FNC] = "==", [OP_NE_FNC] = "!=", [OP_LE] = "<=", [OP_GE] = ">=",
+        [OP_LT] = "<", [OP_GT] = ">", [OP_AND] = "&&", [OP_OR] = "||",
+    };
+    int a = st->a, b = st->b, c = st->c;
+    int i;
+
+    switch (st->op) {
+        case OP_ADD_F:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->_float + PRN_G(%d)->_float;\n", c, a, b);
+            break;
+        case OP_SUB_F:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->_float - PRN_G(%d)->_float;\n", c, a, b);
+            break;
+        case OP_MUL_F:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->_float * PRN_G(%d)->_float;\n", c, a, b);
+            break;
+        case OP_DIV_F:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->_float / PRN_G(%d)->_float;\n", c, a, b);
+            break;
+        case OP_ADD_V:
+        case OP_SUB_V:
+            for (i = 0; i < 3; i++)
+                PR_Emit(f, "PRN_G(%d)->vector[%d] = PRN_G(%d)->vector[%d] %c PRN_G(%d)->vector[%d];\n",
+                        c, i, a, i, st->op == OP_ADD_V ? '+' : '-', b, i);
+            break;
+        case OP_MUL_V:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = PRN_G(%d)->vector[0] * PRN_G(%d)->vector[0] + "
+                    "PRN_G(%d)->vector[1] * PRN_G(%d)->vector[1] + "
+                    "PRN_G(%d)->vector[2] * PRN_G(%d)->vector[2];\n",
+                    c, a, b, a, b, a, b);
+            break;
+        case OP_MUL_FV:
+            for (i = 0; i < 3; i++)
+                PR_Emit(f, "PRN_G(%d)->vector[%d] = PRN_G(%d)->_float * PRN_G(%d)->vector[%d];\n",
+                        c, i, a, b, i);
+            break;
+        case OP_MUL_VF:
+            for (i = 0; i < 3; i++)
+                PR_Emit(f, "PRN_G(%d)->vector[%d] = PRN_G(%d)->_float * PRN_G(%d)->vector[%d];\n",
+                        c, i, b, a, i);
+            break;
+        case OP_BITAND:
+        case OP_BITOR:
+            PR_Emit(f, "PRN_G(%d)->_float = (int)PRN_G(%d)->_float %c (int)PRN_G(%d)->_float;\n",
+                    c, a, st->op == OP_BITAND ? '&' : '|', b);
+            break;
+
+        case OP_EQ_F:
+        case OP_NE_F:
+        case OP_LE:
+        case OP_GE:
+        case OP_LT:
+        case OP_GT:
+        case OP_AND:
+        case OP_OR:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->_float %s PRN_G(%d)->_float;\n", c, a,
+                    compare[st->op], b);
+            break;
+        case OP_EQ_E:
+        case OP_NE_E:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->_int %s PRN_G(%d)->_int;\n", c, a,
+                    compare[st->op], b);
+            break;
+        case OP_EQ_FNC:
+        case OP_NE_FNC:
+            PR_Emit(f, "PRN_G(%d)->_float = PRN_G(%d)->function %s PRN_G(%d)->function;\n", c, a,
+                    compare[st->op], b);
+            break;
+        case OP_EQ_V:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = (PRN_G(%d)->vector[0] == PRN_G(%d)->vector[0]) && "
+                    "(PRN_G(%d)->vector[1] == PRN_G(%d)->vector[1]) && "
+                    "(PRN_G(%d)->vector[2] == PRN_G(%d)->vector[2]);\n",
+                    c, a, b, a, b, a, b);
+            break;
+        case OP_NE_V:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = (PRN_G(%d)->vector[0] != PRN_G(%d)->vector[0]) || "
+                    "(PRN_G(%d)->vector[1] != PRN_G(%d)->vector[1]) || "
+                    "(PRN_G(%d)->vector[2] != PRN_G(%d)->vector[2]);\n",
+                    c, a, b, a, b, a, b);
+            break;
+        case OP_EQ_S:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = !strcmp(PR_GetString(PRN_G(%d)->string), "
+                    "PR_GetString(PRN_G(%d)->string));\n",
+                    c, a, b);
+            break;
+        case OP_NE_S:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = strcmp(PR_GetString(PRN_G(%d)->string), "
+                    "PR_GetString(PRN_G(%d)->string));\n",
+                    c, a, b);
+            break;
+
+        case OP_NOT_F:
+            PR_Emit(f, "PRN_G(%d)->_float = !PRN_G(%d)->_float;\n", c, a);
+            break;
+        case OP_NOT_V:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = !PRN_G(%d)->vector[0] && !PRN_G(%d)->vector[1] && "
+                    "!PRN_G(%d)->vector[2];\n",
+                    c, a, a, a);
+            break;
+        case OP_NOT_S:
+            PR_Emit(f,
+                    "PRN_G(%d)->_float = !PRN_G(%d)->string || "
+                    "!*PR_GetString(PRN_G(%d)->string);\n",
+                    c, a, a);
+            break;
+        case OP_NOT_FNC:
+            PR_Emit(f, "PRN_G(%d)->_float = !PRN_G(%d)->function;\n", c, a);
+            break;
+        case OP_NOT_ENT:
+            PR_Emit(f, "PRN_G(%d)->_float = (PROG_TO_EDICT(PRN_G(%d)->edict) == sv.edicts);\n",
+                    c, a);
+            break;
+
+        case OP_STORE_F:
+        case OP_STORE_ENT:
+        case OP_STORE_FLD:
+        case OP_STORE_S:
+        case OP_STORE_FNC:
+            PR_Emit(f, "PRN_G(%d)->_int = PRN_G(%d)->_int;\n", b, a);
+            break;
+        case OP_STORE_V:
+            for (i = 0; i < 3; i++)
+                PR_Emit(f, "PRN_G(%d)->vector[%d] = PRN_G(%d)->vector[%d];\n", b, i, a, i);
+            break;
+
+        case OP_STOREP_F:
+        case OP_STOREP_ENT:
+        case OP_STOREP_FLD:
+        case OP_STOREP_FNC:
+            PR_Emit(f, "PRN_Pointer(PRN_G(%d)->_int)->_int = PRN_G(%d)->_int;\n", b, a);
+            break;
+        case OP_STOREP_S:
+            PR_Emit(f, "PRN_Pointer(PRN_G(%d)->_int)->_int = PRN_G(%d)->_int;\n", b, a);
+            PR_Emit(f, "ED_StringFieldStored(PRN_G(%d)->_int);\n", b);
+            break;
+        case OP_STOREP_V:
+            for (i = 0; i < 3; i++)
+                PR_Emit(f, "PRN_Pointer(PRN_G(%d)->_int)->vector[%d] = PRN_G(%d)->vector[%d];\n",
+                        b, i, a, i);
+            break;
+
+        case OP_ADDRESS:
+            PR_Emit(f, "pr_xstatement = %d;\n", s);
+            PR_Emit(f, "PRN_G(%d)->_int = PRN_Address(PRN_G(%d)->edict, PRN_G(%d)->_int);\n",
+                    c, a, b);
+            break;
+        case OP_LOAD_F:
+        case OP_LOAD_FLD:
+        case OP_LOAD_ENT:
+        case OP_LOAD_S:
+        case OP_LOAD_FNC:
+            PR_Emit(f, "PRN_G(%d)->_int = PRN_Field(PRN_G(%d)->edict, PRN_G(%d)->_int)->_int;\n",
+                    c, a, b);
+            break;
+        case OP_LOAD_V:
+            PR_Emit(f, "{\n");
+            PR_Emit(f, "    eval_t *ptr = PRN_Field(PRN_G(%d)->edict, PRN_G(%d)->_int);\n", a,
+                    b);
+            for (i = 0; i < 3; i++)
+                PR_Emit(f, "    PRN_G(%d)->vector[%d] = ptr->vector[%d];\n", c, i, i);
+            PR_Emit(f, "}\n");
+            break;
+
+        case OP_IFNOT:
+        case OP_IF:
+            PR_Emit(f, "if (%sPRN_G(%d)->_int) {%s goto s%d; }\n", st->op == OP_IFNOT ? "!" : "",
+                    a, st->b <= 0 ? " PRN_RUNAWAY();" : "", s + st->b);
+            break;
+        case OP_GOTO:
+            PR_Emit(f, "%sgoto s%d;\n", st->a <= 0 ? "PRN_RUNAWAY();\n    " : "", s + st->a);
+            break;
+
+        case OP_CALL0:
+        case OP_CALL1:
+        case OP_CALL2:
+        case OP_CALL3:
+        case OP_CALL4:
+        case OP_CALL5:
+        case OP_CALL6:
+        case OP_CALL7:
+        case OP_CALL8:
+            PR_Emit(f, "pr_argc = %d;\n", st->op - OP_CALL0);
+            PR_Emit(f, "pr_xstatement = %d;\n", s);
+            PR_Emit(f, "PR_NativeCall(PRN_G(%d)->function);\n", a);
+            break;
+
+        case OP_DONE:
+        case OP_RETURN:
+            PR_Emit(f, "pr_globals[OFS_RETURN] = pr_globals[%d];\n", a);
+            PR_Emit(f, "pr_globals[OFS_RETURN + 1] = pr_globals[%d];\n", a + 1);
+            PR_Emit(f, "pr_globals[OFS_RETURN + 2] = pr_globals[%d];\n", a + 2);
+            PR_Emit(f, "return;\n");
+            break;
+
+        case OP_STATE:
+            PR_Emit(f, "PRN_State(PRN_G(%d)->_float, PRN_G(%d)->function);\n", a, b);
+            break;
+    }
+}
+
+/*
+====================
+PR_Translate_f
+
+pr_translate <file> : write the loaded progs out as C. Add the file to the
+                      engine sources and rebuild; it is used whenever a
+                      progs.dat with the same CRC is loaded.
+====================
+*/
+static void PR_Translate_f(void) {
+    char name[MAX_OSPATH];
+    const dfunction_t *func;
+    FILE *f;
+    int *starts;
+    byte *labels, *translated;
+    int i, s, first, end, numstarts, length, count;
+
+    if (Cmd_Argc() != 2) {
+        Con_Printf("pr_translate <file> : translate the loaded progs to C\n");
+        return;
+    }
+    if (!progs) {
+        Con_Printf("No progs loaded.\n");
+        return;
+    }
+    if (strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+
+    length = snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+    if (length >= sizeof(name)) {
+        Con_Printf("ERROR: filename too long.\n");
+        return;
+    }
+
+    f = fopen(name, "w");
+    if (!f) {
+        Con_Printf("ERROR: couldn't open %s\n", name);
+        return;
+    }
+
+    starts = Hunk_TempAlloc(progs->numfunctions * (sizeof(int) + 1) + progs->numstatements);
+    translated = (byte *)(starts + progs->numfunctions);
+    labels = translated + progs->numfunctions;
+    memset(translated, 0, progs->numfunctions);
+    numstarts = 0;
+    for (i = 0; i < progs->numfunctions; i++)
+        if (pr_functions[i].first_statement > 0) starts[numstarts++] = pr_functions[i].first_statement;
+    qsort(starts, numstarts, sizeof(int), PR_CompareInt);
+
+    fprintf(f, "/* generated by pr_translate, progs crc %d - do not edit */\n\n", pr_progscrc);
+    fprintf(f, "#include \"pr_native.h\"\n\n");
+
+    count = 0;
+    for (i = 0; i < progs->numfunctions; i++) {
+        func = &pr_functions[i];
+        first = func->first_statement;
+        if (first <= 0) continue;
+        end = PR_FunctionEnd(starts, numstarts, first);
+        memset(labels, 0, end - first);
+        if (!PR_CheckFunction(first, end, labels)) {
+            Con_Printf("%s: not translated, left to the interpreter\n",
+                       PR_GetString(func->s_name));
+            continue;
+        }
+
+        fprintf(f, "/* %s */\n", PR_GetString(func->s_name));
+        fprintf(f, "static void PRN_%d(void) {\n", i);
+        for (s = first; s < end; s++) {
+            if (labels[s - first]) fprintf(f, "s%d:\n", s);
+            PR_TranslateStatement(f, s, &pr_statements[s]);
+        }
+        fprintf(f, "}\n\n");
+        translated[i] = 1;
+        count++;
+    }
+
+    fprintf(f, "static const prnativefunc_t functions[%d] = {\n", progs->numfunctions);
+    for (i = 0; i < progs->numfunctions; i++) {
+        if (translated[i]) fprintf(f, "    [%d] = PRN_%d,\n", i, i);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "static const prnativeprogs_t native = {%d, %d, %d, functions};\n\n", pr_progscrc,
+            progs->numfunctions, progs->numstatements);
+    fprintf(f, "PR_NATIVE_REGISTER(native)\n");
+    fclose(f);
+
+    Con_Printf("Translated %d functions to %s\n", count, name);
+}
+
+/*
+============================================================================
+Differential checking
+
+Native and interpreted runs of the same session should leave identical
+globals and edicts after every server frame. "pr_nativediff record" hashes
+that state each frame into a file, "pr_nativediff check" compares a second
+run against it and reports the first frame and edict that differ. Both
+start from the next map load, which also reseeds the random number
+generator; run with a fixed host_framerate and no client input.
+============================================================================
+*/
+
+#define PR_DIFF_MAGIC (('D' << 24) | ('N' << 16) | ('P' << 8) | 'Q')
+
+typedef enum { diff_off, diff_record, diff_check } prdiffmode_t;
+
+static prdiffmode_t pr_diffmode;
+static int pr_diffframe;
+
+static unsigned PR_DiffHash(const void *data, int length) {
+    const byte *bytes = data;
+    unsigned hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < length; i++) hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+static void PR_DiffClose(void) {
+    if (!pr_difffile) return;
+    fclose(pr_difffile);
+    pr_difffile = NULL;
+    pr_diffmode = diff_off;
+    Con_Printf("Closed native diff file after %d frames.\n", pr_diffframe);
+}
+
+static void PR_DiffStart(void) {
+    int header[4], check[4];
+
+    header[0] = PR_DIFF_MAGIC;
+    header[1] = pr_progscrc;
+    header[2] = progs->numglobals;
+    header[3] = progs->entityfields;
+
+    if (pr_diffmode == diff_record) {
+        fwrite(header, sizeof(header), 1, pr_difffile);
+    } else if (fread(check, sizeof(check), 1, pr_difffile) != 1 ||
+               memcmp(header, check, sizeof(header))) {
+        Con_Printf("Native diff file was recorded with different progs.\n");
+        PR_DiffClose();
+        return;
+    }
+
+    srand(0);
+    pr_diffframe = 0;
+    pr_diffstarted = true;
+}
+
+/*
+====================
+PR_NativeFrame
+
+Called at the end of each server physics frame
+====================
+*/
+void PR_NativeFrame(void) {
+    static unsigned hashes[MAX_EDICTS + 1], recorded[MAX_EDICTS + 1];
+    const edict_t *ed;
+    int i, count, numedicts, mismatches;
+
+    if (!pr_difffile || !pr_diffstarted) return;
+
+    hashes[0] = PR_DiffHash(pr_globals, progs->numglobals * 4);
+    for (i = 0; i < sv.num_edicts; i++) {
+        ed = EDICT_NUM(i);
+        hashes[i + 1] = ed->free ? 0 : PR_DiffHash(&ed->v, progs->entityfields * 4);
+    }
+    count = sv.num_edicts + 1;
+
+    if (pr_diffmode == diff_record) {
+        fwrite(&count, sizeof(count), 1, pr_difffile);
+        fwrite(hashes, sizeof(hashes[0]), count, pr_difffile);
+        pr_diffframe++;
+        return;
+    }
+
+    if (fread(&numedicts, sizeof(numedicts), 1, pr_difffile) != 1 || numedicts <= 0 ||
+        numedicts > MAX_EDICTS + 1 ||
+        fread(recorded, sizeof(recorded[0]), numedicts, pr_difffile) != numedicts) {
+        Con_Printf("Native diff: end of recording, %d frames match.\n", pr_diffframe);
+        PR_DiffClose();
+        return;
+    }
+
+    mismatches = 0;
+    if (numedicts != count) {
+        Con_Printf("Native diff: frame %d has %d edicts, recorded %d\n", pr_diffframe,
+                   count - 1, numedicts - 1);
+        mismatches++;
+    }
+    if (hashes[0] != recorded[0]) {
+        Con_Printf("Native diff: frame %d globals differ\n", pr_diffframe);
+        mismatches++;
+    }
+    for (i = 1; i < count && i < numedicts; i++) {
+        if (hashes[i] == recorded[i]) continue;
+        ed = EDICT_NUM(i - 1);
+        Con_Printf("Native diff: frame %d edict %d (%s) differs\n", pr_diffframe, i - 1,
+                   ed->free ? "free" : PR_GetString(ed->v.classname));
+        if (++mismatches == 8) break;
+    }
+
+    pr_diffframe++;
+    if (mismatches) PR_DiffClose();
+}
+
+/*
+====================
+PR_NativeDiff_f
+
+pr_nativediff record <file> : hash QuakeC state every frame from the next map
+pr_nativediff check <file>  : compare against a recording from the next map
+pr_nativediff               : stop
+====================
+*/
+static void PR_NativeDiff_f(void) {
+    char name[MAX_OSPATH];
+    const char *mode;
+    int length;
+
+    if (Cmd_Argc() != 3) {
+        if (pr_difffile)
+            PR_DiffClose();
+        else
+            Con_Printf("pr_nativediff <record|check> <file> : compare native and interpreted runs\n");
+        return;
+    }
+    PR_DiffClose();
+
+    mode = Cmd_Argv(1);
+    if (!strcmp(mode, "record")) {
+        pr_diffmode = diff_record;
+    } else if (!strcmp(mode, "check")) {
+        pr_diffmode = diff_check;
+    } else {
+        Con_Printf("Unknown mode \"%s\"\n", mode);
+        return;
+    }
+
+    if (strstr(Cmd_Argv(2), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        pr_diffmode = diff_off;
+        return;
+    }
+    length = snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(2));
+    if (length >= sizeof(name)) {
+        Con_Printf("ERROR: filename too long.\n");
+        pr_diffmode = diff_off;
+        return;
+    }
+
+    pr_difffile = fopen(name, pr_diffmode == diff_record ? "wb" : "rb");
+    if (!pr_difffile) {
+        Con_Printf("ERROR: couldn't open %s\n", name);
+        pr_diffmode = diff_off;
+        return;
+    }
+
+    pr_diffstarted = false;
+    Con_Printf("Native diff (%s code) starts with the next map.\n",
+               pr_native.value ? "native" : "interpreted");
+}
+
+/*
+====================
+PR_NativeInit
+====================
+*/
+void PR_NativeInit(void) {
+    Cvar_RegisterVariable(&pr_native);
+
+    Cmd_AddCommand("pr_translate", PR_Translate_f);
+    Cmd_AddCommand("pr_nativediff", PR_NativeDiff_f);
+}
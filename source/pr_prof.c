@@ -0,0 +1,365 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+/* pr_prof.c -- wall clock profiling of QuakeC functions and builtins */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmd.h"
+#include "common.h"
+#include "console.h"
+#include "cvar.h"
+#include "mathlib.h"
+#include "pr_comp.h"
+#include "progs.h"
+#include "sys.h"
+#include "zone.h"
+
+#ifdef NQ_HACK
+#include "quakedef.h"
+#endif
+#ifdef QW_HACK
+#include "qwsvdef.h"
+#endif
+
+/*
+ * Every call is recorded in a calling context tree: one node per distinct
+ * call path, so the same function called from two places gets two nodes.
+ * Node 0 is the engine, parent of every function the engine calls directly.
+ * Per-function totals and caller->callee edges are folded out of the tree
+ * when a report is printed, and the export writes one line per node in the
+ * "folded stacks" format read by flamegraph.pl, speedscope and friends.
+ */
+#define PR_PROF_NODES 8192
+#define PR_PROF_STACK 64
+
+typedef struct {
+    int function; /* index into pr_functions, -1 for the engine */
+    int parent;
+    int child;   /* first child */
+    int sibling; /* next child of the same parent */
+    unsigned calls;
+    double self;  /* seconds, excluding children */
+    double total; /* seconds, including children */
+} prprofnode_t;
+
+typedef struct {
+    int node; /* -1 if the node pool was full */
+    double start;
+    double children;
+} prprofframe_t;
+
+cvar_t pr_profile = {"pr_profile", "0"};
+qboolean pr_profiling;
+
+static prprofnode_t pr_profnodes[PR_PROF_NODES];
+static int pr_profnumnodes;
+static unsigned pr_profdropped; /* calls not recorded, pool full */
+
+static prprofframe_t pr_profstack[PR_PROF_STACK];
+static int pr_profdepth;
+
+void PR_ProfReset(void) {
+    memset(&pr_profnodes[0], 0, sizeof(pr_profnodes[0]));
+    pr_profnodes[0].function = -1;
+    pr_profnodes[0].parent = -1;
+    pr_profnodes[0].child = -1;
+    pr_profnodes[0].sibling = -1;
+    pr_profnumnodes = 1;
+    pr_profdropped = 0;
+    pr_profdepth = 0;
+}
+
+/*
+====================
+PR_ProfBeginExecute
+
+Called when the engine enters the interpreter from outside any QuakeC.
+Latches pr_profile so that enter/leave calls stay balanced, and discards
+anything left on the stack by an error that unwound past the interpreter.
+====================
+*/
+void PR_ProfBeginExecute(void) {
+    pr_profiling = pr_profile.value != 0;
+    pr_profdepth = 0;
+}
+
+void PR_ProfAbort(void) { pr_profdepth = 0; }
+
+static int PR_ProfChild(int parent, int function) {
+    prprofnode_t *node;
+    int i;
+
+    for (i = pr_profnodes[parent].child; i >= 0; i = pr_profnodes[i].sibling)
+        if (pr_profnodes[i].function == function) return i;
+
+    if (pr_profnumnodes == PR_PROF_NODES) return -1;
+
+    i = pr_profnumnodes++;
+    node = &pr_profnodes[i];
+    memset(node, 0, sizeof(*node));
+    node->function = function;
+    node->parent = parent;
+    node->child = -1;
+    node->sibling = pr_profnodes[parent].child;
+    pr_profnodes[parent].child = i;
+
+    return i;
+}
+
+void PR_ProfEnter(int function) {
+    prprofframe_t *frame;
+    int parent;
+
+    if (pr_profdepth == PR_PROF_STACK) {
+        pr_profdropped++;
+        return;
+    }
+
+    parent = pr_profdepth ? pr_profstack[pr_profdepth - 1].node : 0;
+    frame = &pr_profstack[pr_profdepth++];
+    frame->node = parent >= 0 ? PR_ProfChild(parent, function) : -1;
+    frame->children = 0;
+    frame->start = Sys_DoubleTime();
+    if (frame->node < 0) pr_profdropped++;
+}
+
+void PR_ProfLeave(void) {
+    prprofframe_t *frame;
+    prprofnode_t *node;
+    double elapsed;
+
+    if (!pr_profdepth) return;
+
+    frame = &pr_profstack[--pr_profdepth];
+    if (frame->node < 0) return; /* time is charged to the caller's self */
+
+    elapsed = Sys_DoubleTime() - frame->start;
+    node = &pr_profnodes[frame->node];
+    node->calls++;
+    node->total += elapsed;
+    node->self += elapsed - frame->children;
+    if (pr_profdepth) pr_profstack[pr_profdepth - 1].children += elapsed;
+}
+
+static const char *PR_ProfName(int function) {
+    if (function < 0) return "<engine>";
+    return PR_GetString(pr_functions[function].s_name);
+}
+
+static qboolean PR_ProfIsBuiltin(int function) {
+    return function >= 0 && pr_functions[function].first_statement < 0;
+}
+
+/* true if the node's function also appears further up its call path */
+static qboolean PR_ProfRecursive(int n) {
+    int function = pr_profnodes[n].function;
+
+    for (n = pr_profnodes[n].parent; n > 0; n = pr_profnodes[n].parent)
+        if (pr_profnodes[n].function == function) return true;
+
+    return false;
+}
+
+typedef struct {
+    int caller, callee;
+    unsigned calls;
+    double self, total;
+} prprofsum_t;
+
+static int PR_ProfCompareSelf(const void *a, const void *b) {
+    const prprofsum_t *sa = a;
+    const prprofsum_t *sb = b;
+
+    return (sa->self < sb->self) - (sa->self > sb->self);
+}
+
+static int PR_ProfCompareTotal(const void *a, const void *b) {
+    const prprofsum_t *sa = a;
+    const prprofsum_t *sb = b;
+
+    return (sa->total < sb->total) - (sa->total > sb->total);
+}
+
+static int PR_ProfCompareEdge(const void *a, const void *b) {
+    const prprofsum_t *sa = a;
+    const prprofsum_t *sb = b;
+
+    if (sa->caller != sb->caller) return sa->caller - sb->caller;
+    return sa->callee - sb->callee;
+}
+
+/*
+====================
+PR_ProfDump_f
+
+pr_profdump [count] : top functions by self time, then the heaviest
+                      caller -> callee edges
+====================
+*/
+static void PR_ProfDump_f(void) {
+    const prprofnode_t *node;
+    prprofsum_t *sums;
+    prprofsum_t *sum;
+    int i, count, numsums;
+    double frametotal;
+
+    if (!progs) return;
+    if (pr_profnumnodes <= 1) {
+        Con_Printf("No QuakeC calls recorded (set pr_profile 1)\n");
+        return;
+    }
+
+    count = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 20;
+    if (count <= 0) count = 20;
+
+    sums = Hunk_TempAlloc(qmax(progs->numfunctions, pr_profnumnodes) * sizeof(prprofsum_t));
+
+    /* per function; inclusive time only from the outermost activation */
+    memset(sums, 0, progs->numfunctions * sizeof(sums[0]));
+    frametotal = 0;
+    for (i = 1; i < pr_profnumnodes; i++) {
+        node = &pr_profnodes[i];
+        sum = &sums[node->function];
+        sum->callee = node->function;
+        sum->calls += node->calls;
+        sum->self += node->self;
+        if (!PR_ProfRecursive(i)) sum->total += node->total;
+        if (node->parent == 0) frametotal += node->total;
+    }
+    qsort(sums, progs->numfunctions, sizeof(sums[0]), PR_ProfCompareSelf);
+
+    Con_Printf("%.2f msec in QuakeC, builtins marked *\n", frametotal * 1000.0);
+    Con_Printf("%8s %9s %9s %5s  %s\n", "calls", "self ms", "incl ms", "self%", "function");
+    for (i = 0; i < count && i < progs->numfunctions; i++) {
+        sum = &sums[i];
+        if (!sum->calls) continue;
+        Con_Printf("%8u %9.2f %9.2f %5.1f %c%s\n", sum->calls, sum->self * 1000.0,
+                   sum->total * 1000.0, frametotal ? sum->self * 100.0 / frametotal : 0.0,
+                   PR_ProfIsBuiltin(sum->callee) ? '*' : ' ', PR_ProfName(sum->callee));
+    }
+
+    /* caller -> callee edges, merged across call paths */
+    for (i = 1; i < pr_profnumnodes; i++) {
+        node = &pr_profnodes[i];
+        sum = &sums[i - 1];
+        sum->caller = pr_profnodes[node->parent].function;
+        sum->callee = node->function;
+        sum->calls = node->calls;
+        sum->self = node->self;
+        sum->total = PR_ProfRecursive(i) ? 0 : node->total;
+    }
+    qsort(sums, pr_profnumnodes - 1, sizeof(sums[0]), PR_ProfCompareEdge);
+    numsums = 0;
+    for (i = 0; i < pr_profnumnodes - 1; i++) {
+        if (numsums && sums[numsums - 1].caller == sums[i].caller &&
+            sums[numsums - 1].callee == sums[i].callee) {
+            sums[numsums - 1].calls += sums[i].calls;
+            sums[numsums - 1].total += sums[i].total;
+            continue;
+        }
+        sums[numsums++] = sums[i];
+    }
+    qsort(sums, numsums, sizeof(sums[0]), PR_ProfCompareTotal);
+
+    Con_Printf("%8s %9s  %s\n", "calls", "incl ms", "caller -> callee");
+    for (i = 0; i < count && i < numsums; i++) {
+        sum = &sums[i];
+        Con_Printf("%8u %9.2f  %s -> %s\n", sum->calls, sum->total * 1000.0,
+                   PR_ProfName(sum->caller), PR_ProfName(sum->callee));
+    }
+
+    if (pr_profdropped)
+        Con_Printf("%u calls not recorded, call tree full (%d nodes)\n", pr_profdropped,
+                   PR_PROF_NODES);
+}
+
+static void PR_ProfWritePath(FILE *f, int n) {
+    if (pr_profnodes[n].parent > 0) {
+        PR_ProfWritePath(f, pr_profnodes[n].parent);
+        fputc(';', f);
+    }
+    fputs(PR_ProfName(pr_profnodes[n].function), f);
+}
+
+/*
+====================
+PR_ProfExport_f
+
+pr_profexport <file> : write the call tree as folded stacks, one line per
+                       call path with its self time in microseconds
+====================
+*/
+static void PR_ProfExport_f(void) {
+    char name[MAX_OSPATH];
+    FILE *f;
+    int i, length;
+    long usec;
+
+    if (Cmd_Argc() != 2) {
+        Con_Printf("pr_profexport <file> : write QuakeC profile as folded stacks\n");
+        return;
+    }
+    if (!progs || pr_profnumnodes <= 1) {
+        Con_Printf("No QuakeC calls recorded (set pr_profile 1)\n");
+        return;
+    }
+    if (strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+
+    length = snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+    if (length >= sizeof(name)) {
+        Con_Printf("ERROR: filename too long.\n");
+        return;
+    }
+
+    f = fopen(name, "w");
+    if (!f) {
+        Con_Printf("ERROR: couldn't open %s\n", name);
+        return;
+    }
+
+    for (i = 1; i < pr_profnumnodes; i++) {
+        usec = (long)(pr_profnodes[i].self * 1000000.0 + 0.5);
+        if (usec <= 0) continue;
+        PR_ProfWritePath(f, i);
+        fprintf(f, " %ld\n", usec);
+    }
+    fclose(f);
+
+    Con_Printf("Wrote QuakeC profile to %s\n", name);
+}
+
+/*
+====================
+PR_ProfInit
+====================
+*/
+void PR_ProfInit(void) {
+    Cvar_RegisterVariable(&pr_profile);
+
+    Cmd_AddCommand("pr_profdump", PR_ProfDump_f);
+    Cmd_AddCommand("pr_profexport", PR_ProfExport_f);
+    Cmd_AddCommand("pr_profreset", PR_ProfReset);
+
+    PR_ProfReset();
+}
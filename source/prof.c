@@ -0,0 +1,260 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+/* prof.c -- per-frame subsystem timers */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmd.h"
+#include "common.h"
+#include "console.h"
+#include "host.h"
+#include "prof.h"
+#include "sys.h"
+
+cvar_t host_profile = {"host_profile", "0"};
+qboolean prof_active;
+static qboolean prof_forced; /* enabled by benchdemo regardless of the cvar */
+
+static const char *prof_names[PROF_NUM_TIMERS] = {
+    "frame", "host", "server", "sv_physics", "sv_send", "cl_read", "screen", "render", "sound",
+};
+
+static double prof_start[PROF_NUM_TIMERS];
+static unsigned prof_running; /* bit per timer */
+static double prof_accum[PROF_NUM_TIMERS];
+static double prof_lastframe;
+
+/* ring buffer of the most recent frames, in milliseconds */
+static float prof_history[PROF_HISTORY][PROF_NUM_TIMERS];
+static int prof_head;  /* next slot to be written */
+static int prof_count; /* valid frames in the ring */
+
+static FILE *prof_trace;
+static qboolean prof_binary;
+
+#define PROF_MAGIC (('F' << 24) | ('R' << 16) | ('P' << 8) | 'Q')
+
+void Prof_Begin(prof_timer_t timer) {
+    prof_start[timer] = Sys_DoubleTime();
+    prof_running |= 1U << timer;
+}
+
+void Prof_End(prof_timer_t timer) {
+    if (prof_running & (1U << timer)) {
+        prof_accum[timer] += Sys_DoubleTime() - prof_start[timer];
+        prof_running &= ~(1U << timer);
+    }
+}
+
+/*
+===============
+Prof_BeginFrame
+
+Latch host_profile for the coming frame. Timers left running by a host_abort
+longjmp from the previous frame are discarded here.
+===============
+*/
+void Prof_BeginFrame(void) {
+    double now;
+
+    prof_active = prof_forced || host_profile.value != 0;
+    if (!prof_active) {
+        prof_lastframe = 0;
+        return;
+    }
+
+    now = Sys_DoubleTime();
+    prof_running = 0;
+    memset(prof_accum, 0, sizeof(prof_accum));
+    if (prof_lastframe) prof_accum[PROF_FRAME] = now - prof_lastframe;
+    prof_lastframe = now;
+}
+
+/*
+===============
+Prof_EndFrame
+===============
+*/
+void Prof_EndFrame(void) {
+    float *frame;
+    int i;
+
+    if (!prof_active) return;
+
+    frame = prof_history[prof_head];
+    for (i = 0; i < PROF_NUM_TIMERS; i++) frame[i] = prof_accum[i] * 1000.0;
+    prof_head = (prof_head + 1) & (PROF_HISTORY - 1);
+    if (prof_count < PROF_HISTORY) prof_count++;
+
+    if (!prof_trace) return;
+
+    if (prof_binary) {
+        fwrite(&host_framecount, sizeof(host_framecount), 1, prof_trace);
+        fwrite(&realtime, sizeof(realtime), 1, prof_trace);
+        fwrite(frame, sizeof(*frame), PROF_NUM_TIMERS, prof_trace);
+    } else {
+        fprintf(prof_trace, "%d,%.6f", host_framecount, realtime);
+        for (i = 0; i < PROF_NUM_TIMERS; i++) fprintf(prof_trace, ",%.4f", frame[i]);
+        fprintf(prof_trace, "\n");
+    }
+}
+
+static int Prof_CompareFloat(const void *a, const void *b) {
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+/*
+===============
+Prof_Report
+
+Print percentiles over the most recent frames in the ring buffer
+===============
+*/
+void Prof_Report(int count) {
+    static float sorted[PROF_HISTORY];
+    int i, j, slot;
+    double total;
+
+    if (count > prof_count) count = prof_count;
+    if (count <= 0) {
+        Con_Printf("No frames recorded (set host_profile 1)\n");
+        return;
+    }
+
+    Con_Printf("%d frames, times in msec\n", count);
+    Con_Printf("%-10s %7s %7s %7s %7s %7s\n", "timer", "avg", "p50", "p90", "p99", "max");
+    for (i = 0; i < PROF_NUM_TIMERS; i++) {
+        total = 0;
+        for (j = 0; j < count; j++) {
+            slot = (prof_head - 1 - j) & (PROF_HISTORY - 1);
+            sorted[j] = prof_history[slot][i];
+            total += sorted[j];
+        }
+        qsort(sorted, count, sizeof(sorted[0]), Prof_CompareFloat);
+        Con_Printf("%-10s %7.2f %7.2f %7.2f %7.2f %7.2f\n", prof_names[i], total / count,
+                   sorted[count * 50 / 100], sorted[count * 90 / 100], sorted[count * 99 / 100],
+                   sorted[count - 1]);
+    }
+}
+
+void Prof_Reset(void) {
+    prof_head = 0;
+    prof_count = 0;
+}
+
+void Prof_Force(qboolean enable) { prof_forced = enable; }
+
+static void Prof_Dump_f(void) {
+    Prof_Report(Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : PROF_HISTORY);
+}
+
+static void Prof_CloseTrace(void) {
+    if (!prof_trace) return;
+    fclose(prof_trace);
+    prof_trace = NULL;
+    Con_Printf("Trace file closed.\n");
+}
+
+/*
+===============
+Prof_Trace_f
+
+prof_trace <file>  : stream every profiled frame to <file> in the game
+                     directory; a ".bin" extension selects the binary format
+prof_trace         : close the trace file
+===============
+*/
+static void Prof_Trace_f(void) {
+    char name[MAX_OSPATH];
+    const char *ext;
+    int i, magic, numtimers, length;
+    char label[16];
+
+    if (Cmd_Argc() != 2) {
+        if (prof_trace)
+            Prof_CloseTrace();
+        else
+            Con_Printf("prof_trace <file> : trace frame times to a .csv or .bin file\n");
+        return;
+    }
+    Prof_CloseTrace();
+
+    if (strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+
+    length = snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+    if (length >= sizeof(name)) {
+        Con_Printf("ERROR: filename too long.\n");
+        return;
+    }
+
+    ext = strrchr(name, '.');
+    prof_binary = ext && !strcasecmp(ext, ".bin");
+    prof_trace = fopen(name, prof_binary ? "wb" : "w");
+    if (!prof_trace) {
+        Con_Printf("ERROR: couldn't open %s\n", name);
+        return;
+    }
+
+    /*
+     * The binary header is the magic, timer count and one 16-byte name per
+     * timer; each record is then an int frame number, a double realtime and
+     * one float (msec) per timer, in native byte order.
+     */
+    if (prof_binary) {
+        magic = PROF_MAGIC;
+        numtimers = PROF_NUM_TIMERS;
+        fwrite(&magic, sizeof(magic), 1, prof_trace);
+        fwrite(&numtimers, sizeof(numtimers), 1, prof_trace);
+        for (i = 0; i < PROF_NUM_TIMERS; i++) {
+            memset(label, 0, sizeof(label));
+            strncpy(label, prof_names[i], sizeof(label) - 1);
+            fwrite(label, sizeof(label), 1, prof_trace);
+        }
+    } else {
+        fprintf(prof_trace, "frame,realtime");
+        for (i = 0; i < PROF_NUM_TIMERS; i++) fprintf(prof_trace, ",%s", prof_names[i]);
+        fprintf(prof_trace, "\n");
+    }
+
+    Con_Printf("Tracing frame times to %s\n", name);
+    if (!host_profile.value) Con_Printf("Note: nothing is recorded until host_profile is set.\n");
+}
+
+/*
+===============
+Prof_Init
+===============
+*/
+void Prof_Init(void) {
+    Cvar_RegisterVariable(&host_profile);
+
+    Cmd_AddCommand("prof_dump", Prof_Dump_f);
+    Cmd_AddCommand("prof_reset", Prof_Reset);
+    Cmd_AddCommand("prof_trace", Prof_Trace_f);
+}
+
+void Prof_Shutdown(void) { Prof_CloseTrace(); }
@@ -222,6 +222,38 @@ static void SCR_DrawFPS(void) {
     Draw_String(x, y, st);
 }
 
+#ifdef NQ_HACK
+/*
+==============
+SCR_DrawLerpGraph
+
+One bar per frame for how far the newest message was ahead of the entity
+render clock, one pixel per 4 msec, red where the clock had run past it.
+==============
+*/
+static void SCR_DrawLerpGraph(void) {
+    const lerpstats_t *stats = &cl_lerpstats;
+    int i, x, y, height, color;
+    float ahead;
+    char st[80];
+
+    if (!cl_lerpgraph.value || cls.state != ca_active) return;
+
+    x = scr_vrect.x;
+    y = vid.height - sb_lines - 8;
+    for (i = 0; i < LERP_GRAPH; i++) {
+        ahead = stats->ahead[(stats->head + 1 + i) % LERP_GRAPH] * 1000.0;
+        color = ahead > 0 ? 56 : 73;
+        height = qmax(1, qmin((int)fabs(ahead) / 4, 32));
+        Draw_Fill(x + i, y - height, 1, height, color);
+    }
+
+    snprintf(st, sizeof(st), "%3.0fms jitter %2.0fms buf %d late %u", stats->delay * 1000.0,
+             stats->jitter * 1000.0, stats->depth, stats->late);
+    Draw_String(x, y - 32 - 10, st);
+}
+#endif
+
 /*
 ==============
 DrawPause
@@ -1168,6 +1200,7 @@ void SCR_UpdateScreen(void) {
 
 #ifdef NQ_HACK
     if (cls.state == ca_dedicated) return;  // stdout only
+    if (cls.td_nullvid) return;             // headless benchdemo
 #endif
 
     if (!scr_initialized || !con_initialized) return;  // not initialized yet
@@ -1274,6 +1307,9 @@ void SCR_UpdateScreen(void) {
         SCR_DrawRam();
         SCR_DrawNet();
         SCR_DrawFPS();
+#ifdef NQ_HACK
+        SCR_DrawLerpGraph();
+#endif
         SCR_DrawTurtle();
         SCR_DrawPause();
         SCR_DrawCenterString();
@@ -1324,6 +1360,40 @@ void SCR_UpdateScreen(void) {
 #endif
 }
 
+/*
+==================
+SCR_FrameChecksum
+
+Render the 3D view from the current client state without presenting it and
+return a checksum of the pixels, so benchmark runs can be compared. Returns
+zero if there is no world to draw.
+==================
+*/
+unsigned SCR_FrameChecksum(void) {
+    qboolean forcedup;
+
+    if (!scr_initialized || !cl.worldmodel) return 0;
+
+#ifdef GLQUAKE
+    GL_BeginRendering(&glx, &gly, &glwidth, &glheight);
+#else
+    VID_LockBuffer();
+#endif
+    if (vid.recalc_refdef) SCR_CalcRefdef();
+
+    /* the console state is stale if the screen wasn't being updated */
+    forcedup = con_forcedup;
+    con_forcedup = false;
+    V_RenderView();
+    con_forcedup = forcedup;
+
+#ifndef GLQUAKE
+    VID_UnlockBuffer();
+#endif
+
+    return R_FrameChecksum();
+}
+
 #if !defined(GLQUAKE) && defined(_WIN32)
 /*
 ==================
@@ -96,6 +96,7 @@ static cvar_t _snd_mixahead = {"_snd_mixahead", "0.1", true};
  */
 
 static qboolean fakedma = false;
+static double fakedma_time; /* simulated playback clock for -simsound */
 
 /* FIXME - unused functions? */
 #if 0
@@ -575,6 +576,8 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up) {
 
     if (!sound_started || (snd_blocked > 0)) return;
 
+    if (fakedma) fakedma_time += host_frametime;
+
     VectorCopy(origin, listener_origin);
     VectorCopy(forward, listener_forward);
     VectorCopy(right, listener_right);
@@ -648,7 +651,12 @@ static void GetSoundtime(void) {
      * it is possible to miscount buffers if it has wrapped twice between
      * calls to S_Update.  Oh well.
      */
-    samplepos = SNDDMA_GetDMAPos();
+    if (fakedma) {
+        /* the null device plays back in step with host time */
+        samplepos = ((long long)(fakedma_time * shm->speed) * shm->channels) & (shm->samples - 1);
+    } else {
+        samplepos = SNDDMA_GetDMAPos();
+    }
 
     /* Check for buffer wrap */
     if (samplepos < oldsamplepos) {
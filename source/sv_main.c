@@ -37,6 +37,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 server_t sv;
 server_static_t svs;
 
+cvar_t sv_maxrate = {"sv_maxrate", "0"};
+cvar_t sv_maxsnapshots = {"sv_maxsnapshots", "0"};
+
 /* inline model names for precache */
 #define MODSTRLEN (sizeof("*" stringify(MAX_MODELS)) / sizeof(char))
 static char localmodels[MAX_MODELS][MODSTRLEN];
@@ -146,9 +149,17 @@ void SV_Init(void) {
     Cvar_RegisterVariable(&sv_idealpitchscale);
     Cvar_RegisterVariable(&sv_aim);
     Cvar_RegisterVariable(&sv_nostep);
+    Cvar_RegisterVariable(&sv_parallelphysics);
+    Cvar_RegisterVariable(&sv_maxrate);
+    Cvar_RegisterVariable(&sv_maxsnapshots);
+
+    SV_SnapInit();
 
     Cmd_AddCommand("sv_protocol", SV_Protocol_f);
     Cmd_SetCompletion("sv_protocol", SV_Protocol_Arg_f);
+    Cmd_AddCommand("sv_physstress", SV_PhysStress_f);
+    Cmd_AddCommand("sv_tracebench", SV_TraceBench_f);
+    Cmd_AddCommand("sv_movebench", SV_MoveBench_f);
 
     for (i = 0; i < MAX_MODELS; i++) sprintf(localmodels[i], "*%i", i);
 }
@@ -303,42 +314,79 @@ CLIENT SPAWNING
 ==============================================================================
 */
 
+static int SV_GameType(void) {
+    return (!coop.value && deathmatch.value) ? GAME_DEATHMATCH : GAME_COOP;
+}
+
 /*
 ================
-SV_SendServerinfo
+SV_BuildServerinfo
 
-Sends the first message from the server to a connected client.
-This will be sent on the initial connection and upon each server load.
+The serverinfo message and precache lists are the same for every client,
+so they are written once per map instead of once per connection.
 ================
 */
-void SV_SendServerinfo(client_t *client) {
+static void SV_BuildServerinfo(void) {
+    sizebuf_t *msg = &sv.serverinfo;
     const char **s;
 
-    MSG_WriteByte(&client->message, svc_print);
-    MSG_WriteStringf(&client->message, "%c\nVERSION TyrQuake-%s SERVER (%i CRC)", 2,
-                     stringify(TYR_VERSION), pr_crc);
+    msg->data = sv.serverinfo_buf;
+    msg->maxsize = sizeof(sv.serverinfo_buf);
+    SZ_Clear(msg);
 
-    MSG_WriteByte(&client->message, svc_serverinfo);
-    MSG_WriteLong(&client->message, sv.protocol);
-    MSG_WriteByte(&client->message, svs.maxclients);
+    MSG_WriteByte(msg, svc_print);
+    MSG_WriteStringf(msg, "%c\nVERSION TyrQuake-%s SERVER (%i CRC)", 2, stringify(TYR_VERSION),
+                     pr_crc);
 
-    if (!coop.value && deathmatch.value)
-        MSG_WriteByte(&client->message, GAME_DEATHMATCH);
-    else
-        MSG_WriteByte(&client->message, GAME_COOP);
+    sv.gametype = SV_GameType();
+    MSG_WriteByte(msg, svc_serverinfo);
+    MSG_WriteLong(msg, sv.protocol);
+    MSG_WriteByte(msg, svs.maxclients);
+    MSG_WriteByte(msg, sv.gametype);
 
-    MSG_WriteString(&client->message, PR_GetString(sv.edicts->v.message));
+    MSG_WriteString(msg, PR_GetString(sv.edicts->v.message));
 
-    for (s = sv.model_precache + 1; *s; s++) MSG_WriteString(&client->message, *s);
-    MSG_WriteByte(&client->message, 0);
+    for (s = sv.model_precache + 1; *s; s++) MSG_WriteString(msg, *s);
+    MSG_WriteByte(msg, 0);
 
-    for (s = sv.sound_precache + 1; *s; s++) MSG_WriteString(&client->message, *s);
-    MSG_WriteByte(&client->message, 0);
+    for (s = sv.sound_precache + 1; *s; s++) MSG_WriteString(msg, *s);
+    MSG_WriteByte(msg, 0);
 
     // send music
-    MSG_WriteByte(&client->message, svc_cdtrack);
-    MSG_WriteByte(&client->message, sv.edicts->v.sounds);
-    MSG_WriteByte(&client->message, sv.edicts->v.sounds);
+    MSG_WriteByte(msg, svc_cdtrack);
+    MSG_WriteByte(msg, sv.edicts->v.sounds);
+    MSG_WriteByte(msg, sv.edicts->v.sounds);
+}
+
+/*
+================
+SV_SendSignonData
+
+Shared signon data is passed to the client by reference and goes out as a
+message of its own ahead of client->message. That only keeps the stream in
+order while nothing else is waiting, so otherwise it is copied in as usual.
+================
+*/
+void SV_SendSignonData(client_t *client, const sizebuf_t *data) {
+    if (!client->message.cursize && !client->signondata)
+        client->signondata = data;
+    else
+        SZ_Write(&client->message, data->data, data->cursize);
+}
+
+/*
+================
+SV_SendServerinfo
+
+Sends the first message from the server to a connected client.
+This will be sent on the initial connection and upon each server load.
+================
+*/
+void SV_SendServerinfo(client_t *client) {
+    /* deathmatch and coop may have been changed since the map started */
+    if (!sv.serverinfo.cursize || sv.gametype != SV_GameType()) SV_BuildServerinfo();
+
+    SV_SendSignonData(client, &sv.serverinfo);
 
     // set view
     MSG_WriteByte(&client->message, svc_setview);
@@ -389,6 +437,8 @@ void SV_ConnectClient(int clientnum) {
     client->message.data = client->msgbuf;
     client->message.maxsize = sizeof(client->msgbuf);
     client->message.allowoverflow = true;  // we can catch it
+    client->datagram.data = client->datagram_buf;
+    client->datagram.maxsize = sizeof(client->datagram_buf);
 
     if (sv.loadgame) {
         memcpy(client->spawn_parms, spawn_parms, sizeof(spawn_parms));
@@ -472,119 +522,240 @@ void SV_WriteModelIndex(sizebuf_t *sb, int c, unsigned int bits) {
     }
 }
 
+/*
+ * Largest update SV_WriteEntity can write, in any protocol. Checked before
+ * writing so the message itself never overflows.
+ */
+#define SV_MAXENTITYUPDATE 32
+
 /*
 =============
-SV_WriteEntitiesToClient
+SV_WriteEntity
 
+Writes one entity update if it fits in limit bytes of the message.
+Returns false, leaving the message as it was, if it does not.
 =============
 */
-void SV_WriteEntitiesToClient(edict_t *clent, sizebuf_t *msg) {
-    int e, i;
-    int bits;
-    const leafbits_t *pvs;
-    vec3_t org;
+static qboolean SV_WriteEntity(sizebuf_t *msg, int limit, const edict_t *ent, int e) {
+    int i, bits, start;
     float miss;
-    edict_t *ent;
-
-    // find the client's PVS
-    VectorAdd(clent->v.origin, clent->v.view_ofs, org);
-    pvs = Mod_FatPVS(sv.worldmodel, org);
-
-    // send over all entities (excpet the client) that touch the pvs
-    ent = NEXT_EDICT(sv.edicts);
-    for (e = 1; e < sv.num_edicts; e++, ent = NEXT_EDICT(ent)) {
-        // clent is ALWAYS sent
-        if (ent != clent) {
-            // ignore ents without visible models
-            if (!ent->v.modelindex || !*PR_GetString(ent->v.model)) continue;
 
-            // ignore if not touching a PV leaf
-            for (i = 0; i < ent->num_leafs; i++)
-                if (Mod_TestLeafBit(pvs, ent->leafnums[i])) break;
+    if (msg->maxsize - msg->cursize < SV_MAXENTITYUPDATE) return false;
+    start = msg->cursize;
 
-            if (i == ent->num_leafs) continue;  // not visible
-        }
-
-        if (msg->maxsize - msg->cursize < 16) {
-            Con_Printf("packet overflow\n");
-            return;
-        }
-        // send an update
-        bits = 0;
+    // send an update
+    bits = 0;
 
-        for (i = 0; i < 3; i++) {
-            miss = ent->v.origin[i] - ent->baseline.origin[i];
-            if (miss < -0.1 || miss > 0.1) bits |= U_ORIGIN1 << i;
-        }
+    for (i = 0; i < 3; i++) {
+        miss = ent->v.origin[i] - ent->baseline.origin[i];
+        if (miss < -0.1 || miss > 0.1) bits |= U_ORIGIN1 << i;
+    }
 
-        if (ent->v.angles[0] != ent->baseline.angles[0]) bits |= U_ANGLE1;
+    if (ent->v.angles[0] != ent->baseline.angles[0]) bits |= U_ANGLE1;
 
-        if (ent->v.angles[1] != ent->baseline.angles[1]) bits |= U_ANGLE2;
+    if (ent->v.angles[1] != ent->baseline.angles[1]) bits |= U_ANGLE2;
 
-        if (ent->v.angles[2] != ent->baseline.angles[2]) bits |= U_ANGLE3;
+    if (ent->v.angles[2] != ent->baseline.angles[2]) bits |= U_ANGLE3;
 
-        if (ent->v.movetype == MOVETYPE_STEP) bits |= U_NOLERP;  // don't mess up the step animation
+    if (ent->v.movetype == MOVETYPE_STEP) bits |= U_NOLERP;  // don't mess up the step animation
 
-        if (ent->baseline.colormap != ent->v.colormap) bits |= U_COLORMAP;
+    if (ent->baseline.colormap != ent->v.colormap) bits |= U_COLORMAP;
 
-        if (ent->baseline.skinnum != ent->v.skin) bits |= U_SKIN;
+    if (ent->baseline.skinnum != ent->v.skin) bits |= U_SKIN;
 
-        if (ent->baseline.frame != ent->v.frame) bits |= U_FRAME;
+    if (ent->baseline.frame != ent->v.frame) bits |= U_FRAME;
 
-        if (ent->baseline.effects != ent->v.effects) bits |= U_EFFECTS;
+    if (ent->baseline.effects != ent->v.effects) bits |= U_EFFECTS;
 
-        if (ent->baseline.modelindex != ent->v.modelindex) bits |= U_MODEL;
+    if (ent->baseline.modelindex != ent->v.modelindex) bits |= U_MODEL;
 
-        /* FIXME - TODO: add alpha stuff here */
+    /* FIXME - TODO: add alpha stuff here */
 
-        if (sv.protocol == PROTOCOL_VERSION_FITZ) {
-            if ((bits & U_FRAME) && ((int)ent->v.frame & 0xff00)) bits |= U_FITZ_FRAME2;
-            if ((bits & U_MODEL) && ((int)ent->v.modelindex & 0xff00)) bits |= U_FITZ_MODEL2;
-            /* FIXME - Add the U_LERPFINISH bit */
-            if (bits & 0x00ff0000) bits |= U_FITZ_EXTEND1;
-            if (bits & 0xff000000) bits |= U_FITZ_EXTEND2;
-        }
+    if (sv.protocol == PROTOCOL_VERSION_FITZ) {
+        if ((bits & U_FRAME) && ((int)ent->v.frame & 0xff00)) bits |= U_FITZ_FRAME2;
+        if ((bits & U_MODEL) && ((int)ent->v.modelindex & 0xff00)) bits |= U_FITZ_MODEL2;
+        /* FIXME - Add the U_LERPFINISH bit */
+        if (bits & 0x00ff0000) bits |= U_FITZ_EXTEND1;
+        if (bits & 0xff000000) bits |= U_FITZ_EXTEND2;
+    }
 
-        if (e >= 256) bits |= U_LONGENTITY;
+    if (e >= 256) bits |= U_LONGENTITY;
 
-        if (bits >= 256) bits |= U_MOREBITS;
+    if (bits >= 256) bits |= U_MOREBITS;
 
-        //
-        // write the message
-        //
-        MSG_WriteByte(msg, bits | U_SIGNAL);
+    //
+    // write the message
+    //
+    MSG_WriteByte(msg, bits | U_SIGNAL);
 
-        if (bits & U_MOREBITS) MSG_WriteByte(msg, bits >> 8);
-        if (bits & U_FITZ_EXTEND1) MSG_WriteByte(msg, bits >> 16);
-        if (bits & U_FITZ_EXTEND2) MSG_WriteByte(msg, bits >> 24);
+    if (bits & U_MOREBITS) MSG_WriteByte(msg, bits >> 8);
+    if (bits & U_FITZ_EXTEND1) MSG_WriteByte(msg, bits >> 16);
+    if (bits & U_FITZ_EXTEND2) MSG_WriteByte(msg, bits >> 24);
 
-        if (bits & U_LONGENTITY)
-            MSG_WriteShort(msg, e);
-        else
-            MSG_WriteByte(msg, e);
-
-        if (bits & U_MODEL) SV_WriteModelIndex(msg, ent->v.modelindex, 0);
-        if (bits & U_FRAME) MSG_WriteByte(msg, ent->v.frame);
-        if (bits & U_COLORMAP) MSG_WriteByte(msg, ent->v.colormap);
-        if (bits & U_SKIN) MSG_WriteByte(msg, ent->v.skin);
-        if (bits & U_EFFECTS) MSG_WriteByte(msg, ent->v.effects);
-        if (bits & U_ORIGIN1) MSG_WriteCoord(msg, ent->v.origin[0]);
-        if (bits & U_ANGLE1) MSG_WriteAngle(msg, ent->v.angles[0]);
-        if (bits & U_ORIGIN2) MSG_WriteCoord(msg, ent->v.origin[1]);
-        if (bits & U_ANGLE2) MSG_WriteAngle(msg, ent->v.angles[1]);
-        if (bits & U_ORIGIN3) MSG_WriteCoord(msg, ent->v.origin[2]);
-        if (bits & U_ANGLE3) MSG_WriteAngle(msg, ent->v.angles[2]);
+    if (bits & U_LONGENTITY)
+        MSG_WriteShort(msg, e);
+    else
+        MSG_WriteByte(msg, e);
+
+    if (bits & U_MODEL) SV_WriteModelIndex(msg, ent->v.modelindex, 0);
+    if (bits & U_FRAME) MSG_WriteByte(msg, ent->v.frame);
+    if (bits & U_COLORMAP) MSG_WriteByte(msg, ent->v.colormap);
+    if (bits & U_SKIN) MSG_WriteByte(msg, ent->v.skin);
+    if (bits & U_EFFECTS) MSG_WriteByte(msg, ent->v.effects);
+    if (bits & U_ORIGIN1) MSG_WriteCoord(msg, ent->v.origin[0]);
+    if (bits & U_ANGLE1) MSG_WriteAngle(msg, ent->v.angles[0]);
+    if (bits & U_ORIGIN2) MSG_WriteCoord(msg, ent->v.origin[1]);
+    if (bits & U_ANGLE2) MSG_WriteAngle(msg, ent->v.angles[1]);
+    if (bits & U_ORIGIN3) MSG_WriteCoord(msg, ent->v.origin[2]);
+    if (bits & U_ANGLE3) MSG_WriteAngle(msg, ent->v.angles[2]);
 #if 0 /* FIXME */
     if (bits & U_FITZ_ALPHA)
         MSG_WriteByte(msg, ent->alpha);
 #endif
-        if (bits & U_FITZ_FRAME2) MSG_WriteByte(msg, (int)ent->v.frame >> 8);
-        if (bits & U_FITZ_MODEL2) MSG_WriteByte(msg, (int)ent->v.modelindex >> 8);
+    if (bits & U_FITZ_FRAME2) MSG_WriteByte(msg, (int)ent->v.frame >> 8);
+    if (bits & U_FITZ_MODEL2) MSG_WriteByte(msg, (int)ent->v.modelindex >> 8);
 #if 0 /* FIXME */
     if (bits & U_FITZ_LERPFINISH)
         MSG_WriteByte(msg, (byte)floorf(((ent->v.nextthink - sv.time) * 255.0f) + 0.5f));
 #endif
+
+    if (msg->cursize > limit) {
+        msg->cursize = start;
+        return false;
     }
+
+    return true;
+}
+
+typedef struct {
+    edict_t *ent;
+    int num;
+    qboolean shown; /* in the last datagram */
+    float priority; /* lower is sent first */
+} sv_sendent_t;
+
+static sv_sendent_t sv_sendents[MAX_EDICTS];
+
+static int SV_CompareSendEnts(const void *a, const void *b) {
+    const sv_sendent_t *ea = a;
+    const sv_sendent_t *eb = b;
+
+    if (ea->priority != eb->priority) return ea->priority < eb->priority ? -1 : 1;
+    return ea->num - eb->num;
+}
+
+/*
+=============
+SV_EntityPriority
+
+Distance from the viewer, less for players, anything lighting the scene
+and anything the client is already showing, and less again the longer the
+entity has been left out, so that an entity waiting to come into view soon
+overtakes the shown ones it is competing with.
+=============
+*/
+static float SV_EntityPriority(const client_t *client, const sv_sendent_t *send,
+                               const vec3_t org) {
+    const edict_t *ent = send->ent;
+    int e = send->num;
+    vec3_t center, delta;
+    float priority;
+
+    if (ent == client->edict) return -1;  // own entity always goes first
+
+    VectorAdd(ent->v.absmin, ent->v.absmax, center);
+    VectorScale(center, 0.5, center);
+    VectorSubtract(center, org, delta);
+    priority = Length(delta);
+
+    if (e <= svs.maxclients) priority *= 0.5;
+    if ((int)ent->v.effects & (EF_MUZZLEFLASH | EF_BRIGHTLIGHT | EF_DIMLIGHT)) priority *= 0.5;
+    if (send->shown) priority *= 0.5;
+
+    return priority / (1 + client->entskips[e]);
+}
+
+/*
+=============
+SV_WriteEntitiesToClient
+
+Writes every visible entity that fits in limit bytes of the message. When
+they do not all fit the nearest and most relevant go first. The client
+hides any entity missing from an update, so one in the last datagram may
+still go past the limit, while the message has room, unless an entity
+ranked ahead of it has been left out. Returns the number left out.
+=============
+*/
+int SV_WriteEntitiesToClient(client_t *client, sizebuf_t *msg, int limit) {
+    int e, i, count, start, dropped;
+    const leafbits_t *pvs;
+    vec3_t org;
+    edict_t *clent, *ent;
+    sv_sendent_t *send;
+
+    // find the client's PVS
+    clent = client->edict;
+    VectorAdd(clent->v.origin, clent->v.view_ofs, org);
+    pvs = Mod_FatPVS(sv.worldmodel, org);
+
+    // send over all entities (excpet the client) that touch the pvs
+    count = 0;
+    ent = NEXT_EDICT(sv.edicts);
+    for (e = 1; e < sv.num_edicts; e++, ent = NEXT_EDICT(ent)) {
+        // clent is ALWAYS sent
+        if (ent != clent) {
+            // ignore ents without visible models
+            if (!ent->v.modelindex || !*PR_GetString(ent->v.model)) continue;
+
+            // ignore if not touching a PV leaf
+            for (i = 0; i < ent->num_leafs; i++)
+                if (Mod_TestLeafBit(pvs, ent->leafnums[i])) break;
+
+            if (i == ent->num_leafs) continue;  // not visible
+        }
+        sv_sendents[count].ent = ent;
+        sv_sendents[count].num = e;
+        sv_sendents[count].shown = client->entsent[e] || ent == clent;
+        count++;
+    }
+    memset(client->entsent, 0, sv.num_edicts);
+
+    // the common case: everything fits, in entity order
+    start = msg->cursize;
+    for (i = 0; i < count; i++) {
+        send = &sv_sendents[i];
+        if (!SV_WriteEntity(msg, limit, send->ent, send->num)) break;
+    }
+    if (i == count) {
+        for (i = 0; i < count; i++) {
+            client->entskips[sv_sendents[i].num] = 0;
+            client->entsent[sv_sendents[i].num] = 1;
+        }
+        return 0;
+    }
+
+    // start again with the most important first
+    msg->cursize = start;
+    for (i = 0; i < count; i++) {
+        send = &sv_sendents[i];
+        send->priority = SV_EntityPriority(client, send, org);
+    }
+    qsort(sv_sendents, count, sizeof(sv_sendents[0]), SV_CompareSendEnts);
+
+    dropped = 0;
+    for (i = 0; i < count; i++) {
+        send = &sv_sendents[i];
+        if (SV_WriteEntity(msg, send->shown && !dropped ? msg->maxsize : limit, send->ent,
+                           send->num)) {
+            client->entskips[send->num] = 0;
+            client->entsent[send->num] = 1;
+            continue;
+        }
+        if (client->entskips[send->num] < 255) client->entskips[send->num]++;
+        dropped++;
+    }
+
+    return dropped;
 }
 
 /*
@@ -759,6 +930,55 @@ void SV_WriteClientdataToMessage(edict_t *player, sizebuf_t *msg) {
 #endif
 }
 
+/*
+ * ===========================================================================
+ *
+ * Rate control
+ *
+ * A client can ask for at most "rate" bytes/sec and "snaps" datagrams/sec;
+ * sv_maxrate and sv_maxsnapshots cap what any client gets, 0 meaning no
+ * limit. Datagrams are skipped until the last ones have drained at the
+ * client's rate, and each may carry one snapshot interval's worth of bytes
+ * (a tenth of a second's worth if snaps is unlimited). The sounds and
+ * effects of skipped frames are held in the client's own datagram buffer
+ * and go out first in the next one. Entities that do not fit are left for
+ * a later datagram, nearest and most relevant first, with those already
+ * shown favoured so they do not flicker. Loopback clients are never limited.
+ *
+ * ===========================================================================
+ */
+
+#define SV_MINBUDGET 256 /* room for the client data and a few entities */
+
+static int SV_ClientLimit(int value, float max) {
+    if (max > 0 && (!value || value > max)) return max;
+    return value;
+}
+
+static int SV_ClientRate(const client_t *client) {
+    if (IS_LOOP_DRIVER(client->netconnection->driver)) return 0;
+    return SV_ClientLimit(client->rate, sv_maxrate.value);
+}
+
+static int SV_ClientSnaps(const client_t *client) {
+    if (IS_LOOP_DRIVER(client->netconnection->driver)) return 0;
+    return SV_ClientLimit(client->snaps, sv_maxsnapshots.value);
+}
+
+/*
+=======================
+SV_ChargeRate
+
+Accounts for bytes just sent to the client
+=======================
+*/
+static void SV_ChargeRate(client_t *client, int bytes) {
+    int rate = SV_ClientRate(client);
+
+    if (!rate) return;
+    client->cleartime = qmax(client->cleartime, realtime) + (double)bytes / rate;
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -767,10 +987,34 @@ SV_SendClientDatagram
 qboolean SV_SendClientDatagram(client_t *client) {
     byte buf[MAX_DATAGRAM];
     sizebuf_t msg;
-    int err;
+    int err, rate, snaps, budget, dropped;
+    double interval;
 
-    msg.data = buf;
-    msg.maxsize = qmin(MAX_DATAGRAM, client->netconnection->mtu);
+    /* hold this frame's sounds and effects until a datagram goes out */
+    if (client->datagram.cursize + sv.datagram.cursize <= client->datagram.maxsize)
+        SZ_Write(&client->datagram, sv.datagram.data, sv.datagram.cursize);
+    else
+        Con_DPrintf("datagram overflow for %s\n", client->name);
+
+    rate = SV_ClientRate(client);
+    snaps = SV_ClientSnaps(client);
+    if ((snaps && realtime < client->nextsnapshot) || (rate && realtime < client->cleartime)) {
+        client->skipped++;
+        return true;
+    }
+    if (snaps) {
+        interval = 1.0 / snaps;
+        if (client->nextsnapshot < realtime - interval) client->nextsnapshot = realtime;
+        client->nextsnapshot += interval;
+    }
+
+    /* built straight in the receiver's buffer, if the driver allows */
+    msg.data = NET_SendBuffer(client->netconnection, &msg.maxsize);
+    if (!msg.data) {
+        msg.data = buf;
+        msg.maxsize = MAX_DATAGRAM;
+    }
+    msg.maxsize = qmin(msg.maxsize, qmin(MAX_DATAGRAM, client->netconnection->mtu));
     msg.cursize = 0;
 
     MSG_WriteByte(&msg, svc_time);
@@ -778,11 +1022,24 @@ qboolean SV_SendClientDatagram(client_t *client) {
 
     // add the client specific data to the datagram
     SV_WriteClientdataToMessage(client->edict, &msg);
-    SV_WriteEntitiesToClient(client->edict, &msg);
 
-    // copy the server datagram if there is space
-    if (msg.cursize + sv.datagram.cursize < msg.maxsize)
-        SZ_Write(&msg, sv.datagram.data, sv.datagram.cursize);
+    /* the held sounds and effects, ahead of any entities */
+    if (msg.cursize + client->datagram.cursize <= msg.maxsize)
+        SZ_Write(&msg, client->datagram.data, client->datagram.cursize);
+    else
+        Con_DPrintf("datagram overflow for %s\n", client->name);
+    SZ_Clear(&client->datagram);
+
+    /* entities get what is left of the budget */
+    budget = msg.maxsize;
+    if (rate) budget = qmin(budget, qmax(SV_MINBUDGET, (int)(rate * (snaps ? 1.0 / snaps : 0.1))));
+    dropped = SV_WriteEntitiesToClient(client, &msg, budget);
+    if (dropped && budget < msg.maxsize) {
+        client->thinned++;
+    } else if (dropped) {
+        client->overflows++;
+        Con_DPrintf("packet overflow for %s (%d entities)\n", client->name, dropped);
+    }
 
     // send the datagram
     err = NET_SendUnreliableMessage(client->netconnection, &msg);
@@ -791,6 +1048,8 @@ qboolean SV_SendClientDatagram(client_t *client) {
         SV_DropClient(client, true);
         return false;
     }
+    client->sent++;
+    SV_ChargeRate(client, msg.cursize);
 
     return true;
 }
@@ -895,7 +1154,7 @@ void SV_SendClientMessages(void) {
             continue;
         }
 
-        if (!client->message.cursize && !client->dropasap) continue;
+        if (!client->message.cursize && !client->signondata && !client->dropasap) continue;
         if (!NET_CanSendMessage(client->netconnection)) continue;
 
         if (client->dropasap) {
@@ -904,13 +1163,29 @@ void SV_SendClientMessages(void) {
             continue;
         }
 
+        if (client->signondata) {
+            /* sent straight from the shared buffer, the rest follows */
+            err = NET_SendMessage(client->netconnection, client->signondata);
+            if (err == -1)
+                SV_DropClient(client, true);
+            else
+                SV_ChargeRate(client, client->signondata->cursize);
+            client->signondata = NULL;
+            client->last_message = realtime;
+            continue;
+        }
+
         err = NET_SendMessage(client->netconnection, &client->message);
-        if (err == -1) SV_DropClient(client, true);
+        if (err == -1)
+            SV_DropClient(client, true);
+        else
+            SV_ChargeRate(client, client->message.cursize);
 
         SZ_Clear(&client->message);
         client->last_message = realtime;
         client->sendsignon = false;
     }
+    NET_Flush();
 
     /* clear muzzle flashes */
     SV_CleanupEnts();
@@ -1033,7 +1308,7 @@ void SV_SendReconnect(void) {
 
     MSG_WriteChar(&msg, svc_stufftext);
     MSG_WriteString(&msg, "reconnect\n");
-    NET_SendToAll(&msg, 5);
+    NET_SendToAll(&msg, 0);
 
     if (cls.state != ca_dedicated) Cmd_ExecuteString("reconnect\n", src_command);
 }
@@ -1115,6 +1390,7 @@ void SV_SpawnServer(char *server) {
     // allocate server memory
     sv.max_edicts = MAX_EDICTS;
     sv.edicts = Hunk_AllocName(sv.max_edicts * pr_edict_size, "edicts");
+    SV_RewindNewMap();
 
     sv.datagram.maxsize = sizeof(sv.datagram_buf);
     sv.datagram.cursize = 0;
@@ -1134,6 +1410,7 @@ void SV_SpawnServer(char *server) {
         ent = EDICT_NUM(i + 1);
         svs.clients[i].edict = ent;
     }
+    ED_ResetLists();
 
     sv.state = ss_loading;
     sv.paused = false;
@@ -1207,10 +1484,18 @@ void SV_SpawnServer(char *server) {
     // create a baseline for more efficient communications
     SV_CreateBaseline();
 
+    // build the signon once, every client gets the same
+    SV_BuildServerinfo();
+
     // send serverinfo to all connected clients
     client = svs.clients;
-    for (i = 0; i < svs.maxclients; i++, client++)
+    for (i = 0; i < svs.maxclients; i++, client++) {
+        client->signondata = NULL; /* anything pending was for the last map */
+        memset(client->entskips, 0, sizeof(client->entskips));
+        memset(client->entsent, 0, sizeof(client->entsent));
+        SZ_Clear(&client->datagram);
         if (client->active) SV_SendServerinfo(client);
+    }
 
     Con_DPrintf("Server spawned.\n");
 }
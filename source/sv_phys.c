@@ -19,7 +19,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // sv_phys.c
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmd.h"
 #include "console.h"
+#include "pr_native.h"
 #include "progs.h"
 #include "server.h"
 #include "world.h"
@@ -361,24 +366,27 @@ static int SV_FlyMove(edict_t *ent, float time, trace_t *steptrace) {
 
 /*
 ============
-SV_AddGravity
+SV_Gravity
 
+The speed an entity loses to gravity this frame
 ============
 */
-static void SV_AddGravity(edict_t *ent) {
+static double SV_Gravity(edict_t *ent) {
 #ifdef NQ_HACK
     float scale;
     eval_t *val;
 
     val = GetEdictFieldValue(ent, "gravity");
     scale = (val && val->_float) ? val->_float : 1.0;
-    ent->v.velocity[2] -= scale * sv_gravity.value * host_frametime;
+    return scale * sv_gravity.value * host_frametime;
 #endif
 #ifdef QW_HACK
-    ent->v.velocity[2] -= movevars.gravity * host_frametime;
+    return movevars.gravity * host_frametime;
 #endif
 }
 
+static void SV_AddGravity(edict_t *ent) { ent->v.velocity[2] -= SV_Gravity(ent); }
+
 /*
 ===============================================================================
 
@@ -387,6 +395,193 @@ PUSHMOVE
 ===============================================================================
 */
 
+static movetype_t SV_PushMoveType(const edict_t *ent) {
+    if (ent->v.movetype == MOVETYPE_FLYMISSILE) return MOVE_MISSILE;
+
+    /* only clip against bmodels */
+    if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT) return MOVE_NOMONSTERS;
+
+    return MOVE_NORMAL;
+}
+
+/*
+===============================================================================
+
+PARALLEL TOSS MOVEMENT
+
+With sv_parallelphysics set, the traces for toss, bounce and fly entities
+that will move this frame without thinking are computed up front on the
+worker threads, before any QuakeC runs. The frame then proceeds serially in
+edict order as usual and each entity picks up its precomputed trace, as long
+as its own move still matches what was predicted, nothing outside the
+batch has since been linked or unlinked across its path and the entities it
+was tested against still have the solid, owner, FL_MONSTER flag and origin
+it saw. Anything else is traced again on the spot, which is also where any
+error the trace ran into gets raised. Entities in the batch see each other where they
+were at the start of the frame.
+
+===============================================================================
+*/
+
+#define MIN_PARALLEL_MOVES 32 /* not worth waking the workers for fewer */
+#define MAX_TOSSCLIPS 8        /* candidates recorded per move */
+
+cvar_t sv_parallelphysics = {"sv_parallelphysics", "0"};
+
+typedef struct {
+    edict_t *ent;
+    vec3_t start, end;
+    vec3_t mins, maxs;
+    vec3_t movemins, movemaxs; /* everything the trace could have clipped against */
+    movetype_t type;
+    int owner;
+    const edict_t *blocker;
+    trace_t trace;
+    tracerecord_t record;
+    traceclip_t clips[MAX_TOSSCLIPS];
+} svtossmove_t;
+
+static svtossmove_t sv_tossmoves[MAX_EDICTS];
+static byte sv_tossmoving[MAX_EDICTS]; /* by edict number, skipped by the move log */
+static int sv_numtossmoves;
+static int sv_nexttossmove;
+
+/*
+ * Predicts the move SV_Physics_Toss will make, following the same steps
+ * without changing the entity. Returns false if the entity may think, is
+ * resting, or needs its velocity or origin fixed up first.
+ */
+static qboolean SV_PredictTossMove(edict_t *ent, svtossmove_t *move) {
+    qboolean onground;
+    vec3_t velocity, push;
+    int i;
+
+    if (ent->v.movetype != MOVETYPE_TOSS && ent->v.movetype != MOVETYPE_BOUNCE &&
+        ent->v.movetype != MOVETYPE_FLY && ent->v.movetype != MOVETYPE_FLYMISSILE)
+        return false;
+    if (ent->v.nextthink > 0 && ent->v.nextthink <= sv.time + host_frametime) return false;
+
+    onground = ((int)ent->v.flags & FL_ONGROUND) != 0;
+#ifdef QW_HACK
+    if (ent->v.velocity[2] > 0) onground = false;
+#endif
+    if (onground) return false;
+
+    for (i = 0; i < 3; i++) {
+        if (IS_NAN(ent->v.velocity[i]) || IS_NAN(ent->v.origin[i])) return false;
+        velocity[i] = ent->v.velocity[i];
+        if (velocity[i] > sv_maxvelocity.value)
+            velocity[i] = sv_maxvelocity.value;
+        else if (velocity[i] < -sv_maxvelocity.value)
+            velocity[i] = -sv_maxvelocity.value;
+    }
+    if (ent->v.movetype != MOVETYPE_FLY && ent->v.movetype != MOVETYPE_FLYMISSILE)
+        velocity[2] -= SV_Gravity(ent);
+
+    VectorScale(velocity, host_frametime, push);
+    VectorCopy(ent->v.origin, move->start);
+    VectorAdd(ent->v.origin, push, move->end);
+    VectorCopy(ent->v.mins, move->mins);
+    VectorCopy(ent->v.maxs, move->maxs);
+    move->type = SV_PushMoveType(ent);
+    move->owner = ent->v.owner;
+    move->ent = ent;
+
+    /* as SV_TraceMove, allowing for the larger monster box of missiles */
+    for (i = 0; i < 3; i++) {
+        move->movemins[i] = qmin(move->start[i], move->end[i]) - 1;
+        move->movemaxs[i] = qmax(move->start[i], move->end[i]) + 1;
+        if (move->type == MOVE_MISSILE) {
+            move->movemins[i] += qmin(move->mins[i], -15.0f);
+            move->movemaxs[i] += qmax(move->maxs[i], 15.0f);
+        } else {
+            move->movemins[i] += move->mins[i];
+            move->movemaxs[i] += move->maxs[i];
+        }
+    }
+
+    return true;
+}
+
+static void SV_TossMoveJob(int index, void *data) {
+    svtossmove_t *move = &sv_tossmoves[index];
+
+    move->record.clips = move->clips;
+    move->record.max = MAX_TOSSCLIPS;
+    move->blocker = SV_TraceMoveRecord(move->start, move->mins, move->maxs, move->end,
+                                       move->type, move->ent, &move->trace, &move->record);
+}
+
+/*
+================
+SV_BeginTossMoves
+
+Collects the moves to run in parallel and traces them all against the world
+as it stands at the start of the frame.
+================
+*/
+static void SV_BeginTossMoves(void) {
+    edict_t *ent;
+    int i;
+
+    sv_numtossmoves = 0;
+    sv_nexttossmove = 0;
+    if (!sv_parallelphysics.value) return;
+
+    memset(sv_tossmoving, 0, sizeof(sv_tossmoving));
+    ent = sv.edicts;
+    for (i = 0; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent)) {
+        if (ent->free) continue;
+#ifdef NQ_HACK
+        if (i <= svs.maxclients) continue;
+#endif
+#ifdef QW_HACK
+        if (i <= MAX_CLIENTS) continue;
+#endif
+        if (SV_PredictTossMove(ent, &sv_tossmoves[sv_numtossmoves])) {
+            sv_tossmoving[i] = 1;
+            sv_numtossmoves++;
+        }
+    }
+    if (sv_numtossmoves < MIN_PARALLEL_MOVES) {
+        sv_numtossmoves = 0;
+        return;
+    }
+
+    Sys_ParallelFor(sv_numtossmoves, SV_TossMoveJob, NULL);
+    SV_OpenMoveLog(sv_tossmoving);
+}
+
+static void SV_EndTossMoves(void) {
+    if (sv_numtossmoves) SV_CloseMoveLog();
+    sv_numtossmoves = 0;
+}
+
+/* The precomputed move for ent, if there is one. Must be called in edict order. */
+static const svtossmove_t *SV_FindTossMove(const edict_t *ent) {
+    const svtossmove_t *move;
+
+    while (sv_nexttossmove < sv_numtossmoves) {
+        move = &sv_tossmoves[sv_nexttossmove];
+        if (move->ent > ent) break;
+        sv_nexttossmove++;
+        if (move->ent == ent) return move;
+    }
+
+    return NULL;
+}
+
+static qboolean SV_TossMoveValid(const svtossmove_t *move, const edict_t *ent, const vec3_t end,
+                                 movetype_t type) {
+    if (!VectorCompare(move->start, ent->v.origin) || !VectorCompare(move->end, end)) return false;
+    if (!VectorCompare(move->mins, ent->v.mins) || !VectorCompare(move->maxs, ent->v.maxs))
+        return false;
+    if (move->type != type || move->owner != ent->v.owner) return false;
+    if (!SV_RecordValid(&move->record)) return false;
+
+    return !SV_MoveLogTouches(move->movemins, move->movemaxs);
+}
+
 /*
 ============
 SV_PushEntity
@@ -394,22 +589,22 @@ SV_PushEntity
 Does not change the entities velocity at all
 ============
 */
-static const edict_t *SV_PushEntity(edict_t *ent, const vec3_t push, trace_t *trace) {
+static const edict_t *SV_PushEntityMove(edict_t *ent, const vec3_t push, trace_t *trace,
+                                        const svtossmove_t *precomputed) {
     vec3_t end;
     movetype_t movetype;
     const edict_t *blocker;
 
     VectorAdd(ent->v.origin, push, end);
+    movetype = SV_PushMoveType(ent);
 
-    if (ent->v.movetype == MOVETYPE_FLYMISSILE)
-        movetype = MOVE_MISSILE;
-    else if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
-        /* only clip against bmodels */
-        movetype = MOVE_NOMONSTERS;
-    else
-        movetype = MOVE_NORMAL;
-
-    blocker = SV_TraceMoveEntity(ent, ent->v.origin, end, movetype, trace);
+    if (precomputed && SV_TossMoveValid(precomputed, ent, end, movetype)) {
+        *trace = precomputed->trace;
+        blocker = precomputed->blocker;
+        if (trace->backedup) Con_DPrintf("backup past 0\n");
+    } else {
+        blocker = SV_TraceMoveEntity(ent, ent->v.origin, end, movetype, trace);
+    }
     VectorCopy(trace->endpos, ent->v.origin);
     SV_LinkEdict(ent, true);
 
@@ -418,6 +613,10 @@ static const edict_t *SV_PushEntity(edict_t *ent, const vec3_t push, trace_t *tr
     return blocker;
 }
 
+static const edict_t *SV_PushEntity(edict_t *ent, const vec3_t push, trace_t *trace) {
+    return SV_PushEntityMove(ent, push, trace, NULL);
+}
+
 /*
 ============
 SV_Push
@@ -1075,7 +1274,7 @@ static void SV_Physics_Toss(edict_t *ent) {
 
     /* move origin */
     VectorScale(ent->v.velocity, host_frametime, move);
-    ground = SV_PushEntity(ent, move, &trace);
+    ground = SV_PushEntityMove(ent, move, &trace, SV_FindTossMove(ent));
     if (trace.fraction == 1) return;
     if (ent->free) return;
 
@@ -1255,6 +1454,8 @@ void SV_Physics(void) {
 #endif
 
     SV_CheckAllEnts();
+    SV_BeginTossMoves();
+    sv_linkstats.frames++;
 
     /*
      * Treat each object in turn.
@@ -1293,9 +1494,92 @@ void SV_Physics(void) {
 #endif
     }
 
+    SV_EndTossMoves();
+
     if (pr_global_struct->force_retouch) pr_global_struct->force_retouch--;
 
 #ifdef NQ_HACK
     sv.time += host_frametime;
 #endif
+
+    PR_NativeFrame();
+    SV_RewindFrame();
+}
+
+/*
+================
+SV_PhysStress_f
+
+sv_physstress <count> : throw count gibs and nails around from the first
+                        client, replacing any from the last time; time the
+                        result with host_profile and sv_parallelphysics
+================
+*/
+static int SV_PrecachedModel(const char *name) {
+    const char **check;
+    int i;
+
+    for (i = 0, check = sv.model_precache; *check; i++, check++)
+        if (!strcmp(*check, name)) return i;
+
+    return 0;
+}
+
+void SV_PhysStress_f(void) {
+    static const char *const classname = "physstress";
+    edict_t *ent, *player;
+    int i, count, gibmodel, nailmodel;
+
+    if (Cmd_Argc() != 2) {
+        Con_Printf("sv_physstress <count> : spawn gibs and nails to stress server physics\n");
+        return;
+    }
+    if (!sv.active) {
+        Con_Printf("No server running\n");
+        return;
+    }
+
+    ent = NEXT_EDICT(sv.edicts);
+    for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent))
+        if (!ent->free && !strcmp(PR_GetString(ent->v.classname), classname)) ED_Free(ent);
+
+    player = EDICT_NUM(1);
+    if (player->free) return;
+
+    gibmodel = SV_PrecachedModel("progs/gib1.mdl");
+    nailmodel = SV_PrecachedModel("progs/spike.mdl");
+    /* leave some room for the progs */
+    count = qmin(Q_atoi(Cmd_Argv(1)), MAX_EDICTS - 64 - sv.num_edicts);
+    for (i = 0; i < count; i++) {
+        ent = ED_Alloc();
+        ED_SetString(&ent->v.classname, classname);
+        VectorCopy(player->v.origin, ent->v.origin);
+        ent->v.origin[2] += 16;
+        ent->v.velocity[0] = (rand() % 1024) - 512;
+        ent->v.velocity[1] = (rand() % 1024) - 512;
+        if (i & 1) {
+            /* nail, flies until it comes to rest on a floor */
+            ent->v.velocity[2] = (rand() % 256) - 128;
+            VectorNormalize(ent->v.velocity);
+            VectorScale(ent->v.velocity, 1000, ent->v.velocity);
+            ent->v.movetype = MOVETYPE_FLYMISSILE;
+            ent->v.solid = SOLID_BBOX;
+            ent->v.owner = EDICT_TO_PROG(player);
+            ent->v.model = nailmodel ? PR_SetString(sv.model_precache[nailmodel]) : 0;
+            ent->v.modelindex = nailmodel;
+        } else {
+            /* gib, bounces off the world only */
+            ent->v.velocity[2] = 200 + (rand() % 400);
+            ent->v.avelocity[0] = rand() % 600;
+            ent->v.avelocity[1] = rand() % 600;
+            ent->v.avelocity[2] = rand() % 600;
+            ent->v.movetype = MOVETYPE_BOUNCE;
+            ent->v.solid = SOLID_NOT;
+            ent->v.model = gibmodel ? PR_SetString(sv.model_precache[gibmodel]) : 0;
+            ent->v.modelindex = gibmodel;
+        }
+        SV_LinkEdict(ent, false);
+    }
+
+    Con_Printf("%d gibs and %d nails spawned\n", count - count / 2, count / 2);
 }
@@ -0,0 +1,778 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+/* sv_snap.c -- binary server snapshots for save, load and rewind */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmd.h"
+#include "common.h"
+#include "console.h"
+#include "cvar.h"
+#include "host.h"
+#include "progs.h"
+#include "protocol.h"
+#include "quakedef.h"
+#include "server.h"
+#include "sys.h"
+#include "world.h"
+#include "zone.h"
+
+/*
+ * A snapshot is the QuakeC view of the server: globals, the string table,
+ * lightstyles and, for each edict, its free flag, freetime and progs fields.
+ * Area links and the other engine-side parts of edict_t are rebuilt on
+ * restore by relinking. Edicts are stored packed as a snapedict_t followed
+ * by progs->entityfields ints.
+ */
+typedef struct {
+    int free;
+    float freetime;
+} snapedict_t;
+
+#define SNAP_MAGIC (('P' << 24) | ('N' << 16) | ('S' << 8) | 'Q')
+#define SNAP_VERSION 1
+#define SNAP_WRITE_CHUNK (64 * 1024) /* bytes written to disk per host frame */
+
+cvar_t sv_rewind = {"sv_rewind", "0"};          /* seconds of history, 0 disables */
+cvar_t sv_rewindrate = {"sv_rewindrate", "10"}; /* snapshots per second */
+
+static int SV_SnapEdictSize(void) { return sizeof(snapedict_t) + progs->entityfields * 4; }
+
+static void SV_SnapPackEdict(byte *dst, const edict_t *ed) {
+    snapedict_t *packed = (snapedict_t *)dst;
+
+    packed->free = ed->free;
+    packed->freetime = ed->freetime;
+    memcpy(dst + sizeof(*packed), &ed->v, progs->entityfields * 4);
+}
+
+static qboolean SV_SnapEdictChanged(const byte *packed, const edict_t *ed) {
+    const snapedict_t *old = (const snapedict_t *)packed;
+
+    return old->free != ed->free || old->freetime != ed->freetime ||
+           memcmp(packed + sizeof(*old), &ed->v, progs->entityfields * 4);
+}
+
+/* the caller relinks once every edict is in place */
+static void SV_SnapUnpackEdict(int num, const byte *src) {
+    const snapedict_t *packed = (const snapedict_t *)src;
+    edict_t *ed = EDICT_NUM(num);
+
+    SV_UnlinkEdict(ed);
+    ed->free = packed->free;
+    ed->freetime = packed->freetime;
+    memcpy(&ed->v, src + sizeof(*packed), progs->entityfields * 4);
+}
+
+/*
+ * Clear anything past the restored edicts, relink the rest and rebuild the
+ * edict free list and find index
+ */
+static void SV_SnapFinishEdicts(int num_edicts) {
+    edict_t *ed;
+    int i;
+
+    for (i = num_edicts; i < sv.num_edicts; i++) {
+        ed = EDICT_NUM(i);
+        SV_UnlinkEdict(ed);
+        memset(&ed->v, 0, progs->entityfields * 4);
+        ed->free = true;
+        ed->freetime = 0;
+    }
+    sv.num_edicts = num_edicts;
+
+    for (i = 1; i < sv.num_edicts; i++) {
+        ed = EDICT_NUM(i);
+        if (!ed->free) SV_LinkEdict(ed, false);
+    }
+    ED_ResetLists();
+}
+
+static void SV_SnapSendLightstyle(int style) {
+    client_t *client;
+    int i;
+
+    for (i = 0, client = svs.clients; i < svs.maxclients; i++, client++) {
+        if (!client->active && !client->spawned) continue;
+        MSG_WriteChar(&client->message, svc_lightstyle);
+        MSG_WriteChar(&client->message, style);
+        MSG_WriteString(&client->message, sv.lightstyles[style]);
+    }
+}
+
+static void SV_SnapSetLightstyle(int style, const char *value) {
+    if (sv.lightstyles[style] == value) return;
+    if (sv.lightstyles[style] && !strcmp(sv.lightstyles[style], value)) return;
+
+    sv.lightstyles[style] = value;
+    SV_SnapSendLightstyle(style);
+}
+
+/*
+============================================================================
+Snapshot files
+
+The file is the snapheader_t, then MAX_LIGHTSTYLES and numstrings
+length-prefixed strings, the globals and num_edicts packed edicts, all in
+native byte order. It is captured in one pass into memory; the disk writes
+are spread over the following host frames so saving doesn't stall the game.
+============================================================================
+*/
+
+static struct {
+    FILE *file;
+    byte *data;
+    int size;
+    int written;
+} snap_writer;
+
+static int SV_SnapStringSize(const char *s) { return sizeof(int) + (s ? strlen(s) + 1 : 0); }
+
+static void SV_SnapWriteString(byte **cursor, const char *s) {
+    int length = s ? strlen(s) : -1;
+
+    memcpy(*cursor, &length, sizeof(length));
+    *cursor += sizeof(length);
+    if (s) {
+        memcpy(*cursor, s, length + 1);
+        *cursor += length + 1;
+    }
+}
+
+static void SV_SnapCloseWriter(void) {
+    if (!snap_writer.file) return;
+    fclose(snap_writer.file);
+    free(snap_writer.data);
+    memset(&snap_writer, 0, sizeof(snap_writer));
+}
+
+/*
+====================
+SV_SnapUpdate
+
+Called once a host frame to push out some of a pending snapshot file
+====================
+*/
+void SV_SnapUpdate(void) {
+    int length;
+
+    if (!snap_writer.file) return;
+
+    length = qmin(SNAP_WRITE_CHUNK, snap_writer.size - snap_writer.written);
+    if (fwrite(snap_writer.data + snap_writer.written, 1, length, snap_writer.file) != length) {
+        Con_Printf("ERROR: couldn't write snapshot.\n");
+        SV_SnapCloseWriter();
+        return;
+    }
+
+    snap_writer.written += length;
+    if (snap_writer.written == snap_writer.size) {
+        SV_SnapCloseWriter();
+        Con_DPrintf("Snapshot written.\n");
+    }
+}
+
+/* finish any pending write before it is replaced or the engine exits */
+void SV_SnapShutdown(void) {
+    while (snap_writer.file) SV_SnapUpdate();
+}
+
+/*
+====================
+SV_SnapSave
+
+Capture the server state and start writing it to filename
+====================
+*/
+qboolean SV_SnapSave(const char *filename) {
+    snapheader_t *header;
+    byte *cursor;
+    int i, size, numstrings, edictsize;
+    FILE *f;
+
+    SV_SnapShutdown();
+
+    f = fopen(filename, "wb");
+    if (!f) return false;
+
+    numstrings = PR_NumStrings();
+    edictsize = SV_SnapEdictSize();
+
+    size = sizeof(*header);
+    for (i = 0; i < MAX_LIGHTSTYLES; i++) size += SV_SnapStringSize(sv.lightstyles[i]);
+    for (i = 0; i < numstrings; i++) size += SV_SnapStringSize(PR_GetString(-i - 1));
+    size += progs->numglobals * 4 + sv.num_edicts * edictsize;
+
+    snap_writer.data = malloc(size);
+    if (!snap_writer.data) {
+        fclose(f);
+        return false;
+    }
+    snap_writer.file = f;
+    snap_writer.size = size;
+    snap_writer.written = 0;
+
+    header = (snapheader_t *)snap_writer.data;
+    memset(header, 0, sizeof(*header));
+    header->magic = SNAP_MAGIC;
+    header->version = SNAP_VERSION;
+    header->crc = pr_crc;
+    header->numglobals = progs->numglobals;
+    header->entityfields = progs->entityfields;
+    header->num_edicts = sv.num_edicts;
+    header->numstrings = numstrings;
+    header->skill = current_skill;
+    header->time = sv.time;
+    snprintf(header->mapname, sizeof(header->mapname), "%s", sv.name);
+    memcpy(header->spawn_parms, svs.clients->spawn_parms, sizeof(header->spawn_parms));
+
+    cursor = snap_writer.data + sizeof(*header);
+    for (i = 0; i < MAX_LIGHTSTYLES; i++) SV_SnapWriteString(&cursor, sv.lightstyles[i]);
+    for (i = 0; i < numstrings; i++) SV_SnapWriteString(&cursor, PR_GetString(-i - 1));
+
+    memcpy(cursor, pr_globals, progs->numglobals * 4);
+    cursor += progs->numglobals * 4;
+    for (i = 0; i < sv.num_edicts; i++, cursor += edictsize) SV_SnapPackEdict(cursor, EDICT_NUM(i));
+
+    return true;
+}
+
+/*
+====================
+SV_SnapLoad
+
+Read and sanity check a snapshot file; the caller frees the result with
+SV_SnapFree once it has been restored
+====================
+*/
+snapheader_t *SV_SnapLoad(const char *filename) {
+    snapheader_t *header;
+    FILE *f;
+    long size;
+
+    f = fopen(filename, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    header = size >= (long)sizeof(*header) ? malloc(size) : NULL;
+    if (!header || fread(header, 1, size, f) != size || header->magic != SNAP_MAGIC ||
+        header->version != SNAP_VERSION) {
+        free(header);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    header->mapname[sizeof(header->mapname) - 1] = 0;
+    header->size = size;
+
+    return header;
+}
+
+void SV_SnapFree(snapheader_t *header) { free(header); }
+
+/* NULL is stored as length -1 */
+static qboolean SV_SnapReadString(const byte **cursor, const byte *end, const char **s) {
+    int length;
+
+    if (end - *cursor < sizeof(length)) return false;
+    memcpy(&length, *cursor, sizeof(length));
+    *cursor += sizeof(length);
+    if (length < 0) {
+        *s = NULL;
+        return length == -1;
+    }
+    if (end - *cursor <= length || (*cursor)[length]) return false;
+
+    *s = (const char *)*cursor;
+    *cursor += length + 1;
+
+    return true;
+}
+
+/*
+ * Strings a restore puts in the string table or the lightstyles need to
+ * outlive the snapshot file. They are copied into one of two blocks,
+ * alternating, so the previous restore's copies stay readable while the
+ * next one is built; anything still in either block is copied again, so
+ * nothing points into the block being rebuilt. A block is only replaced
+ * when it is too small, and the one it replaces is freed, so repeated
+ * restores use no more memory than the largest two.
+ */
+typedef struct {
+    char *base;
+    int size, used;
+} snapstrings_t;
+
+static snapstrings_t snap_strings[2];
+static int snap_stringblock;
+
+static qboolean SV_SnapInStrings(const char *s) {
+    int i;
+
+    for (i = 0; i < 2; i++)
+        if (s >= snap_strings[i].base && s < snap_strings[i].base + snap_strings[i].size) return true;
+    return false;
+}
+
+/* the string to keep, or NULL if s must be copied */
+static const char *SV_SnapKeepString(const char *current, const char *s) {
+    if (current && !SV_SnapInStrings(current) && !strcmp(current, s)) return current;
+    return NULL;
+}
+
+/* switch to the other block, with room for need bytes */
+static qboolean SV_SnapNextStrings(int need) {
+    snapstrings_t *block = &snap_strings[snap_stringblock ^ 1];
+
+    if (need > block->size) {
+        free(block->base);
+        block->size = qmax(need * 2, 16 * 1024);
+        block->base = malloc(block->size);
+        if (!block->base) {
+            block->size = 0;
+            return false;
+        }
+    }
+    block->used = 0;
+    snap_stringblock ^= 1;
+
+    return true;
+}
+
+static const char *SV_SnapCopyString(const char *s) {
+    char *copy = snap_strings[snap_stringblock].base + snap_strings[snap_stringblock].used;
+
+    strcpy(copy, s);
+    snap_strings[snap_stringblock].used += strlen(s) + 1;
+
+    return copy;
+}
+
+/*
+====================
+SV_SnapRestore
+
+Restore a loaded snapshot into the running server, which must be on the
+same map with the same progs
+====================
+*/
+qboolean SV_SnapRestore(snapheader_t *header) {
+    const char *lightstyles[MAX_LIGHTSTYLES];
+    const char *restored[MAX_LIGHTSTYLES];
+    qboolean changed[MAX_LIGHTSTYLES];
+    const char **strings, **kept;
+    const byte *cursor, *end;
+    int i, edictsize, need;
+
+    if (header->crc != pr_crc || header->numglobals != progs->numglobals ||
+        header->entityfields != progs->entityfields) {
+        Con_Printf("Snapshot was saved with different progs.\n");
+        return false;
+    }
+    if (header->num_edicts <= svs.maxclients || header->num_edicts > sv.max_edicts ||
+        header->numstrings < 0) {
+        Con_Printf("Snapshot is corrupt.\n");
+        return false;
+    }
+
+    strings = malloc(header->numstrings * sizeof(*strings) * 2 + 1);
+    if (!strings) return false;
+    kept = strings + header->numstrings;
+
+    /* check the sizes of everything before touching the server */
+    edictsize = SV_SnapEdictSize();
+    cursor = (const byte *)(header + 1);
+    end = (const byte *)header + header->size;
+    for (i = 0; i < MAX_LIGHTSTYLES; i++)
+        if (!SV_SnapReadString(&cursor, end, &lightstyles[i])) break;
+    if (i == MAX_LIGHTSTYLES)
+        for (i = 0; i < header->numstrings; i++)
+            if (!SV_SnapReadString(&cursor, end, &strings[i]) || !strings[i]) break;
+    if (i != header->numstrings ||
+        end - cursor != progs->numglobals * 4 + header->num_edicts * edictsize) {
+        Con_Printf("Snapshot is corrupt.\n");
+        free(strings);
+        return false;
+    }
+
+    /* a style the snapshot doesn't have keeps its current value */
+    need = 0;
+    for (i = 0; i < MAX_LIGHTSTYLES; i++) {
+        changed[i] = false;
+        if (!lightstyles[i]) {
+            lightstyles[i] = sv.lightstyles[i];
+            restored[i] = lightstyles[i] && SV_SnapInStrings(lightstyles[i]) ? NULL : lightstyles[i];
+        } else {
+            changed[i] = !sv.lightstyles[i] || strcmp(sv.lightstyles[i], lightstyles[i]);
+            restored[i] = SV_SnapKeepString(sv.lightstyles[i], lightstyles[i]);
+        }
+        if (lightstyles[i] && !restored[i]) need += strlen(lightstyles[i]) + 1;
+    }
+    for (i = 0; i < header->numstrings; i++) {
+        kept[i] = i < PR_NumStrings() ? SV_SnapKeepString(PR_GetString(-i - 1), strings[i]) : NULL;
+        if (!kept[i]) need += strlen(strings[i]) + 1;
+    }
+
+    if (!SV_SnapNextStrings(need)) {
+        Con_Printf("Not enough memory to restore the snapshot.\n");
+        free(strings);
+        return false;
+    }
+
+    for (i = 0; i < MAX_LIGHTSTYLES; i++) {
+        if (!lightstyles[i]) continue;
+        sv.lightstyles[i] = restored[i] ? restored[i] : SV_SnapCopyString(lightstyles[i]);
+        if (changed[i]) SV_SnapSendLightstyle(i);
+    }
+    for (i = 0; i < header->numstrings; i++)
+        if (!kept[i]) kept[i] = SV_SnapCopyString(strings[i]);
+    PR_RestoreStringTable(kept, header->numstrings);
+    free(strings);
+
+    memcpy(pr_globals, cursor, progs->numglobals * 4);
+    cursor += progs->numglobals * 4;
+    for (i = 0; i < header->num_edicts; i++, cursor += edictsize) SV_SnapUnpackEdict(i, cursor);
+    SV_SnapFinishEdicts(header->num_edicts);
+    sv.time = header->time;
+
+    SV_RewindReset();
+
+    return true;
+}
+
+/*
+============================================================================
+Rewind
+
+A shadow copy holds the state at the newest rewind snapshot. Each new
+snapshot compares the server against the shadow and keeps, in a ring
+buffer, an undo block with the old contents of the globals and of each
+edict that changed; only those are copied into the shadow. Rewinding
+applies the undo blocks from newest back to the target on the shadow, then
+copies the shadow into the server. The oldest snapshot never needs its undo
+block, so it is freed as soon as its snapshot becomes the oldest.
+============================================================================
+*/
+
+#define REWIND_SNAPS 1024
+#define REWIND_MEM (4 * 1024 * 1024) /* default undo buffer, -rewindmem <kb> */
+
+typedef struct {
+    double time;
+    int num_edicts;
+    const char *lightstyles[MAX_LIGHTSTYLES];
+    int undo;     /* offset in the undo buffer */
+    int undosize; /* 0 if nothing changed, or freed */
+    qboolean globals; /* undo starts with the old globals */
+    int numundo;      /* edict records following the globals */
+} rewindsnap_t;
+
+static struct {
+    qboolean active;
+    byte *shadow; /* globals, then sv.max_edicts packed edicts */
+    int shadow_edicts;
+    byte *undo;
+    int undobytes;
+    int head; /* end of the newest undo block */
+    rewindsnap_t snaps[REWIND_SNAPS];
+    int first, count;
+    double nexttime;
+    unsigned copied, captured; /* edicts copied, snapshots taken */
+} rw;
+
+static rewindsnap_t *SV_RewindSnap(int i) { return &rw.snaps[(rw.first + i) % REWIND_SNAPS]; }
+
+static byte *SV_RewindShadowEdict(int num) {
+    return rw.shadow + progs->numglobals * 4 + num * SV_SnapEdictSize();
+}
+
+void SV_RewindReset(void) {
+    rw.first = rw.count = 0;
+    rw.head = 0;
+    rw.nexttime = 0;
+}
+
+/*
+====================
+SV_RewindNewMap
+
+Called by SV_SpawnServer once the edicts are allocated
+====================
+*/
+void SV_RewindNewMap(void) {
+    int p;
+
+    memset(&rw, 0, sizeof(rw));
+    for (p = 0; p < 2; p++) free(snap_strings[p].base);
+    memset(snap_strings, 0, sizeof(snap_strings));
+    if (sv_rewind.value <= 0) return;
+
+    rw.undobytes = REWIND_MEM;
+    p = COM_CheckParm("-rewindmem");
+    if (p && p < com_argc - 1) rw.undobytes = Q_atoi(com_argv[p + 1]) * 1024;
+
+    rw.shadow = Hunk_AllocName(progs->numglobals * 4 + sv.max_edicts * SV_SnapEdictSize(),
+                               "rwshadow");
+    rw.undo = Hunk_AllocName(rw.undobytes, "rwundo");
+    rw.active = true;
+}
+
+/* start of the oldest live undo block, -1 if there are none */
+static int SV_RewindTail(void) {
+    int i;
+
+    for (i = 1; i < rw.count; i++)
+        if (SV_RewindSnap(i)->undosize) return SV_RewindSnap(i)->undo;
+    return -1;
+}
+
+static void SV_RewindDropOldest(void) {
+    rw.first = (rw.first + 1) % REWIND_SNAPS;
+    rw.count--;
+    if (rw.count) SV_RewindSnap(0)->undosize = 0;
+}
+
+/* find room for an undo block, dropping old snapshots as needed */
+static int SV_RewindAlloc(int size) {
+    int tail, ofs;
+
+    while (1) {
+        tail = SV_RewindTail();
+        if (tail < 0) {
+            if (size > rw.undobytes) return -1;
+            rw.head = size;
+            return 0;
+        }
+        if (rw.head > tail) {
+            if (rw.undobytes - rw.head >= size) {
+                ofs = rw.head;
+                rw.head += size;
+                return ofs;
+            }
+            if (tail >= size) {
+                rw.head = size;
+                return 0;
+            }
+        } else if (tail - rw.head >= size) {
+            ofs = rw.head;
+            rw.head += size;
+            return ofs;
+        }
+        SV_RewindDropOldest();
+    }
+}
+
+static void SV_RewindPush(int num_edicts) {
+    rewindsnap_t *snap;
+
+    if (rw.count == REWIND_SNAPS) SV_RewindDropOldest();
+    snap = SV_RewindSnap(rw.count++);
+    memset(snap, 0, sizeof(*snap));
+    snap->time = sv.time;
+    snap->num_edicts = num_edicts;
+    memcpy(snap->lightstyles, sv.lightstyles, sizeof(snap->lightstyles));
+    rw.captured++;
+}
+
+static void SV_RewindBase(void) {
+    int i;
+
+    memcpy(rw.shadow, pr_globals, progs->numglobals * 4);
+    for (i = 0; i < sv.num_edicts; i++) SV_SnapPackEdict(SV_RewindShadowEdict(i), EDICT_NUM(i));
+    rw.shadow_edicts = sv.num_edicts;
+    rw.copied += sv.num_edicts;
+
+    SV_RewindReset();
+    SV_RewindPush(sv.num_edicts);
+}
+
+/*
+====================
+SV_RewindFrame
+
+Called at the end of each server physics frame
+====================
+*/
+void SV_RewindFrame(void) {
+    static byte changed[MAX_EDICTS];
+    rewindsnap_t *snap;
+    qboolean globals;
+    byte *undo, *shadow;
+    int i, num, numchanged, size, ofs, edictsize, globalsize;
+
+    if (!rw.active || sv_rewind.value <= 0) return;
+    if (sv.time < rw.nexttime) return;
+    rw.nexttime = sv.time + 1.0 / qmax(sv_rewindrate.value, 1.0f);
+
+    if (!rw.count) {
+        SV_RewindBase();
+        return;
+    }
+
+    while (rw.count > 1 && SV_RewindSnap(1)->time < sv.time - sv_rewind.value)
+        SV_RewindDropOldest();
+
+    /* find what changed since the last snapshot */
+    edictsize = SV_SnapEdictSize();
+    globalsize = progs->numglobals * 4;
+    num = qmax(sv.num_edicts, rw.shadow_edicts);
+    globals = memcmp(rw.shadow, pr_globals, globalsize) != 0;
+    size = globals ? globalsize : 0;
+    numchanged = 0;
+    for (i = 0; i < num; i++) {
+        /* shadow slots past the last snapshot's edicts hold nothing useful */
+        changed[i] = i >= rw.shadow_edicts || SV_SnapEdictChanged(SV_RewindShadowEdict(i), EDICT_NUM(i));
+        if (changed[i]) numchanged++;
+    }
+    size += numchanged * (sizeof(int) + edictsize);
+
+    ofs = size ? SV_RewindAlloc(size) : 0;
+    if (ofs < 0) {
+        /* this frame alone doesn't fit, start over from here */
+        SV_RewindBase();
+        return;
+    }
+
+    /* move the old state into the undo block and update the shadow */
+    undo = rw.undo + ofs;
+    if (globals) {
+        memcpy(undo, rw.shadow, globalsize);
+        memcpy(rw.shadow, pr_globals, globalsize);
+        undo += globalsize;
+    }
+    for (i = 0; i < num; i++) {
+        if (!changed[i]) continue;
+        shadow = SV_RewindShadowEdict(i);
+        memcpy(undo, &i, sizeof(i));
+        memcpy(undo + sizeof(i), shadow, edictsize);
+        SV_SnapPackEdict(shadow, EDICT_NUM(i));
+        undo += sizeof(i) + edictsize;
+    }
+    rw.shadow_edicts = sv.num_edicts;
+    rw.copied += numchanged;
+
+    SV_RewindPush(sv.num_edicts);
+    snap = SV_RewindSnap(rw.count - 1);
+    snap->undo = ofs;
+    snap->undosize = size;
+    snap->globals = globals;
+    snap->numundo = numchanged;
+}
+
+static void SV_RewindApplyUndo(const rewindsnap_t *snap) {
+    const byte *undo = rw.undo + snap->undo;
+    int i, num, edictsize;
+
+    edictsize = SV_SnapEdictSize();
+    if (snap->globals) {
+        memcpy(rw.shadow, undo, progs->numglobals * 4);
+        undo += progs->numglobals * 4;
+    }
+    for (i = 0; i < snap->numundo; i++, undo += sizeof(num) + edictsize) {
+        memcpy(&num, undo, sizeof(num));
+        memcpy(SV_RewindShadowEdict(num), undo + sizeof(num), edictsize);
+    }
+}
+
+/*
+====================
+SV_Rewind_f
+
+rewind <seconds> : put the server back to the newest snapshot that is at
+                   least that old
+rewind           : show the available history
+====================
+*/
+static void SV_Rewind_f(void) {
+    const rewindsnap_t *target, *snap;
+    double start, now;
+    int i, j, num;
+
+    if (!sv.active || !rw.active) {
+        Con_Printf("Rewind is not enabled (set sv_rewind and restart the map).\n");
+        return;
+    }
+    if (!rw.count) {
+        Con_Printf("No rewind history yet.\n");
+        return;
+    }
+
+    if (Cmd_Argc() != 2) {
+        Con_Printf("%.1f seconds of history in %d snapshots, %.1f MB undo buffer\n",
+                   sv.time - SV_RewindSnap(0)->time, rw.count, rw.undobytes / (1024.0 * 1024.0));
+        if (rw.captured)
+            Con_Printf("%.1f edicts copied per snapshot\n", (double)rw.copied / rw.captured);
+        return;
+    }
+
+    /* newest snapshot that is old enough, or the oldest there is */
+    for (i = rw.count - 1; i > 0; i--)
+        if (SV_RewindSnap(i)->time <= sv.time - Q_atof(Cmd_Argv(1))) break;
+    target = SV_RewindSnap(i);
+
+    now = sv.time;
+    start = Sys_DoubleTime();
+    for (j = rw.count - 1; j > i; j--) {
+        snap = SV_RewindSnap(j);
+        if (snap->undosize) SV_RewindApplyUndo(snap);
+    }
+
+    memcpy(pr_globals, rw.shadow, progs->numglobals * 4);
+    num = qmax(sv.num_edicts, target->num_edicts);
+    for (j = 0; j < num; j++) SV_SnapUnpackEdict(j, SV_RewindShadowEdict(j));
+    SV_SnapFinishEdicts(target->num_edicts);
+    for (j = 0; j < MAX_LIGHTSTYLES; j++)
+        if (target->lightstyles[j]) SV_SnapSetLightstyle(j, target->lightstyles[j]);
+    sv.time = target->time;
+
+    /* the newer snapshots are gone; the head is the end of the newest live block */
+    rw.count = i + 1;
+    rw.shadow_edicts = target->num_edicts;
+    rw.nexttime = sv.time;
+    rw.head = 0;
+    for (j = rw.count - 1; j > 0; j--) {
+        snap = SV_RewindSnap(j);
+        if (snap->undosize) {
+            rw.head = snap->undo + snap->undosize;
+            break;
+        }
+    }
+
+    Con_Printf("Rewound %.1f seconds in %.2f msec\n", now - sv.time,
+               (Sys_DoubleTime() - start) * 1000.0);
+}
+
+/*
+====================
+SV_SnapInit
+====================
+*/
+void SV_SnapInit(void) {
+    Cvar_RegisterVariable(&sv_rewind);
+    Cvar_RegisterVariable(&sv_rewindrate);
+
+    Cmd_AddCommand("rewind", SV_Rewind_f);
+}
@@ -36,6 +36,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 cvar_t sv_idealpitchscale = {"sv_idealpitchscale", "0.8"};
 cvar_t sv_edgefriction = {"edgefriction", "2"};
 
+#define SV_MINRATE 500 /* lowest rate a client can ask for */
+
 /*
 ===============
 SV_SetIdealPitch
@@ -457,10 +459,52 @@ static void SV_Status_f(client_t *client) {
         seconds -= (minutes * 60);
         hours = minutes / 60;
         minutes -= (hours * 60);
-        SV_ClientPrintf(client, "#%-2u %-16.16s  %3i  %2i:%02i:%02i\n", i + 1, client->name,
-                        (int)client->edict->v.frags, hours, minutes, seconds);
-        SV_ClientPrintf(client, "   %s\n", client->netconnection->address);
+        SV_ClientPrintf(client, "#%-2u %-16.16s  %3i  %2i:%02i:%02i\n", i + 1, other->name,
+                        (int)other->edict->v.frags, hours, minutes, seconds);
+        SV_ClientPrintf(client, "   %s\n", other->netconnection->address);
+        SV_ClientPrintf(client, "   sent %u skipped %u thinned %u overflow %u (rate %d snaps %d)\n",
+                        other->sent, other->skipped, other->thinned, other->overflows,
+                        other->rate, other->snaps);
+    }
+}
+
+/*
+==================
+SV_Rate_f
+
+rate [bytes/sec] : limit the bandwidth the server sends, 0 for no limit
+==================
+*/
+static void SV_Rate_f(client_t *client) {
+    int rate;
+
+    if (Cmd_Argc() != 2) {
+        SV_ClientPrintf(client, "\"rate\" is \"%d\"\n", client->rate);
+        return;
     }
+
+    rate = Q_atoi(Cmd_Argv(1));
+    if (rate > 0 && rate < SV_MINRATE) rate = SV_MINRATE;
+    client->rate = qmax(rate, 0);
+}
+
+/*
+==================
+SV_Snaps_f
+
+snaps [count] : limit the datagrams per second the server sends, 0 for no limit
+==================
+*/
+static void SV_Snaps_f(client_t *client) {
+    int snaps;
+
+    if (Cmd_Argc() != 2) {
+        SV_ClientPrintf(client, "\"snaps\" is \"%d\"\n", client->snaps);
+        return;
+    }
+
+    snaps = Q_atoi(Cmd_Argv(1));
+    client->snaps = qmax(snaps, 0);
 }
 
 /*
@@ -752,7 +796,7 @@ static void SV_PreSpawn_f(client_t *client) {
         SV_ClientPrintf(client, "prespawn not valid -- already spawned\n");
         return;
     }
-    SZ_Write(&client->message, sv.signon.data, sv.signon.cursize);
+    SV_SendSignonData(client, &sv.signon);
     MSG_WriteByte(&client->message, svc_signonnum);
     MSG_WriteByte(&client->message, 2);
     client->sendsignon = true;
@@ -1020,7 +1064,8 @@ static client_command_t client_commands[] = {
     {"kill", SV_Kill_f},         {"pause", SV_Pause_f},
     {"kick", SV_Kick_f},         {"ban", NET_Ban_f},
     {"prespawn", SV_PreSpawn_f}, {"spawn", SV_Spawn_f},
-    {"begin", SV_Begin_f},       {NULL, NULL},
+    {"begin", SV_Begin_f},       {"rate", SV_Rate_f},
+    {"snaps", SV_Snaps_f},       {NULL, NULL},
 };
 
 static void SV_ExecuteClientCommand(const char *command_string, client_t *client) {
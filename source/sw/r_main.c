@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "cmd.h"
 #include "console.h"
+#include "prof.h"
 #include "quakedef.h"
 #include "r_local.h"
 #include "screen.h"
@@ -1083,5 +1084,7 @@ void R_RenderView(void) {
 
     if ((intptr_t)(&r_warpbuffer) & 3) Sys_Error("Globals are missaligned");
 
+    PROF_BEGIN(PROF_RENDER);
     R_RenderView_();
+    PROF_END(PROF_RENDER);
 }
@@ -103,6 +103,30 @@ void R_TimeRefresh_f(void) {
     r_refdef.viewangles[1] = startangle;
 }
 
+/*
+====================
+R_FrameChecksum
+
+FNV-1a over the 8-bit pixels of the refresh window
+====================
+*/
+unsigned R_FrameChecksum(void) {
+    int x, y;
+    unsigned sum;
+    const byte *row;
+
+    sum = 2166136261u;
+    for (y = 0; y < r_refdef.vrect.height; y++) {
+        row = vid.buffer + (r_refdef.vrect.y + y) * vid.rowbytes + r_refdef.vrect.x;
+        for (x = 0; x < r_refdef.vrect.width; x++) {
+            sum ^= row[x];
+            sum *= 16777619u;
+        }
+    }
+
+    return sum;
+}
+
 /*
 ================
 R_LineGraph
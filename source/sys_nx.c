@@ -104,10 +104,111 @@ void Sys_Printf(const char *fmt, ...) {
 #endif // DEBUG
 }
 
+/*
+ * ===========================================================================
+ * Worker threads
+ * ===========================================================================
+ */
+
+/* applications get cores 0-2; the main thread runs on core 0 */
+#define SYS_MAX_WORKERS 2
+#define SYS_WORKER_STACK 0x10000
+
+static Thread sys_workers[SYS_MAX_WORKERS];
+static int sys_numworkers = -1; /* -1 until the workers are started */
+static Semaphore sys_jobstart;
+static Semaphore sys_jobdone;
+static volatile qboolean sys_workersquit;
+
+static struct {
+    void (*func)(int index, void *data);
+    void *data;
+    int count;
+    int next; /* next index to hand out, taken atomically */
+} sys_job;
+
+static void Sys_RunJob(void) {
+    int index;
+
+    while ((index = __atomic_fetch_add(&sys_job.next, 1, __ATOMIC_RELAXED)) < sys_job.count)
+        sys_job.func(index, sys_job.data);
+}
+
+static void Sys_WorkerThread(void *arg) {
+    while (1) {
+        semaphoreWait(&sys_jobstart);
+        if (sys_workersquit) break;
+        Sys_RunJob();
+        semaphoreSignal(&sys_jobdone);
+    }
+}
+
+static void Sys_StartWorkers(void) {
+    s32 priority;
+    int i;
+
+    semaphoreInit(&sys_jobstart, 0);
+    semaphoreInit(&sys_jobdone, 0);
+    sys_numworkers = 0;
+    if (COM_CheckParm("-noworkers")) return;
+
+    if (R_FAILED(svcGetThreadPriority(&priority, CUR_THREAD_HANDLE))) priority = 0x2C;
+    for (i = 0; i < SYS_MAX_WORKERS; i++) {
+        if (R_FAILED(threadCreate(&sys_workers[i], Sys_WorkerThread, NULL, NULL, SYS_WORKER_STACK,
+                                  priority, i + 1)))
+            break;
+        if (R_FAILED(threadStart(&sys_workers[i]))) {
+            threadClose(&sys_workers[i]);
+            break;
+        }
+        sys_numworkers++;
+    }
+}
+
+static void Sys_StopWorkers(void) {
+    int i;
+
+    if (sys_numworkers <= 0) return;
+
+    sys_workersquit = true;
+    for (i = 0; i < sys_numworkers; i++) semaphoreSignal(&sys_jobstart);
+    for (i = 0; i < sys_numworkers; i++) {
+        threadWaitForExit(&sys_workers[i]);
+        threadClose(&sys_workers[i]);
+    }
+    sys_numworkers = 0;
+}
+
+int Sys_NumWorkers(void) {
+    if (sys_numworkers < 0) Sys_StartWorkers();
+    return sys_numworkers;
+}
+
+void Sys_ParallelFor(int count, void (*func)(int index, void *data), void *data) {
+    int i, workers;
+
+    workers = Sys_NumWorkers();
+    if (workers > count - 1) workers = count - 1;
+    if (workers <= 0) {
+        for (i = 0; i < count; i++) func(i, data);
+        return;
+    }
+
+    sys_job.func = func;
+    sys_job.data = data;
+    sys_job.count = count;
+    sys_job.next = 0;
+
+    for (i = 0; i < workers; i++) semaphoreSignal(&sys_jobstart);
+    Sys_RunJob();
+    for (i = 0; i < workers; i++) semaphoreWait(&sys_jobdone);
+}
+
 void Sys_Quit(void) {
 #ifndef SERVERONLY
     Host_Shutdown();
 #endif
+    Sys_StopWorkers();
     // we'll have have to do this here
     socketExit();
     if (SDL_WasInit(0))
@@ -19,13 +19,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // world.c -- world query functions
 
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "world.h"
 #include "bspfile.h"
+#include "cmd.h"
 #include "console.h"
 #include "mathlib.h"
 #include "model.h"
 #include "progs.h"
 #include "server.h"
+#include "zone.h"
 
 #ifdef NQ_HACK
 #include "host.h"
@@ -51,13 +58,26 @@ typedef struct {
     vec3_t maxs;
 } bounds_t;
 
+/*
+ * Bounds as four floats for the packed area lists below; w is always zero
+ * so that it never decides a comparison
+ */
+typedef float areavec_t __attribute__((vector_size(16), aligned(4)));
+typedef int areamask_t __attribute__((vector_size(16)));
+
+typedef struct {
+    areavec_t mins, maxs;
+} areabounds_t;
+
 typedef struct {
     bounds_t move;    /* enclose the test object along entire move */
+    areabounds_t packedmove; /* the same, for testing against area lists */
     bounds_t object;  /* size of the moving object */
     bounds_t monster; /* size to test against monsters (>= object) */
     vec3_t start, end;
     movetype_t type;
     const edict_t *passedict;
+    tracerecord_t *record;
 } moveclip_t;
 
 /*
@@ -118,18 +138,53 @@ ENTITY AREA CHECKING
 ===============================================================================
 */
 
+/*
+ * Alongside its link lists, each area node keeps the abs boxes of the same
+ * entities in the same order, packed together so that a walk can reject
+ * entities that are nowhere near without touching edict memory. The boxes
+ * are copied when the entity is linked, so QuakeC that writes absmin or
+ * absmax directly is not seen until the next link, same as the area tree
+ * itself. Unlinking leaves a hole with an empty box, which every test
+ * rejects; holes are squeezed out once there are enough of them and no
+ * SV_TouchLinks is walking the list.
+ */
+typedef struct arealist_s {
+    areabounds_t *bounds;
+    edict_t **edicts; /* NULL in holes */
+    int count;        /* entries used, including holes */
+    int holes;
+    int size;    /* entries allocated */
+    int walking; /* SV_TouchLinks loops in progress */
+} arealist_t;
+
 typedef struct areanode_s {
     int axis;  // -1 = leaf node
     float dist;
     struct areanode_s *children[2];
     link_t trigger_edicts;
     link_t solid_edicts;
+    arealist_t triggers;
+    arealist_t solids;
 } areanode_t;
 
 #define AREA_DEPTH 4
 #define AREA_NODES 32
 
 static areanode_t sv_areanodes[AREA_NODES];
+
+/*
+ * Recent SV_PointContents results, hashed on the exact point. Entities that
+ * sit still ask about the same points every frame. The world hull never
+ * changes during a map, so the cache is only flushed by SV_ClearWorld.
+ */
+#define POINTCACHE_SIZE 256 /* must be a power of two */
+
+typedef struct {
+    vec3_t point;
+    int contents; /* 0 if the slot is empty */
+} pointcache_t;
+
+static pointcache_t sv_pointcache[POINTCACHE_SIZE];
 static int sv_numareanodes;
 
 #if defined(QW_HACK) && defined(SERVERONLY)
@@ -241,22 +296,163 @@ static areanode_t *SV_CreateAreaNode(int depth, const vec3_t mins, const vec3_t
     return anode;
 }
 
+/*
+===============================================================================
+
+PACKED AREA LISTS
+
+===============================================================================
+*/
+
+static const areabounds_t sv_emptybounds = {
+    {INFINITY, INFINITY, INFINITY, INFINITY},
+    {-INFINITY, -INFINITY, -INFINITY, -INFINITY},
+};
+
+static inline void SV_PackBounds(const vec3_t mins, const vec3_t maxs, areabounds_t *bounds) {
+    bounds->mins = (areavec_t){mins[0], mins[1], mins[2], 0};
+    bounds->maxs = (areavec_t){maxs[0], maxs[1], maxs[2], 0};
+}
+
+/* Same test as the unpacked code: apart if any min is past the other's max */
+static inline qboolean SV_BoundsApart(const areabounds_t *a, const areabounds_t *b) {
+    areamask_t apart = (a->mins > b->maxs) | (a->maxs < b->mins);
+
+    return (apart[0] | apart[1] | apart[2] | apart[3]) != 0;
+}
+
+static void SV_AreaListFree(arealist_t *list) {
+    free(list->bounds);
+    free(list->edicts);
+    memset(list, 0, sizeof(*list));
+}
+
+static void SV_AreaListAdd(arealist_t *list, edict_t *ent) {
+    if (list->count == list->size) {
+        list->size = list->size ? list->size * 2 : 16;
+        list->bounds = realloc(list->bounds, list->size * sizeof(list->bounds[0]));
+        list->edicts = realloc(list->edicts, list->size * sizeof(list->edicts[0]));
+        if (!list->bounds || !list->edicts) SV_Error("%s: out of memory", __func__);
+    }
+
+    SV_PackBounds(ent->v.absmin, ent->v.absmax, &list->bounds[list->count]);
+    list->edicts[list->count] = ent;
+    ent->arealist = list;
+    ent->areaslot = list->count++;
+}
+
+static void SV_AreaListCompact(arealist_t *list) {
+    int i, count;
+
+    for (i = count = 0; i < list->count; i++) {
+        if (!list->edicts[i]) continue;
+        list->bounds[count] = list->bounds[i];
+        list->edicts[count] = list->edicts[i];
+        list->edicts[count]->areaslot = count;
+        count++;
+    }
+    list->count = count;
+    list->holes = 0;
+}
+
+static void SV_AreaListRemove(edict_t *ent) {
+    arealist_t *list = ent->arealist;
+
+    list->bounds[ent->areaslot] = sv_emptybounds;
+    list->edicts[ent->areaslot] = NULL;
+    list->holes++;
+    ent->arealist = NULL;
+
+    if (!list->walking && list->holes > 16 && list->holes * 2 > list->count)
+        SV_AreaListCompact(list);
+}
+
 /*
 ===============
 SV_ClearWorld
 
 ===============
 */
+/*
+ * Bumped for every new world, so leaf caches left in edict memory from an
+ * earlier map are never trusted
+ */
+static int sv_worldcount;
+
+svlinkstats_t sv_linkstats;
+
 void SV_ClearWorld(void) {
     model_t *model = &sv.worldmodel->model;
+    int i;
+
+    sv_worldcount++;
 
+    memset(sv_pointcache, 0, sizeof(sv_pointcache));
+    for (i = 0; i < sv_numareanodes; i++) {
+        SV_AreaListFree(&sv_areanodes[i].triggers);
+        SV_AreaListFree(&sv_areanodes[i].solids);
+    }
     memset(sv_areanodes, 0, sizeof(sv_areanodes));
     sv_numareanodes = 0;
     SV_CreateAreaNode(0, model->mins, model->maxs);
 }
 
-static link_t **sv_link_next;
-static link_t **sv_link_prev;
+/*
+ * While the move log is open, the old and new bounds of every solid entity
+ * that is unlinked or linked are recorded, except for entities flagged in the
+ * skip array (indexed by edict number). SV_Physics uses this to find traces
+ * computed at the start of a frame that something has since moved into.
+ */
+#define MAX_MOVELOG 256
+
+static bounds_t sv_movelog[MAX_MOVELOG];
+static int sv_movelogcount = -1; /* -1 when closed, MAX_MOVELOG + 1 on overflow */
+static const byte *sv_movelogskip;
+
+void SV_OpenMoveLog(const byte *skip) {
+    sv_movelogskip = skip;
+    sv_movelogcount = 0;
+}
+
+void SV_CloseMoveLog(void) { sv_movelogcount = -1; }
+
+static void SV_LogMove(const edict_t *ent) {
+    bounds_t *bounds;
+
+    if (sv_movelogcount < 0 || sv_movelogcount > MAX_MOVELOG) return;
+    if (sv_movelogskip[NUM_FOR_EDICT(ent)]) return;
+    if (sv_movelogcount == MAX_MOVELOG) {
+        sv_movelogcount++;
+        return;
+    }
+
+    bounds = &sv_movelog[sv_movelogcount++];
+    VectorCopy(ent->v.absmin, bounds->mins);
+    VectorCopy(ent->v.absmax, bounds->maxs);
+}
+
+/*
+===============
+SV_MoveLogTouches
+
+True if anything logged since the log was opened may touch the given box.
+===============
+*/
+qboolean SV_MoveLogTouches(const vec3_t mins, const vec3_t maxs) {
+    const bounds_t *bounds;
+    int i;
+
+    if (sv_movelogcount > MAX_MOVELOG) return true;
+
+    for (i = 0, bounds = sv_movelog; i < sv_movelogcount; i++, bounds++) {
+        if (mins[0] > bounds->maxs[0] || mins[1] > bounds->maxs[1] || mins[2] > bounds->maxs[2] ||
+            maxs[0] < bounds->mins[0] || maxs[1] < bounds->mins[1] || maxs[2] < bounds->mins[2])
+            continue;
+        return true;
+    }
+
+    return false;
+}
 
 /*
 ===============
@@ -266,9 +462,9 @@ SV_UnlinkEdict
 */
 void SV_UnlinkEdict(edict_t *ent) {
     if (!ent->area.prev) return;  // not linked in anywhere
+    if (ent->v.solid != SOLID_TRIGGER) SV_LogMove(ent);
     RemoveLink(&ent->area);
-    if (sv_link_next && *sv_link_next == &ent->area) *sv_link_next = ent->area.next;
-    if (sv_link_prev && *sv_link_prev == &ent->area) *sv_link_prev = ent->area.prev;
+    SV_AreaListRemove(ent);
     ent->area.prev = ent->area.next = NULL;
 }
 
@@ -277,32 +473,25 @@ void SV_UnlinkEdict(edict_t *ent) {
 SV_TouchLinks
 ====================
 */
-static void SV_TouchLinks(edict_t *ent, const areanode_t *node) {
-    link_t *link, *next;
-    const link_t *const triggers = &node->trigger_edicts;
+static void SV_TouchLinks(edict_t *ent, areanode_t *node) {
+    arealist_t *const triggers = &node->triggers;
+    areabounds_t bounds;
     edict_t *touch;
-    int old_self, old_other;
+    int i, old_self, old_other;
 
-    /* touch linked edicts */
-    for (link = triggers->next; link != triggers; link = next) {
-        sv_link_next = &next;
-        /*
-         * FIXME - Just paranoia? Check if this can really happen...
-         *         (I think it was related to the E2M2 drawbridge bug)
-         */
-        if (!link) { /* my area got removed out from under me! */
-            Con_Printf("%s: encountered NULL link\n", __func__);
-            break;
-        }
+    /*
+     * Touch functions may link and unlink anything, including ent. Holes
+     * keep the entries in place while this list is walked, and anything
+     * added goes on the end, to be reached later in the loop.
+     */
+    SV_PackBounds(ent->v.absmin, ent->v.absmax, &bounds);
+    triggers->walking++;
+    for (i = 0; i < triggers->count; i++) {
+        if (SV_BoundsApart(&bounds, &triggers->bounds[i])) continue;
 
-        next = link->next;
-        touch = container_of(link, edict_t, area);
-        if (touch == ent) continue;
+        touch = triggers->edicts[i];
+        if (!touch || touch == ent) continue;
         if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER) continue;
-        if (ent->v.absmin[0] > touch->v.absmax[0] || ent->v.absmin[1] > touch->v.absmax[1] ||
-            ent->v.absmin[2] > touch->v.absmax[2] || ent->v.absmax[0] < touch->v.absmin[0] ||
-            ent->v.absmax[1] < touch->v.absmin[1] || ent->v.absmax[2] < touch->v.absmin[2])
-            continue;
 
         old_self = pr_global_struct->self;
         old_other = pr_global_struct->other;
@@ -314,9 +503,13 @@ static void SV_TouchLinks(edict_t *ent, const areanode_t *node) {
 
         pr_global_struct->self = old_self;
         pr_global_struct->other = old_other;
+
+        SV_PackBounds(ent->v.absmin, ent->v.absmax, &bounds);
     }
+    triggers->walking--;
 
-    sv_link_next = NULL;
+    if (!triggers->walking && triggers->holes > 16 && triggers->holes * 2 > triggers->count)
+        SV_AreaListCompact(triggers);
 
     /* recurse down both sides */
     if (node->axis == -1) return;
@@ -329,13 +522,19 @@ static void SV_TouchLinks(edict_t *ent, const areanode_t *node) {
 ===============
 SV_FindTouchedLeafs
 
+Also narrows the entity's leaf cache to the abs boxes that land on the same
+side of every node visited, and so touch exactly the same leaves. Only
+axial planes give a simple range; any other plane restricts the cache to
+the current box.
 ===============
 */
-static void SV_FindTouchedLeafs(edict_t *ent, const mnode_t *node) {
+static void SV_FindTouchedLeafs(edict_t *ent, const mnode_t *node, leafcache_t *cache,
+                                qboolean *axial) {
     const mplane_t *splitplane;
     const mleaf_t *leaf;
-    int sides;
+    int sides, type;
     int leafnum;
+    float dist;
 
     if (node->contents == CONTENTS_SOLID) return;
 
@@ -353,8 +552,72 @@ static void SV_FindTouchedLeafs(edict_t *ent, const mnode_t *node) {
     /* recurse down the contacted sides */
     splitplane = node->plane;
     sides = BOX_ON_PLANE_SIDE(ent->v.absmin, ent->v.absmax, splitplane);
-    if (sides & PSIDE_FRONT) SV_FindTouchedLeafs(ent, node->children[0]);
-    if (sides & PSIDE_BACK) SV_FindTouchedLeafs(ent, node->children[1]);
+
+    /* the conditions BOX_ON_PLANE_SIDE tested */
+    type = splitplane->type;
+    dist = splitplane->dist;
+    if (type >= 3) {
+        *axial = false;
+    } else if (sides == PSIDE_FRONT) {
+        cache->minlo[type] = qmax(cache->minlo[type], dist);
+    } else {
+        cache->minhi[type] = qmin(cache->minhi[type], dist);
+        if (sides == PSIDE_BACK)
+            cache->maxhi[type] = qmin(cache->maxhi[type], dist);
+        else
+            cache->maxlo[type] = qmax(cache->maxlo[type], dist);
+    }
+
+    if (sides & PSIDE_FRONT) SV_FindTouchedLeafs(ent, node->children[0], cache, axial);
+    if (sides & PSIDE_BACK) SV_FindTouchedLeafs(ent, node->children[1], cache, axial);
+}
+
+static qboolean SV_LeafCacheHit(const edict_t *ent) {
+    const leafcache_t *cache = &ent->leafcache;
+    const float *absmin = ent->v.absmin;
+    const float *absmax = ent->v.absmax;
+    int i;
+
+    if (cache->worldcount != sv_worldcount) return false;
+
+    for (i = 0; i < 3; i++) {
+        if (!(absmin[i] >= cache->minlo[i] && absmin[i] < cache->minhi[i])) return false;
+        if (!(absmax[i] > cache->maxlo[i] && absmax[i] <= cache->maxhi[i])) return false;
+    }
+
+    return true;
+}
+
+static void SV_LinkLeafs(edict_t *ent) {
+    leafcache_t *cache = &ent->leafcache;
+    qboolean axial;
+    int i;
+
+    if (SV_LeafCacheHit(ent)) {
+        sv_linkstats.leafskips++;
+        return;
+    }
+
+    for (i = 0; i < 3; i++) {
+        cache->minlo[i] = cache->maxlo[i] = -INFINITY;
+        cache->minhi[i] = cache->maxhi[i] = INFINITY;
+    }
+
+    ent->num_leafs = 0;
+    axial = true;
+    SV_FindTouchedLeafs(ent, sv.worldmodel->nodes, cache, &axial);
+    sv_linkstats.leafwalks++;
+
+    if (!axial) {
+        /* only this exact box */
+        for (i = 0; i < 3; i++) {
+            cache->minlo[i] = ent->v.absmin[i];
+            cache->minhi[i] = nextafterf(ent->v.absmin[i], INFINITY);
+            cache->maxlo[i] = nextafterf(ent->v.absmax[i], -INFINITY);
+            cache->maxhi[i] = ent->v.absmax[i];
+        }
+    }
+    cache->worldcount = sv_worldcount;
 }
 
 /*
@@ -399,8 +662,13 @@ void SV_LinkEdict(edict_t *ent, qboolean touch_triggers) {
     }
 
     /* link to PVS leafs */
-    ent->num_leafs = 0;
-    if (ent->v.modelindex) SV_FindTouchedLeafs(ent, sv.worldmodel->nodes);
+    sv_linkstats.links++;
+    if (ent->v.modelindex) {
+        SV_LinkLeafs(ent);
+    } else {
+        ent->num_leafs = 0;
+        ent->leafcache.worldcount = 0;
+    }
 
     if (ent->v.solid == SOLID_NOT) return;
 
@@ -417,32 +685,92 @@ void SV_LinkEdict(edict_t *ent, qboolean touch_triggers) {
     }
 
     /* link it in */
-    if (ent->v.solid == SOLID_TRIGGER)
+    if (ent->v.solid == SOLID_TRIGGER) {
         InsertLinkBefore(&ent->area, &node->trigger_edicts);
-    else
+        SV_AreaListAdd(&node->triggers, ent);
+    } else {
         InsertLinkBefore(&ent->area, &node->solid_edicts);
+        SV_AreaListAdd(&node->solids, ent);
+        SV_LogMove(ent);
+    }
 
     if (touch_triggers) /* touch all entities at this node and decend for more */
         SV_TouchLinks(ent, sv_areanodes);
 }
 
+/*
+====================
+SV_AreaEdicts
+====================
+*/
+static int SV_AreaEdicts_r(areanode_t *node, const vec3_t mins, const vec3_t maxs,
+                           edict_t **list, int count, int maxcount) {
+    link_t *const lists[2] = {&node->solid_edicts, &node->trigger_edicts};
+    link_t *link;
+    edict_t *check;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        for (link = lists[i]->next; link != lists[i]; link = link->next) {
+            check = container_of(link, edict_t, area);
+            if (check->v.absmin[0] > maxs[0] || check->v.absmin[1] > maxs[1] ||
+                check->v.absmin[2] > maxs[2] || check->v.absmax[0] < mins[0] ||
+                check->v.absmax[1] < mins[1] || check->v.absmax[2] < mins[2])
+                continue;
+            if (count == maxcount) return count;
+            list[count++] = check;
+        }
+    }
+
+    /* recurse down both sides */
+    if (node->axis == -1) return count;
+
+    if (maxs[node->axis] > node->dist)
+        count = SV_AreaEdicts_r(node->children[0], mins, maxs, list, count, maxcount);
+    if (mins[node->axis] < node->dist)
+        count = SV_AreaEdicts_r(node->children[1], mins, maxs, list, count, maxcount);
+
+    return count;
+}
+
+int SV_AreaEdicts(const vec3_t mins, const vec3_t maxs, edict_t **list, int maxcount) {
+    return SV_AreaEdicts_r(sv_areanodes, mins, maxs, list, 0, maxcount);
+}
+
 /*
 ==================
 SV_PointContents
 ==================
 */
+static int SV_WorldPointContents(const vec3_t point) {
+    pointcache_t *entry;
+    uint32_t bits[3];
+    uint32_t hash;
+
+    memcpy(bits, point, sizeof(bits));
+    hash = bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+    entry = &sv_pointcache[(hash ^ hash >> 16) & (POINTCACHE_SIZE - 1)];
+    if (entry->contents && !memcmp(entry->point, point, sizeof(entry->point)))
+        return entry->contents;
+
+    VectorCopy(point, entry->point);
+    entry->contents = Mod_HullPointContents(&sv.worldmodel->hulls[0], 0, point);
+
+    return entry->contents;
+}
+
 int SV_PointContents(const vec3_t point) {
 #ifdef NQ_HACK
     int contents;
 
-    contents = Mod_HullPointContents(&sv.worldmodel->hulls[0], 0, point);
+    contents = SV_WorldPointContents(point);
     if (contents <= CONTENTS_CURRENT_0 && contents >= CONTENTS_CURRENT_DOWN)
         contents = CONTENTS_WATER;
 
     return contents;
 #endif
 #if defined(QW_HACK) && defined(SERVERONLY)
-    return Mod_HullPointContents(&sv.worldmodel->hulls[0], 0, point);
+    return SV_WorldPointContents(point);
 #endif
 }
 
@@ -503,6 +831,128 @@ static void SV_ClipToEntity(const edict_t *ent, const vec3_t start, const vec3_t
 
 //===========================================================================
 
+/*
+====================
+SV_RecordClip
+
+Notes the fields of a candidate that decide how a recorded trace clips
+against it. Returns false, ending the trace, when the record is full or the
+candidate would make SV_ClipToLink or SV_HullForEntity raise an error; the
+caller traces again without a record to have it raised on its own thread.
+====================
+*/
+static qboolean SV_RecordClip(const edict_t *touch, tracerecord_t *record) {
+    traceclip_t *traceclip;
+    const model_t *model;
+
+    if (touch->v.solid == SOLID_TRIGGER) {
+        record->error = true;
+        return false;
+    }
+    if (touch->v.solid == SOLID_BSP) {
+        model = sv.models[(int)touch->v.modelindex];
+        if (touch->v.movetype != MOVETYPE_PUSH || !model || model->type != mod_brush) {
+            record->error = true;
+            return false;
+        }
+    }
+    if (record->count == record->max) {
+        record->overflow = true;
+        return false;
+    }
+
+    traceclip = &record->clips[record->count++];
+    traceclip->ent = touch;
+    traceclip->solid = touch->v.solid;
+    traceclip->monster = ((int)touch->v.flags & FL_MONSTER) != 0;
+    traceclip->owner = touch->v.owner;
+    VectorCopy(touch->v.origin, traceclip->origin);
+
+    return true;
+}
+
+/*
+====================
+SV_RecordValid
+
+True if every candidate in the record still has the fields it was traced
+with
+====================
+*/
+qboolean SV_RecordValid(const tracerecord_t *record) {
+    const traceclip_t *traceclip;
+    const edict_t *ent;
+    int i;
+
+    if (record->overflow || record->error) return false;
+
+    for (i = 0, traceclip = record->clips; i < record->count; i++, traceclip++) {
+        ent = traceclip->ent;
+        if (ent->v.solid != traceclip->solid || ent->v.owner != traceclip->owner) return false;
+        if ((((int)ent->v.flags & FL_MONSTER) != 0) != traceclip->monster) return false;
+        if (!VectorCompare(ent->v.origin, traceclip->origin)) return false;
+    }
+
+    return true;
+}
+
+/*
+====================
+SV_ClipToLink
+
+Clips the move against one entity from an area list, once its box is known
+to touch the move. Returns false when the trace is all solid and there is
+no point in looking any further.
+====================
+*/
+static inline qboolean SV_ClipToLink(edict_t *touch, const moveclip_t *clip, trace_t *trace,
+                                     const edict_t **clipent) {
+    trace_t stacktrace;
+    const bounds_t *clipbounds;
+
+    if (touch == clip->passedict) return true;
+    if (clip->record && !SV_RecordClip(touch, clip->record)) return false;
+
+    if (touch->v.solid == SOLID_NOT) return true;
+    if (touch->v.solid == SOLID_TRIGGER) SV_Error("Trigger in clipping list");
+
+    if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP) return true;
+
+    if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
+        return true;  // points never interact
+
+    /* might intersect, so do an exact clip */
+    if (trace->allsolid) return false;
+    if (clip->passedict) {
+        /* don't clip against own missiles */
+        if (PROG_TO_EDICT(touch->v.owner) == clip->passedict) return true;
+        /* don't clip against owner */
+        if (PROG_TO_EDICT(clip->passedict->v.owner) == touch) return true;
+    }
+
+    if ((int)touch->v.flags & FL_MONSTER)
+        clipbounds = &clip->monster;
+    else
+        clipbounds = &clip->object;
+    SV_ClipToEntity(touch, clip->start, clipbounds->mins, clipbounds->maxs, clip->end,
+                    &stacktrace);
+
+    if (stacktrace.allsolid || stacktrace.startsolid || stacktrace.fraction < trace->fraction) {
+        *clipent = touch;
+        stacktrace.backedup |= trace->backedup;
+        if (trace->startsolid) {
+            *trace = stacktrace;
+            trace->startsolid = true;
+        } else
+            *trace = stacktrace;
+    } else {
+        if (stacktrace.startsolid) trace->startsolid = true;
+        if (stacktrace.backedup) trace->backedup = true;
+    }
+
+    return true;
+}
+
 /*
 ====================
 SV_ClipToLinks
@@ -513,73 +963,61 @@ Returns a pointer to the entity which clipped the move, NULL otherwise.
 */
 static const edict_t *SV_ClipToLinks_r(const edict_t *clipent, const areanode_t *node,
                                        const moveclip_t *clip, trace_t *trace) {
+    const arealist_t *const solids = &node->solids;
+    edict_t *touch;
+    int i;
+
+    /* touch linked edicts */
+    for (i = 0; i < solids->count; i++) {
+        if (SV_BoundsApart(&clip->packedmove, &solids->bounds[i])) continue;
+
+        touch = solids->edicts[i];
+        if (!touch) continue;
+        if (!SV_ClipToLink(touch, clip, trace, &clipent)) return clipent;
+    }
+
+    /* recurse down both sides */
+    if (node->axis == -1) return clipent;
+
+    if (clip->move.maxs[node->axis] > node->dist)
+        clipent = SV_ClipToLinks_r(clipent, node->children[0], clip, trace);
+    if (clip->move.mins[node->axis] < node->dist)
+        clipent = SV_ClipToLinks_r(clipent, node->children[1], clip, trace);
+
+    return clipent;
+}
+
+/* The same walk over the link lists and edict memory, for sv_movebench */
+static const edict_t *SV_ClipToLinksUnpacked_r(const edict_t *clipent, const areanode_t *node,
+                                               const moveclip_t *clip, trace_t *trace) {
     link_t *link, *next;
     const link_t *const solids = &node->solid_edicts;
     edict_t *touch;
-    trace_t stacktrace;
-    const bounds_t *clipbounds;
 
     /* touch linked edicts */
     for (link = solids->next; link != solids; link = next) {
         next = link->next;
         touch = container_of(link, edict_t, area);
-        if (touch->v.solid == SOLID_NOT) continue;
-        if (touch == clip->passedict) continue;
-        if (touch->v.solid == SOLID_TRIGGER) SV_Error("Trigger in clipping list");
-
-        if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP) continue;
 
         if (clip->move.mins[0] > touch->v.absmax[0] || clip->move.mins[1] > touch->v.absmax[1] ||
             clip->move.mins[2] > touch->v.absmax[2] || clip->move.maxs[0] < touch->v.absmin[0] ||
             clip->move.maxs[1] < touch->v.absmin[1] || clip->move.maxs[2] < touch->v.absmin[2])
             continue;
 
-        if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
-            continue;  // points never interact
-
-        /* might intersect, so do an exact clip */
-        if (trace->allsolid) return clipent;
-        if (clip->passedict) {
-            /* don't clip against own missiles */
-            if (PROG_TO_EDICT(touch->v.owner) == clip->passedict) continue;
-            /* don't clip against owner */
-            if (PROG_TO_EDICT(clip->passedict->v.owner) == touch) continue;
-        }
-
-        if ((int)touch->v.flags & FL_MONSTER)
-            clipbounds = &clip->monster;
-        else
-            clipbounds = &clip->object;
-        SV_ClipToEntity(touch, clip->start, clipbounds->mins, clipbounds->maxs, clip->end,
-                        &stacktrace);
-
-        if (stacktrace.allsolid || stacktrace.startsolid || stacktrace.fraction < trace->fraction) {
-            clipent = touch;
-            if (trace->startsolid) {
-                *trace = stacktrace;
-                trace->startsolid = true;
-            } else
-                *trace = stacktrace;
-        } else if (stacktrace.startsolid)
-            trace->startsolid = true;
+        if (!SV_ClipToLink(touch, clip, trace, &clipent)) return clipent;
     }
 
     /* recurse down both sides */
     if (node->axis == -1) return clipent;
 
     if (clip->move.maxs[node->axis] > node->dist)
-        clipent = SV_ClipToLinks_r(clipent, node->children[0], clip, trace);
+        clipent = SV_ClipToLinksUnpacked_r(clipent, node->children[0], clip, trace);
     if (clip->move.mins[node->axis] < node->dist)
-        clipent = SV_ClipToLinks_r(clipent, node->children[1], clip, trace);
+        clipent = SV_ClipToLinksUnpacked_r(clipent, node->children[1], clip, trace);
 
     return clipent;
 }
 
-static const edict_t *SV_ClipToLinks(const areanode_t *node, const moveclip_t *clip,
-                                     trace_t *trace) {
-    return SV_ClipToLinks_r(NULL, node, clip, trace);
-}
-
 /*
 ==================
 SV_MoveBounds
@@ -608,9 +1046,10 @@ If the move was clipped, returns a pointer to the entity that clipped the
 move, otherwise NULL.
 ==================
 */
-const edict_t *SV_TraceMove(const vec3_t start, const vec3_t mins, const vec3_t maxs,
-                            const vec3_t end, const movetype_t type, const edict_t *passedict,
-                            trace_t *trace) {
+static const edict_t *SV_TraceMove_(const vec3_t start, const vec3_t mins, const vec3_t maxs,
+                                    const vec3_t end, const movetype_t type,
+                                    const edict_t *passedict, trace_t *trace, qboolean packed,
+                                    tracerecord_t *record) {
     const edict_t *clipent;
     qboolean clipworld;
     moveclip_t clip;
@@ -624,6 +1063,7 @@ const edict_t *SV_TraceMove(const vec3_t start, const vec3_t mins, const vec3_t
     VectorCopy(maxs, clip.object.maxs);
     clip.type = type;
     clip.passedict = passedict;
+    clip.record = record;
 
     /* clip to world */
     SV_ClipToEntity(sv.edicts, start, mins, maxs, end, trace);
@@ -641,10 +1081,273 @@ const edict_t *SV_TraceMove(const vec3_t start, const vec3_t mins, const vec3_t
 
     /* create the bounding box of the entire move */
     SV_MoveBounds(&clip.monster, start, end, &clip.move);
+    SV_PackBounds(clip.move.mins, clip.move.maxs, &clip.packedmove);
 
     /* clip to entities */
-    clipent = SV_ClipToLinks(sv_areanodes, &clip, trace);
+    if (packed)
+        clipent = SV_ClipToLinks_r(NULL, sv_areanodes, &clip, trace);
+    else
+        clipent = SV_ClipToLinksUnpacked_r(NULL, sv_areanodes, &clip, trace);
     if (!clipent && clipworld) clipent = sv.edicts;
 
     return clipent;
 }
+
+const edict_t *SV_TraceMove(const vec3_t start, const vec3_t mins, const vec3_t maxs,
+                            const vec3_t end, const movetype_t type, const edict_t *passedict,
+                            trace_t *trace) {
+    const edict_t *clipent;
+
+    clipent = SV_TraceMove_(start, mins, maxs, end, type, passedict, trace, true, NULL);
+    if (trace->backedup) Con_DPrintf("backup past 0\n");
+
+    return clipent;
+}
+
+/*
+==================
+SV_TraceMoveRecord
+
+As SV_TraceMove, also filling in the record with every entity the move was
+tested against. Raises no errors and prints nothing, so may be called from
+worker threads; the caller reports trace->backedup.
+==================
+*/
+const edict_t *SV_TraceMoveRecord(const vec3_t start, const vec3_t mins, const vec3_t maxs,
+                                  const vec3_t end, const movetype_t type,
+                                  const edict_t *passedict, trace_t *trace,
+                                  tracerecord_t *record) {
+    record->count = 0;
+    record->overflow = false;
+    record->error = false;
+
+    return SV_TraceMove_(start, mins, maxs, end, type, passedict, trace, true, record);
+}
+
+/*
+===============================================================================
+
+TRACE BENCHMARK
+
+===============================================================================
+*/
+
+#define TRACEBENCH_BATCH 4096
+
+typedef struct {
+    vec3_t start, end;
+    int hullnum;
+} tracebenchmove_t;
+
+static uint32_t SV_TraceBenchRandom(uint32_t *state) {
+    /* xorshift, so the game's rand() sequence is left alone */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static float SV_TraceBenchFloat(uint32_t *state, float min, float max) {
+    return min + (max - min) * (SV_TraceBenchRandom(state) & 0xffffff) / (float)0xffffff;
+}
+
+static void SV_TraceBenchInit(trace_t *trace, const vec3_t end) {
+    /* as SV_ClipToEntity */
+    memset(trace, 0, sizeof(*trace));
+    trace->fraction = 1;
+    trace->allsolid = true;
+    VectorCopy(end, trace->endpos);
+}
+
+/*
+================
+SV_TraceBench_f
+
+sv_tracebench [count] : fire random traces through the world hulls with both
+                        Mod_TraceHull and the original recursive walk, time
+                        them and check that the results are identical
+================
+*/
+void SV_TraceBench_f(void) {
+    const model_t *model;
+    const hull_t *hull;
+    tracebenchmove_t *moves, *move;
+    trace_t *traces[2];
+    qboolean *results[2];
+    uint32_t state;
+    int i, j, done, count, batch, mismatches;
+    double start, recursive, iterative;
+
+    if (!sv.active) {
+        Con_Printf("No server running\n");
+        return;
+    }
+
+    count = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 1000000;
+    if (count <= 0) return;
+
+    moves = Hunk_TempAlloc(TRACEBENCH_BATCH *
+                           (sizeof(*moves) + 2 * sizeof(trace_t) + 2 * sizeof(qboolean)));
+    traces[0] = (trace_t *)(moves + TRACEBENCH_BATCH);
+    traces[1] = traces[0] + TRACEBENCH_BATCH;
+    results[0] = (qboolean *)(traces[1] + TRACEBENCH_BATCH);
+    results[1] = results[0] + TRACEBENCH_BATCH;
+
+    model = &sv.worldmodel->model;
+    state = 0x2545f491;
+    mismatches = 0;
+    recursive = iterative = 0;
+
+    for (done = 0; done < count; done += batch) {
+        batch = qmin(count - done, TRACEBENCH_BATCH);
+
+        /* a mix of short moves, long lines and point tests */
+        for (i = 0, move = moves; i < batch; i++, move++) {
+            move->hullnum = SV_TraceBenchRandom(&state) % 3;
+            for (j = 0; j < 3; j++)
+                move->start[j] = SV_TraceBenchFloat(&state, model->mins[j], model->maxs[j]);
+            switch (i & 3) {
+                case 0:
+                case 1:
+                    for (j = 0; j < 3; j++)
+                        move->end[j] = move->start[j] + SV_TraceBenchFloat(&state, -64, 64);
+                    break;
+                case 2:
+                    for (j = 0; j < 3; j++)
+                        move->end[j] = SV_TraceBenchFloat(&state, model->mins[j], model->maxs[j]);
+                    break;
+                default:
+                    VectorCopy(move->start, move->end);
+                    break;
+            }
+        }
+
+        for (i = 0, move = moves; i < batch; i++, move++) {
+            SV_TraceBenchInit(&traces[0][i], move->end);
+            SV_TraceBenchInit(&traces[1][i], move->end);
+        }
+
+        start = Sys_DoubleTime();
+        for (i = 0, move = moves; i < batch; i++, move++) {
+            hull = &sv.worldmodel->hulls[move->hullnum];
+            results[0][i] = Mod_TraceHullRecursive(hull, hull->firstclipnode, move->start,
+                                                   move->end, &traces[0][i]);
+        }
+        recursive += Sys_DoubleTime() - start;
+
+        start = Sys_DoubleTime();
+        for (i = 0, move = moves; i < batch; i++, move++) {
+            hull = &sv.worldmodel->hulls[move->hullnum];
+            results[1][i] =
+                Mod_TraceHull(hull, hull->firstclipnode, move->start, move->end, &traces[1][i]);
+        }
+        iterative += Sys_DoubleTime() - start;
+
+        for (i = 0; i < batch; i++)
+            if (results[0][i] != results[1][i] ||
+                memcmp(&traces[0][i], &traces[1][i], sizeof(trace_t)))
+                mismatches++;
+    }
+
+    Con_Printf("%d traces, %d mismatches\n", count, mismatches);
+    Con_Printf("recursive %.1f ns/trace, Mod_TraceHull %.1f ns/trace\n",
+               recursive * 1e9 / count, iterative * 1e9 / count);
+}
+
+/*
+================
+SV_MoveBench_f
+
+sv_movebench [count] : fire random moves around the map's solid entities
+                       through SV_TraceMove, once walking the packed area
+                       lists and once walking the links and edicts, time
+                       both and check that the results are identical
+================
+*/
+void SV_MoveBench_f(void) {
+    static const vec3_t sizes[3][2] = {
+        {{0, 0, 0}, {0, 0, 0}},
+        {{-16, -16, -24}, {16, 16, 32}},
+        {{-32, -32, -24}, {32, 32, 64}},
+    };
+    tracebenchmove_t *moves, *move;
+    trace_t *traces[2];
+    const edict_t **results[2];
+    edict_t **solids, *ent;
+    uint32_t state;
+    int i, j, done, count, batch, numsolids, mismatches;
+    double start, packed, unpacked;
+
+    if (!sv.active) {
+        Con_Printf("No server running\n");
+        return;
+    }
+
+    count = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 100000;
+    if (count <= 0) return;
+
+    solids = Hunk_TempAlloc(sv.num_edicts * sizeof(*solids) +
+                            TRACEBENCH_BATCH * (sizeof(*moves) + 2 * sizeof(trace_t) +
+                                                2 * sizeof(const edict_t *)));
+    moves = (tracebenchmove_t *)(solids + sv.num_edicts);
+    traces[0] = (trace_t *)(moves + TRACEBENCH_BATCH);
+    traces[1] = traces[0] + TRACEBENCH_BATCH;
+    results[0] = (const edict_t **)(traces[1] + TRACEBENCH_BATCH);
+    results[1] = results[0] + TRACEBENCH_BATCH;
+
+    /* start the moves around entities, where the area lists matter */
+    numsolids = 0;
+    ent = NEXT_EDICT(sv.edicts);
+    for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent))
+        if (!ent->free && ent->area.prev && ent->v.solid != SOLID_TRIGGER)
+            solids[numsolids++] = ent;
+    if (!numsolids) {
+        Con_Printf("No solid entities linked\n");
+        return;
+    }
+
+    state = 0x2545f491;
+    mismatches = 0;
+    packed = unpacked = 0;
+
+    for (done = 0; done < count; done += batch) {
+        batch = qmin(count - done, TRACEBENCH_BATCH);
+
+        for (i = 0, move = moves; i < batch; i++, move++) {
+            ent = solids[SV_TraceBenchRandom(&state) % numsolids];
+            move->hullnum = SV_TraceBenchRandom(&state) % 3;
+            for (j = 0; j < 3; j++) {
+                move->start[j] = ent->v.origin[j] + SV_TraceBenchFloat(&state, -128, 128);
+                move->end[j] = move->start[j] + SV_TraceBenchFloat(&state, -128, 128);
+            }
+            SV_TraceBenchInit(&traces[0][i], move->end);
+            SV_TraceBenchInit(&traces[1][i], move->end);
+        }
+
+        start = Sys_DoubleTime();
+        for (i = 0, move = moves; i < batch; i++, move++)
+            results[0][i] = SV_TraceMove_(move->start, sizes[move->hullnum][0],
+                                          sizes[move->hullnum][1], move->end,
+                                          (i & 1) ? MOVE_MISSILE : MOVE_NORMAL, NULL,
+                                          &traces[0][i], true, NULL);
+        packed += Sys_DoubleTime() - start;
+
+        start = Sys_DoubleTime();
+        for (i = 0, move = moves; i < batch; i++, move++)
+            results[1][i] = SV_TraceMove_(move->start, sizes[move->hullnum][0],
+                                          sizes[move->hullnum][1], move->end,
+                                          (i & 1) ? MOVE_MISSILE : MOVE_NORMAL, NULL,
+                                          &traces[1][i], false, NULL);
+        unpacked += Sys_DoubleTime() - start;
+
+        for (i = 0; i < batch; i++)
+            if (results[0][i] != results[1][i] ||
+                memcmp(&traces[0][i], &traces[1][i], sizeof(trace_t)))
+                mismatches++;
+    }
+
+    Con_Printf("%d moves among %d solid entities, %d mismatches\n", count, numsolids,
+               mismatches);
+    Con_Printf("packed lists %.1f ns/move, links %.1f ns/move\n", packed * 1e9 / count,
+               unpacked * 1e9 / count);
+}
@@ -67,6 +67,182 @@ static memzone_t *mainzone;
 
 static void Z_ClearZone(memzone_t *zone, int size);
 
+/*
+ * ============================================================================
+ *
+ * SLAB ALLOCATION
+ *
+ * Small zone requests are served in constant time from power of two size
+ * classes. Pages of the slab arena are handed to a size class the first time
+ * it runs dry and are never given back; each class keeps a free list
+ * threaded through its unused objects. Requests bigger than the largest
+ * class, or made once the arena is exhausted, go to the first-fit zone.
+ * ============================================================================
+ */
+
+#define SLAB_SIZE 0x40000 /* 256k */
+#define SLAB_PAGESIZE 4096
+#define SLAB_MINSHIFT 4 /* smallest class is 16 bytes */
+#define SLAB_NUMCLASSES 6 /* ...and the largest 512 */
+#define SLAB_NOCLASS 0xff
+#define SLAB_FREEID 0x1d4a1f /* marks objects on a free list */
+
+typedef struct slabobj_s {
+    struct slabobj_s *next;
+    int id; /* SLAB_FREEID while free, cleared on allocation */
+} slabobj_t;
+
+typedef struct {
+    int size;            /* object size */
+    int pages;           /* pages owned by this class */
+    int used, peak;      /* objects handed out */
+    unsigned allocs;     /* lifetime allocation count */
+    slabobj_t *freelist;
+} slabclass_t;
+
+static struct {
+    byte *base;
+    int numpages;
+    int nextpage;    /* first page not yet given to a class */
+    byte *pageclass; /* class index of each page */
+    unsigned overflow; /* small requests that fell through to the zone */
+    slabclass_t classes[SLAB_NUMCLASSES];
+} slab;
+
+static void Z_SlabInit(int size) {
+    int i;
+
+    slab.numpages = size / SLAB_PAGESIZE;
+    slab.base = Hunk_AllocName(slab.numpages * SLAB_PAGESIZE, "zoneslab");
+    slab.pageclass = Hunk_AllocName(slab.numpages, "zoneslab");
+    memset(slab.pageclass, SLAB_NOCLASS, slab.numpages);
+    for (i = 0; i < SLAB_NUMCLASSES; i++) slab.classes[i].size = 1 << (SLAB_MINSHIFT + i);
+}
+
+static inline qboolean Z_SlabOwns(const void *ptr) {
+    const byte *p = ptr;
+    return p >= slab.base && p < slab.base + slab.numpages * SLAB_PAGESIZE;
+}
+
+static inline int Z_SlabClass(int size) {
+    int i;
+
+    for (i = 0; i < SLAB_NUMCLASSES; i++)
+        if (size <= slab.classes[i].size) return i;
+
+    return -1;
+}
+
+static inline int Z_SlabPageClass(const void *ptr) {
+    return slab.pageclass[((const byte *)ptr - slab.base) / SLAB_PAGESIZE];
+}
+
+/*
+ * Live objects can hold SLAB_FREEID by chance, so only a walk of the free
+ * list is conclusive. It is only done when the id matches.
+ */
+static qboolean Z_SlabIsFree(const slabclass_t *class, const slabobj_t *obj) {
+    const slabobj_t *free;
+
+    if (obj->id != SLAB_FREEID) return false;
+    for (free = class->freelist; free; free = free->next)
+        if (free == obj) return true;
+
+    return false;
+}
+
+/*
+ * Give the next free arena page to a class and thread its objects onto the
+ * class free list.
+ */
+static qboolean Z_SlabGrow(int classnum) {
+    slabclass_t *class = &slab.classes[classnum];
+    byte *page;
+    slabobj_t *obj;
+    int offset;
+
+    if (slab.nextpage == slab.numpages) return false;
+
+    slab.pageclass[slab.nextpage] = classnum;
+    page = slab.base + slab.nextpage * SLAB_PAGESIZE;
+    slab.nextpage++;
+    class->pages++;
+
+    for (offset = SLAB_PAGESIZE - class->size; offset >= 0; offset -= class->size) {
+        obj = (slabobj_t *)(page + offset);
+        obj->id = SLAB_FREEID;
+        obj->next = class->freelist;
+        class->freelist = obj;
+    }
+
+    return true;
+}
+
+/*
+ * Returns NULL if the request is too large for the slabs, or if its class is
+ * empty and the arena has no pages left.
+ */
+static void *Z_SlabMalloc(int size) {
+    slabclass_t *class;
+    slabobj_t *obj;
+    int classnum;
+
+    classnum = Z_SlabClass(size);
+    if (classnum < 0) return NULL;
+
+    class = &slab.classes[classnum];
+    if (!class->freelist && !Z_SlabGrow(classnum)) {
+        slab.overflow++;
+        return NULL;
+    }
+
+    obj = class->freelist;
+    class->freelist = obj->next;
+    class->allocs++;
+    if (++class->used > class->peak) class->peak = class->used;
+
+    /* clear the whole object so Z_Realloc can grow it in place */
+    memset(obj, 0, class->size);
+
+    return obj;
+}
+
+static void Z_SlabFree(const void *ptr) {
+    slabclass_t *class;
+    slabobj_t *obj;
+    int classnum;
+
+    classnum = Z_SlabPageClass(ptr);
+    if (classnum == SLAB_NOCLASS) Sys_Error("%s: pointer in an unused slab page", __func__);
+
+    class = &slab.classes[classnum];
+    if (((const byte *)ptr - slab.base) % class->size)
+        Sys_Error("%s: misaligned slab pointer", __func__);
+
+    obj = (slabobj_t *)ptr;
+    if (Z_SlabIsFree(class, obj)) Sys_Error("%s: freed a freed pointer", __func__);
+    obj->id = SLAB_FREEID;
+    obj->next = class->freelist;
+    class->freelist = obj;
+    class->used--;
+}
+
+static void Z_SlabPrint(void) {
+    const slabclass_t *class;
+    int i, capacity;
+
+    Con_Printf("slabs: %d of %d pages used, %u overflowed to zone\n", slab.nextpage,
+               slab.numpages, slab.overflow);
+    Con_Printf("  size pages   used   free   peak     allocs  frag\n");
+    for (i = 0; i < SLAB_NUMCLASSES; i++) {
+        class = &slab.classes[i];
+        capacity = class->pages * (SLAB_PAGESIZE / class->size);
+        Con_Printf("  %4d %5d %6d %6d %6d %10u  %3d%%\n", class->size, class->pages, class->used,
+                   capacity - class->used, class->peak, class->allocs,
+                   capacity ? (capacity - class->used) * 100 / capacity : 0);
+    }
+}
+
 /*
  * ========================
  * Z_ClearZone
@@ -102,6 +278,11 @@ void Z_Free(const void *ptr) {
 
     if (!ptr) Sys_Error("%s: NULL pointer", __func__);
 
+    if (Z_SlabOwns(ptr)) {
+        Z_SlabFree(ptr);
+        return;
+    }
+
     block = (memblock_t *)((const byte *)ptr - sizeof(memblock_t));
     if (block->id != ZONEID) Sys_Error("%s: freed a pointer without ZONEID", __func__);
     if (block->tag == 0) Sys_Error("%s: freed a freed pointer", __func__);
@@ -210,6 +391,9 @@ static void *Z_TagMalloc(int size, int tag) {
 void *Z_Malloc(int size) {
     void *buf;
 
+    buf = Z_SlabMalloc(size);
+    if (buf) return buf;
+
     Z_CheckHeap(); /* DEBUG */
     buf = Z_TagMalloc(size, 1);
     if (!buf) Sys_Error("%s: failed on allocation of %i bytes", __func__, size);
@@ -230,19 +414,43 @@ void *Z_Realloc(const void *ptr, int size) {
 
     if (!ptr) return Z_Malloc(size);
 
-    block = (memblock_t *)((byte *)ptr - sizeof(memblock_t));
-    if (block->id != ZONEID) Sys_Error("%s: realloced a pointer without ZONEID", __func__);
-    if (!block->tag) Sys_Error("%s: realloced a freed pointer", __func__);
-
-    orig_size = block->size;
-    orig_size -= sizeof(memblock_t);
-    orig_size -= sizeof(int); /* ZONEID marker */
+    if (Z_SlabOwns(ptr)) {
+        /*
+         * Slab objects are fully cleared on allocation and the tail is
+         * cleared again on shrinking, so everything past the requested size
+         * is zero and they can grow in place.
+         */
+        orig_size = slab.classes[Z_SlabPageClass(ptr)].size;
+        if (Z_SlabIsFree(&slab.classes[Z_SlabPageClass(ptr)], ptr))
+            Sys_Error("%s: realloced a freed pointer", __func__);
+        if (size <= orig_size) {
+            memset((byte *)ptr + size, 0, orig_size - size);
+            return (void *)ptr;
+        }
+    } else {
+        block = (memblock_t *)((byte *)ptr - sizeof(memblock_t));
+        if (block->id != ZONEID) Sys_Error("%s: realloced a pointer without ZONEID", __func__);
+        if (!block->tag) Sys_Error("%s: realloced a freed pointer", __func__);
+
+        orig_size = block->size;
+        orig_size -= sizeof(memblock_t);
+        orig_size -= sizeof(int); /* ZONEID marker */
+
+        if (Z_SlabClass(size) < 0) {
+            Z_Free(ptr);
+            ret = Z_TagMalloc(size, 1);
+            if (!ret) Sys_Error("%s: failed on allocation of %i bytes", __func__, size);
+            if (ret != ptr) memmove(ret, ptr, qmin(orig_size, size));
+            if (size > orig_size) memset((byte *)ret + orig_size, 0, size - orig_size);
+            return ret;
+        }
+    }
 
+    /* moving between the slabs and the zone, or to a bigger class */
+    ret = Z_Malloc(size);
+    memcpy(ret, ptr, qmin(orig_size, size));
     Z_Free(ptr);
-    ret = Z_TagMalloc(size, 1);
-    if (!ret) Sys_Error("%s: failed on allocation of %i bytes", __func__, size);
-    if (ret != ptr) memmove(ret, ptr, qmin(orig_size, size));
-    if (size > orig_size) memset((byte *)ret + orig_size, 0, size - orig_size);
+
     return ret;
 }
 
@@ -254,7 +462,7 @@ void *Z_Realloc(const void *ptr, int size) {
 static void Z_Print(const memzone_t *zone, qboolean detailed) {
     const memblock_t *block;
     unsigned free_blocks = 0, used_blocks = 0;
-    size_t free_size = 0, used_size = 0;
+    size_t free_size = 0, used_size = 0, largest_free = 0;
 
     block = zone->blocklist.next;
     while (block) {
@@ -265,6 +473,7 @@ static void Z_Print(const memzone_t *zone, qboolean detailed) {
         if (!block->tag) {
             free_blocks++;
             free_size += block->size;
+            if (block->size > largest_free) largest_free = block->size;
         } else {
             used_blocks++;
             used_size += block->size;
@@ -283,6 +492,10 @@ static void Z_Print(const memzone_t *zone, qboolean detailed) {
     Con_Printf("zone size: %d  location: %p\n", zone->size, zone);
     Con_Printf("  %7lu bytes used in %d blocks\n", (unsigned long)used_size, used_blocks);
     Con_Printf("  %7lu bytes available in %d blocks\n", (unsigned long)free_size, free_blocks);
+    Con_Printf("  %7lu bytes largest free block (%d%% fragmented)\n", (unsigned long)largest_free,
+               free_size ? (int)(100 - largest_free * 100 / free_size) : 0);
+
+    Z_SlabPrint();
 }
 
 static void Z_Zone_f(void) {
@@ -691,9 +904,33 @@ typedef struct cache_system_s {
     char name[CACHE_NAMELEN];
     struct cache_system_s *prev, *next;
     struct cache_system_s *lru_prev, *lru_next; /* for LRU flushing */
+    struct cache_system_s *gap_prev, *gap_next; /* free gap index */
+    int gap;        /* free bytes between this block and the next */
+    int gap_bucket; /* -1 if not in the index */
 } cache_system_t;
 
+/*
+ * The free space between two cache blocks is indexed by the block below it,
+ * in segregated lists keyed on the log2 of the gap size. The gaps below the
+ * first block and above the last one depend on the hunk marks and are
+ * checked directly instead.
+ */
+#define CACHE_GAPBUCKETS 32
+
 static cache_system_t cache_head;
+static cache_system_t *cache_gaps[CACHE_GAPBUCKETS];
+static int cache_gapbytes; /* total of all indexed gaps */
+
+static struct {
+    unsigned allocs;
+    unsigned evictions;
+    unsigned moves;
+    unsigned compactions;
+    size_t evicted_bytes;
+    double alloc_time;
+    double alloc_maxtime;
+} cache_stats;
+
 static cache_system_t *Cache_TryAlloc(int size, qboolean nobottom);
 
 static inline cache_system_t *Cache_System(const cache_user_t *c) {
@@ -702,9 +939,76 @@ static inline cache_system_t *Cache_System(const cache_user_t *c) {
 
 static inline void *Cache_Data(const cache_system_t *c) { return (byte *)(c + 1) + c->user->pad; }
 
+static inline int Cache_GapBucket(int size) {
+    int bucket = 0;
+
+    while (size >>= 1) bucket++;
+
+    return bucket;
+}
+
+static void Cache_GapRemove(cache_system_t *cs) {
+    if (cs->gap_bucket < 0) return;
+
+    if (cs->gap_prev)
+        cs->gap_prev->gap_next = cs->gap_next;
+    else
+        cache_gaps[cs->gap_bucket] = cs->gap_next;
+    if (cs->gap_next) cs->gap_next->gap_prev = cs->gap_prev;
+
+    cache_gapbytes -= cs->gap;
+    cs->gap_prev = cs->gap_next = NULL;
+    cs->gap_bucket = -1;
+    cs->gap = 0;
+}
+
+/*
+ * Re-index the gap above a block after its neighbours have changed
+ */
+static void Cache_GapUpdate(cache_system_t *cs) {
+    int gap, bucket;
+
+    if (cs == &cache_head) return;
+
+    Cache_GapRemove(cs);
+    if (cs->next == &cache_head) return;
+
+    gap = (byte *)cs->next - ((byte *)cs + cs->size);
+    if (gap <= 0) return;
+
+    bucket = Cache_GapBucket(gap);
+    cs->gap = gap;
+    cs->gap_bucket = bucket;
+    cs->gap_prev = NULL;
+    cs->gap_next = cache_gaps[bucket];
+    if (cs->gap_next) cs->gap_next->gap_prev = cs;
+    cache_gaps[bucket] = cs;
+    cache_gapbytes += gap;
+}
+
+/*
+ * Returns a block with at least size free bytes above it, or NULL
+ */
+static cache_system_t *Cache_GapFind(int size) {
+    cache_system_t *cs;
+    int bucket;
+
+    /* the first list may hold gaps smaller than the request */
+    bucket = Cache_GapBucket(size);
+    for (cs = cache_gaps[bucket]; cs; cs = cs->gap_next)
+        if (cs->gap >= size) return cs;
+
+    /* anything in the larger lists will do */
+    for (bucket++; bucket < CACHE_GAPBUCKETS; bucket++)
+        if (cache_gaps[bucket]) return cache_gaps[bucket];
+
+    return NULL;
+}
+
 #ifdef DEBUG
 void Cache_CheckLinks(void) {
     const cache_system_t *cache;
+    int gap, gapbytes;
 
     cache = cache_head.next;
     while (cache != &cache_head) cache = cache->next;
@@ -717,6 +1021,14 @@ void Cache_CheckLinks(void) {
 
     cache = cache_head.lru_prev;
     while (cache != &cache_head) cache = cache->lru_prev;
+
+    gapbytes = 0;
+    for (cache = cache_head.next; cache->next != &cache_head; cache = cache->next) {
+        gap = (const byte *)cache->next - ((const byte *)cache + cache->size);
+        if (gap != cache->gap) Sys_Error("%s: gap index out of date", __func__);
+        gapbytes += gap;
+    }
+    if (gapbytes != cache_gapbytes) Sys_Error("%s: gap total out of date", __func__);
 }
 #endif
 
@@ -736,6 +1048,7 @@ static void Cache_Move(cache_system_t *old_cs) {
         memcpy(new_cs->name, old_cs->name, sizeof(new_cs->name));
         Cache_Dealloc(old_cs->user);
         new_cs->user->data = Cache_Data(new_cs);
+        cache_stats.moves++;
     } else {
         /* tough luck... */
         Cache_Free(old_cs->user);
@@ -804,6 +1117,33 @@ static void Cache_MakeLRU(cache_system_t *cs) {
     cache_head.lru_next = cs;
 }
 
+/*
+ * ============
+ * Cache_LinkBlock
+ *
+ * Set up a new block at the given address and link it between prev and next
+ * ============
+ */
+static cache_system_t *Cache_LinkBlock(void *addr, int size, cache_system_t *prev,
+                                       cache_system_t *next) {
+    cache_system_t *new = addr;
+
+    memset(new, 0, sizeof(*new));
+    new->size = size;
+    new->gap_bucket = -1;
+
+    new->next = next;
+    new->prev = prev;
+    prev->next = new;
+    next->prev = new;
+
+    Cache_GapUpdate(prev);
+    Cache_GapUpdate(new);
+    Cache_MakeLRU(new);
+
+    return new;
+}
+
 /*
  * ============
  * Cache_TryAlloc
@@ -813,65 +1153,30 @@ static void Cache_MakeLRU(cache_system_t *cs) {
  * ============
  */
 static cache_system_t *Cache_TryAlloc(int size, qboolean nobottom) {
-    cache_system_t *cs, *new;
+    cache_system_t *cs;
+    byte *low, *high, *end;
+
+    low = hunkstate.base + hunkstate.lowbytes;
+    high = hunkstate.base + hunkstate.size - hunkstate.highbytes;
 
     /* is the cache completely empty? */
     if (!nobottom && cache_head.prev == &cache_head) {
-        if (hunkstate.size - hunkstate.highbytes - hunkstate.lowbytes < size)
-            Sys_Error("%s: %i is greater than free hunk", __func__, size);
-
-        new = (cache_system_t *)(hunkstate.base + hunkstate.lowbytes);
-        memset(new, 0, sizeof(*new));
-        new->size = size;
-
-        cache_head.prev = cache_head.next = new;
-        new->prev = new->next = &cache_head;
-
-        Cache_MakeLRU(new);
-        return new;
+        if (high - low < size) Sys_Error("%s: %i is greater than free hunk", __func__, size);
+        return Cache_LinkBlock(low, size, &cache_head, &cache_head);
     }
 
-    /* search from the bottom up for space */
-    new = (cache_system_t *)(hunkstate.base + hunkstate.lowbytes);
+    /* below the first block */
     cs = cache_head.next;
+    if (!nobottom && (byte *)cs - low >= size) return Cache_LinkBlock(low, size, &cache_head, cs);
 
-    do {
-        if (!nobottom || cs != cache_head.next) {
-            if ((byte *)cs - (byte *)new >= size) { /* found space */
-                memset(new, 0, sizeof(*new));
-                new->size = size;
-
-                new->next = cs;
-                new->prev = cs->prev;
-                cs->prev->next = new;
-                cs->prev = new;
-
-                Cache_MakeLRU(new);
-
-                return new;
-            }
-        }
-
-        /* continue looking */
-        new = (cache_system_t *)((byte *)cs + cs->size);
-        cs = cs->next;
-
-    } while (cs != &cache_head);
+    /* between two blocks */
+    cs = Cache_GapFind(size);
+    if (cs) return Cache_LinkBlock((byte *)cs + cs->size, size, cs, cs->next);
 
     /* try to allocate one at the very end */
-    if (hunkstate.base + hunkstate.size - hunkstate.highbytes - (byte *)new >= size) {
-        memset(new, 0, sizeof(*new));
-        new->size = size;
-
-        new->next = &cache_head;
-        new->prev = cache_head.prev;
-        cache_head.prev->next = new;
-        cache_head.prev = new;
-
-        Cache_MakeLRU(new);
-
-        return new;
-    }
+    cs = cache_head.prev;
+    end = (byte *)cs + cs->size;
+    if (high - end >= size) return Cache_LinkBlock(end, size, cs, &cache_head);
 
     return NULL; /* couldn't allocate */
 }
@@ -901,6 +1206,44 @@ static void Cache_Print(void) {
     }
 }
 
+/*
+ * ============
+ * Cache_Stats
+ * ============
+ */
+static void Cache_Stats(void) {
+    const cache_system_t *cs;
+    int blocks, used, gaps, bucket;
+    byte *low, *high;
+
+    blocks = used = 0;
+    for (cs = cache_head.next; cs != &cache_head; cs = cs->next) {
+        blocks++;
+        used += cs->size;
+    }
+    gaps = 0;
+    for (bucket = 0; bucket < CACHE_GAPBUCKETS; bucket++)
+        for (cs = cache_gaps[bucket]; cs; cs = cs->gap_next) gaps++;
+
+    low = hunkstate.base + hunkstate.lowbytes;
+    high = hunkstate.base + hunkstate.size - hunkstate.highbytes;
+
+    Con_Printf("%d blocks, %d bytes used\n", blocks, used);
+    if (blocks) {
+        Con_Printf("%d bytes below, %d bytes above, %d bytes in %d gaps between\n",
+                   (int)((byte *)cache_head.next - low),
+                   (int)(high - ((byte *)cache_head.prev + cache_head.prev->size)), cache_gapbytes,
+                   gaps);
+    } else {
+        Con_Printf("%d bytes free\n", (int)(high - low));
+    }
+    Con_Printf("%u allocs, %.3f ms avg, %.3f ms max\n", cache_stats.allocs,
+               cache_stats.allocs ? cache_stats.alloc_time * 1000 / cache_stats.allocs : 0.0,
+               cache_stats.alloc_maxtime * 1000);
+    Con_Printf("%u evictions (%lu bytes), %u moves, %u compactions\n", cache_stats.evictions,
+               (unsigned long)cache_stats.evicted_bytes, cache_stats.moves, cache_stats.compactions);
+}
+
 /*
  * ============
  * Cache_Report
@@ -911,18 +1254,52 @@ void Cache_Report(void) {
                 (hunkstate.size - hunkstate.highbytes - hunkstate.lowbytes) / (float)(1024 * 1024));
 }
 
-/* FIXME - Unused? */
-#if 0
+/*
+ * ============
+ * Cache_Slide
+ *
+ * Move a block down to a lower address, which may overlap the old one
+ * ============
+ */
+static cache_system_t *Cache_Slide(cache_system_t *old_cs, void *dest) {
+    cache_system_t *new_cs = dest;
+
+    Cache_GapRemove(old_cs);
+    memmove(new_cs, old_cs, old_cs->size);
+
+    new_cs->prev->next = new_cs;
+    new_cs->next->prev = new_cs;
+    new_cs->lru_prev->lru_next = new_cs;
+    new_cs->lru_next->lru_prev = new_cs;
+    new_cs->user->data = Cache_Data(new_cs);
+
+    Cache_GapUpdate(new_cs->prev);
+    Cache_GapUpdate(new_cs);
+    cache_stats.moves++;
+
+    return new_cs;
+}
+
 /*
  * ============
  * Cache_Compact
+ *
+ * Slide every block down to the low hunk mark so that all of the free cache
+ * memory ends up in one piece at the top
  * ============
  */
-static void
-Cache_Compact(void)
-{
+static void Cache_Compact(void) {
+    cache_system_t *cs, *next;
+    byte *dest;
+
+    dest = hunkstate.base + hunkstate.lowbytes;
+    for (cs = cache_head.next; cs != &cache_head; cs = next) {
+        next = cs->next;
+        if ((byte *)cs != dest) cs = Cache_Slide(cs, dest);
+        dest = (byte *)cs + cs->size;
+    }
+    cache_stats.compactions++;
 }
-#endif
 
 /*
  * ============
@@ -932,6 +1309,7 @@ Cache_Compact(void)
 static void Cache_Init(void) {
     cache_head.next = cache_head.prev = &cache_head;
     cache_head.lru_next = cache_head.lru_prev = &cache_head;
+    cache_head.gap_bucket = -1;
 }
 
 /*
@@ -947,8 +1325,10 @@ static void Cache_Dealloc(cache_user_t *c) {
     if (!c->data) Sys_Error("%s: not allocated", __func__);
 
     cs = Cache_System(c);
+    Cache_GapRemove(cs);
     cs->prev->next = cs->next;
     cs->next->prev = cs->prev;
+    Cache_GapUpdate(cs->prev);
     cs->next = cs->prev = NULL;
 
     Cache_UnlinkLRU(cs);
@@ -1009,6 +1389,9 @@ void *Cache_Alloc(cache_user_t *c, int size, const char *name) {
  */
 void *Cache_AllocPadded(cache_user_t *c, int pad, int size, const char *name) {
     cache_system_t *cs;
+    qboolean compacted;
+    double start, time;
+    int available;
 
     if (c->data) Sys_Error("%s: already allocated", __func__);
 
@@ -1016,6 +1399,9 @@ void *Cache_AllocPadded(cache_user_t *c, int pad, int size, const char *name) {
 
     size = (size + pad + sizeof(cache_system_t) + 15) & ~15;
 
+    start = Sys_DoubleTime();
+    compacted = false;
+
     /* find memory for it */
     while (1) {
         cs = Cache_TryAlloc(size, false);
@@ -1027,12 +1413,33 @@ void *Cache_AllocPadded(cache_user_t *c, int pad, int size, const char *name) {
             c->destructor = NULL;
             break;
         }
+
+        /* if the free space is only scattered, gather it up before evicting */
+        if (!compacted && cache_head.next != &cache_head) {
+            available = cache_gapbytes;
+            available += (byte *)cache_head.next - (hunkstate.base + hunkstate.lowbytes);
+            available += hunkstate.size - hunkstate.highbytes -
+                         ((byte *)cache_head.prev + cache_head.prev->size - hunkstate.base);
+            if (available >= size) {
+                Cache_Compact();
+                compacted = true;
+                continue;
+            }
+        }
+
         /* free the least recently used cache data */
         if (cache_head.lru_prev == &cache_head) Sys_Error("%s: out of memory", __func__);
         /* not enough memory at all */
+        cache_stats.evictions++;
+        cache_stats.evicted_bytes += cache_head.lru_prev->size;
         Cache_Free(cache_head.lru_prev->user);
     }
 
+    time = Sys_DoubleTime() - start;
+    cache_stats.allocs++;
+    cache_stats.alloc_time += time;
+    if (time > cache_stats.alloc_maxtime) cache_stats.alloc_maxtime = time;
+
     return Cache_Check(c);
 }
 
@@ -1046,8 +1453,16 @@ static void Cache_f(void) {
             Cache_Flush();
             return;
         }
+        if (!strcmp(Cmd_Argv(1), "compact")) {
+            Cache_Compact();
+            return;
+        }
+        if (!strcmp(Cmd_Argv(1), "stats")) {
+            Cache_Stats();
+            return;
+        }
     }
-    Con_Printf("Usage: cache print|flush\n");
+    Con_Printf("Usage: cache print|flush|compact|stats\n");
 }
 
 /* ========================================================================= */
@@ -1075,6 +1490,7 @@ size_t Memory_GetSize(void) {
 void Memory_Init(void *buf, int size) {
     int p;
     int zonesize = DYNAMIC_SIZE;
+    int slabsize;
 
     hunkstate.base = buf;
     hunkstate.size = size;
@@ -1093,6 +1509,16 @@ void Memory_Init(void *buf, int size) {
     mainzone = Hunk_AllocName(zonesize, "zone");
     Z_ClearZone(mainzone, zonesize);
 
+    slabsize = SLAB_SIZE;
+    p = COM_CheckParm("-zoneslab");
+    if (p) {
+        if (p < com_argc - 1)
+            slabsize = Q_atoi(com_argv[p + 1]) * 1024;
+        else
+            Sys_Error("%s: you must specify a size in KB after -zoneslab", __func__);
+    }
+    Z_SlabInit(slabsize);
+
     /* Needs to be added after the zone init... */
     Cmd_AddCommand("flush", Cache_Flush);
     Cmd_AddCommand("hunk", Hunk_f);